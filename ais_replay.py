@@ -0,0 +1,157 @@
+# AIS FEED replay / load generator
+# Sends a recorded AIS feed (!AIVDM lines, optionally prefixed with a
+# millisecond timestamp and ';') to the panel's NMEA 0183 UART, or generates
+# a busy harbour: N vessels sending class A/B position and static reports.
+# Requires: pip install pyserial (only for --port)
+
+# Usage:
+# python ais_replay.py recording.nmea --port /dev/ttyUSB0 --baud 38400
+# python ais_replay.py --synthetic 400 --rate 6000 --port /dev/ttyUSB0
+# python ais_replay.py --synthetic 400 --rate 6000 --duration 60 > feed.nmea
+import argparse
+import math
+import random
+import sys
+import time
+
+
+def checksum(body):
+    c = 0
+    for ch in body:
+        c ^= ord(ch)
+    return '%02X' % c
+
+
+def armor(bits):
+    """Bit string to (6-bit armored payload, fill bits)."""
+    fill = (6 - len(bits) % 6) % 6
+    bits += '0' * fill
+    out = ''
+    for i in range(0, len(bits), 6):
+        v = int(bits[i:i + 6], 2)
+        out += chr(v + 48 if v < 40 else v + 56)
+    return out, fill
+
+
+def u(v, n):
+    return format(int(v) & ((1 << n) - 1), '0%db' % n)
+
+
+def text(s, chars):
+    out = ''
+    for ch in s.upper().ljust(chars, '@')[:chars]:
+        v = ord(ch)
+        out += u(v - 64 if v >= 64 else v, 6)
+    return out
+
+
+def sentences(bits, seq):
+    payload, fill = armor(bits)
+    parts = [payload[i:i + 60] for i in range(0, len(payload), 60)]
+    for n, part in enumerate(parts, 1):
+        body = 'AIVDM,%d,%d,%s,A,%s,%d' % (len(parts), n, seq if len(parts) > 1 else '',
+                                          part, fill if n == len(parts) else 0)
+        yield '!%s*%s\r\n' % (body, checksum(body))
+
+
+class Vessel:
+    def __init__(self, i, lat, lon):
+        self.mmsi = 230000000 + i * 97
+        self.class_b = i % 3 == 0
+        self.lat = lat + random.uniform(-0.1, 0.1)
+        self.lon = lon + random.uniform(-0.2, 0.2)
+        self.sog = random.choice([0, 0, 0.2, 5, 8, 12, 18])
+        self.cog = random.uniform(0, 360)
+        self.name = 'VESSEL %d' % i
+
+    def move(self, dt):
+        d = self.sog * dt / 3600 / 60
+        self.lat += d * math.cos(math.radians(self.cog))
+        self.lon += d * math.sin(math.radians(self.cog)) / math.cos(math.radians(self.lat))
+
+    def position(self):
+        lat, lon = int(self.lat * 600000), int(self.lon * 600000)
+        if self.class_b:
+            return (u(18, 6) + u(0, 2) + u(self.mmsi, 30) + u(0, 8) + u(self.sog * 10, 10) +
+                    u(1, 1) + u(lon, 28) + u(lat, 27) + u(self.cog * 10, 12) + u(511, 9) +
+                    u(60, 6) + u(0, 2) + '0' * 8 + u(0, 20))
+        return (u(1, 6) + u(0, 2) + u(self.mmsi, 30) + u(0 if self.sog else 5, 4) + u(0, 8) +
+                u(self.sog * 10, 10) + u(1, 1) + u(lon, 28) + u(lat, 27) + u(self.cog * 10, 12) +
+                u(int(self.cog), 9) + u(60, 6) + u(0, 2) + u(0, 3) + u(0, 1) + u(0, 19))
+
+    def static(self):
+        if self.class_b:
+            return (u(24, 6) + u(0, 2) + u(self.mmsi, 30) + u(0, 2) + text(self.name, 20))
+        return (u(5, 6) + u(0, 2) + u(self.mmsi, 30) + u(0, 2) + u(0, 30) + text('CS%d' % (self.mmsi % 10000), 7) +
+                text(self.name, 20) + u(70, 8) + u(100, 9) + u(20, 9) + u(8, 6) + u(8, 6) + u(1, 4) +
+                u(0, 20) + u(60, 8) + text('HELSINKI', 20) + u(0, 1) + u(0, 1))
+
+
+def synthetic(count, rate):
+    vessels = [Vessel(i, 60.15, 24.95) for i in range(count)]
+    seq = 0
+    while True:
+        v = random.choice(vessels)
+        v.move(count / rate * 60)
+        if random.random() < 0.1:
+            seq = (seq + 1) % 10
+            yield from ((None, s) for s in sentences(v.static(), seq))
+        else:
+            yield from ((None, s) for s in sentences(v.position(), seq))
+
+
+def recorded(path):
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            stamp, sep, body = line.partition(';')
+            if sep and stamp.isdigit():
+                yield int(stamp), body + '\r\n'
+            elif line:
+                yield None, line + '\r\n'
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('recording', nargs='?')
+    parser.add_argument('--synthetic', type=int, metavar='VESSELS')
+    parser.add_argument('--rate', type=float, default=3000, help='sentences per minute without timestamps')
+    parser.add_argument('--duration', type=float, default=0, help='seconds, 0 = until the end / forever')
+    parser.add_argument('--port')
+    parser.add_argument('--baud', type=int, default=38400)
+    args = parser.parse_args()
+
+    if args.port:
+        import serial
+        out = serial.Serial(args.port, args.baud)
+        write = lambda s: out.write(s.encode())
+    else:
+        write = sys.stdout.write
+
+    feed = synthetic(args.synthetic, args.rate) if args.synthetic else recorded(args.recording)
+    interval = 60.0 / args.rate
+    start = time.time()
+    first = None
+    sent = chars = 0
+    for stamp, line in feed:
+        if stamp is not None:
+            first = stamp if first is None else first
+            due = start + (stamp - first) / 1000.0
+        else:
+            due = start + sent * interval
+        wait = due - time.time()
+        if wait > 0:
+            time.sleep(wait)
+        write(line)
+        sent += 1
+        chars += len(line)
+        if args.duration and time.time() - start >= args.duration:
+            break
+
+    elapsed = max(time.time() - start, 1e-3)
+    print('Sent {} sentences in {:.1f}s: {:.0f}/min, {:.0f} chars/s ({:.0f}% of {} baud)'.format(
+        sent, elapsed, sent / elapsed * 60, chars / elapsed,
+        chars * 10 / elapsed / args.baud * 100, args.baud), file=sys.stderr)
+
+
+main()
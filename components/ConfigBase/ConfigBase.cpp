@@ -0,0 +1,198 @@
+#include "ConfigBase.h"
+
+#include <cerrno>
+#include <cinttypes>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+
+static const char *TAG = "CONFIG";
+
+#define READ_CHUNK 128
+
+/*
+ * JsonWriter
+ * */
+
+void JsonWriter::put(const char *s, size_t len)
+{
+    if (_ok && fwrite(s, 1, len, _f) != len)
+    {
+        _ok = false;
+    }
+}
+
+void JsonWriter::beginObject()
+{
+    put("{", 1);
+    _first = true;
+}
+
+void JsonWriter::endObject()
+{
+    put("\n}\n", 3);
+}
+
+void JsonWriter::key(const char *key)
+{
+    put(_first ? "\n  " : ",\n  ", _first ? 3 : 4);
+    _first = false;
+    string(key);
+    put(": ", 2);
+}
+
+void JsonWriter::string(const char *value)
+{
+    put("\"", 1);
+    const char *run = value;
+    for (const char *p = value; *p; p++)
+    {
+        unsigned char c = *p;
+        if (c != '"' && c != '\\' && c >= 0x20)
+        {
+            continue;
+        }
+        put(run, p - run);
+        run = p + 1;
+        char esc[8];
+        switch (c)
+        {
+        case '"':
+            put("\\\"", 2);
+            break;
+        case '\\':
+            put("\\\\", 2);
+            break;
+        case '\n':
+            put("\\n", 2);
+            break;
+        case '\t':
+            put("\\t", 2);
+            break;
+        default:
+            put(esc, snprintf(esc, sizeof(esc), "\\u%04x", c));
+        }
+    }
+    put(run, strlen(run));
+    put("\"", 1);
+}
+
+void JsonWriter::field(const char *key, bool value)
+{
+    this->key(key);
+    put(value ? "true" : "false", value ? 4 : 5);
+}
+
+void JsonWriter::field(const char *key, int64_t value)
+{
+    char buf[24];
+    this->key(key);
+    put(buf, snprintf(buf, sizeof(buf), "%" PRId64, value));
+}
+
+void JsonWriter::field(const char *key, uint64_t value)
+{
+    char buf[24];
+    this->key(key);
+    put(buf, snprintf(buf, sizeof(buf), "%" PRIu64, value));
+}
+
+void JsonWriter::field(const char *key, double value, int digits)
+{
+    char buf[32];
+    this->key(key);
+    if (!std::isfinite(value))
+    {
+        put("null", 4); // JSON has no NaN or infinity, load() skips null
+        return;
+    }
+    put(buf, snprintf(buf, sizeof(buf), "%.*g", digits, value));
+}
+
+void JsonWriter::field(const char *key, const std::string &value)
+{
+    this->key(key);
+    string(value.c_str());
+}
+
+/*
+ * Files
+ * */
+
+static bool exists(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+esp_err_t config_write_file(const char *path, void (*write)(JsonWriter &, const void *), const void *arg)
+{
+    const std::string tmp = std::string(path) + ".tmp";
+    const std::string bak = std::string(path) + ".bak";
+    FILE *f = fopen(tmp.c_str(), "w");
+    if (f == NULL)
+    {
+        ESP_LOGE(TAG, "Can't create %s: %s", tmp.c_str(), strerror(errno));
+        return ESP_FAIL;
+    }
+    JsonWriter writer(f);
+    write(writer, arg);
+    bool ok = writer.ok() && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "Can't write %s", tmp.c_str());
+        unlink(tmp.c_str());
+        return ESP_FAIL;
+    }
+
+    // SPIFFS and FAT refuse to rename onto an existing file, so the old one
+    // moves aside first and load() looks for it there
+    unlink(bak.c_str());
+    if (exists(path) && rename(path, bak.c_str()) != 0)
+    {
+        ESP_LOGE(TAG, "Can't rename %s: %s", path, strerror(errno));
+        unlink(tmp.c_str());
+        return ESP_FAIL;
+    }
+    if (rename(tmp.c_str(), path) != 0)
+    {
+        ESP_LOGE(TAG, "Can't rename %s: %s", tmp.c_str(), strerror(errno));
+        return ESP_FAIL;
+    }
+    unlink(bak.c_str());
+    return ESP_OK;
+}
+
+esp_err_t config_read_file(const char *path, JsonSax &sax, const bool &complete)
+{
+    std::string name = path;
+    FILE *f = fopen(name.c_str(), "r");
+    if (f == NULL)
+    {
+        // Power lost between the two renames of config_write_file()
+        name += ".bak";
+        f = fopen(name.c_str(), "r");
+        if (f == NULL)
+        {
+            return ESP_ERR_NOT_FOUND;
+        }
+        ESP_LOGW(TAG, "%s missing, reading %s", path, name.c_str());
+    }
+    char buf[READ_CHUNK];
+    size_t len;
+    bool ok = true;
+    while (ok && (len = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        ok = sax.feed(buf, len);
+    }
+    fclose(f);
+    if (!ok || !complete)
+    {
+        ESP_LOGE(TAG, "%s is not a complete JSON document", name.c_str());
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
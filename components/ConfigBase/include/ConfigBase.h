@@ -0,0 +1,260 @@
+#ifndef _CONFIG_BASE_H_
+#define _CONFIG_BASE_H_
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "esp_err.h"
+#include "JsonSax.h"
+
+/*
+    Base class for config structs kept as flat JSON files.
+
+    The struct lists its fields once, as a constexpr tuple of key and member:
+
+        struct NetConfig : ConfigBase<NetConfig>
+        {
+            std::string host = "192.168.1.128";
+            uint16_t port = 443;
+            bool tls = true;
+
+            static constexpr auto fields = std::make_tuple(
+                configField("host", &NetConfig::host),
+                configField("port", &NetConfig::port),
+                configField("tls", &NetConfig::tls));
+        };
+
+    save() streams the fields straight to the file. load() feeds the file
+    through JsonSax in small chunks. Neither builds a DOM or allocates beyond
+    the std::string members.
+
+    save() writes path.tmp first and then renames it. The previous file is
+    kept as path.bak until the new one is in place. If the device loses power
+    in between, load() falls back to path.bak.
+
+    Fields may be bool, integers, float, double or std::string. Strings are
+    limited to JSON_SAX_MAX_STRING characters; longer ones are not loaded.
+    load() keeps the current value of a missing field. It rejects a value of
+    the wrong type, a non-integral number for an integer field and a value
+    out of the field's range. It ignores unknown keys and nested values, so
+    files from older and newer firmware still load. When load() fails, fields
+    read before the error are already set, so load into a copy.
+*/
+
+template <typename C, typename T>
+struct ConfigField
+{
+    const char *key;
+    T C::*member;
+};
+
+template <typename C, typename T>
+constexpr ConfigField<C, T> configField(const char *key, T C::*member)
+{
+    return ConfigField<C, T>{key, member};
+}
+
+// Streams one flat JSON object to a file
+class JsonWriter
+{
+public:
+    explicit JsonWriter(FILE *f) : _f(f), _first(true), _ok(true) {}
+
+    void beginObject();
+    void endObject();
+    void field(const char *key, bool value);
+    void field(const char *key, int64_t value);
+    void field(const char *key, uint64_t value);
+    void field(const char *key, double value, int digits);
+    void field(const char *key, const std::string &value);
+
+    // false once a write failed
+    bool ok() const { return _ok; }
+
+private:
+    void key(const char *key);
+    void string(const char *value);
+    void put(const char *s, size_t len);
+
+    FILE *_f;
+    bool _first;
+    bool _ok;
+};
+
+/* Writes path atomically as described above; write() streams the content */
+esp_err_t config_write_file(const char *path, void (*write)(JsonWriter &, const void *), const void *arg);
+
+/* Feeds path (or path.bak) to the parser. ESP_ERR_NOT_FOUND without either
+ * file, ESP_ERR_INVALID_RESPONSE for a malformed or incomplete document. */
+esp_err_t config_read_file(const char *path, JsonSax &sax, const bool &complete);
+
+template <typename Derived>
+class ConfigBase
+{
+public:
+    esp_err_t save(const char *path) const
+    {
+        return config_write_file(path, &ConfigBase::write, static_cast<const Derived *>(this));
+    }
+
+    esp_err_t load(const char *path)
+    {
+        Reader reader(*static_cast<Derived *>(this));
+        esp_err_t err = config_read_file(path, reader.sax, reader.complete);
+        _loaded = reader.loaded;
+        _rejected = reader.rejected;
+        return err;
+    }
+
+    // Fields set and fields rejected by the last load()
+    size_t loaded() const { return _loaded; }
+    size_t rejected() const { return _rejected; }
+
+protected:
+    ConfigBase() : _loaded(0), _rejected(0) {}
+
+private:
+    // A function, since Derived is still incomplete where ConfigBase<Derived> is instantiated
+    static constexpr auto indices()
+    {
+        return std::make_index_sequence<std::tuple_size<std::remove_const_t<decltype(Derived::fields)>>::value>{};
+    }
+
+    template <typename T>
+    static void writeValue(JsonWriter &w, const char *key, const T &value)
+    {
+        if constexpr (std::is_same<T, bool>::value || std::is_same<T, std::string>::value)
+        {
+            w.field(key, value);
+        }
+        else if constexpr (std::is_floating_point<T>::value)
+        {
+            w.field(key, (double)value, std::numeric_limits<T>::max_digits10);
+        }
+        else if constexpr (std::is_signed<T>::value)
+        {
+            w.field(key, (int64_t)value);
+        }
+        else
+        {
+            w.field(key, (uint64_t)value);
+        }
+    }
+
+    template <size_t... I>
+    static void writeFields(JsonWriter &w, const Derived &self, std::index_sequence<I...>)
+    {
+        (writeValue(w, std::get<I>(Derived::fields).key, self.*std::get<I>(Derived::fields).member), ...);
+    }
+
+    static void write(JsonWriter &w, const void *arg)
+    {
+        w.beginObject();
+        writeFields(w, *static_cast<const Derived *>(arg), indices());
+        w.endObject();
+    }
+
+    template <typename T>
+    static bool assignNumber(T &dst, double value)
+    {
+        if constexpr (std::is_same<T, bool>::value || std::is_same<T, std::string>::value)
+        {
+            return false;
+        }
+        else if constexpr (std::is_integral<T>::value)
+        {
+            // max() + 1.0 is exact, also where max() itself is not a double
+            if (value != std::floor(value) || value < (double)std::numeric_limits<T>::lowest() ||
+                !(value < (double)std::numeric_limits<T>::max() + 1.0))
+            {
+                return false;
+            }
+            dst = (T)value;
+            return true;
+        }
+        else
+        {
+            dst = (T)value;
+            return true;
+        }
+    }
+
+    template <typename T>
+    static bool assignBool(T &dst, bool value)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+        {
+            dst = value;
+            return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    static bool assignString(T &dst, const char *value)
+    {
+        if constexpr (std::is_same<T, std::string>::value)
+        {
+            dst = value;
+            return true;
+        }
+        return false;
+    }
+
+    struct Reader : JsonHandler
+    {
+        explicit Reader(Derived &self) : sax(*this), self(self), complete(false), loaded(0), rejected(0) {}
+
+        // Calls assign(member) for the field named by the current key, if any
+        template <typename F, size_t... I>
+        void apply(F assign, std::index_sequence<I...>)
+        {
+            if (sax.depth() != 1)
+            {
+                return;
+            }
+            bool matched = false;
+            bool ok = false;
+            (void)((std::strcmp(sax.key(), std::get<I>(Derived::fields).key) == 0 &&
+                    (matched = true, ok = assign(self.*std::get<I>(Derived::fields).member), true)) ||
+                   ...);
+            if (matched)
+            {
+                ok ? loaded++ : rejected++;
+            }
+        }
+
+        void onNumber(double value) override
+        {
+            apply([value](auto &member) { return assignNumber(member, value); }, indices());
+        }
+        void onBool(bool value) override
+        {
+            apply([value](auto &member) { return assignBool(member, value); }, indices());
+        }
+        void onString(const char *value) override
+        {
+            // truncated() stays set for the document, the length tells which string
+            bool truncated = sax.truncated() && std::strlen(value) >= JSON_SAX_MAX_STRING;
+            apply([value, truncated](auto &member) { return !truncated && assignString(member, value); }, indices());
+        }
+        void onDocumentEnd() override { complete = true; }
+
+        JsonSax sax;
+        Derived &self;
+        bool complete;
+        size_t loaded;
+        size_t rejected;
+    };
+
+    size_t _loaded;
+    size_t _rejected;
+};
+
+#endif
@@ -0,0 +1,350 @@
+#include "JsonSax.h"
+
+#include <cstdlib>
+#include <cstring>
+
+JsonSax::JsonSax(JsonHandler &handler, bool single) : _handler(handler), _single(single)
+{
+    reset();
+}
+
+void JsonSax::reset()
+{
+    _state = ST_VALUE;
+    _isKey = false;
+    _truncated = false;
+    _depth = 0;
+    _unicodeDigits = 0;
+    _unicode = 0;
+    _stack = 0;
+    _len = 0;
+    _buf[0] = '\0';
+    _key[0] = '\0';
+}
+
+bool JsonSax::feed(const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && _state != ST_ERROR; i++)
+    {
+        // Numbers and literals end on the first character that is not theirs,
+        // which then has to be parsed again as a separator
+        if (!step(data[i]))
+        {
+            if (_state != ST_ERROR && !step(data[i]))
+            {
+                _state = ST_ERROR;
+            }
+        }
+    }
+    return _state != ST_ERROR;
+}
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Returns false when the character was not consumed (end of a number or
+ * literal) or on error (state set to ST_ERROR).
+ * */
+
+bool JsonSax::step(char c)
+{
+    switch (_state)
+    {
+    case ST_VALUE:
+        if (isSpace(c))
+            return true;
+        return startValue(c);
+
+    case ST_VALUE_OR_END:
+        if (isSpace(c))
+            return true;
+        if (c == ']')
+            return pop(false);
+        return startValue(c);
+
+    case ST_KEY_OR_END:
+        if (c == '}')
+            return pop(true);
+        // fall through
+    case ST_KEY:
+        if (isSpace(c))
+            return true;
+        if (c != '"')
+            break;
+        _isKey = true;
+        _len = 0;
+        _state = ST_STRING;
+        return true;
+
+    case ST_COLON:
+        if (isSpace(c))
+            return true;
+        if (c != ':')
+            break;
+        _state = ST_VALUE;
+        return true;
+
+    case ST_AFTER_VALUE:
+        if (isSpace(c))
+            return true;
+        if (c == ',' && _depth > 0)
+        {
+            _state = inObject() ? ST_KEY : ST_VALUE;
+            return true;
+        }
+        if (c == '}')
+            return pop(true);
+        if (c == ']')
+            return pop(false);
+        break;
+
+    case ST_STRING:
+        if (c == '"')
+        {
+            emitString();
+            return true;
+        }
+        if (c == '\\')
+        {
+            _state = ST_STRING_ESC;
+            return true;
+        }
+        // Control characters, NUL included, must be escaped
+        if (static_cast<unsigned char>(c) < 0x20)
+            break;
+        append(c);
+        return true;
+
+    case ST_STRING_ESC:
+        _state = ST_STRING;
+        switch (c)
+        {
+        case 'b': append('\b'); return true;
+        case 'f': append('\f'); return true;
+        case 'n': append('\n'); return true;
+        case 'r': append('\r'); return true;
+        case 't': append('\t'); return true;
+        case 'u':
+            _unicode = 0;
+            _unicodeDigits = 0;
+            _state = ST_STRING_UNICODE;
+            return true;
+        case '"':
+        case '\\':
+        case '/': append(c); return true;
+        }
+        break;
+
+    case ST_STRING_UNICODE:
+    {
+        int v = hexValue(c);
+        if (v < 0)
+            break;
+        _unicode = (_unicode << 4) | v;
+        if (++_unicodeDigits == 4)
+        {
+            appendUtf8(_unicode);
+            _state = ST_STRING;
+        }
+        return true;
+    }
+
+    case ST_NUMBER:
+        if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+        {
+            append(c);
+            return true;
+        }
+        _buf[_len] = '\0';
+        {
+            char *end = nullptr;
+            double v = strtod(_buf, &end);
+            if (end == _buf || *end != '\0')
+                break;
+            _handler.onNumber(v);
+        }
+        endValue();
+        return false;
+
+    case ST_LITERAL:
+        if (c >= 'a' && c <= 'z')
+        {
+            append(c);
+            return true;
+        }
+        if (!emitLiteral())
+            break;
+        endValue();
+        return false;
+
+    case ST_END:
+        if (isSpace(c))
+            return true;
+        break;
+
+    case ST_ERROR:
+        return false;
+    }
+
+    _state = ST_ERROR;
+    return false;
+}
+
+bool JsonSax::startValue(char c)
+{
+    _len = 0;
+    switch (c)
+    {
+    case '{':
+        if (!push(true))
+            return false;
+        _handler.onObjectStart();
+        _state = ST_KEY_OR_END;
+        return true;
+    case '[':
+        if (!push(false))
+            return false;
+        _handler.onArrayStart();
+        _state = ST_VALUE_OR_END;
+        return true;
+    case '"':
+        _isKey = false;
+        _state = ST_STRING;
+        return true;
+    case 't':
+    case 'f':
+    case 'n':
+        append(c);
+        _state = ST_LITERAL;
+        return true;
+    default:
+        if (c == '-' || (c >= '0' && c <= '9'))
+        {
+            append(c);
+            _state = ST_NUMBER;
+            return true;
+        }
+        _state = ST_ERROR;
+        return false;
+    }
+}
+
+void JsonSax::endValue()
+{
+    _state = ST_AFTER_VALUE;
+    if (_depth == 0)
+    {
+        _handler.onDocumentEnd();
+        // Otherwise ready for the next document in the stream
+        _state = _single ? ST_END : ST_VALUE;
+    }
+}
+
+bool JsonSax::push(bool object)
+{
+    if (_depth >= JSON_SAX_MAX_DEPTH)
+    {
+        _state = ST_ERROR;
+        return false;
+    }
+    if (object)
+        _stack |= (1UL << _depth);
+    else
+        _stack &= ~(1UL << _depth);
+    _depth++;
+    return true;
+}
+
+bool JsonSax::pop(bool object)
+{
+    if (_depth == 0 || inObject() != object)
+    {
+        _state = ST_ERROR;
+        return false;
+    }
+    if (object)
+        _handler.onObjectEnd();
+    else
+        _handler.onArrayEnd();
+    _depth--;
+    endValue();
+    return true;
+}
+
+bool JsonSax::inObject() const
+{
+    return _depth > 0 && (_stack & (1UL << (_depth - 1)));
+}
+
+void JsonSax::append(char c)
+{
+    if (_len < JSON_SAX_MAX_STRING)
+        _buf[_len++] = c;
+    else
+        _truncated = true;
+}
+
+void JsonSax::appendUtf8(uint32_t cp)
+{
+    if (cp < 0x80)
+    {
+        append(cp);
+    }
+    else if (cp < 0x800)
+    {
+        append(0xC0 | (cp >> 6));
+        append(0x80 | (cp & 0x3F));
+    }
+    else if (cp >= 0xD800 && cp <= 0xDFFF)
+    {
+        append('?'); // surrogate pairs are not needed for our data
+    }
+    else
+    {
+        append(0xE0 | (cp >> 12));
+        append(0x80 | ((cp >> 6) & 0x3F));
+        append(0x80 | (cp & 0x3F));
+    }
+}
+
+void JsonSax::emitString()
+{
+    _buf[_len] = '\0';
+    if (_isKey)
+    {
+        memcpy(_key, _buf, _len + 1);
+        _handler.onKey(_key);
+        _state = ST_COLON;
+        return;
+    }
+    _handler.onString(_buf);
+    endValue();
+}
+
+bool JsonSax::emitLiteral()
+{
+    _buf[_len] = '\0';
+    if (strcmp(_buf, "true") == 0)
+        _handler.onBool(true);
+    else if (strcmp(_buf, "false") == 0)
+        _handler.onBool(false);
+    else if (strcmp(_buf, "null") == 0)
+        _handler.onNull();
+    else
+        return false;
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef _JSON_SAX_H_
+#define _JSON_SAX_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+    Incremental (SAX style) JSON parser.
+    Input can be fed in chunks of any size, split anywhere. Memory use is
+    fixed: one string buffer and a nesting stack, no DOM and no heap.
+    Strings longer than JSON_SAX_MAX_STRING are truncated (see truncated()).
+    By default documents may follow each other in the stream; a single
+    document parser rejects anything but whitespace after the first one.
+*/
+
+#define JSON_SAX_MAX_STRING 96
+#define JSON_SAX_MAX_DEPTH 32
+
+class JsonHandler
+{
+public:
+    virtual ~JsonHandler() = default;
+    // depth() is the depth inside the new container
+    virtual void onObjectStart() {}
+    // depth() is still the depth inside the closing container
+    virtual void onObjectEnd() {}
+    virtual void onArrayStart() {}
+    virtual void onArrayEnd() {}
+    virtual void onKey(const char * /*key*/) {}
+    virtual void onString(const char * /*value*/) {}
+    virtual void onNumber(double /*value*/) {}
+    virtual void onBool(bool /*value*/) {}
+    virtual void onNull() {}
+    // A complete top level value was parsed
+    virtual void onDocumentEnd() {}
+};
+
+class JsonSax
+{
+public:
+    explicit JsonSax(JsonHandler &handler, bool single = false);
+
+    // Parses a chunk. Returns false once the input is malformed.
+    bool feed(const char *data, size_t len);
+    // Forgets any partial document, e.g. at the start of a new message
+    void reset();
+
+    bool error() const { return _state == ST_ERROR; }
+    bool truncated() const { return _truncated; }
+    uint8_t depth() const { return _depth; }
+    // Last object key read; the key of the value being reported
+    // (values inside arrays report the key of the array)
+    const char *key() const { return _key; }
+
+private:
+    enum State : uint8_t
+    {
+        ST_VALUE,
+        ST_VALUE_OR_END,
+        ST_KEY,
+        ST_KEY_OR_END,
+        ST_COLON,
+        ST_AFTER_VALUE,
+        ST_STRING,
+        ST_STRING_ESC,
+        ST_STRING_UNICODE,
+        ST_NUMBER,
+        ST_LITERAL,
+        ST_END, // after a single document
+        ST_ERROR
+    };
+
+    bool step(char c);
+    bool startValue(char c);
+    void endValue();
+    bool push(bool object);
+    bool pop(bool object);
+    bool inObject() const;
+    void append(char c);
+    void appendUtf8(uint32_t cp);
+    void emitString();
+    bool emitLiteral();
+
+    JsonHandler &_handler;
+    const bool _single;
+    State _state;
+    bool _isKey;
+    bool _truncated;
+    uint8_t _depth;
+    uint8_t _unicodeDigits;
+    uint32_t _unicode;
+    uint32_t _stack; // bit n set => depth n+1 is an object
+    size_t _len;
+    char _buf[JSON_SAX_MAX_STRING + 1];
+    char _key[JSON_SAX_MAX_STRING + 1];
+};
+
+#endif
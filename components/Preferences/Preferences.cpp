@@ -18,6 +18,7 @@
 #include <cmath>
 
 #include "esp_log.h"
+#include "esp_system.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 
@@ -27,11 +28,51 @@ const char *nvs_errors[] = {"OTHER", "NOT_INITIALIZED", "NOT_FOUND", "TYPE_MISMA
                             "INVALID_HANDLE", "REMOVE_FAILED", "KEY_TOO_LONG", "PAGE_FULL", "INVALID_STATE", "INVALID_LENGTH"};
 #define nvs_error(e) (((e) > ESP_ERR_NVS_BASE) ? nvs_errors[(e) & ~(ESP_ERR_NVS_BASE)] : nvs_errors[0])
 
-Preferences::Preferences() : _handle(0), _started(false), _readOnly(false) {}
+// Write-back instances, flushed together before a restart
+static Preferences *s_writeBackList = NULL;
+static bool s_shutdownHandler = false;
+
+static const char *type_names[] = {"i8", "u8", "i16", "u16", "i32", "u32", "i64", "u64", "str", "blob"};
+
+// Holds the write-back mutex for a scope; no-op while it does not exist
+class PreferencesLock
+{
+    SemaphoreHandle_t _mutex;
+
+public:
+    explicit PreferencesLock(SemaphoreHandle_t mutex) : _mutex(mutex)
+    {
+        if (_mutex)
+        {
+            xSemaphoreTake(_mutex, portMAX_DELAY);
+        }
+    }
+    ~PreferencesLock()
+    {
+        if (_mutex)
+        {
+            xSemaphoreGive(_mutex);
+        }
+    }
+};
+
+Preferences::Preferences()
+    : _handle(0), _started(false), _readOnly(false), _writeBack(false), _debounceMs(0), _mutex(NULL), _timer(NULL),
+      _stats(), _nextWriteBack(NULL)
+{
+}
 
 Preferences::~Preferences()
 {
     end();
+    if (_timer)
+    {
+        esp_timer_delete(_timer);
+    }
+    if (_mutex)
+    {
+        vSemaphoreDelete(_mutex);
+    }
 }
 
 bool Preferences::begin(const char *name, bool readOnly, const char *partition_label)
@@ -71,188 +112,415 @@ void Preferences::end()
     {
         return;
     }
+    setWriteBack(false);
     nvs_close(_handle);
     _started = false;
 }
 
 /*
- * Clear all keys in opened preferences
+ * Write-back cache
  * */
 
-bool Preferences::clear()
+static void flush_on_shutdown()
+{
+    Preferences::flushAll();
+}
+
+bool Preferences::setWriteBack(bool enable, uint32_t debounceMs)
 {
     if (!_started || _readOnly)
     {
-        return false;
+        return !enable;
     }
-    esp_err_t err = nvs_erase_all(_handle);
-    if (err)
+    if (!enable)
     {
-        ESP_LOGE(TAG, "nvs_erase_all fail: %s", nvs_error(err));
-        return false;
+        if (!_writeBack)
+        {
+            return true;
+        }
+        bool ok = flush();
+        esp_timer_stop(_timer);
+        for (Preferences **p = &s_writeBackList; *p; p = &(*p)->_nextWriteBack)
+        {
+            if (*p == this)
+            {
+                *p = _nextWriteBack;
+                break;
+            }
+        }
+        PreferencesLock lock(_mutex);
+        _writeBack = false;
+        _cache.clear();
+        return ok;
     }
-    err = nvs_commit(_handle);
-    if (err)
+
+    if (!_mutex && (_mutex = xSemaphoreCreateMutex()) == NULL)
     {
-        ESP_LOGE(TAG, "nvs_commit fail: %s", nvs_error(err));
         return false;
     }
+    if (!_timer)
+    {
+        const esp_timer_create_args_t args = {
+            .callback = &Preferences::debounced,
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "preferences",
+            .skip_unhandled_events = true};
+        esp_err_t err = esp_timer_create(&args, &_timer);
+        if (err)
+        {
+            ESP_LOGE(TAG, "esp_timer_create fail: %s", esp_err_to_name(err));
+            return false;
+        }
+    }
+    _debounceMs = debounceMs;
+    if (!_writeBack)
+    {
+        _nextWriteBack = s_writeBackList;
+        s_writeBackList = this;
+        if (!s_shutdownHandler)
+        {
+            s_shutdownHandler = esp_register_shutdown_handler(flush_on_shutdown) == ESP_OK;
+        }
+        _writeBack = true;
+    }
     return true;
 }
 
-/*
- * Remove a key
- * */
+void Preferences::debounced(void *arg)
+{
+    static_cast<Preferences *>(arg)->flush();
+}
 
-bool Preferences::remove(const char *key)
+bool Preferences::flush()
 {
-    if (!_started || !key || _readOnly)
+    if (!_started || !_writeBack)
     {
-        return false;
+        return _started;
     }
-    esp_err_t err = nvs_erase_key(_handle, key);
-    if (err)
+    PreferencesLock lock(_mutex);
+    esp_err_t result = ESP_OK;
+    int written = 0;
+    for (auto &item : _cache)
     {
-        ESP_LOGE(TAG, "nvs_erase_key fail: %s %s", key, nvs_error(err));
-        return false;
+        Entry &e = item.second;
+        if (!e.dirty)
+        {
+            continue;
+        }
+        esp_err_t err;
+        if (e.erased)
+        {
+            _stats.nvsSets++;
+            err = nvs_erase_key(_handle, item.first.c_str());
+            if (err == ESP_ERR_NVS_NOT_FOUND)
+            {
+                err = ESP_OK;
+            }
+        }
+        else
+        {
+            err = nvsSet(item.first.c_str(), e.type, e.data.data(), e.data.size());
+        }
+        if (err)
+        {
+            result = err;   // stays dirty for the next flush
+            continue;
+        }
+        e.dirty = false;
+        written++;
     }
-    err = nvs_commit(_handle);
-    if (err)
+    if (written)
     {
-        ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
-        return false;
+        esp_err_t err = commit();
+        if (err)
+        {
+            ESP_LOGE(TAG, "nvs_commit fail: %s", nvs_error(err));
+            result = err;
+        }
     }
-    return true;
+    return result == ESP_OK;
 }
 
-/*
- * Put a key value
- * */
-
-size_t Preferences::putChar(const char *key, int8_t value)
+size_t Preferences::pending() const
 {
-    if (!_started || !key || _readOnly)
-    {
-        return 0;
-    }
-    esp_err_t err = nvs_set_i8(_handle, key, value);
-    if (err)
+    PreferencesLock lock(_mutex);
+    size_t n = 0;
+    for (const auto &item : _cache)
     {
-        ESP_LOGE(TAG, "nvs_set_i8 fail: %s %s", key, nvs_error(err));
-        return 0;
+        n += item.second.dirty;
     }
-    err = nvs_commit(_handle);
-    if (err)
+    return n;
+}
+
+void Preferences::flushAll()
+{
+    for (Preferences *p = s_writeBackList; p; p = p->_nextWriteBack)
     {
-        ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
-        return 0;
+        p->flush();
     }
-    return 1;
 }
 
-size_t Preferences::putUChar(const char *key, uint8_t value)
+bool Preferences::cached(const char *key, PreferenceType type, std::string &data, bool &found) const
 {
-    if (!_started || !key || _readOnly)
+    if (!_writeBack)
     {
-        return 0;
+        return false;
     }
-    esp_err_t err = nvs_set_u8(_handle, key, value);
-    if (err)
+    PreferencesLock lock(_mutex);
+    auto it = _cache.find(key);
+    if (it == _cache.end())
     {
-        ESP_LOGE(TAG, "nvs_set_u8 fail: %s %s", key, nvs_error(err));
-        return 0;
+        _stats.cacheMisses++;
+        return false;
     }
-    err = nvs_commit(_handle);
-    if (err)
+    _stats.cacheHits++;
+    // NVS keeps one type per key, anything else reads as missing
+    found = !it->second.erased && it->second.type == type;
+    if (found)
     {
-        ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
-        return 0;
+        data = it->second.data;
     }
-    return 1;
+    return true;
 }
 
-size_t Preferences::putShort(const char *key, int16_t value)
+bool Preferences::cachedScalar(const char *key, PreferenceType type, void *value, size_t len) const
 {
-    if (!_started || !key || _readOnly)
+    std::string data;
+    bool found = false;
+    if (!cached(key, type, data, found))
     {
-        return 0;
+        return false;
     }
-    esp_err_t err = nvs_set_i16(_handle, key, value);
-    if (err)
+    if (found && data.size() == len)
     {
-        ESP_LOGE(TAG, "nvs_set_i16 fail: %s %s", key, nvs_error(err));
-        return 0;
+        memcpy(value, data.data(), len);
     }
-    err = nvs_commit(_handle);
-    if (err)
+    return true;
+}
+
+/* Keeps a value just read from NVS, so the next read stays in RAM */
+void Preferences::remember(const char *key, PreferenceType type, const void *value, size_t len) const
+{
+    if (!_writeBack)
     {
-        ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
-        return 0;
+        return;
     }
-    return 2;
+    PreferencesLock lock(_mutex);
+    _cache.emplace(key, Entry{type, std::string(static_cast<const char *>(value), len), false, false});
 }
 
-size_t Preferences::putUShort(const char *key, uint16_t value)
+/*
+ * Clear all keys in opened preferences
+ * */
+
+bool Preferences::clear()
 {
-    if (!_started || !key || _readOnly)
+    if (!_started || _readOnly)
     {
-        return 0;
+        return false;
     }
-    esp_err_t err = nvs_set_u16(_handle, key, value);
+    PreferencesLock lock(_mutex);
+    if (_writeBack)
+    {
+        esp_timer_stop(_timer);
+        _cache.clear();
+    }
+    esp_err_t err = nvs_erase_all(_handle);
     if (err)
     {
-        ESP_LOGE(TAG, "nvs_set_u16 fail: %s %s", key, nvs_error(err));
-        return 0;
+        ESP_LOGE(TAG, "nvs_erase_all fail: %s", nvs_error(err));
+        return false;
     }
-    err = nvs_commit(_handle);
+    err = commit();
     if (err)
     {
-        ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
-        return 0;
+        ESP_LOGE(TAG, "nvs_commit fail: %s", nvs_error(err));
+        return false;
     }
-    return 2;
+    return true;
 }
 
-size_t Preferences::putInt(const char *key, int32_t value)
+/*
+ * Remove a key
+ * */
+
+bool Preferences::remove(const char *key)
 {
     if (!_started || !key || _readOnly)
     {
-        return 0;
+        return false;
+    }
+    if (_writeBack)
+    {
+        {
+            PreferencesLock lock(_mutex);
+            Entry &e = _cache[key];
+            e.type = PT_INVALID;
+            e.data.clear();
+            e.erased = true;
+            e.dirty = true;
+        }
+        if (_debounceMs)
+        {
+            esp_timer_stop(_timer);
+            esp_timer_start_once(_timer, _debounceMs * 1000ULL);
+        }
+        return true;
     }
-    esp_err_t err = nvs_set_i32(_handle, key, value);
+    _stats.nvsSets++;
+    esp_err_t err = nvs_erase_key(_handle, key);
     if (err)
     {
-        ESP_LOGE(TAG, "nvs_set_i32 fail: %s %s", key, nvs_error(err));
-        return 0;
+        ESP_LOGE(TAG, "nvs_erase_key fail: %s %s", key, nvs_error(err));
+        return false;
     }
-    err = nvs_commit(_handle);
+    err = commit();
     if (err)
     {
         ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
-        return 0;
+        return false;
     }
-    return 4;
+    return true;
 }
 
-size_t Preferences::putUInt(const char *key, uint32_t value)
+/*
+ * Put a key value
+ * */
+
+esp_err_t Preferences::nvsSet(const char *key, PreferenceType type, const void *value, size_t len)
+{
+    // value may sit unaligned in a cache string
+    uint64_t v = 0;
+    if (type < PT_STR)
+    {
+        memcpy(&v, value, len);
+    }
+    esp_err_t err;
+    switch (type)
+    {
+    case PT_I8:
+        err = nvs_set_i8(_handle, key, (int8_t)v);
+        break;
+    case PT_U8:
+        err = nvs_set_u8(_handle, key, (uint8_t)v);
+        break;
+    case PT_I16:
+        err = nvs_set_i16(_handle, key, (int16_t)v);
+        break;
+    case PT_U16:
+        err = nvs_set_u16(_handle, key, (uint16_t)v);
+        break;
+    case PT_I32:
+        err = nvs_set_i32(_handle, key, (int32_t)v);
+        break;
+    case PT_U32:
+        err = nvs_set_u32(_handle, key, (uint32_t)v);
+        break;
+    case PT_I64:
+        err = nvs_set_i64(_handle, key, (int64_t)v);
+        break;
+    case PT_U64:
+        err = nvs_set_u64(_handle, key, v);
+        break;
+    case PT_STR:
+        err = nvs_set_str(_handle, key, (const char *)value);
+        break;
+    case PT_BLOB:
+        err = nvs_set_blob(_handle, key, value, len);
+        break;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+    _stats.nvsSets++;
+    if (err)
+    {
+        ESP_LOGE(TAG, "nvs_set_%s fail: %s %s", type_names[type], key, nvs_error(err));
+    }
+    return err;
+}
+
+esp_err_t Preferences::commit()
+{
+    _stats.nvsCommits++;
+    return nvs_commit(_handle);
+}
+
+/* Sets and commits, or in write-back mode only updates the cache */
+size_t Preferences::put(const char *key, PreferenceType type, const void *value, size_t len)
 {
     if (!_started || !key || _readOnly)
     {
         return 0;
     }
-    esp_err_t err = nvs_set_u32(_handle, key, value);
-    if (err)
+    if (!_writeBack)
     {
-        ESP_LOGE(TAG, "nvs_set_u32 fail: %s %s", key, nvs_error(err));
-        return 0;
+        if (nvsSet(key, type, value, len))
+        {
+            return 0;
+        }
+        esp_err_t err = commit();
+        if (err)
+        {
+            ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
+            return 0;
+        }
+        return len;
     }
-    err = nvs_commit(_handle);
-    if (err)
+    if (strlen(key) > NVS_KEY_NAME_MAX_SIZE - 1)
     {
-        ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
+        ESP_LOGE(TAG, "key too long: %s", key);
         return 0;
     }
-    return 4;
+    {
+        PreferencesLock lock(_mutex);
+        Entry &e = _cache[key];
+        if (!e.erased && e.type == type && e.data.size() == len && memcmp(e.data.data(), value, len) == 0)
+        {
+            return len; // unchanged, nothing to write
+        }
+        e.type = type;
+        e.data.assign(static_cast<const char *>(value), len);
+        e.erased = false;
+        e.dirty = true;
+    }
+    if (_debounceMs)
+    {
+        // Restarted by every put, so a burst ends in a single commit
+        esp_timer_stop(_timer);
+        esp_timer_start_once(_timer, _debounceMs * 1000ULL);
+    }
+    return len;
+}
+
+size_t Preferences::putChar(const char *key, int8_t value)
+{
+    return put(key, PT_I8, &value, sizeof(value));
+}
+
+size_t Preferences::putUChar(const char *key, uint8_t value)
+{
+    return put(key, PT_U8, &value, sizeof(value));
+}
+
+size_t Preferences::putShort(const char *key, int16_t value)
+{
+    return put(key, PT_I16, &value, sizeof(value));
+}
+
+size_t Preferences::putUShort(const char *key, uint16_t value)
+{
+    return put(key, PT_U16, &value, sizeof(value));
+}
+
+size_t Preferences::putInt(const char *key, int32_t value)
+{
+    return put(key, PT_I32, &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value)
+{
+    return put(key, PT_U32, &value, sizeof(value));
 }
 
 size_t Preferences::putLong(const char *key, int32_t value)
@@ -267,44 +535,12 @@ size_t Preferences::putULong(const char *key, uint32_t value)
 
 size_t Preferences::putLong64(const char *key, int64_t value)
 {
-    if (!_started || !key || _readOnly)
-    {
-        return 0;
-    }
-    esp_err_t err = nvs_set_i64(_handle, key, value);
-    if (err)
-    {
-        ESP_LOGE(TAG, "nvs_set_i64 fail: %s %s", key, nvs_error(err));
-        return 0;
-    }
-    err = nvs_commit(_handle);
-    if (err)
-    {
-        ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
-        return 0;
-    }
-    return 8;
+    return put(key, PT_I64, &value, sizeof(value));
 }
 
 size_t Preferences::putULong64(const char *key, uint64_t value)
 {
-    if (!_started || !key || _readOnly)
-    {
-        return 0;
-    }
-    esp_err_t err = nvs_set_u64(_handle, key, value);
-    if (err)
-    {
-        ESP_LOGE(TAG, "nvs_set_u64 fail: %s %s", key, nvs_error(err));
-        return 0;
-    }
-    err = nvs_commit(_handle);
-    if (err)
-    {
-        ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
-        return 0;
-    }
-    return 8;
+    return put(key, PT_U64, &value, sizeof(value));
 }
 
 size_t Preferences::putFloat(const char *key, const float value)
@@ -324,23 +560,12 @@ size_t Preferences::putBool(const char *key, const bool value)
 
 size_t Preferences::putString(const char *key, const char *value)
 {
-    if (!_started || !key || !value || _readOnly)
-    {
-        return 0;
-    }
-    esp_err_t err = nvs_set_str(_handle, key, value);
-    if (err)
-    {
-        ESP_LOGE(TAG, "nvs_set_str fail: %s %s", key, nvs_error(err));
-        return 0;
-    }
-    err = nvs_commit(_handle);
-    if (err)
+    if (!value)
     {
-        ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
         return 0;
     }
-    return strlen(value);
+    size_t len = strlen(value);
+    return put(key, PT_STR, value, len + 1) ? len : 0;
 }
 
 size_t Preferences::putString(const char *key, const std::string &value)
@@ -350,23 +575,11 @@ size_t Preferences::putString(const char *key, const std::string &value)
 
 size_t Preferences::putBytes(const char *key, const void *value, size_t len)
 {
-    if (!_started || !key || !value || !len || _readOnly)
-    {
-        return 0;
-    }
-    esp_err_t err = nvs_set_blob(_handle, key, value, len);
-    if (err)
+    if (!value || !len)
     {
-        ESP_LOGE(TAG, "nvs_set_blob fail: %s %s", key, nvs_error(err));
-        return 0;
-    }
-    err = nvs_commit(_handle);
-    if (err)
-    {
-        ESP_LOGE(TAG, "nvs_commit fail: %s %s", key, nvs_error(err));
         return 0;
     }
-    return len;
+    return put(key, PT_BLOB, value, len);
 }
 
 PreferenceType Preferences::getType(const char *key) const
@@ -375,56 +588,46 @@ PreferenceType Preferences::getType(const char *key) const
     {
         return PT_INVALID;
     }
-    int8_t mt1;
-    uint8_t mt2;
-    int16_t mt3;
-    uint16_t mt4;
-    int32_t mt5;
-    uint32_t mt6;
-    int64_t mt7;
-    uint64_t mt8;
-    size_t len = 0;
-    if (nvs_get_i8(_handle, key, &mt1) == ESP_OK)
+    if (_writeBack)
     {
-        return PT_I8;
+        PreferencesLock lock(_mutex);
+        auto it = _cache.find(key);
+        if (it != _cache.end())
+        {
+            return it->second.erased ? PT_INVALID : it->second.type;
+        }
     }
-    if (nvs_get_u8(_handle, key, &mt2) == ESP_OK)
+    // One lookup of the stored item instead of a get per type
+    nvs_type_t type;
+    if (nvs_find_key(_handle, key, &type) != ESP_OK)
     {
-        return PT_U8;
+        return PT_INVALID;
     }
-    if (nvs_get_i16(_handle, key, &mt3) == ESP_OK)
+    switch (type)
     {
+    case NVS_TYPE_I8:
+        return PT_I8;
+    case NVS_TYPE_U8:
+        return PT_U8;
+    case NVS_TYPE_I16:
         return PT_I16;
-    }
-    if (nvs_get_u16(_handle, key, &mt4) == ESP_OK)
-    {
+    case NVS_TYPE_U16:
         return PT_U16;
-    }
-    if (nvs_get_i32(_handle, key, &mt5) == ESP_OK)
-    {
+    case NVS_TYPE_I32:
         return PT_I32;
-    }
-    if (nvs_get_u32(_handle, key, &mt6) == ESP_OK)
-    {
+    case NVS_TYPE_U32:
         return PT_U32;
-    }
-    if (nvs_get_i64(_handle, key, &mt7) == ESP_OK)
-    {
+    case NVS_TYPE_I64:
         return PT_I64;
-    }
-    if (nvs_get_u64(_handle, key, &mt8) == ESP_OK)
-    {
+    case NVS_TYPE_U64:
         return PT_U64;
-    }
-    if (nvs_get_str(_handle, key, NULL, &len) == ESP_OK)
-    {
+    case NVS_TYPE_STR:
         return PT_STR;
-    }
-    if (nvs_get_blob(_handle, key, NULL, &len) == ESP_OK)
-    {
+    case NVS_TYPE_BLOB:
         return PT_BLOB;
+    default:
+        return PT_INVALID;
     }
-    return PT_INVALID;
 }
 
 bool Preferences::isKey(const char *key) const
@@ -438,12 +641,14 @@ bool Preferences::isKey(const char *key) const
 
 int8_t Preferences::getChar(const char *key, const int8_t defaultValue) const {
   int8_t value = defaultValue;
-  if (!_started || !key) {
+  if (!_started || !key || cachedScalar(key, PT_I8, &value, sizeof(value))) {
     return value;
   }
   esp_err_t err = nvs_get_i8(_handle, key, &value);
   if (err) {
     ESP_LOGW(TAG, "nvs_get_i8 fail: %s %s", key, nvs_error(err));
+  } else {
+    remember(key, PT_I8, &value, sizeof(value));
   }
   return value;
 }
@@ -451,12 +656,14 @@ int8_t Preferences::getChar(const char *key, const int8_t defaultValue) const {
 uint8_t Preferences::getUChar(const char *key,
                               const uint8_t defaultValue) const {
   uint8_t value = defaultValue;
-  if (!_started || !key) {
+  if (!_started || !key || cachedScalar(key, PT_U8, &value, sizeof(value))) {
     return value;
   }
   esp_err_t err = nvs_get_u8(_handle, key, &value);
   if (err) {
     ESP_LOGW(TAG, "nvs_get_u8 fail: %s %s", key, nvs_error(err));
+  } else {
+    remember(key, PT_U8, &value, sizeof(value));
   }
   return value;
 }
@@ -464,12 +671,14 @@ uint8_t Preferences::getUChar(const char *key,
 int16_t Preferences::getShort(const char *key,
                               const int16_t defaultValue) const {
   int16_t value = defaultValue;
-  if (!_started || !key) {
+  if (!_started || !key || cachedScalar(key, PT_I16, &value, sizeof(value))) {
     return value;
   }
   esp_err_t err = nvs_get_i16(_handle, key, &value);
   if (err) {
     ESP_LOGW(TAG, "nvs_get_i16 fail: %s %s", key, nvs_error(err));
+  } else {
+    remember(key, PT_I16, &value, sizeof(value));
   }
   return value;
 }
@@ -477,24 +686,28 @@ int16_t Preferences::getShort(const char *key,
 uint16_t Preferences::getUShort(const char *key,
                                 const uint16_t defaultValue) const {
   uint16_t value = defaultValue;
-  if (!_started || !key) {
+  if (!_started || !key || cachedScalar(key, PT_U16, &value, sizeof(value))) {
     return value;
   }
   esp_err_t err = nvs_get_u16(_handle, key, &value);
   if (err) {
     ESP_LOGW(TAG, "nvs_get_u16 fail: %s %s", key, nvs_error(err));
+  } else {
+    remember(key, PT_U16, &value, sizeof(value));
   }
   return value;
 }
 
 int32_t Preferences::getInt(const char *key, const int32_t defaultValue) const {
   int32_t value = defaultValue;
-  if (!_started || !key) {
+  if (!_started || !key || cachedScalar(key, PT_I32, &value, sizeof(value))) {
     return value;
   }
   esp_err_t err = nvs_get_i32(_handle, key, &value);
   if (err) {
     ESP_LOGW(TAG, "nvs_get_i32 fail: %s %s", key, nvs_error(err));
+  } else {
+    remember(key, PT_I32, &value, sizeof(value));
   }
   return value;
 }
@@ -502,12 +715,14 @@ int32_t Preferences::getInt(const char *key, const int32_t defaultValue) const {
 uint32_t Preferences::getUInt(const char *key,
                               const uint32_t defaultValue) const {
   uint32_t value = defaultValue;
-  if (!_started || !key) {
+  if (!_started || !key || cachedScalar(key, PT_U32, &value, sizeof(value))) {
     return value;
   }
   esp_err_t err = nvs_get_u32(_handle, key, &value);
   if (err) {
     ESP_LOGW(TAG, "nvs_get_u32 fail: %s %s", key, nvs_error(err));
+  } else {
+    remember(key, PT_U32, &value, sizeof(value));
   }
   return value;
 }
@@ -525,12 +740,14 @@ uint32_t Preferences::getULong(const char *key,
 int64_t Preferences::getLong64(const char *key,
                                const int64_t defaultValue) const {
   int64_t value = defaultValue;
-  if (!_started || !key) {
+  if (!_started || !key || cachedScalar(key, PT_I64, &value, sizeof(value))) {
     return value;
   }
   esp_err_t err = nvs_get_i64(_handle, key, &value);
   if (err) {
     ESP_LOGW(TAG, "nvs_get_i64 fail: %s %s", key, nvs_error(err));
+  } else {
+    remember(key, PT_I64, &value, sizeof(value));
   }
   return value;
 }
@@ -538,12 +755,14 @@ int64_t Preferences::getLong64(const char *key,
 uint64_t Preferences::getULong64(const char *key,
                                  const uint64_t defaultValue) const {
   uint64_t value = defaultValue;
-  if (!_started || !key) {
+  if (!_started || !key || cachedScalar(key, PT_U64, &value, sizeof(value))) {
     return value;
   }
   esp_err_t err = nvs_get_u64(_handle, key, &value);
   if (err) {
     ESP_LOGW(TAG, "nvs_get_u64 fail: %s %s", key, nvs_error(err));
+  } else {
+    remember(key, PT_U64, &value, sizeof(value));
   }
   return value;
 }
@@ -571,6 +790,15 @@ size_t Preferences::getString(const char *key, char *value,
   if (!_started || !key || !value || !maxLen) {
     return 0;
   }
+  std::string data;
+  bool found = false;
+  if (cached(key, PT_STR, data, found)) {
+    if (!found || data.size() > maxLen) {
+      return 0;
+    }
+    memcpy(value, data.data(), data.size());
+    return data.size();
+  }
   esp_err_t err = nvs_get_str(_handle, key, NULL, &len);
   if (err) {
     ESP_LOGE(TAG, "nvs_get_str len fail: %s %s", key, nvs_error(err));
@@ -585,6 +813,7 @@ size_t Preferences::getString(const char *key, char *value,
     ESP_LOGE(TAG, "nvs_get_str fail: %s %s", key, nvs_error(err));
     return 0;
   }
+  remember(key, PT_STR, value, len);
   return len;
 }
 
@@ -595,6 +824,11 @@ std::string Preferences::getString(const char *key,
   if (!_started || !key) {
     return defaultValue;
   }
+  std::string data;
+  bool found = false;
+  if (cached(key, PT_STR, data, found)) {
+    return found ? std::string(data.c_str()) : defaultValue;
+  }
   esp_err_t err = nvs_get_str(_handle, key, value, &len);
   if (err) {
     ESP_LOGE(TAG, "nvs_get_str len fail: %s %s", key, nvs_error(err));
@@ -607,6 +841,7 @@ std::string Preferences::getString(const char *key,
     ESP_LOGE(TAG, "nvs_get_str fail: %s %s", key, nvs_error(err));
     return defaultValue;
   }
+  remember(key, PT_STR, buf, len);
   return std::string(buf);
 }
 
@@ -615,6 +850,11 @@ size_t Preferences::getBytesLength(const char *key) const {
   if (!_started || !key) {
     return 0;
   }
+  std::string data;
+  bool found = false;
+  if (cached(key, PT_BLOB, data, found)) {
+    return found ? data.size() : 0;
+  }
   esp_err_t err = nvs_get_blob(_handle, key, NULL, &len);
   if (err) {
     ESP_LOGE(TAG, "nvs_get_blob len fail: %s %s", key, nvs_error(err));
@@ -624,6 +864,19 @@ size_t Preferences::getBytesLength(const char *key) const {
 }
 
 size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) const {
+  std::string data;
+  bool found = false;
+  if (_started && key && cached(key, PT_BLOB, data, found)) {
+    if (!found || !buf || !maxLen) {
+      return found ? data.size() : 0;
+    }
+    if (data.size() > maxLen) {
+      ESP_LOGE(TAG, "not enough space in buffer: %u < %u", maxLen, data.size());
+      return 0;
+    }
+    memcpy(buf, data.data(), data.size());
+    return data.size();
+  }
   size_t len = getBytesLength(key);
   if (!len || !buf || !maxLen) {
     return len;
@@ -637,9 +890,80 @@ size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) const {
     ESP_LOGE(TAG, "nvs_get_blob fail: %s %s", key, nvs_error(err));
     return 0;
   }
+  remember(key, PT_BLOB, buf, len);
   return len;
 }
 
+bool Preferences::getValue(const char *key, PreferenceType type, void *value,
+                           size_t &len) const {
+  if (!_started || !key || !value) {
+    return false;
+  }
+  std::string data;
+  bool found = false;
+  if (cached(key, type, data, found)) {
+    if (!found || data.size() > len) {
+      return false;
+    }
+    memcpy(value, data.data(), data.size());
+    len = data.size();
+    return true;
+  }
+  // Missing keys are normal here (first boot, new schema fields): no logging
+  uint64_t v = 0;
+  esp_err_t err;
+  switch (type) {
+  case PT_I8:
+    err = nvs_get_i8(_handle, key, (int8_t *)&v);
+    break;
+  case PT_U8:
+    err = nvs_get_u8(_handle, key, (uint8_t *)&v);
+    break;
+  case PT_I16:
+    err = nvs_get_i16(_handle, key, (int16_t *)&v);
+    break;
+  case PT_U16:
+    err = nvs_get_u16(_handle, key, (uint16_t *)&v);
+    break;
+  case PT_I32:
+    err = nvs_get_i32(_handle, key, (int32_t *)&v);
+    break;
+  case PT_U32:
+    err = nvs_get_u32(_handle, key, (uint32_t *)&v);
+    break;
+  case PT_I64:
+    err = nvs_get_i64(_handle, key, (int64_t *)&v);
+    break;
+  case PT_U64:
+    err = nvs_get_u64(_handle, key, &v);
+    break;
+  case PT_STR:
+    err = nvs_get_str(_handle, key, (char *)value, &len);
+    break;
+  case PT_BLOB:
+    err = nvs_get_blob(_handle, key, value, &len);
+    break;
+  default:
+    return false;
+  }
+  if (err) {
+    if (err != ESP_ERR_NVS_NOT_FOUND && err != ESP_ERR_NVS_TYPE_MISMATCH) {
+      ESP_LOGW(TAG, "nvs_get_%s fail: %s %s", type_names[type], key, nvs_error(err));
+    }
+    return false;
+  }
+  if (type < PT_STR) {
+    size_t size = (size_t)1 << (type / 2);
+    if (size > len) {
+      return false;
+    }
+    memcpy(value, &v, size);
+    len = size;
+  }
+  remember(key, type, value, len);
+  return true;
+}
+
 size_t Preferences::freeEntries() const {
   nvs_stats_t nvs_stats;
   esp_err_t err = nvs_get_stats(NULL, &nvs_stats);
@@ -0,0 +1,125 @@
+// Settings-save benchmark for the Preferences write-back cache
+// (CONFIG_PREFERENCES_BENCHMARK).
+//
+// Two workloads, each write-through and write-back:
+//   page    a settings page of ten values saved 20 times, with flush() as
+//           the Save button
+//   slider  one value put 50 times in a row, like dragging the brightness
+//           slider, left to the debounce timer
+// For each run it logs the mean and worst put/save latency, the nvs_set_* and
+// nvs_commit calls, and the NVS entries consumed (drop in free entries, which
+// is what wears the flash).
+
+#include "Preferences.h"
+
+#include <cinttypes>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "nvs.h"
+
+static const char *TAG = "PREFERENCES";
+
+namespace
+{
+constexpr int PAGE_SAVES = 20;
+constexpr int SLIDER_STEPS = 50;
+constexpr uint32_t DEBOUNCE_MS = 300;
+
+struct BenchResult
+{
+    int64_t total_us;
+    int64_t max_us;
+    uint32_t sets;
+    uint32_t commits;
+    int32_t entries;
+};
+
+int32_t free_entries()
+{
+    nvs_stats_t st;
+    return nvs_get_stats(NULL, &st) == ESP_OK ? (int32_t)st.free_entries : 0;
+}
+
+// Ten values, some of them changing from save to save
+void save_page(Preferences &p, int round)
+{
+    p.putUChar("brightness", 100 + round % 50);
+    p.putString("theme", round % 2 ? "dark" : "light");
+    p.putString("tz", "CET-1CEST,M3.5.0,M10.5.0/3");
+    p.putUChar("unit_speed", 1);
+    p.putUChar("unit_depth", round % 3);
+    p.putUInt("refresh_s", 600);
+    p.putBool("auto_dim", round % 2);
+    p.putFloat("depth_offset", 0.3f);
+    p.putInt("alarm_depth", 250 + round);
+    p.putString("wifi_hint", "marina");
+}
+
+BenchResult run(const char *name, bool write_back, bool slider)
+{
+    BenchResult r = {};
+    Preferences p;
+    if (!p.begin(name))
+    {
+        return r;
+    }
+    p.clear();
+    p.setWriteBack(write_back, slider ? DEBOUNCE_MS : 0);
+    const PreferencesStats before = p.stats();
+    const int32_t free_before = free_entries();
+
+    int n = slider ? SLIDER_STEPS : PAGE_SAVES;
+    for (int i = 0; i < n; i++)
+    {
+        int64_t t = esp_timer_get_time();
+        if (slider)
+        {
+            p.putUChar("brightness", 20 + i);
+        }
+        else
+        {
+            save_page(p, i);
+            p.flush();
+        }
+        int64_t us = esp_timer_get_time() - t;
+        r.total_us += us;
+        r.max_us = us > r.max_us ? us : r.max_us;
+    }
+    if (slider && write_back)
+    {
+        vTaskDelay(pdMS_TO_TICKS(DEBOUNCE_MS * 2)); // let the debounce commit
+    }
+    p.end();
+
+    r.sets = p.stats().nvsSets - before.nvsSets;
+    r.commits = p.stats().nvsCommits - before.nvsCommits;
+    r.entries = free_before - free_entries();
+    r.total_us /= n;
+    return r;
+}
+
+void report(const char *workload, const char *mode, const BenchResult &r)
+{
+    ESP_LOGI(TAG, "%-6s %-13s %6" PRId64 " us mean, %6" PRId64 " us max, %3" PRIu32 " sets, %3" PRIu32
+                  " commits, %3" PRId32 " NVS entries",
+             workload, mode, r.total_us, r.max_us, r.sets, r.commits, r.entries);
+}
+} // namespace
+
+void preferences_benchmark(const char *name)
+{
+    ESP_LOGI(TAG, "Settings save benchmark: page = %d saves of 10 values, slider = %d puts", PAGE_SAVES,
+             SLIDER_STEPS);
+    report("page", "write-through", run(name, false, false));
+    report("page", "write-back", run(name, true, false));
+    report("slider", "write-through", run(name, false, true));
+    report("slider", "write-back", run(name, true, true));
+
+    Preferences p;
+    if (p.begin(name))
+    {
+        p.clear();
+    }
+}
@@ -14,10 +14,15 @@
 #ifndef _PREFERENCES_H_
 #define _PREFERENCES_H_
 
+#include <map>
 #include <string>
 #include <cmath>
 #include <stddef.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
 typedef enum
 {
     PT_I8,
@@ -33,12 +38,43 @@ typedef enum
     PT_INVALID
 } PreferenceType;
 
+typedef struct
+{
+    uint32_t nvsSets;      // nvs_set_* and nvs_erase_key calls
+    uint32_t nvsCommits;
+    uint32_t cacheHits;    // reads answered from RAM in write-back mode
+    uint32_t cacheMisses;
+} PreferencesStats;
+
 class Preferences
 {
 protected:
+    struct Entry
+    {
+        PreferenceType type;
+        std::string data;  // raw value; strings keep their terminating NUL
+        bool dirty;
+        bool erased;       // remove() not yet flushed
+    };
+
     uint32_t _handle;
     bool _started;
     bool _readOnly;
+    bool _writeBack;
+    uint32_t _debounceMs;
+    SemaphoreHandle_t _mutex;
+    esp_timer_handle_t _timer;
+    mutable std::map<std::string, Entry> _cache;
+    mutable PreferencesStats _stats;
+    Preferences *_nextWriteBack;
+
+    size_t put(const char *key, PreferenceType type, const void *value, size_t len);
+    bool cached(const char *key, PreferenceType type, std::string &data, bool &found) const;
+    bool cachedScalar(const char *key, PreferenceType type, void *value, size_t len) const;
+    void remember(const char *key, PreferenceType type, const void *value, size_t len) const;
+    esp_err_t nvsSet(const char *key, PreferenceType type, const void *value, size_t len);
+    esp_err_t commit();
+    static void debounced(void *arg);
 
 public:
     Preferences();
@@ -47,6 +83,18 @@ public:
     bool begin(const char *name, bool readOnly = false, const char *partition_label = NULL);
     void end();
 
+    /*
+     * Write-back mode: put* and remove only update a RAM cache, which also
+     * serves reads. Pending changes reach NVS with a single commit on flush(),
+     * debounceMs after the last change (0: flush() only), before esp_restart()
+     * (so also before an OTA reboot) and on end().
+     */
+    bool setWriteBack(bool enable, uint32_t debounceMs = 1000);
+    bool flush();
+    size_t pending() const;
+    static void flushAll();
+    const PreferencesStats &stats() const { return _stats; }
+
     bool clear();
     bool remove(const char *key);
 
@@ -88,7 +136,16 @@ public:
               const std::string &defaultValue = std::string()) const;
     size_t getBytesLength(const char *key) const;
     size_t getBytes(const char *key, void *buf, size_t maxLen) const;
+    /*
+     * Reads key as the given type in one lookup, without logging a missing
+     * key. len is the buffer size on entry and the value size on return.
+     */
+    bool getValue(const char *key, PreferenceType type, void *value, size_t &len) const;
     size_t freeEntries() const;
 };
 
+/* Logs settings-save latency and NVS writes, write-through against write-back
+ * (CONFIG_PREFERENCES_BENCHMARK). Uses and clears the given namespace. */
+void preferences_benchmark(const char *name);
+
 #endif
\ No newline at end of file
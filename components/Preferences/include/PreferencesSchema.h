@@ -0,0 +1,338 @@
+/*
+   Typed settings on top of Preferences.
+
+   A schema is a struct with one constexpr tuple of fields, each a key, a
+   type, a default and a range:
+
+     enum { BRIGHTNESS, DARK_THEME };
+     struct DisplaySchema
+     {
+         static constexpr auto fields = std::make_tuple(
+             PreferenceField<uint8_t>("brightness", 128, 8, 255),
+             PreferenceField<bool>("dark_theme", true));
+     };
+     PreferencesStore<DisplaySchema> store;
+
+   Keys longer than the 15 characters NVS allows, duplicate keys and defaults
+   outside their range fail to compile. begin() loads every field with one
+   typed NVS read; get<K>() then returns the RAM copy and set<K>() checks the
+   range, updates RAM and writes NVS only when the value changed.
+
+   subscribe<K>() registers a callback for one field. A set() that changes
+   the value calls the subscribers of that field only, from the caller's
+   task, so each subsystem applies just the settings it depends on.
+
+   Not locked: get() and set() belong to one task, normally the GUI, and
+   subscribe() to setup, before anything calls set().
+*/
+
+#ifndef _PREFERENCES_SCHEMA_H_
+#define _PREFERENCES_SCHEMA_H_
+
+#include <functional>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "esp_log.h"
+#include "Preferences.h"
+
+#define PREFERENCES_KEY_MAX 15  // NVS_KEY_NAME_MAX_SIZE - 1
+
+namespace preferences_detail
+{
+template <typename T>
+struct TypeOf;
+template <> struct TypeOf<int8_t> { static constexpr PreferenceType value = PT_I8; };
+template <> struct TypeOf<uint8_t> { static constexpr PreferenceType value = PT_U8; };
+template <> struct TypeOf<int16_t> { static constexpr PreferenceType value = PT_I16; };
+template <> struct TypeOf<uint16_t> { static constexpr PreferenceType value = PT_U16; };
+template <> struct TypeOf<int32_t> { static constexpr PreferenceType value = PT_I32; };
+template <> struct TypeOf<uint32_t> { static constexpr PreferenceType value = PT_U32; };
+template <> struct TypeOf<int64_t> { static constexpr PreferenceType value = PT_I64; };
+template <> struct TypeOf<uint64_t> { static constexpr PreferenceType value = PT_U64; };
+// Stored the way putBool, putFloat and putDouble store them
+template <> struct TypeOf<bool> { static constexpr PreferenceType value = PT_U8; };
+template <> struct TypeOf<float> { static constexpr PreferenceType value = PT_BLOB; };
+template <> struct TypeOf<double> { static constexpr PreferenceType value = PT_BLOB; };
+
+constexpr size_t length(const char *s)
+{
+    size_t n = 0;
+    while (s[n])
+    {
+        n++;
+    }
+    return n;
+}
+
+constexpr bool equal(const char *a, const char *b)
+{
+    while (*a && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+} // namespace preferences_detail
+
+template <typename T>
+struct PreferenceField
+{
+    static_assert(std::is_arithmetic<T>::value, "PreferenceField holds numbers, bool or std::string");
+    using value_type = T;
+
+    const char *key;
+    T defaultValue;
+    T min;
+    T max;
+
+    template <size_t N>
+    constexpr PreferenceField(const char (&name)[N], T def, T lo = std::numeric_limits<T>::lowest(),
+                              T hi = std::numeric_limits<T>::max())
+        : key(name), defaultValue(def), min(lo), max(hi)
+    {
+        static_assert(N > 1 && N - 1 <= PREFERENCES_KEY_MAX, "NVS keys are 1 to 15 characters");
+    }
+
+    constexpr bool valid(const T &value) const { return !(value < min) && !(max < value); }
+    constexpr bool validDefault() const { return valid(defaultValue); }
+};
+
+template <>
+struct PreferenceField<std::string>
+{
+    using value_type = std::string;
+
+    const char *key;
+    const char *defaultValue;
+    size_t maxLength;
+
+    template <size_t N>
+    constexpr PreferenceField(const char (&name)[N], const char *def, size_t maxLen)
+        : key(name), defaultValue(def), maxLength(maxLen)
+    {
+        static_assert(N > 1 && N - 1 <= PREFERENCES_KEY_MAX, "NVS keys are 1 to 15 characters");
+    }
+
+    bool valid(const std::string &value) const { return value.size() <= maxLength; }
+    constexpr bool validDefault() const { return preferences_detail::length(defaultValue) <= maxLength; }
+};
+
+namespace preferences_detail
+{
+template <typename Fields>
+struct Values;
+template <typename... F>
+struct Values<std::tuple<F...>>
+{
+    using type = std::tuple<typename F::value_type...>;
+    using observers = std::tuple<std::vector<std::function<void(const typename F::value_type &)>>...>;
+};
+
+template <typename Fields, size_t... I>
+constexpr bool uniqueKeys(const Fields &fields, std::index_sequence<I...>)
+{
+    const char *keys[] = {std::get<I>(fields).key...};
+    for (size_t i = 0; i < sizeof...(I); i++)
+    {
+        for (size_t j = i + 1; j < sizeof...(I); j++)
+        {
+            if (equal(keys[i], keys[j]))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Fields, size_t... I>
+constexpr bool validDefaults(const Fields &fields, std::index_sequence<I...>)
+{
+    return (std::get<I>(fields).validDefault() && ...);
+}
+
+template <typename T>
+bool read(const Preferences &prefs, const char *key, T &value)
+{
+    size_t len = sizeof(value);
+    return prefs.getValue(key, TypeOf<T>::value, &value, len) && len == sizeof(value);
+}
+
+inline bool read(const Preferences &prefs, const char *key, bool &value)
+{
+    uint8_t v;
+    if (!read(prefs, key, v))
+    {
+        return false;
+    }
+    value = v == 1;
+    return true;
+}
+
+inline bool read(const Preferences &prefs, const char *key, std::string &value)
+{
+    char buf[256];
+    size_t len = sizeof(buf);
+    if (!prefs.getValue(key, PT_STR, buf, len))
+    {
+        return false;
+    }
+    value.assign(buf);
+    return true;
+}
+
+inline bool write(Preferences &prefs, const char *key, int8_t value) { return prefs.putChar(key, value); }
+inline bool write(Preferences &prefs, const char *key, uint8_t value) { return prefs.putUChar(key, value); }
+inline bool write(Preferences &prefs, const char *key, int16_t value) { return prefs.putShort(key, value); }
+inline bool write(Preferences &prefs, const char *key, uint16_t value) { return prefs.putUShort(key, value); }
+inline bool write(Preferences &prefs, const char *key, int32_t value) { return prefs.putInt(key, value); }
+inline bool write(Preferences &prefs, const char *key, uint32_t value) { return prefs.putUInt(key, value); }
+inline bool write(Preferences &prefs, const char *key, int64_t value) { return prefs.putLong64(key, value); }
+inline bool write(Preferences &prefs, const char *key, uint64_t value) { return prefs.putULong64(key, value); }
+inline bool write(Preferences &prefs, const char *key, bool value) { return prefs.putBool(key, value); }
+inline bool write(Preferences &prefs, const char *key, float value) { return prefs.putFloat(key, value); }
+inline bool write(Preferences &prefs, const char *key, double value) { return prefs.putDouble(key, value); }
+inline bool write(Preferences &prefs, const char *key, const std::string &value)
+{
+    return prefs.putString(key, value) == value.size();
+}
+} // namespace preferences_detail
+
+template <typename Schema>
+class PreferencesStore
+{
+    using Fields = std::remove_const_t<decltype(Schema::fields)>;
+    using Indices = std::make_index_sequence<std::tuple_size<Fields>::value>;
+
+    static_assert(preferences_detail::uniqueKeys(Schema::fields, Indices{}), "duplicate key in schema");
+    static_assert(preferences_detail::validDefaults(Schema::fields, Indices{}), "default outside its range");
+
+public:
+    static constexpr size_t size = std::tuple_size<Fields>::value;
+    template <size_t K>
+    using Field = std::tuple_element_t<K, Fields>;
+    template <size_t K>
+    using Type = typename Field<K>::value_type;
+
+    PreferencesStore() : _loaded(0) { reset(Indices{}); }
+
+    /*
+     * Opens the namespace and loads every field; missing, mistyped or out of
+     * range values keep their default. writeBackMs > 0 defers NVS writes, see
+     * Preferences::setWriteBack().
+     */
+    bool begin(const char *name, uint32_t writeBackMs = 0, const char *partition_label = NULL)
+    {
+        if (!_prefs.begin(name, false, partition_label))
+        {
+            return false;
+        }
+        if (writeBackMs)
+        {
+            _prefs.setWriteBack(true, writeBackMs);
+        }
+        _loaded = 0;
+        load(Indices{});
+        return true;
+    }
+
+    void end() { _prefs.end(); }
+
+    // Fields found in NVS by the last begin()
+    size_t loaded() const { return _loaded; }
+
+    template <size_t K>
+    static constexpr const char *key()
+    {
+        return std::get<K>(Schema::fields).key;
+    }
+
+    template <size_t K>
+    const Type<K> &get() const
+    {
+        return std::get<K>(_values);
+    }
+
+    template <size_t K>
+    bool set(const Type<K> &value)
+    {
+        const Field<K> &field = std::get<K>(Schema::fields);
+        if (!field.valid(value))
+        {
+            ESP_LOGW("PREFERENCES", "%s: value out of range", field.key);
+            return false;
+        }
+        if (value == std::get<K>(_values))
+        {
+            return true;
+        }
+        if (!preferences_detail::write(_prefs, field.key, value))
+        {
+            return false;
+        }
+        std::get<K>(_values) = value;
+        for (auto &observer : std::get<K>(_observers))
+        {
+            observer(std::get<K>(_values));
+        }
+        return true;
+    }
+
+    template <size_t K>
+    void subscribe(std::function<void(const Type<K> &)> observer)
+    {
+        std::get<K>(_observers).push_back(std::move(observer));
+    }
+
+    template <size_t K>
+    bool reset()
+    {
+        return set<K>(std::get<K>(Schema::fields).defaultValue);
+    }
+
+    Preferences &preferences() { return _prefs; }
+
+private:
+    template <size_t K>
+    void load()
+    {
+        const Field<K> &field = std::get<K>(Schema::fields);
+        Type<K> value;
+        if (!preferences_detail::read(_prefs, field.key, value))
+        {
+            return;
+        }
+        if (!field.valid(value))
+        {
+            ESP_LOGW("PREFERENCES", "%s: stored value out of range, using default", field.key);
+            return;
+        }
+        std::get<K>(_values) = value;
+        _loaded++;
+    }
+
+    template <size_t... I>
+    void load(std::index_sequence<I...>)
+    {
+        (load<I>(), ...);
+    }
+
+    template <size_t... I>
+    void reset(std::index_sequence<I...>)
+    {
+        ((std::get<I>(_values) = std::get<I>(Schema::fields).defaultValue), ...);
+    }
+
+    Preferences _prefs;
+    typename preferences_detail::Values<Fields>::type _values;
+    typename preferences_detail::Values<Fields>::observers _observers;
+    size_t _loaded;
+};
+
+#endif
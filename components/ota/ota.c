@@ -6,6 +6,7 @@
    software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
    CONDITIONS OF ANY KIND, either express or implied.
 */
+#include <inttypes.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -16,7 +17,9 @@
 #include "esp_ota_ops.h"
 #include "esp_http_client.h"
 #include "esp_https_ota.h"
+#include "esp_timer.h"
 #include "ota.h"
+#include "ota_priv.h"
 
 #if CONFIG_BOOTLOADER_APP_ANTI_ROLLBACK
 #include "esp_efuse.h"
@@ -33,6 +36,61 @@ extern const uint8_t server_cert_pem_end[] asm("_binary_ca_cert_pem_end");
 char ota_reason[50];
 #define OTA_URL_SIZE 256
 
+#ifndef CONFIG_OTA_PROGRESS_INTERVAL_MS
+#define CONFIG_OTA_PROGRESS_INTERVAL_MS 500
+#endif
+
+void ota_progress_init(ota_progress_state_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->start_us = s->last_us = esp_timer_get_time();
+}
+
+/*
+ * Reports progress once per CONFIG_OTA_PROGRESS_INTERVAL_MS and only if bytes
+ * arrived since, whatever the chunk size. Posting never waits: when the event
+ * queue is full the sample is dropped, so a slow UI can't stall the download.
+ */
+void ota_progress_update(ota_progress_state_t *s, int32_t bytes, int32_t image_size, bool final)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_us = now - s->last_us;
+
+    if (!final && (elapsed_us < CONFIG_OTA_PROGRESS_INTERVAL_MS * 1000LL || bytes == s->last_bytes)) {
+        return;
+    }
+
+    if (elapsed_us > 0 && bytes >= s->last_bytes) {
+        uint32_t sample = (uint32_t)((int64_t)(bytes - s->last_bytes) * 1000000 / elapsed_us);
+        // First sample seeds the average, later ones weigh 1/4
+        s->rate = s->rate == 0 ? sample : (s->rate * 3 + sample) / 4;
+    }
+    s->last_us = now;
+    s->last_bytes = bytes;
+
+    ota_progress_t p = {
+        .bytes_read = bytes,
+        .image_size = image_size,
+        .percent = 0,
+        .bytes_per_sec = s->rate,
+        .eta_sec = UINT32_MAX,
+    };
+    if (p.image_size > 0) {
+        p.percent = (uint8_t)((int64_t)bytes * 100 / p.image_size);
+        if (final) {
+            p.eta_sec = 0;
+        } else if (s->rate > 0) {
+            p.eta_sec = (uint32_t)((p.image_size - bytes) / s->rate);
+        }
+    }
+
+    if (esp_event_post(TUX_EVENTS, TUX_EVENT_OTA_IN_PROGRESS, &p, sizeof(p), 0) != ESP_OK) {
+        s->dropped++;
+    }
+    ESP_LOGD(TAG, "%d/%d bytes, %u%%, %u B/s, ETA %u s", (int)p.bytes_read, (int)p.image_size,
+             p.percent, (unsigned)p.bytes_per_sec, (unsigned)p.eta_sec);
+}
+
 static esp_err_t validate_image_header(esp_app_desc_t *new_app_info)
 {
     if (new_app_info == NULL) {
@@ -82,6 +140,58 @@ static esp_err_t _http_client_init_cb(esp_http_client_handle_t http_client)
     return err;
 }
 
+void ota_link_setup(void)
+{
+#if CONFIG_OTA_CONNECT_WIFI
+#if !CONFIG_BT_ENABLED
+    /* Ensure to disable any WiFi power save mode, this allows best throughput
+     * and hence timings for overall OTA operation.
+     */
+    esp_wifi_set_ps(WIFI_PS_NONE);
+#else
+    /* WIFI_PS_MIN_MODEM is the default mode for WiFi Power saving. When both
+     * WiFi and Bluetooth are running, WiFI modem has to go down, hence we
+     * need WIFI_PS_MIN_MODEM. And as WiFi modem goes down, OTA download time
+     * increases.
+     */
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+#endif // CONFIG_BT_ENABLED
+#endif // CONFIG_OTA_CONNECT_WIFI
+}
+
+void ota_http_config(esp_http_client_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->url = CONFIG_OTA_FIRMWARE_UPGRADE_URL;
+    config->cert_pem = (char *)server_cert_pem_start;
+    config->timeout_ms = CONFIG_OTA_OTA_RECV_TIMEOUT;
+    config->keep_alive_enable = true;
+#ifdef CONFIG_OTA_SKIP_COMMON_NAME_CHECK
+    config->skip_cert_common_name_check = true;
+#endif
+}
+
+/* Ends the task for the download paths that do not use esp_https_ota */
+static void report_download(esp_err_t err, const char *failed_reason)
+{
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "OTA upgrade successful. Rebooting ...");
+
+        strcpy(ota_reason,"Upgrade successful");
+        ESP_ERROR_CHECK(esp_event_post(TUX_EVENTS, TUX_EVENT_OTA_COMPLETED, ota_reason,sizeof(ota_reason), portMAX_DELAY));
+
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        esp_restart();
+    } else if (err != ESP_ERR_INVALID_VERSION) {
+        // validate_image_header already reported a version mismatch
+        ESP_LOGE(TAG, "OTA stopped: %s", esp_err_to_name(err));
+
+        strncpy(ota_reason, failed_reason, sizeof(ota_reason) - 1);
+        ESP_ERROR_CHECK(esp_event_post(TUX_EVENTS, TUX_EVENT_OTA_FAILED, ota_reason,sizeof(ota_reason), portMAX_DELAY));
+    }
+    vTaskDelete(NULL);
+}
+
 void run_ota_task(void *pvParameter)
 {
     ESP_LOGI(TAG, "Starting OTA");
@@ -116,33 +226,22 @@ void run_ota_task(void *pvParameter)
     }
 #endif
 
-#if CONFIG_OTA_CONNECT_WIFI
-#if !CONFIG_BT_ENABLED
-    /* Ensure to disable any WiFi power save mode, this allows best throughput
-     * and hence timings for overall OTA operation.
-     */
-    esp_wifi_set_ps(WIFI_PS_NONE);
-#else
-    /* WIFI_PS_MIN_MODEM is the default mode for WiFi Power saving. When both
-     * WiFi and Bluetooth are running, WiFI modem has to go down, hence we
-     * need WIFI_PS_MIN_MODEM. And as WiFi modem goes down, OTA download time
-     * increases.
-     */
-    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
-#endif // CONFIG_BT_ENABLED
-#endif // CONFIG_OTA_CONNECT_WIFI
+    ota_link_setup();
 
+    esp_err_t err;
     esp_err_t ota_finish_err = ESP_OK;
-    esp_http_client_config_t config = {
-        .url = CONFIG_OTA_FIRMWARE_UPGRADE_URL,
-        .cert_pem = (char *)server_cert_pem_start,
-        .timeout_ms = CONFIG_OTA_OTA_RECV_TIMEOUT,
-        .keep_alive_enable = true,
-    };
-
-
-#ifdef CONFIG_OTA_SKIP_COMMON_NAME_CHECK
-    config.skip_cert_common_name_check = true;
+    esp_http_client_config_t config;
+    ota_http_config(&config);
+
+#ifdef CONFIG_OTA_RESUMABLE
+    err = ota_resume_download(&config, validate_image_header);
+    report_download(err, ota_resume_pending() ? "Download interrupted, will resume" : "Upgrade failed");
+#elif defined(CONFIG_OTA_PACKAGES)
+    err = ota_package_download(&config, validate_image_header);
+    report_download(err, "Upgrade failed");
+#elif defined(CONFIG_OTA_PIPELINED)
+    err = ota_pipeline_download(&config, validate_image_header);
+    report_download(err, "Upgrade failed");
 #endif
 
     esp_https_ota_config_t ota_config = {
@@ -155,7 +254,7 @@ void run_ota_task(void *pvParameter)
     };
 
     esp_https_ota_handle_t https_ota_handle = NULL;
-    esp_err_t err = esp_https_ota_begin(&ota_config, &https_ota_handle);
+    err = esp_https_ota_begin(&ota_config, &https_ota_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "OTA Begin failed");
         
@@ -180,33 +279,24 @@ void run_ota_task(void *pvParameter)
         goto ota_end;
     }
 
-    int counter=0;
+    ota_progress_state_t progress;
+    ota_progress_init(&progress);
     while (1) {
         err = esp_https_ota_perform(https_ota_handle);
         if (err != ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
             break;
         }
-
-        counter++;
-        // esp_https_ota_perform returns after every read operation which gives user the ability to
-        // monitor the status of OTA upgrade by calling esp_https_ota_get_image_len_read, which gives length of image
-        // data read so far.
-        int image_len_read = esp_https_ota_get_image_len_read(https_ota_handle);
-        ESP_LOGD(TAG, "Image bytes read: %d", image_len_read);
-
-        // One event trigger for every x count
-        if (counter > 200)
-        {
-            /* Too many events generated with this. Maybe trigger event for every 10th item? */
-            // Notify about TUX_EVENT_OTA_IN_PROGRESS event / Calculate and send progress percentage (or bytes)
-            ESP_ERROR_CHECK(esp_event_post(TUX_EVENTS, TUX_EVENT_OTA_IN_PROGRESS, &image_len_read,sizeof(image_len_read), portMAX_DELAY));        
-            counter = 0; //reset
-        }
-
+        // esp_https_ota_perform returns after every read operation
+        ota_progress_update(&progress, esp_https_ota_get_image_len_read(https_ota_handle),
+                            esp_https_ota_get_image_size(https_ota_handle), false);
     }
-    
-    strcpy(ota_reason,"Download completed");
-    ESP_ERROR_CHECK(esp_event_post(TUX_EVENTS, TUX_EVENT_OTA_IN_PROGRESS, ota_reason,sizeof(ota_reason), portMAX_DELAY));        
+    ota_progress_update(&progress, esp_https_ota_get_image_len_read(https_ota_handle),
+                        esp_https_ota_get_image_size(https_ota_handle), true);
+
+    int64_t total_ms = (esp_timer_get_time() - progress.start_us) / 1000;
+    int image_len = esp_https_ota_get_image_len_read(https_ota_handle);
+    ESP_LOGI(TAG, "Download finished: %d bytes in %" PRId64 " ms, %" PRId64 " KB/s, %u progress events dropped",
+             image_len, total_ms, (int64_t)image_len * 1000 / (total_ms + 1) / 1024, (unsigned)progress.dropped);
 
     if (esp_https_ota_is_complete_data_received(https_ota_handle) != true) {
         // the OTA image was not completely received and user can customise the response to this situation.
@@ -1,14 +1,46 @@
 #ifndef tux_ota_H
 #define tux_ota_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
 #include "../main/events/tux_events.hpp"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Payload of TUX_EVENT_OTA_IN_PROGRESS */
+typedef struct {
+    int32_t bytes_read;         // image bytes written so far
+    int32_t image_size;         // -1 if the server sent no length
+    uint8_t percent;            // 0 while image_size is unknown
+    uint32_t bytes_per_sec;     // smoothed download rate
+    uint32_t eta_sec;           // UINT32_MAX while unknown
+} ota_progress_t;
+
 void run_ota_task(void *pvParameter);
 
+/* Times downloads over the CONFIG_OTA_BENCH_* sweep into a CSV file; the
+ * images are verified but never set for boot (CONFIG_OTA_BENCHMARK) */
+void run_ota_bench_task(void *pvParameter);
+
+/* True if a resumable download stopped part way (CONFIG_OTA_RESUMABLE) */
+bool ota_resume_pending(void);
+
+/* Mounts the current asset slot at /spiffs. A slot on another filesystem
+ * than CONFIG_STORAGE_FS_* is first moved into the other slot. */
+esp_err_t ota_assets_mount(int max_files);
+
+/* Label of the slot holding the current assets */
+const char *ota_assets_partition(void);
+
+/* Label of the other slot, NULL without one; overwritten by the next update */
+const char *ota_assets_spare_partition(void);
+
+/* Updates changed assets into the other slot and restarts into it (CONFIG_ASSETS_UPDATE) */
+void run_asset_update_task(void *pvParameter);
+
 #ifdef __cplusplus
 } /*extern "C"*/
 #endif
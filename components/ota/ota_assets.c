@@ -0,0 +1,832 @@
+/*
+   Asset pack updates.
+
+   UI assets (wallpapers, weather data, readme) live in a slot mounted at
+   /spiffs. There are two slots, storage and storage_b, and NVS says which
+   one is active and which filesystem each holds (storage.h). An update
+     1. fetches the manifest at CONFIG_ASSETS_MANIFEST_URL and stops unless
+        its version is newer than the active slot's assets.manifest,
+     2. formats the other slot with the configured filesystem and fills it:
+        a file whose SHA-256 matches the active slot's manifest is copied
+        across locally, any other file is downloaded from next to the
+        manifest, and every file is hashed as it is written,
+     3. carries over everything else on the active slot (logs, caches),
+     4. writes the manifest last, then flips the slot in NVS and restarts.
+   The active slot is never written, so an update that stops anywhere before
+   the NVS commit leaves the old assets in place.
+
+   storage_b only exists in the partition tables from this firmware on, and
+   a partition table is written by a serial flash, never over the air. On a
+   device still on the old table the update stops before writing anything
+   and logs that storage_b is missing.
+
+   A slot on another filesystem than the configured one, such as the SPIFFS
+   of an older firmware, is moved over the same way at boot: everything is
+   copied into the other slot, which then becomes active. On a partition
+   table without storage_b the assets stay where they are, unless
+   CONFIG_STORAGE_MOVE_IN_PLACE asks to hold the files in PSRAM while the
+   slot is reformatted in place. That move is not safe against a reset or
+   power cut between the format and the last file written back, which
+   loses the assets until the next serial flash, hence off by default.
+   Otherwise the move needs storage_b, which only a serial flash of the
+   partition table brings.
+
+   Manifest, as written by ota_pack.py assets:
+     TXA1 <version>
+     <sha256 hex> <size> <path>
+     ...
+*/
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_event.h"
+#include "esp_heap_caps.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+#include "ota.h"
+#include "ota_priv.h"
+#include "storage.h"
+
+static const char *TAG = "OTA";
+
+#ifndef CONFIG_ASSETS_MANIFEST_URL
+#define CONFIG_ASSETS_MANIFEST_URL "https://192.168.1.128/fatfs/assets.manifest"
+#endif
+
+#define ASSETS_NAMESPACE    "assets"
+#define ASSETS_SLOT_KEY     "slot"
+#define ASSETS_FAILED_KEY   "fs_failed"     // filesystem the slot failed to move to
+#define ACTIVE_ROOT         "/spiffs"
+#define STAGING_ROOT        "/assets_new"
+#define MANIFEST_NAME       "assets.manifest"
+#define MANIFEST_MAGIC      "TXA1"
+#define MANIFEST_MAX        8192        // MAX_ASSETS lines of about 100 bytes
+#define MAX_ASSETS          64
+#define ASSET_PATH_MAX      32          // CONFIG_SPIFFS_OBJ_NAME_LEN
+#define COPY_BUFFER_SIZE    4096
+#define DIGEST_SIZE         32
+#define HELD_FILES_MAX      128         // files a slot moved in place may hold
+
+static const char *const SLOTS[] = { "storage", "storage_b" };
+
+typedef struct {
+    char path[ASSET_PATH_MAX];
+    uint32_t size;
+    uint8_t sha256[DIGEST_SIZE];
+} asset_entry_t;
+
+typedef struct {
+    uint32_t version;           // 0 without a manifest
+    int count;
+    asset_entry_t entries[MAX_ASSETS];
+} asset_manifest_t;
+
+typedef struct {
+    esp_http_client_handle_t client;
+    uint8_t *buf;
+    ota_progress_state_t progress;
+    int32_t downloaded;         // bytes of all changed files so far
+    int32_t download_size;
+} asset_update_t;
+
+static char assets_reason[50];
+
+static void post(int32_t event, const char *reason)
+{
+    strncpy(assets_reason, reason, sizeof(assets_reason) - 1);
+    esp_event_post(TUX_EVENTS, event, assets_reason, sizeof(assets_reason), portMAX_DELAY);
+}
+
+/* ---------- Slots ---------- */
+
+static uint8_t read_u8(const char *key, uint8_t fallback)
+{
+    nvs_handle_t h;
+    uint8_t value = fallback;
+    if (nvs_open(ASSETS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        nvs_get_u8(h, key, &value);
+        nvs_close(h);
+    }
+    return value;
+}
+
+static esp_err_t write_u8(const char *key, uint8_t value)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(ASSETS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_u8(h, key, value);
+    if (err == ESP_OK) {
+        err = nvs_commit(h);
+    }
+    nvs_close(h);
+    return err;
+}
+
+/* Key of the filesystem recorded for slot, none for a slot this firmware never wrote */
+static const char *fs_key(int slot)
+{
+    return slot ? "fs1" : "fs0";
+}
+
+static bool slot_exists(int slot)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, SLOTS[slot]) != NULL;
+}
+
+static int active_slot(void)
+{
+    int slot = read_u8(ASSETS_SLOT_KEY, 0) == 1 ? 1 : 0;
+    return slot_exists(slot) ? slot : 0;
+}
+
+const char *ota_assets_partition(void)
+{
+    return SLOTS[active_slot()];
+}
+
+const char *ota_assets_spare_partition(void)
+{
+    int spare = 1 - active_slot();
+    return slot_exists(spare) ? SLOTS[spare] : NULL;
+}
+
+/* slot was just filled with the configured filesystem */
+static esp_err_t set_active_slot(int slot)
+{
+    // Recorded first: should the swap not follow, the record is still true
+    esp_err_t err = write_u8(fs_key(slot), (uint8_t)storage_fs());
+    if (err == ESP_OK) {
+        err = write_u8(ASSETS_SLOT_KEY, (uint8_t)slot);
+    }
+    return err;
+}
+
+/* ---------- Manifest ---------- */
+
+static bool parse_hex(const char *hex, uint8_t *out, int len)
+{
+    for (int i = 0; i < len; i++) {
+        unsigned v;
+        if (sscanf(hex + i * 2, "%2x", &v) != 1) {
+            return false;
+        }
+        out[i] = (uint8_t)v;
+    }
+    return true;
+}
+
+/* A path relative to the slot root that stays inside it */
+static bool safe_path(const char *path)
+{
+    return path[0] != '/' && strstr(path, "..") == NULL;
+}
+
+static esp_err_t parse_manifest(char *text, asset_manifest_t *m)
+{
+    m->version = 0;
+    m->count = 0;
+    char *save;
+    char *line = strtok_r(text, "\r\n", &save);
+    if (line == NULL || sscanf(line, MANIFEST_MAGIC " %" SCNu32, &m->version) != 1) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    while ((line = strtok_r(NULL, "\r\n", &save)) != NULL) {
+        char hex[2 * DIGEST_SIZE + 1];
+        asset_entry_t *e = &m->entries[m->count];
+        if (m->count == MAX_ASSETS) {
+            ESP_LOGE(TAG, "Manifest lists more than %d assets", MAX_ASSETS);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (sscanf(line, "%64s %" SCNu32 " %31s", hex, &e->size, e->path) != 3 || strlen(hex) != 2 * DIGEST_SIZE ||
+            !parse_hex(hex, e->sha256, DIGEST_SIZE) || !safe_path(e->path) || strcmp(e->path, MANIFEST_NAME) == 0) {
+            ESP_LOGE(TAG, "Bad manifest line: %s", line);
+            return ESP_ERR_INVALID_ARG;
+        }
+        m->count++;
+    }
+    return ESP_OK;
+}
+
+static const asset_entry_t *find_entry(const asset_manifest_t *m, const char *path)
+{
+    for (int i = 0; i < m->count; i++) {
+        if (strcmp(m->entries[i].path, path) == 0) {
+            return &m->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* Manifest of the active slot; an empty one (version 0) if it has none. */
+static void load_local_manifest(asset_manifest_t *m, char *text)
+{
+    m->version = 0;
+    m->count = 0;
+    FILE *f = fopen(ACTIVE_ROOT "/" MANIFEST_NAME, "r");
+    if (f == NULL) {
+        return;
+    }
+    size_t n = fread(text, 1, MANIFEST_MAX - 1, f);
+    fclose(f);
+    text[n] = '\0';
+    if (parse_manifest(text, m) != ESP_OK) {
+        ESP_LOGW(TAG, "Ignoring the unreadable local asset manifest");
+        m->version = 0;
+        m->count = 0;
+    }
+}
+
+/* ---------- Transfers ---------- */
+
+/* Opens a GET for url on the kept-alive client, ready to read the body. */
+static esp_err_t http_get(esp_http_client_handle_t client, const char *url)
+{
+    esp_http_client_set_url(client, url);
+    if (esp_http_client_open(client, 0) != ESP_OK) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status != 200) {
+        ESP_LOGE(TAG, "HTTP %d for %s", status, url);
+        esp_http_client_close(client);
+        return ESP_ERR_HTTP_FETCH_HEADER;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t fetch_manifest(asset_update_t *u, char *text)
+{
+    esp_err_t err = http_get(u->client, CONFIG_ASSETS_MANIFEST_URL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    int got = 0;
+    int n;
+    while (got < MANIFEST_MAX - 1 && (n = esp_http_client_read(u->client, text + got, MANIFEST_MAX - 1 - got)) > 0) {
+        got += n;
+    }
+    bool complete = esp_http_client_is_complete_data_received(u->client);
+    esp_http_client_close(u->client);
+    if (!complete) {
+        ESP_LOGE(TAG, "Asset manifest incomplete or over %d bytes", MANIFEST_MAX - 1);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    text[got] = '\0';
+    return ESP_OK;
+}
+
+/* Closes f, checks size and digest against e and removes the file on any failure. */
+static esp_err_t finish_file(FILE *f, const char *path, mbedtls_sha256_context *sha, uint32_t size,
+                             const asset_entry_t *e, esp_err_t err)
+{
+    uint8_t digest[DIGEST_SIZE];
+    mbedtls_sha256_finish(sha, digest);
+    mbedtls_sha256_free(sha);
+    if (fclose(f) != 0 && err == ESP_OK) {
+        err = ESP_FAIL;
+    }
+    if (err == ESP_OK && e != NULL && (size != e->size || memcmp(digest, e->sha256, DIGEST_SIZE) != 0)) {
+        err = ESP_ERR_INVALID_CRC;
+    }
+    if (err != ESP_OK) {
+        unlink(path);
+    }
+    return err;
+}
+
+/* Creates the directories leading to path; on SPIFFS, where a name may hold
+ * slashes, mkdir fails harmlessly. */
+static void make_parents(const char *path)
+{
+    char dir[sizeof(STAGING_ROOT) + ASSET_PATH_MAX + 1];
+    strlcpy(dir, path, sizeof(dir));
+    for (char *slash = strchr(dir + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        mkdir(dir, 0755);
+        *slash = '/';
+    }
+}
+
+/* Copies src to dst; with e, only if the copy matches it. */
+static esp_err_t copy_file(asset_update_t *u, const char *src, const char *dst, const asset_entry_t *e)
+{
+    FILE *in = fopen(src, "rb");
+    if (in == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    make_parents(dst);
+    FILE *out = fopen(dst, "wb");
+    if (out == NULL) {
+        fclose(in);
+        return ESP_FAIL;
+    }
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    esp_err_t err = ESP_OK;
+    uint32_t size = 0;
+    size_t n;
+    while ((n = fread(u->buf, 1, COPY_BUFFER_SIZE, in)) > 0) {
+        mbedtls_sha256_update(&sha, u->buf, n);
+        if (fwrite(u->buf, 1, n, out) != n) {
+            err = ESP_ERR_NO_MEM;   // slot full
+            break;
+        }
+        size += n;
+    }
+    fclose(in);
+    return finish_file(out, dst, &sha, size, e, err);
+}
+
+static esp_err_t download_file(asset_update_t *u, const char *url, const char *dst, const asset_entry_t *e)
+{
+    esp_err_t err = http_get(u->client, url);
+    if (err != ESP_OK) {
+        return err;
+    }
+    make_parents(dst);
+    FILE *out = fopen(dst, "wb");
+    if (out == NULL) {
+        esp_http_client_close(u->client);
+        return ESP_FAIL;
+    }
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    uint32_t size = 0;
+    int n;
+    while ((n = esp_http_client_read(u->client, (char *)u->buf, COPY_BUFFER_SIZE)) > 0) {
+        mbedtls_sha256_update(&sha, u->buf, n);
+        if (fwrite(u->buf, 1, n, out) != (size_t)n) {
+            err = ESP_ERR_NO_MEM;
+            break;
+        }
+        size += n;
+        u->downloaded += n;
+        ota_progress_update(&u->progress, u->downloaded, u->download_size, false);
+    }
+    if (err == ESP_OK && (n < 0 || !esp_http_client_is_complete_data_received(u->client))) {
+        err = ESP_ERR_HTTP_EAGAIN;
+    }
+    esp_http_client_close(u->client);
+    return finish_file(out, dst, &sha, size, e, err);
+}
+
+/*
+ * Copies the files under dir ("" for the root, subdirectories included) from
+ * the active slot to the staging slot, except the manifest and the files it
+ * lists; without a manifest, everything. Returns the number of files left
+ * behind.
+ */
+static int copy_tree(asset_update_t *u, const char *dir, const asset_manifest_t *skip)
+{
+    char path[ASSET_PATH_MAX];
+    char src[sizeof(ACTIVE_ROOT) + ASSET_PATH_MAX + 1];
+    char dst[sizeof(STAGING_ROOT) + ASSET_PATH_MAX + 1];
+
+    snprintf(src, sizeof(src), ACTIVE_ROOT "/%s", dir);
+    DIR *d = opendir(src);
+    if (d == NULL) {
+        return 1;
+    }
+    int left = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if (snprintf(path, sizeof(path), "%s%s%s", dir, *dir ? "/" : "", entry->d_name) >= (int)sizeof(path)) {
+            ESP_LOGW(TAG, "Not carried over: %s/%s", dir, entry->d_name);
+            left++;
+            continue;
+        }
+        if (entry->d_type == DT_DIR) {
+            left += copy_tree(u, path, skip);
+            continue;
+        }
+        if (skip && (find_entry(skip, path) || strcmp(path, MANIFEST_NAME) == 0)) {
+            continue;
+        }
+        snprintf(src, sizeof(src), ACTIVE_ROOT "/%s", path);
+        snprintf(dst, sizeof(dst), STAGING_ROOT "/%s", path);
+        if (copy_file(u, src, dst, NULL) != ESP_OK) {
+            ESP_LOGW(TAG, "Not carried over: %s", path);
+            left++;
+        }
+    }
+    closedir(d);
+    return left;
+}
+
+/* Formats the other slot with the configured filesystem and mounts it at STAGING_ROOT */
+static esp_err_t open_staging(int slot)
+{
+    esp_err_t err = storage_format(storage_fs(), SLOTS[slot]);
+    if (err == ESP_OK) {
+        err = storage_mount(storage_fs(), SLOTS[slot], STAGING_ROOT, 2);
+    }
+    return err;
+}
+
+/* ---------- Update ---------- */
+
+static esp_err_t fill_slot(asset_update_t *u, const asset_manifest_t *local, const asset_manifest_t *remote,
+                           const char *manifest_text)
+{
+    char src[sizeof(ACTIVE_ROOT) + ASSET_PATH_MAX + 1];
+    char dst[sizeof(STAGING_ROOT) + ASSET_PATH_MAX + 1];
+    char url[sizeof(CONFIG_ASSETS_MANIFEST_URL) + ASSET_PATH_MAX];
+
+    // Files download from the manifest's directory
+    const char *slash = strrchr(CONFIG_ASSETS_MANIFEST_URL, '/');
+    int base_len = slash ? (int)(slash - CONFIG_ASSETS_MANIFEST_URL) + 1 : 0;
+
+    bool unchanged[MAX_ASSETS];
+    u->download_size = 0;
+    for (int i = 0; i < remote->count; i++) {
+        const asset_entry_t *old = find_entry(local, remote->entries[i].path);
+        unchanged[i] = old && old->size == remote->entries[i].size &&
+                       memcmp(old->sha256, remote->entries[i].sha256, DIGEST_SIZE) == 0;
+        if (!unchanged[i]) {
+            u->download_size += remote->entries[i].size;
+        }
+    }
+
+    int copied = 0;
+    int downloaded = 0;
+    for (int i = 0; i < remote->count; i++) {
+        const asset_entry_t *e = &remote->entries[i];
+        snprintf(dst, sizeof(dst), STAGING_ROOT "/%s", e->path);
+        esp_err_t err = ESP_ERR_NOT_FOUND;
+        if (unchanged[i]) {
+            snprintf(src, sizeof(src), ACTIVE_ROOT "/%s", e->path);
+            err = copy_file(u, src, dst, e);
+            if (err == ESP_ERR_INVALID_CRC || err == ESP_ERR_NOT_FOUND) {
+                // Local copy damaged or gone, fetch it after all
+                ESP_LOGW(TAG, "%s does not match the local manifest", e->path);
+                u->download_size += e->size;
+            }
+        }
+        if (err == ESP_OK) {
+            copied++;
+            continue;
+        }
+        if (err != ESP_ERR_INVALID_CRC && err != ESP_ERR_NOT_FOUND) {
+            ESP_LOGE(TAG, "Copying %s failed: %s", e->path, esp_err_to_name(err));
+            return err;
+        }
+        snprintf(url, sizeof(url), "%.*s%s", base_len, CONFIG_ASSETS_MANIFEST_URL, e->path);
+        err = download_file(u, url, dst, e);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Downloading %s failed: %s", e->path, esp_err_to_name(err));
+            return err;
+        }
+        downloaded++;
+    }
+    ota_progress_update(&u->progress, u->downloaded, u->download_size, true);
+
+    // Runtime files (logs, caches) move with the assets, as far as they fit
+    copy_tree(u, "", remote);
+
+    // The manifest goes last: a slot without one never becomes active
+    FILE *f = fopen(STAGING_ROOT "/" MANIFEST_NAME, "w");
+    if (f == NULL) {
+        return ESP_FAIL;
+    }
+    size_t len = strlen(manifest_text);
+    bool written = fwrite(manifest_text, 1, len, f) == len;
+    if (fclose(f) != 0 || !written) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Asset slot filled: %d files copied, %d downloaded (%" PRId32 " bytes)", copied, downloaded,
+             u->downloaded);
+    return ESP_OK;
+}
+
+static esp_err_t update_assets(asset_update_t *u, char *local_text, char *remote_text, bool *up_to_date)
+{
+    static asset_manifest_t local, remote;     // too big for the task stack
+    load_local_manifest(&local, local_text);
+
+    esp_err_t err = fetch_manifest(u, remote_text);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // parse_manifest cuts the text into lines, the slot gets the original
+    char *parsed = strdup(remote_text);
+    if (parsed == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    err = parse_manifest(parsed, &remote);
+    free(parsed);
+    if (err != ESP_OK) {
+        return err;
+    }
+    ESP_LOGI(TAG, "Assets: local version %" PRIu32 ", server version %" PRIu32 ", %d files", local.version,
+             remote.version, remote.count);
+    if (remote.version <= local.version) {
+        *up_to_date = true;
+        return ESP_OK;
+    }
+
+    int from = active_slot();
+    int to = 1 - from;
+    if (!slot_exists(to)) {
+        ESP_LOGE(TAG, "No %s partition for a second asset slot", SLOTS[to]);
+        return ESP_ERR_NOT_FOUND;
+    }
+    err = open_staging(to);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = fill_slot(u, &local, &remote, remote_text);
+    storage_unmount(SLOTS[to]);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // The single NVS write is the swap
+    err = set_active_slot(to);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Asset slot %s active from the next boot", SLOTS[to]);
+    }
+    return err;
+}
+
+void run_asset_update_task(void *pvParameter)
+{
+    ESP_LOGI(TAG, "Checking for asset updates");
+    post(TUX_EVENT_OTA_STARTED, "Checking assets...");
+    ota_link_setup();
+
+    esp_http_client_config_t config;
+    ota_http_config(&config);
+    config.url = CONFIG_ASSETS_MANIFEST_URL;
+
+    asset_update_t u = {
+        .client = esp_http_client_init(&config),
+        .buf = malloc(COPY_BUFFER_SIZE),
+    };
+    char *local_text = malloc(MANIFEST_MAX);
+    char *remote_text = malloc(MANIFEST_MAX);
+    ota_progress_init(&u.progress);
+
+    bool up_to_date = false;
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (u.client && u.buf && local_text && remote_text) {
+        err = update_assets(&u, local_text, remote_text, &up_to_date);
+    }
+    if (u.client) {
+        esp_http_client_cleanup(u.client);
+    }
+    free(u.buf);
+    free(local_text);
+    free(remote_text);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Asset update stopped: %s", esp_err_to_name(err));
+        post(TUX_EVENT_OTA_FAILED, "Asset update failed");
+    } else if (up_to_date) {
+        post(TUX_EVENT_OTA_ABORTED, "No asset updates found!");
+    } else {
+        post(TUX_EVENT_OTA_COMPLETED, "Assets updated");
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        esp_restart();
+    }
+    vTaskDelete(NULL);
+}
+
+/* ---------- Mounting ---------- */
+
+static esp_err_t mount_slot(int slot, int max_files, storage_fs_t *fs)
+{
+    storage_fs_t known = (storage_fs_t)read_u8(fs_key(slot), STORAGE_FS_NONE);
+    if (known != STORAGE_FS_NONE && storage_mount(known, SLOTS[slot], ACTIVE_ROOT, max_files) == ESP_OK) {
+        *fs = known;
+        return ESP_OK;
+    }
+    // A factory image, or a slot written by an older firmware
+    esp_err_t err = storage_mount_any(SLOTS[slot], ACTIVE_ROOT, max_files, fs);
+    if (err == ESP_OK) {
+        write_u8(fs_key(slot), (uint8_t)*fs);
+    }
+    return err;
+}
+
+/* Copies the mounted slot from into the other one, on the configured filesystem, and makes that active */
+static esp_err_t move_slot(int from)
+{
+    int to = 1 - from;
+    if (!slot_exists(to)) {
+        ESP_LOGE(TAG, "No %s partition to move the assets to", SLOTS[to]);
+        return ESP_ERR_NOT_FOUND;
+    }
+    asset_update_t u = {
+        .buf = malloc(COPY_BUFFER_SIZE),
+    };
+    if (u.buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = open_staging(to);
+    if (err == ESP_OK) {
+        int left = copy_tree(&u, "", NULL);
+        storage_unmount(SLOTS[to]);
+        if (left) {
+            ESP_LOGE(TAG, "%d files not copied to %s", left, storage_fs_name(storage_fs()));
+            err = ESP_ERR_NO_MEM;
+        }
+    }
+    free(u.buf);
+    if (err == ESP_OK) {
+        err = set_active_slot(to);
+    }
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Assets moved to %s on %s in %" PRId64 " ms", SLOTS[to], storage_fs_name(storage_fs()),
+                 (esp_timer_get_time() - start) / 1000);
+    }
+    return err;
+}
+
+/* ---------- Moving in place (CONFIG_STORAGE_MOVE_IN_PLACE) ---------- */
+
+#if CONFIG_STORAGE_MOVE_IN_PLACE
+
+typedef struct {
+    char path[ASSET_PATH_MAX];
+    uint32_t offset;            // into held_tree_t.data
+    uint32_t size;
+} held_file_t;
+
+typedef struct {
+    held_file_t *files;
+    int count;
+    uint8_t *data;
+    size_t used;
+    size_t capacity;
+} held_tree_t;
+
+/* Reads the files under dir on the active slot into t; false as soon as one
+ * cannot be read or does not fit. */
+static bool hold_tree(held_tree_t *t, const char *dir)
+{
+    char path[ASSET_PATH_MAX];
+    char src[sizeof(ACTIVE_ROOT) + ASSET_PATH_MAX + 1];
+
+    snprintf(src, sizeof(src), ACTIVE_ROOT "/%s", dir);
+    DIR *d = opendir(src);
+    if (d == NULL) {
+        return false;
+    }
+    bool ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if (snprintf(path, sizeof(path), "%s%s%s", dir, *dir ? "/" : "", entry->d_name) >= (int)sizeof(path)) {
+            ESP_LOGE(TAG, "Name too long to move: %s/%s", dir, entry->d_name);
+            ok = false;
+            break;
+        }
+        if (entry->d_type == DT_DIR) {
+            ok = hold_tree(t, path);
+            continue;
+        }
+        snprintf(src, sizeof(src), ACTIVE_ROOT "/%s", path);
+        struct stat st;
+        if (t->count == HELD_FILES_MAX || stat(src, &st) != 0 || (size_t)st.st_size > t->capacity - t->used) {
+            ESP_LOGE(TAG, "Cannot hold %s", path);
+            ok = false;
+            break;
+        }
+        held_file_t *f = &t->files[t->count];
+        FILE *in = fopen(src, "rb");
+        ok = in && fread(t->data + t->used, 1, st.st_size, in) == (size_t)st.st_size;
+        if (in) {
+            fclose(in);
+        }
+        strlcpy(f->path, path, sizeof(f->path));
+        f->offset = t->used;
+        f->size = st.st_size;
+        t->used += st.st_size;
+        t->count++;
+    }
+    closedir(d);
+    return ok;
+}
+
+/* Writes the held files to the slot mounted at STAGING_ROOT; returns the number lost. */
+static int restore_tree(const held_tree_t *t)
+{
+    char dst[sizeof(STAGING_ROOT) + ASSET_PATH_MAX + 1];
+    int left = 0;
+    for (int i = 0; i < t->count; i++) {
+        const held_file_t *f = &t->files[i];
+        snprintf(dst, sizeof(dst), STAGING_ROOT "/%s", f->path);
+        make_parents(dst);
+        FILE *out = fopen(dst, "wb");
+        bool written = out && fwrite(t->data + f->offset, 1, f->size, out) == f->size;
+        if (out && fclose(out) != 0) {
+            written = false;
+        }
+        if (!written) {
+            ESP_LOGE(TAG, "Lost: %s", f->path);
+            unlink(dst);
+            left++;
+        }
+    }
+    return left;
+}
+
+/*
+ * Reformats slot, mounted at ACTIVE_ROOT, with the configured filesystem,
+ * holding its files in PSRAM meanwhile. Leaves the slot mounted, on the old
+ * filesystem if the files could not all be held.
+ */
+static esp_err_t move_in_place(int slot, int max_files, storage_fs_t from)
+{
+    held_tree_t t = {0};
+    // Used space, allocation overhead included, bounds the file contents
+    size_t total;
+    storage_info(SLOTS[slot], &total, &t.capacity);
+    t.files = heap_caps_calloc(HELD_FILES_MAX, sizeof(held_file_t), MALLOC_CAP_SPIRAM);
+    t.data = heap_caps_malloc(t.capacity + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (t.files == NULL || t.data == NULL || !hold_tree(&t, "")) {
+        free(t.files);
+        free(t.data);
+        ESP_LOGE(TAG, "Assets stay on %s: they do not fit in PSRAM, and storage_b needs a serial flash",
+                 storage_fs_name(from));
+        write_u8(ASSETS_FAILED_KEY, (uint8_t)storage_fs());
+        return ESP_OK;
+    }
+
+    int64_t start = esp_timer_get_time();
+    storage_unmount(SLOTS[slot]);
+    esp_err_t err = open_staging(slot);
+    if (err == ESP_OK) {
+        int left = restore_tree(&t);
+        storage_unmount(SLOTS[slot]);
+        // The slot holds the new filesystem whatever was lost
+        write_u8(fs_key(slot), (uint8_t)storage_fs());
+        if (left) {
+            ESP_LOGE(TAG, "%d of %d files lost moving to %s", left, t.count, storage_fs_name(storage_fs()));
+        } else {
+            ESP_LOGI(TAG, "Assets moved in place to %s, %d files in %" PRId64 " ms", storage_fs_name(storage_fs()),
+                     t.count, (esp_timer_get_time() - start) / 1000);
+        }
+    } else {
+        ESP_LOGE(TAG, "Formatting %s failed: %s", SLOTS[slot], esp_err_to_name(err));
+    }
+    free(t.files);
+    free(t.data);
+    storage_fs_t fs;
+    return mount_slot(slot, max_files, &fs);
+}
+
+#endif // CONFIG_STORAGE_MOVE_IN_PLACE
+
+esp_err_t ota_assets_mount(int max_files)
+{
+    int slot = active_slot();
+    storage_fs_t fs;
+    esp_err_t err = mount_slot(slot, max_files, &fs);
+    if (err != ESP_OK || fs == storage_fs() || read_u8(ASSETS_FAILED_KEY, STORAGE_FS_NONE) == storage_fs()) {
+        return err;
+    }
+
+    ESP_LOGW(TAG, "Assets are on %s, moving them to %s", storage_fs_name(fs), storage_fs_name(storage_fs()));
+    if (!slot_exists(1 - slot)) {
+        // A partition table from before storage_b
+#if CONFIG_STORAGE_MOVE_IN_PLACE
+        return move_in_place(slot, max_files, fs);
+#else
+        ESP_LOGW(TAG, "Assets stay on %s: no storage_b to move them to", storage_fs_name(fs));
+        return ESP_OK;
+#endif
+    }
+    err = move_slot(slot);
+    if (err != ESP_OK) {
+        // Not again at every boot; the old slot stays in use as it is
+        ESP_LOGE(TAG, "Assets stay on %s: %s", storage_fs_name(fs), esp_err_to_name(err));
+        write_u8(ASSETS_FAILED_KEY, (uint8_t)storage_fs());
+        return ESP_OK;
+    }
+    storage_unmount(SLOTS[slot]);
+    return mount_slot(1 - slot, max_files, &fs);
+}
@@ -0,0 +1,159 @@
+/*
+   OTA throughput benchmark.
+
+   Downloads the firmware image once per combination of the CONFIG_OTA_BENCH_*
+   lists and writes one CSV row per run, to a file and to the log:
+
+     record_size   sent as ?chunk=N; ota_flaky_server.py then writes the
+                   image in N byte pieces, which makes N the TLS record size
+     request_size  Range request size, 0 for a single GET
+     buffer_size,  receive buffers; 1 buffer is the serial read-erase-write
+     buffers       loop of esp_https_ota, more overlap with a writer task
+
+   Every run goes through ota_pipeline_run into the passive slot, and the
+   result is verified like an update but never set for boot, so the device
+   keeps running the current firmware.
+*/
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "ota.h"
+#include "ota_priv.h"
+
+static const char *TAG = "OTA";
+
+#ifndef CONFIG_OTA_BENCH_RECORD_SIZES
+#define CONFIG_OTA_BENCH_RECORD_SIZES "0"
+#endif
+#ifndef CONFIG_OTA_BENCH_REQUEST_SIZES
+#define CONFIG_OTA_BENCH_REQUEST_SIZES "0,16384,65536"
+#endif
+#ifndef CONFIG_OTA_BENCH_BUFFER_SIZES
+#define CONFIG_OTA_BENCH_BUFFER_SIZES "4096,16384"
+#endif
+#ifndef CONFIG_OTA_BENCH_BUFFERS
+#define CONFIG_OTA_BENCH_BUFFERS "1,2,4"
+#endif
+#ifndef CONFIG_OTA_BENCH_RUNS
+#define CONFIG_OTA_BENCH_RUNS 2
+#endif
+#ifndef CONFIG_OTA_BENCH_CSV_PATH
+#define CONFIG_OTA_BENCH_CSV_PATH "/spiffs/ota_bench.csv"
+#endif
+
+#define MAX_VALUES          8
+#define URL_SIZE            300
+
+static const char CSV_HEADER[] =
+    "run,record_size,request_size,buffer_size,buffers,result,bytes,requests,"
+    "connect_ms,first_byte_ms,download_ms,kb_per_s,reads,read_p50_us,read_p95_us,read_max_us,"
+    "buffer_wait_ms,erase_ms,write_ms,writer_idle_ms,verify_ms\n";
+
+/* "0,16384,65536" => values; a bad list is reported and read as { fallback } */
+static int parse_list(const char *name, const char *list, int fallback, int *values)
+{
+    int n = 0;
+    const char *p = list;
+    while (*p && n < MAX_VALUES) {
+        char *end;
+        long v = strtol(p, &end, 10);
+        if (end == p || v < 0) {
+            ESP_LOGW(TAG, "Bad %s list \"%s\", using %d", name, list, fallback);
+            n = 0;
+            break;
+        }
+        values[n++] = (int)v;
+        p = *end == ',' ? end + 1 : end;
+    }
+    if (n == 0) {
+        values[n++] = fallback;
+    }
+    return n;
+}
+
+static int csv_row(char *buf, size_t size, int run, int record_size, const ota_pipeline_params_t *params,
+                   esp_err_t err, const ota_pipeline_stats_t *s)
+{
+    uint32_t kbps = s->download_us > 0 ? (uint32_t)((int64_t)s->bytes * 1000000 / s->download_us / 1024) : 0;
+    return snprintf(buf, size,
+                    "%d,%d,%d,%d,%d,%s,%" PRIu32 ",%" PRIu32 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRIu32 ","
+                    "%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64
+                    ",%" PRId64 "\n",
+                    run, record_size, params->request_size, params->buffer_size, params->buffers,
+                    err == ESP_OK ? "ok" : esp_err_to_name(err), s->bytes, s->requests, s->connect_us / 1000,
+                    s->first_byte_us / 1000, s->download_us / 1000, kbps, s->reads,
+                    ota_pipeline_read_percentile(s, 50), ota_pipeline_read_percentile(s, 95), s->read_max_us,
+                    s->buffer_wait_us / 1000, s->erase_us / 1000, s->write_us / 1000, s->writer_idle_us / 1000,
+                    s->verify_us / 1000);
+}
+
+void run_ota_bench_task(void *pvParameter)
+{
+    int records[MAX_VALUES], requests[MAX_VALUES], sizes[MAX_VALUES], counts[MAX_VALUES];
+    int n_records = parse_list("record size", CONFIG_OTA_BENCH_RECORD_SIZES, 0, records);
+    int n_requests = parse_list("request size", CONFIG_OTA_BENCH_REQUEST_SIZES, 0, requests);
+    int n_sizes = parse_list("buffer size", CONFIG_OTA_BENCH_BUFFER_SIZES, 16384, sizes);
+    int n_counts = parse_list("buffers", CONFIG_OTA_BENCH_BUFFERS, 1, counts);
+    int total = n_records * n_requests * n_sizes * n_counts * CONFIG_OTA_BENCH_RUNS;
+    ESP_LOGI(TAG, "OTA benchmark: %d downloads, CSV to %s", total, CONFIG_OTA_BENCH_CSV_PATH);
+
+    ota_link_setup();
+    esp_http_client_config_t config;
+    ota_http_config(&config);
+    const char *base_url = config.url;
+    char url[URL_SIZE];
+
+    FILE *f = fopen(CONFIG_OTA_BENCH_CSV_PATH, "w");
+    if (f == NULL) {
+        ESP_LOGW(TAG, "Can't create %s, CSV goes to the log only", CONFIG_OTA_BENCH_CSV_PATH);
+    } else {
+        fputs(CSV_HEADER, f);
+    }
+    ESP_LOGI(TAG, "CSV %.*s", (int)strlen(CSV_HEADER) - 1, CSV_HEADER);
+
+    int run = 0;
+    int failed = 0;
+    char row[256];
+    for (int r = 0; r < n_records; r++) {
+        if (records[r] > 0) {
+            snprintf(url, sizeof(url), "%s%cchunk=%d", base_url, strchr(base_url, '?') ? '&' : '?', records[r]);
+            config.url = url;
+        } else {
+            config.url = base_url;
+        }
+        for (int q = 0; q < n_requests; q++) {
+            for (int b = 0; b < n_sizes; b++) {
+                for (int c = 0; c < n_counts; c++) {
+                    for (int i = 0; i < CONFIG_OTA_BENCH_RUNS; i++) {
+                        const ota_pipeline_params_t params = {
+                            .buffers = counts[c] > 0 ? counts[c] : 1,
+                            .buffer_size = sizes[b] >= 4096 ? sizes[b] : 4096,
+                            .request_size = requests[q],
+                            .set_boot = false,
+                        };
+                        ota_pipeline_stats_t stats;
+                        esp_err_t err = ota_pipeline_run(&config, NULL, &params, &stats);
+                        failed += err != ESP_OK;
+                        int len = csv_row(row, sizeof(row), ++run, records[r], &params, err, &stats);
+                        ESP_LOGI(TAG, "CSV %.*s", len - 1, row);
+                        if (f) {
+                            fputs(row, f);
+                            fflush(f);
+                        }
+                        // Let the server side and the TCP stack settle between runs
+                        vTaskDelay(pdMS_TO_TICKS(1000));
+                    }
+                }
+            }
+        }
+    }
+    if (f) {
+        fclose(f);
+    }
+    ESP_LOGI(TAG, "OTA benchmark done: %d runs, %d failed", run, failed);
+    vTaskDelete(NULL);
+}
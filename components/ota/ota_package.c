@@ -0,0 +1,469 @@
+/*
+   Compressed and delta OTA packages.
+
+   A package (ota_pack.py) is an ota_pkg_header_t followed by a raw deflate
+   stream: either the whole image, or delta ops against the image running
+   now. Both are inflated with the ROM's tinfl and written straight into the
+   passive slot as they arrive, so nothing is staged. A delta adds each
+   downloaded byte to the byte at the same spot in the running image, which
+   keeps moved code with relocated addresses cheap (mostly zero bytes).
+
+   The running image is hashed first, so a delta is only applied to the exact
+   image it was made from; the reconstructed image is checked against the
+   SHA-256 in the header, then by esp_ota_end like any other image.
+
+   Delta URL: <firmware url>.from-<first 8 hex of the running ELF SHA-256>.
+   When there is none, or it does not apply, <firmware url> is fetched,
+   which may be a full package or a plain .bin.
+*/
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_app_format.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+#include "rom/miniz.h"
+#include "ota.h"
+#include "ota_priv.h"
+
+static const char *TAG = "OTA";
+
+#define NET_BUF_SIZE        4096
+#define BASE_BUF_SIZE       4096
+#define DELTA_URL_SIZE      280
+
+// Image header, first segment header and app descriptor
+#define APP_DESC_OFFSET     (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t))
+#define IMAGE_HEAD_SIZE     (APP_DESC_OFFSET + sizeof(esp_app_desc_t))
+
+typedef enum {
+    DELTA_OP,
+    DELTA_ARGS,
+    DELTA_ADD,
+    DELTA_LITERAL,
+} delta_state_t;
+
+typedef struct {
+    // Output: the passive slot
+    const esp_partition_t *part;
+    esp_ota_handle_t ota;
+    mbedtls_sha256_context sha;
+    uint32_t image_size;        // 0 when unknown (plain image, chunked)
+    uint8_t image_sha256[32];   // packages only
+    uint32_t written;
+    uint8_t head[IMAGE_HEAD_SIZE];
+    esp_err_t (*validate)(esp_app_desc_t *);
+
+    // Inflate
+    tinfl_decompressor *inflator;
+    uint8_t *dict;              // TINFL_LZ_DICT_SIZE, also the output buffer
+    size_t dict_ofs;
+    bool inflate_done;
+
+    // Delta
+    const esp_partition_t *base;
+    uint32_t base_size;
+    uint8_t *base_buf;
+    delta_state_t state;
+    uint8_t op;
+    uint8_t args[8];
+    uint8_t args_len;
+    uint8_t args_need;
+    uint32_t src;
+    uint32_t remaining;
+} pkg_ctx_t;
+
+/* ---------- Output ---------- */
+
+static esp_err_t out_write(pkg_ctx_t *c, const uint8_t *data, size_t len)
+{
+    if (c->image_size && c->written + len > c->image_size) {
+        ESP_LOGE(TAG, "Package produces more than %" PRIu32 " bytes", c->image_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // Check the app descriptor before the first byte goes to flash
+    if (c->written < IMAGE_HEAD_SIZE) {
+        size_t n = len < IMAGE_HEAD_SIZE - c->written ? len : IMAGE_HEAD_SIZE - c->written;
+        memcpy(c->head + c->written, data, n);
+        if (c->written + n < IMAGE_HEAD_SIZE) {
+            c->written += n;
+            return ESP_OK;
+        }
+        esp_app_desc_t *desc = (esp_app_desc_t *)(c->head + APP_DESC_OFFSET);
+        if (c->head[0] != ESP_IMAGE_HEADER_MAGIC || desc->magic_word != ESP_APP_DESC_MAGIC_WORD) {
+            ESP_LOGE(TAG, "Package does not contain an app image");
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        if (c->validate && c->validate(desc) != ESP_OK) {
+            return ESP_ERR_INVALID_VERSION;
+        }
+        esp_err_t err = esp_ota_begin(c->part, OTA_WITH_SEQUENTIAL_WRITES, &c->ota);
+        if (err == ESP_OK) {
+            err = esp_ota_write(c->ota, c->head, IMAGE_HEAD_SIZE);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        mbedtls_sha256_update(&c->sha, c->head, IMAGE_HEAD_SIZE);
+        c->written = IMAGE_HEAD_SIZE;
+        data += n;
+        len -= n;
+        if (len == 0) {
+            return ESP_OK;
+        }
+    }
+    mbedtls_sha256_update(&c->sha, data, len);
+    c->written += len;
+    return esp_ota_write(c->ota, data, len);
+}
+
+/* ---------- Delta ---------- */
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Runs inflated delta ops, which may be split anywhere. */
+static esp_err_t delta_feed(pkg_ctx_t *c, const uint8_t *data, size_t len)
+{
+    esp_err_t err = ESP_OK;
+    while (len > 0 && err == ESP_OK) {
+        switch (c->state) {
+        case DELTA_OP:
+            c->op = *data++;
+            len--;
+            c->args_len = 0;
+            c->args_need = c->op == OTA_PKG_OP_ADD ? 8 : 4;
+            if (c->op != OTA_PKG_OP_ADD && c->op != OTA_PKG_OP_LITERAL) {
+                ESP_LOGE(TAG, "Bad delta op %d at image offset %" PRIu32, c->op, c->written);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            c->state = DELTA_ARGS;
+            break;
+
+        case DELTA_ARGS: {
+            size_t n = c->args_need - c->args_len;
+            n = n < len ? n : len;
+            memcpy(c->args + c->args_len, data, n);
+            c->args_len += n;
+            data += n;
+            len -= n;
+            if (c->args_len < c->args_need) {
+                break;
+            }
+            if (c->op == OTA_PKG_OP_ADD) {
+                c->src = get_u32(c->args);
+                c->remaining = get_u32(c->args + 4);
+                if (c->src > c->base_size || c->remaining > c->base_size - c->src) {
+                    ESP_LOGE(TAG, "Delta reads past the base image");
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+                c->state = DELTA_ADD;
+            } else {
+                c->remaining = get_u32(c->args);
+                c->state = DELTA_LITERAL;
+            }
+            if (c->remaining == 0) {
+                c->state = DELTA_OP;
+            }
+            break;
+        }
+
+        case DELTA_ADD: {
+            size_t n = c->remaining < len ? c->remaining : len;
+            n = n < BASE_BUF_SIZE ? n : BASE_BUF_SIZE;
+            err = esp_partition_read(c->base, c->src, c->base_buf, n);
+            if (err != ESP_OK) {
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                c->base_buf[i] += data[i];
+            }
+            err = out_write(c, c->base_buf, n);
+            c->src += n;
+            c->remaining -= n;
+            data += n;
+            len -= n;
+            if (c->remaining == 0) {
+                c->state = DELTA_OP;
+            }
+            break;
+        }
+
+        case DELTA_LITERAL: {
+            size_t n = c->remaining < len ? c->remaining : len;
+            err = out_write(c, data, n);
+            c->remaining -= n;
+            data += n;
+            len -= n;
+            if (c->remaining == 0) {
+                c->state = DELTA_OP;
+            }
+            break;
+        }
+        }
+    }
+    return err;
+}
+
+/* ---------- Inflate ---------- */
+
+static esp_err_t inflate_feed(pkg_ctx_t *c, const uint8_t *data, size_t len)
+{
+    while (!c->inflate_done) {
+        size_t in_bytes = len;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - c->dict_ofs;
+        tinfl_status st = tinfl_decompress(c->inflator, data, &in_bytes, c->dict, c->dict + c->dict_ofs,
+                                           &out_bytes, TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_bytes;
+        len -= in_bytes;
+        if (out_bytes > 0) {
+            const uint8_t *out = c->dict + c->dict_ofs;
+            esp_err_t err = c->base ? delta_feed(c, out, out_bytes) : out_write(c, out, out_bytes);
+            if (err != ESP_OK) {
+                return err;
+            }
+            c->dict_ofs = (c->dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+        if (st == TINFL_STATUS_DONE) {
+            c->inflate_done = true;
+        } else if (st < 0) {
+            ESP_LOGE(TAG, "Corrupt package data (%d)", st);
+            return ESP_ERR_INVALID_RESPONSE;
+        } else if (st == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) {
+            return ESP_OK;
+        }
+    }
+    // Trailing bytes after the deflate stream
+    return len == 0 ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+/* ---------- Download ---------- */
+
+/* Checks that base_size bytes of the running image hash to the delta's base. */
+static esp_err_t check_base(pkg_ctx_t *c, const ota_pkg_header_t *h)
+{
+    c->base = esp_ota_get_running_partition();
+    c->base_size = h->base_size;
+    if (c->base == NULL || h->base_size > c->base->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    esp_err_t err = ESP_OK;
+    for (uint32_t ofs = 0; ofs < h->base_size && err == ESP_OK; ofs += BASE_BUF_SIZE) {
+        uint32_t n = h->base_size - ofs < BASE_BUF_SIZE ? h->base_size - ofs : BASE_BUF_SIZE;
+        err = esp_partition_read(c->base, ofs, c->base_buf, n);
+        mbedtls_sha256_update(&sha, c->base_buf, n);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    if (err == ESP_OK && memcmp(digest, h->base_sha256, sizeof(digest)) != 0) {
+        ESP_LOGW(TAG, "Delta was made for another image");
+        err = ESP_ERR_INVALID_STATE;
+    }
+    return err;
+}
+
+/* Reads exactly len bytes unless the connection ends first. */
+static int http_read_full(esp_http_client_handle_t client, uint8_t *buf, int len)
+{
+    int got = 0;
+    while (got < len) {
+        int n = esp_http_client_read(client, (char *)buf + got, len - got);
+        if (n <= 0) {
+            break;
+        }
+        got += n;
+    }
+    return got;
+}
+
+/* Sets up c from the first bytes of the response; hands back any image data among them. */
+static esp_err_t start_package(pkg_ctx_t *c, esp_http_client_handle_t client, int64_t content_length,
+                               uint8_t *buf, int *pending)
+{
+    int n = http_read_full(client, buf, sizeof(ota_pkg_header_t));
+    if (n > 0 && buf[0] == ESP_IMAGE_HEADER_MAGIC) {
+        // A plain image: stored as it comes
+        ESP_LOGI(TAG, "Plain image, %" PRId64 " bytes", content_length);
+        c->image_size = content_length > 0 ? (uint32_t)content_length : 0;
+        *pending = n;
+        return ESP_OK;
+    }
+    const ota_pkg_header_t *h = (const ota_pkg_header_t *)buf;
+    if (n != sizeof(*h) || h->magic != OTA_PKG_MAGIC || h->version != OTA_PKG_VERSION ||
+        h->header_size < sizeof(*h) || h->image_size > c->part->size) {
+        ESP_LOGE(TAG, "Not an OTA package");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    // Skip header fields this version does not know
+    for (int skip = h->header_size - sizeof(*h); skip > 0;) {
+        int r = http_read_full(client, buf + sizeof(*h), skip < NET_BUF_SIZE / 2 ? skip : NET_BUF_SIZE / 2);
+        if (r <= 0) {
+            return ESP_ERR_HTTP_EAGAIN;
+        }
+        skip -= r;
+    }
+
+    c->image_size = h->image_size;
+    c->inflator = malloc(sizeof(tinfl_decompressor));
+    c->dict = malloc(TINFL_LZ_DICT_SIZE);
+    if (c->inflator == NULL || c->dict == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    tinfl_init(c->inflator);
+
+    if (h->encoding == OTA_PKG_ENC_DELTA) {
+        esp_err_t err = check_base(c, h);
+        if (err != ESP_OK) {
+            return err;
+        }
+        ESP_LOGI(TAG, "Delta package for %" PRIu32 " bytes, %" PRId64 " to download", h->image_size,
+                 content_length);
+    } else if (h->encoding == OTA_PKG_ENC_DEFLATE) {
+        ESP_LOGI(TAG, "Compressed package for %" PRIu32 " bytes, %" PRId64 " to download", h->image_size,
+                 content_length);
+    } else {
+        ESP_LOGE(TAG, "Unknown package encoding %d", h->encoding);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    memcpy(c->image_sha256, h->image_sha256, sizeof(c->image_sha256));
+    *pending = 0;
+    return ESP_OK;
+}
+
+static esp_err_t package_fetch(const esp_http_client_config_t *config, esp_err_t (*validate)(esp_app_desc_t *))
+{
+    pkg_ctx_t *c = calloc(1, sizeof(pkg_ctx_t));
+    uint8_t *buf = malloc(NET_BUF_SIZE);
+    if (c) {
+        c->base_buf = malloc(BASE_BUF_SIZE);
+    }
+    if (c == NULL || buf == NULL || c->base_buf == NULL) {
+        if (c) {
+            free(c->base_buf);
+        }
+        free(c);
+        free(buf);
+        return ESP_ERR_NO_MEM;
+    }
+    c->validate = validate;
+    c->part = esp_ota_get_next_update_partition(NULL);
+    mbedtls_sha256_init(&c->sha);
+    mbedtls_sha256_starts(&c->sha, 0);
+
+    esp_err_t err = ESP_OK;
+    esp_http_client_handle_t client = esp_http_client_init(config);
+    if (c->part == NULL || client == NULL) {
+        err = ESP_ERR_NOT_FOUND;
+    } else if (esp_http_client_open(client, 0) != ESP_OK) {
+        err = ESP_ERR_HTTP_CONNECT;
+    }
+    int64_t content_length = err == ESP_OK ? esp_http_client_fetch_headers(client) : -1;
+    if (err == ESP_OK) {
+        int status = esp_http_client_get_status_code(client);
+        if (status == 404) {
+            err = ESP_ERR_NOT_FOUND;
+        } else if (status != 200) {
+            ESP_LOGE(TAG, "%s: HTTP %d", config->url, status);
+            err = ESP_ERR_HTTP_FETCH_HEADER;
+        }
+    }
+
+    int pending = 0;
+    if (err == ESP_OK) {
+        err = start_package(c, client, content_length, buf, &pending);
+    }
+
+    ota_progress_state_t progress;
+    ota_progress_init(&progress);
+    int32_t received = pending > 0 ? pending : (int32_t)sizeof(ota_pkg_header_t);
+    while (err == ESP_OK) {
+        if (pending > 0) {
+            err = c->inflator ? inflate_feed(c, buf, pending) : out_write(c, buf, pending);
+        }
+        if (err != ESP_OK) {
+            break;
+        }
+        pending = esp_http_client_read(client, (char *)buf, NET_BUF_SIZE);
+        if (pending == 0 && esp_http_client_is_complete_data_received(client)) {
+            break;
+        }
+        if (pending <= 0) {
+            err = ESP_ERR_HTTP_EAGAIN;
+            break;
+        }
+        received += pending;
+        ota_progress_update(&progress, received, (int32_t)content_length, false);
+    }
+    if (client) {
+        esp_http_client_close(client);
+        esp_http_client_cleanup(client);
+    }
+
+    if (err == ESP_OK) {
+        ota_progress_update(&progress, received, (int32_t)content_length, true);
+        uint8_t digest[32];
+        mbedtls_sha256_finish(&c->sha, digest);
+        if (c->inflator && !c->inflate_done) {
+            ESP_LOGE(TAG, "Package ended early");
+            err = ESP_ERR_INVALID_SIZE;
+        } else if (c->written < IMAGE_HEAD_SIZE || (c->image_size && c->written != c->image_size)) {
+            ESP_LOGE(TAG, "Image is %" PRIu32 " bytes, expected %" PRIu32, c->written, c->image_size);
+            err = ESP_ERR_INVALID_SIZE;
+        } else if (c->inflator && memcmp(digest, c->image_sha256, sizeof(digest)) != 0) {
+            ESP_LOGE(TAG, "Reconstructed image does not match its SHA-256");
+            err = ESP_ERR_INVALID_CRC;
+        }
+    }
+    if (c->ota) {
+        if (err == ESP_OK) {
+            // Validates the image before it can be booted
+            err = esp_ota_end(c->ota);
+        } else {
+            esp_ota_abort(c->ota);
+        }
+    }
+    if (err == ESP_OK) {
+        err = esp_ota_set_boot_partition(c->part);
+    }
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "%" PRIu32 " byte image from %" PRId32 " bytes in %" PRId64 " ms", c->written, received,
+                 (esp_timer_get_time() - progress.start_us) / 1000);
+    }
+
+    mbedtls_sha256_free(&c->sha);
+    free(c->inflator);
+    free(c->dict);
+    free(c->base_buf);
+    free(c);
+    free(buf);
+    return err;
+}
+
+esp_err_t ota_package_download(const esp_http_client_config_t *config, esp_err_t (*validate)(esp_app_desc_t *))
+{
+    esp_app_desc_t running;
+    esp_err_t err = esp_ota_get_partition_description(esp_ota_get_running_partition(), &running);
+    if (err == ESP_OK) {
+        char url[DELTA_URL_SIZE];
+        snprintf(url, sizeof(url), "%s.from-%02x%02x%02x%02x", config->url, running.app_elf_sha256[0],
+                 running.app_elf_sha256[1], running.app_elf_sha256[2], running.app_elf_sha256[3]);
+        esp_http_client_config_t cfg = *config;
+        cfg.url = url;
+        err = package_fetch(&cfg, validate);
+        if (err == ESP_OK || err == ESP_ERR_INVALID_VERSION) {
+            return err;
+        }
+        ESP_LOGI(TAG, "No usable delta (%s), fetching the full image", esp_err_to_name(err));
+    }
+    return package_fetch(config, validate);
+}
@@ -0,0 +1,450 @@
+/*
+   Pipelined OTA download.
+
+   esp_https_ota_perform reads one chunk and writes it to flash before the
+   next read, so network waits, TLS decryption and flash erase/write add up.
+   Here the OTA task only receives: it fills buffers from a small pool,
+   hashes them and queues them. A writer task on the other core takes full
+   buffers, writes them into the passive slot and hands them back; while no
+   buffer is waiting it erases ahead, so most writes find erased flash.
+
+   The image's appended SHA-256 is checked on the fly, so a corrupt download
+   fails as soon as the last byte is in; esp_ota_set_boot_partition verifies
+   the flash copy once more before switching.
+
+   Note that flash erase/write stalls code running from flash on both cores,
+   so the overlap is with network waits and buffering in the Wi-Fi/lwIP
+   layers, not with TLS work itself.
+
+   ota_bench.c drives the same code with other parameters; one buffer gives
+   the serial read-erase-write loop of esp_https_ota for comparison.
+*/
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_app_format.h"
+#include "esp_image_format.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+#include "ota.h"
+#include "ota_priv.h"
+
+static const char *TAG = "OTA";
+
+#ifndef CONFIG_OTA_PIPELINE_BUFFERS
+#define CONFIG_OTA_PIPELINE_BUFFERS 4
+#endif
+#ifndef CONFIG_OTA_PIPELINE_BUFFER_SIZE
+#define CONFIG_OTA_PIPELINE_BUFFER_SIZE 16384
+#endif
+
+#define SECTOR_SIZE         4096
+#define ERASE_STEP          (16 * SECTOR_SIZE)  // block erase where aligned
+#define DIGEST_SIZE         32
+
+// Image header, first segment header and app descriptor
+#define APP_DESC_OFFSET     (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t))
+#define IMAGE_HEAD_SIZE     (APP_DESC_OFFSET + sizeof(esp_app_desc_t))
+
+typedef struct {
+    uint8_t *data;
+    uint32_t len;               // 0 ends the stream
+} ota_chunk_t;
+
+typedef struct {
+    QueueHandle_t free_q;
+    QueueHandle_t full_q;
+    TaskHandle_t receiver;      // notified when the writer is done
+    const esp_partition_t *part;
+    uint32_t image_size;
+    uint32_t erase_step;
+    uint32_t erased;            // flash erased up to here
+    uint32_t written;
+    volatile esp_err_t err;     // first writer error
+    ota_pipeline_stats_t *stats;
+
+    // Range requests
+    int32_t range_start;        // from Content-Range, -1 if absent
+    int32_t range_total;
+} ota_pipeline_t;
+
+/* Erases the next step, or up to the image end. */
+static esp_err_t erase_ahead(ota_pipeline_t *p)
+{
+    uint32_t end = (p->erased / p->erase_step + 1) * p->erase_step;
+    uint32_t image_end = (p->image_size + SECTOR_SIZE - 1) & ~(SECTOR_SIZE - 1);
+    if (end > image_end) {
+        end = image_end;
+    }
+    int64_t t = esp_timer_get_time();
+    esp_err_t err = esp_partition_erase_range(p->part, p->erased, end - p->erased);
+    p->stats->erase_us += esp_timer_get_time() - t;
+    if (err == ESP_OK) {
+        p->erased = end;
+    }
+    return err;
+}
+
+static void write_chunk(ota_pipeline_t *p, const ota_chunk_t *chunk)
+{
+    while (p->err == ESP_OK && p->erased < p->written + chunk->len) {
+        p->err = erase_ahead(p);
+    }
+    if (p->err == ESP_OK) {
+        int64_t t = esp_timer_get_time();
+        p->err = esp_partition_write(p->part, p->written, chunk->data, chunk->len);
+        p->stats->write_us += esp_timer_get_time() - t;
+        p->written += chunk->len;
+    }
+}
+
+static void writer_task(void *arg)
+{
+    ota_pipeline_t *p = (ota_pipeline_t *)arg;
+    ota_chunk_t chunk;
+
+    while (1) {
+        if (xQueueReceive(p->full_q, &chunk, 0) != pdTRUE) {
+            // Nothing to write yet: use the time to erase
+            if (p->err == ESP_OK && p->erased < p->image_size) {
+                p->err = erase_ahead(p);
+                continue;
+            }
+            int64_t t = esp_timer_get_time();
+            xQueueReceive(p->full_q, &chunk, portMAX_DELAY);
+            p->stats->writer_idle_us += esp_timer_get_time() - t;
+        }
+        if (chunk.len == 0) {
+            break;
+        }
+        write_chunk(p, &chunk);
+        xQueueSend(p->free_q, &chunk, portMAX_DELAY);
+    }
+
+    xTaskNotifyGive(p->receiver);
+    vTaskDelete(NULL);
+}
+
+/* ---------- HTTP ---------- */
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+    ota_pipeline_t *p = (ota_pipeline_t *)evt->user_data;
+    // "Content-Range: bytes 0-16383/1234567"
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Content-Range") == 0) {
+        unsigned start, end, total;
+        if (sscanf(evt->header_value, "bytes %u-%u/%u", &start, &end, &total) == 3) {
+            p->range_start = (int32_t)start;
+            p->range_total = (int32_t)total;
+        }
+    }
+    return ESP_OK;
+}
+
+/* Sends the next request on the (kept alive) connection; returns the body length. */
+static int64_t http_request(ota_pipeline_t *p, esp_http_client_handle_t client, const ota_pipeline_params_t *params,
+                            uint32_t from)
+{
+    if (params->request_size > 0) {
+        char value[40];
+        snprintf(value, sizeof(value), "bytes=%" PRIu32 "-%" PRIu32, from, from + params->request_size - 1);
+        esp_http_client_set_header(client, "Range", value);
+    }
+    p->range_start = -1;
+    p->range_total = -1;
+
+    int64_t t = esp_timer_get_time();
+    if (esp_http_client_open(client, 0) != ESP_OK) {
+        return -1;
+    }
+    int64_t opened = esp_timer_get_time();
+    int64_t len = esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (p->stats->requests++ == 0) {
+        p->stats->connect_us = opened - t;
+    }
+
+    if (params->request_size > 0 && status == 206 && p->range_start == (int32_t)from && p->range_total > 0) {
+        if (from == 0) {
+            p->image_size = (uint32_t)p->range_total;
+        }
+        return len;
+    }
+    if (from == 0 && status == 200) {
+        p->image_size = len > 0 ? (uint32_t)len : 0;
+        return len;
+    }
+    ESP_LOGE(TAG, "HTTP %d for bytes from %" PRIu32, status, from);
+    return -1;
+}
+
+/* Fills buf from the current response; short only at its end. */
+static int http_read_full(ota_pipeline_t *p, esp_http_client_handle_t client, uint8_t *buf, int len)
+{
+    ota_pipeline_stats_t *s = p->stats;
+    int got = 0;
+    while (got < len) {
+        int64_t t = esp_timer_get_time();
+        int n = esp_http_client_read(client, (char *)buf + got, len - got);
+        int64_t us = esp_timer_get_time() - t;
+        if (n <= 0) {
+            return got > 0 ? got : n;
+        }
+        if (s->first_byte_us == 0) {
+            s->first_byte_us = t + us - s->start_us;
+        }
+        // Read durations by power of two, bucket i holds [2^(i-1), 2^i) us
+        int bucket = 0;
+        while (bucket < OTA_PIPELINE_HIST_BUCKETS - 1 && (us >> bucket) > 0) {
+            bucket++;
+        }
+        s->read_hist[bucket]++;
+        s->reads++;
+        s->read_max_us = us > s->read_max_us ? us : s->read_max_us;
+        got += n;
+    }
+    return got;
+}
+
+/* Checks the app descriptor in the first buffer before anything is written. */
+static esp_err_t check_head(const uint8_t *data, uint32_t len, esp_err_t (*validate)(esp_app_desc_t *))
+{
+    if (len < IMAGE_HEAD_SIZE || data[0] != ESP_IMAGE_HEADER_MAGIC) {
+        ESP_LOGE(TAG, "Not an app image");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    esp_app_desc_t desc;
+    memcpy(&desc, data + APP_DESC_OFFSET, sizeof(desc));
+    if (desc.magic_word != ESP_APP_DESC_MAGIC_WORD) {
+        ESP_LOGE(TAG, "Image without app descriptor");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (validate && validate(&desc) != ESP_OK) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    return ESP_OK;
+}
+
+uint32_t ota_pipeline_read_percentile(const ota_pipeline_stats_t *s, int percent)
+{
+    uint32_t want = (s->reads * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < OTA_PIPELINE_HIST_BUCKETS; i++) {
+        seen += s->read_hist[i];
+        if (seen >= want && want > 0) {
+            return i == 0 ? 0 : 1u << i;   // upper bound of the bucket
+        }
+    }
+    return 0;
+}
+
+esp_err_t ota_pipeline_run(const esp_http_client_config_t *config, esp_err_t (*validate)(esp_app_desc_t *),
+                           const ota_pipeline_params_t *params, ota_pipeline_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->start_us = esp_timer_get_time();
+    ota_pipeline_t p = {
+        .part = esp_ota_get_next_update_partition(NULL),
+        .err = ESP_OK,
+        .receiver = xTaskGetCurrentTaskHandle(),
+        .erase_step = params->buffers > 1 ? ERASE_STEP : SECTOR_SIZE,
+        .stats = stats,
+    };
+    if (p.part == NULL) {
+        ESP_LOGE(TAG, "No OTA partition to update");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_http_client_config_t cfg = *config;
+    cfg.event_handler = http_event_handler;
+    cfg.user_data = &p;
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = ESP_OK;
+    int64_t body = http_request(&p, client, params, 0);
+    if (body <= 0 || p.image_size <= IMAGE_HEAD_SIZE) {
+        ESP_LOGE(TAG, "%s: no image", config->url);
+        err = ESP_ERR_HTTP_FETCH_HEADER;
+    } else if (p.image_size > p.part->size) {
+        ESP_LOGE(TAG, "Image of %" PRIu32 " bytes does not fit %s", p.image_size, p.part->label);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    uint32_t request_end = body > 0 ? (uint32_t)body : 0;
+
+    int buffers = 0;
+    if (err == ESP_OK) {
+        p.free_q = xQueueCreate(params->buffers, sizeof(ota_chunk_t));
+        p.full_q = xQueueCreate(params->buffers + 1, sizeof(ota_chunk_t));   // + end marker
+        for (; p.free_q && buffers < params->buffers; buffers++) {
+            ota_chunk_t chunk = { .data = malloc(params->buffer_size) };
+            if (chunk.data == NULL) {
+                break;
+            }
+            xQueueSend(p.free_q, &chunk, 0);
+        }
+        if (p.full_q == NULL || buffers < params->buffers) {
+            ESP_LOGE(TAG, "No memory for %d OTA buffers of %d bytes", params->buffers, params->buffer_size);
+            err = ESP_ERR_NO_MEM;
+        }
+    }
+
+#if CONFIG_FREERTOS_UNICORE
+    BaseType_t core = 0;
+#else
+    BaseType_t core = xPortGetCoreID() == 0 ? 1 : 0;
+#endif
+    TaskHandle_t writer = NULL;
+    if (err == ESP_OK && params->buffers > 1 &&
+        xTaskCreatePinnedToCore(writer_task, "ota_write", 1024 * 3, &p, uxTaskPriorityGet(NULL) + 1, &writer,
+                                core) != pdPASS) {
+        err = ESP_ERR_NO_MEM;
+    }
+
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    uint8_t appended[DIGEST_SIZE];
+    bool hash_appended = false;
+    uint32_t received = 0;
+
+    ota_progress_state_t progress;
+    ota_progress_init(&progress);
+    while (err == ESP_OK && received < p.image_size) {
+        if (received == request_end) {
+            // Next Range request on the same connection
+            int64_t n = http_request(&p, client, params, received);
+            if (n <= 0) {
+                err = ESP_ERR_HTTP_FETCH_HEADER;
+                break;
+            }
+            request_end += (uint32_t)n;
+        }
+
+        ota_chunk_t chunk;
+        int64_t t = esp_timer_get_time();
+        xQueueReceive(p.free_q, &chunk, portMAX_DELAY);
+        stats->buffer_wait_us += esp_timer_get_time() - t;
+
+        uint32_t want = request_end - received;
+        want = want < (uint32_t)params->buffer_size ? want : (uint32_t)params->buffer_size;
+        int n = http_read_full(&p, client, chunk.data, want);
+        if (n <= 0 || p.err != ESP_OK) {
+            xQueueSend(p.free_q, &chunk, 0);
+            err = p.err != ESP_OK ? p.err : ESP_ERR_HTTP_EAGAIN;
+            break;
+        }
+        chunk.len = n;
+        if (received == 0) {
+            err = check_head(chunk.data, chunk.len, validate);
+            if (err != ESP_OK) {
+                xQueueSend(p.free_q, &chunk, 0);
+                break;
+            }
+            hash_appended = ((const esp_image_header_t *)chunk.data)->hash_appended == 1;
+        }
+
+        // Everything but the appended digest goes into the hash
+        uint32_t digest_at = hash_appended ? p.image_size - DIGEST_SIZE : p.image_size;
+        if (received < digest_at) {
+            uint32_t h = digest_at - received < chunk.len ? digest_at - received : chunk.len;
+            mbedtls_sha256_update(&sha, chunk.data, h);
+        }
+        if (received + chunk.len > digest_at) {
+            uint32_t from = received > digest_at ? received : digest_at;
+            memcpy(appended + (from - digest_at), chunk.data + (from - received), received + chunk.len - from);
+        }
+        received += chunk.len;
+
+        if (writer) {
+            xQueueSend(p.full_q, &chunk, portMAX_DELAY);
+        } else {
+            // One buffer: write in turn, like esp_https_ota
+            write_chunk(&p, &chunk);
+            xQueueSend(p.free_q, &chunk, 0);
+            err = p.err;
+        }
+        ota_progress_update(&progress, (int32_t)received, (int32_t)p.image_size, false);
+    }
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+
+    if (writer) {
+        ota_chunk_t end = { .data = NULL, .len = 0 };
+        xQueueSend(p.full_q, &end, portMAX_DELAY);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (err == ESP_OK) {
+            err = p.err;
+        }
+    }
+    stats->bytes = received;
+    stats->download_us = esp_timer_get_time() - stats->start_us;
+
+    uint8_t digest[DIGEST_SIZE];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    if (err == ESP_OK && hash_appended && memcmp(digest, appended, DIGEST_SIZE) != 0) {
+        ESP_LOGE(TAG, "Image SHA-256 mismatch, download corrupted");
+        err = ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    if (err == ESP_OK) {
+        ota_progress_update(&progress, (int32_t)received, (int32_t)p.image_size, true);
+        // Reads the image back from flash and checks it, as the bootloader would
+        int64_t t = esp_timer_get_time();
+        if (params->set_boot) {
+            err = esp_ota_set_boot_partition(p.part);
+        } else {
+            const esp_partition_pos_t pos = { .offset = p.part->address, .size = p.part->size };
+            esp_image_metadata_t data;
+            err = esp_image_verify(ESP_IMAGE_VERIFY_SILENT, &pos, &data);
+        }
+        stats->verify_us = esp_timer_get_time() - t;
+    }
+
+    ota_chunk_t chunk;
+    while (p.free_q && xQueueReceive(p.free_q, &chunk, 0) == pdTRUE) {
+        free(chunk.data);
+    }
+    while (p.full_q && xQueueReceive(p.full_q, &chunk, 0) == pdTRUE) {
+        free(chunk.data);
+    }
+    if (p.free_q) {
+        vQueueDelete(p.free_q);
+    }
+    if (p.full_q) {
+        vQueueDelete(p.full_q);
+    }
+    return err;
+}
+
+esp_err_t ota_pipeline_download(const esp_http_client_config_t *config, esp_err_t (*validate)(esp_app_desc_t *))
+{
+    const ota_pipeline_params_t params = {
+        .buffers = CONFIG_OTA_PIPELINE_BUFFERS,
+        .buffer_size = CONFIG_OTA_PIPELINE_BUFFER_SIZE,
+#ifdef CONFIG_OTA_ENABLE_PARTIAL_HTTP_DOWNLOAD
+        .request_size = CONFIG_OTA_HTTP_REQUEST_SIZE,
+#endif
+        .set_boot = true,
+    };
+    ota_pipeline_stats_t s;
+    esp_err_t err = ota_pipeline_run(config, validate, &params, &s);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Download finished: %" PRIu32 " bytes in %" PRId64 " ms, %" PRIu32 " KB/s "
+                 "(buffers %d x %d; receiver waited %" PRId64 " ms for buffers; "
+                 "writer erase %" PRId64 " ms, write %" PRId64 " ms, idle %" PRId64 " ms; verify %" PRId64 " ms)",
+                 s.bytes, s.download_us / 1000, (uint32_t)((int64_t)s.bytes * 1000 / (s.download_us / 1000 + 1) / 1024),
+                 params.buffers, params.buffer_size, s.buffer_wait_us / 1000, s.erase_us / 1000,
+                 s.write_us / 1000, s.writer_idle_us / 1000, s.verify_us / 1000);
+    }
+    return err;
+}
@@ -0,0 +1,104 @@
+/*
+   Helpers shared by the OTA download paths (ota.c, ota_resume.c,
+   ota_package.c, ota_pipeline.c, ota_bench.c, ota_assets.c).
+   Not part of the component interface.
+*/
+#ifndef tux_ota_priv_H
+#define tux_ota_priv_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include "esp_ota_ops.h"
+
+/* Wi-Fi power save off for the download, as far as Bluetooth allows */
+void ota_link_setup(void);
+
+/* Firmware URL, server certificate and timeouts from Kconfig */
+void ota_http_config(esp_http_client_config_t *config);
+
+typedef struct {
+    int64_t start_us;
+    int64_t last_us;            // time of the last rate sample
+    int32_t last_bytes;
+    uint32_t rate;              // bytes/s, exponentially smoothed
+    uint32_t dropped;           // progress events the event loop had no room for
+} ota_progress_state_t;
+
+void ota_progress_init(ota_progress_state_t *s);
+
+/* Posts TUX_EVENT_OTA_IN_PROGRESS without blocking, rate limited unless final */
+void ota_progress_update(ota_progress_state_t *s, int32_t bytes, int32_t image_size, bool final);
+
+/* Downloads config->url into the passive OTA slot, resuming where a previous
+ * attempt stopped. On success the new slot is validated and set for boot. */
+esp_err_t ota_resume_download(const esp_http_client_config_t *config,
+                              esp_err_t (*validate)(esp_app_desc_t *));
+
+/* OTA package as built by ota_pack.py, little endian */
+#define OTA_PKG_MAGIC           0x31505854      // "TXP1"
+#define OTA_PKG_VERSION         1
+#define OTA_PKG_ENC_DEFLATE     1               // raw deflate of the image
+#define OTA_PKG_ENC_DELTA       2               // raw deflate of delta ops against the running image
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t encoding;
+    uint16_t header_size;       // data starts here, newer tools may append fields
+    uint32_t image_size;        // reconstructed image
+    uint32_t base_size;         // delta only: bytes of the running image used
+    uint8_t image_sha256[32];
+    uint8_t base_sha256[32];
+} ota_pkg_header_t;
+
+/* Delta ops inside the inflated stream */
+#define OTA_PKG_OP_ADD          1               // u32 base offset, u32 length, length bytes added to base
+#define OTA_PKG_OP_LITERAL      2               // u32 length, length bytes
+
+/* Downloads a package (or a plain image) from config->url into the passive
+ * OTA slot, trying a delta against the running image first. On success the
+ * new slot is validated and set for boot. */
+esp_err_t ota_package_download(const esp_http_client_config_t *config,
+                               esp_err_t (*validate)(esp_app_desc_t *));
+
+/* Downloads config->url into the passive OTA slot with receive and flash
+ * write overlapped on two tasks. On success the new slot is set for boot. */
+esp_err_t ota_pipeline_download(const esp_http_client_config_t *config,
+                                esp_err_t (*validate)(esp_app_desc_t *));
+
+typedef struct {
+    int buffers;                // 1: receive and write in turn, like esp_https_ota
+    int buffer_size;
+    int request_size;           // Range request size, 0 for a single GET
+    bool set_boot;              // else only verify the written image
+} ota_pipeline_params_t;
+
+#define OTA_PIPELINE_HIST_BUCKETS 24
+
+typedef struct {
+    int64_t start_us;
+    int64_t connect_us;         // TCP connect and TLS handshake
+    int64_t first_byte_us;      // from start
+    int64_t download_us;        // from start until the last byte is in flash
+    int64_t buffer_wait_us;     // receiver waiting for a free buffer
+    int64_t erase_us;
+    int64_t write_us;
+    int64_t writer_idle_us;     // writer waiting for the network
+    int64_t verify_us;
+    uint32_t bytes;
+    uint32_t requests;
+    uint32_t reads;             // esp_http_client_read calls
+    uint32_t read_hist[OTA_PIPELINE_HIST_BUCKETS];  // read durations, bucket i < 2^i us
+    int64_t read_max_us;
+} ota_pipeline_stats_t;
+
+/* One download with explicit parameters, timing every phase into stats */
+esp_err_t ota_pipeline_run(const esp_http_client_config_t *config, esp_err_t (*validate)(esp_app_desc_t *),
+                           const ota_pipeline_params_t *params, ota_pipeline_stats_t *stats);
+
+/* Upper bound in us of the given percentile of read durations */
+uint32_t ota_pipeline_read_percentile(const ota_pipeline_stats_t *s, int percent);
+
+#endif
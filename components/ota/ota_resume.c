@@ -0,0 +1,413 @@
+/*
+   Resumable OTA download.
+
+   esp_https_ota restarts from byte zero after any failure, which on a flaky
+   link can mean a 2 MB image never completes. Here the image is written
+   sector by sector straight into the passive OTA partition; every sector is
+   read back before it counts, and the verified offset is kept in NVS with
+   the target partition and the image's ELF SHA-256 (from its app
+   descriptor). After a dropped connection or a reboot the download carries
+   on with a Range request from the last verified sector, provided the server
+   still serves the same image to the same slot.
+
+   The app image carries its own SHA-256, which esp_ota_set_boot_partition
+   checks before the new slot is accepted.
+*/
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_app_format.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "nvs.h"
+#include "ota.h"
+#include "ota_priv.h"
+
+static const char *TAG = "OTA";
+
+#ifndef CONFIG_OTA_RESUME_RETRIES
+#define CONFIG_OTA_RESUME_RETRIES 10
+#endif
+
+#define RESUME_NAMESPACE    "ota_resume"
+#define RESUME_KEY          "state"
+#define SECTOR_SIZE         4096
+#define SAVE_EVERY          (16 * SECTOR_SIZE)     // NVS write per 64 KB
+#define RETRY_DELAY_MS      2000
+#define RETRY_DELAY_MAX_MS  30000
+
+// Image header, first segment header and app descriptor
+#define APP_DESC_OFFSET     (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t))
+#define IMAGE_HEAD_SIZE     (APP_DESC_OFFSET + sizeof(esp_app_desc_t))
+
+typedef struct {
+    uint32_t partition_address;
+    uint32_t image_size;
+    uint32_t offset;            // verified bytes in flash, sector aligned
+    uint8_t elf_sha256[32];
+} ota_resume_state_t;
+
+typedef struct {
+    int32_t range_start;        // from Content-Range, -1 if absent
+    int32_t range_total;
+} http_range_t;
+
+/* ---------- NVS state ---------- */
+
+static bool state_load(ota_resume_state_t *st)
+{
+    nvs_handle_t h;
+    if (nvs_open(RESUME_NAMESPACE, NVS_READONLY, &h) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(*st);
+    esp_err_t err = nvs_get_blob(h, RESUME_KEY, st, &len);
+    nvs_close(h);
+    return err == ESP_OK && len == sizeof(*st);
+}
+
+static esp_err_t state_save(const ota_resume_state_t *st)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(RESUME_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(h, RESUME_KEY, st, sizeof(*st));
+    if (err == ESP_OK) {
+        err = nvs_commit(h);
+    }
+    nvs_close(h);
+    return err;
+}
+
+static void state_clear(void)
+{
+    nvs_handle_t h;
+    if (nvs_open(RESUME_NAMESPACE, NVS_READWRITE, &h) == ESP_OK) {
+        nvs_erase_key(h, RESUME_KEY);
+        nvs_commit(h);
+        nvs_close(h);
+    }
+}
+
+bool ota_resume_pending(void)
+{
+    ota_resume_state_t st;
+    return state_load(&st) && st.offset < st.image_size;
+}
+
+/* ---------- HTTP ---------- */
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+    http_range_t *range = (http_range_t *)evt->user_data;
+    // "Content-Range: bytes 4096-8191/1234567"
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Content-Range") == 0) {
+        unsigned start, end, total;
+        if (sscanf(evt->header_value, "bytes %u-%u/%u", &start, &end, &total) == 3) {
+            range->range_start = (int32_t)start;
+            range->range_total = (int32_t)total;
+        }
+    }
+    return ESP_OK;
+}
+
+/* Opens a GET for bytes [from, to]; to < 0 means up to the end. */
+static esp_http_client_handle_t http_open_range(const esp_http_client_config_t *config, http_range_t *range,
+                                                uint32_t from, int32_t to, int *status)
+{
+    esp_http_client_config_t cfg = *config;
+    cfg.event_handler = http_event_handler;
+    cfg.user_data = range;
+    range->range_start = -1;
+    range->range_total = -1;
+
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (client == NULL) {
+        return NULL;
+    }
+    char value[40];
+    if (to >= 0) {
+        snprintf(value, sizeof(value), "bytes=%" PRIu32 "-%" PRIi32, from, to);
+    } else {
+        snprintf(value, sizeof(value), "bytes=%" PRIu32 "-", from);
+    }
+    esp_http_client_set_header(client, "Range", value);
+
+    if (esp_http_client_open(client, 0) != ESP_OK || esp_http_client_fetch_headers(client) < 0) {
+        esp_http_client_cleanup(client);
+        return NULL;
+    }
+    *status = esp_http_client_get_status_code(client);
+    return client;
+}
+
+static void http_close(esp_http_client_handle_t client)
+{
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+}
+
+/* Reads exactly len bytes unless the connection ends first. */
+static int http_read_full(esp_http_client_handle_t client, uint8_t *buf, int len)
+{
+    int got = 0;
+    while (got < len) {
+        int n = esp_http_client_read(client, (char *)buf + got, len - got);
+        if (n <= 0) {
+            break;
+        }
+        got += n;
+    }
+    return got;
+}
+
+/* Fetches only the image head: the app descriptor identifies the image. */
+static esp_err_t read_image_head(const esp_http_client_config_t *config, esp_app_desc_t *desc, uint32_t *image_size)
+{
+    http_range_t range;
+    int status = 0;
+    esp_http_client_handle_t client = http_open_range(config, &range, 0, IMAGE_HEAD_SIZE - 1, &status);
+    if (client == NULL) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (status == 206 && range.range_total > 0) {
+        *image_size = (uint32_t)range.range_total;
+    } else if (status == 200) {
+        // Server ignores Range; it still works, only not resumable cheaply
+        *image_size = (uint32_t)esp_http_client_get_content_length(client);
+    } else {
+        ESP_LOGE(TAG, "Image head request failed, HTTP %d", status);
+        err = ESP_ERR_HTTP_FETCH_HEADER;
+    }
+
+    uint8_t head[IMAGE_HEAD_SIZE];
+    if (err == ESP_OK && http_read_full(client, head, sizeof(head)) != sizeof(head)) {
+        err = ESP_ERR_HTTP_EAGAIN;
+    }
+    http_close(client);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (head[0] != ESP_IMAGE_HEADER_MAGIC) {
+        ESP_LOGE(TAG, "Not an app image");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    memcpy(desc, head + APP_DESC_OFFSET, sizeof(*desc));
+    if (desc->magic_word != ESP_APP_DESC_MAGIC_WORD || *image_size <= IMAGE_HEAD_SIZE) {
+        ESP_LOGE(TAG, "Image without app descriptor");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return ESP_OK;
+}
+
+/* ---------- Flash ---------- */
+
+/* Erases, writes and reads back one sector (the last one may be short). */
+static esp_err_t write_sector(const esp_partition_t *part, uint32_t offset, const uint8_t *data, size_t len,
+                              uint8_t *verify)
+{
+    esp_err_t err = esp_partition_erase_range(part, offset, SECTOR_SIZE);
+    if (err == ESP_OK) {
+        err = esp_partition_write(part, offset, data, len);
+    }
+    if (err == ESP_OK) {
+        err = esp_partition_read(part, offset, verify, len);
+    }
+    if (err == ESP_OK && memcmp(data, verify, len) != 0) {
+        err = ESP_ERR_INVALID_CRC;
+    }
+    return err;
+}
+
+/* ---------- Download ---------- */
+
+/*
+ * One connection's worth of download, from st->offset on. Returns ESP_OK
+ * once the whole image is in flash, an error when the connection dropped;
+ * st->offset has advanced by every sector verified meanwhile, the caller
+ * saves it.
+ */
+static esp_err_t download_once(const esp_http_client_config_t *config, const esp_partition_t *part,
+                               ota_resume_state_t *st, uint8_t *buf, uint8_t *verify,
+                               ota_progress_state_t *progress)
+{
+    uint32_t fill = 0;
+    uint32_t saved = st->offset;
+
+    while (st->offset < st->image_size) {
+        uint32_t from = st->offset + fill;
+        int32_t to = -1;
+#ifdef CONFIG_OTA_ENABLE_PARTIAL_HTTP_DOWNLOAD
+        to = (int32_t)(from + CONFIG_OTA_HTTP_REQUEST_SIZE - 1);
+        if (to >= (int32_t)st->image_size) {
+            to = -1;
+        }
+#endif
+        http_range_t range;
+        int status = 0;
+        esp_http_client_handle_t client = http_open_range(config, &range, from, to, &status);
+        if (client == NULL) {
+            return ESP_ERR_HTTP_CONNECT;
+        }
+
+        if (status == 200) {
+            // No Range support: skip what is already in flash
+            uint32_t skip = from;
+            while (skip > 0) {
+                int n = http_read_full(client, verify, skip > SECTOR_SIZE ? SECTOR_SIZE : skip);
+                if (n <= 0) {
+                    http_close(client);
+                    return ESP_ERR_HTTP_EAGAIN;
+                }
+                skip -= n;
+            }
+        } else if (status != 206 || range.range_start != (int32_t)from ||
+                   range.range_total != (int32_t)st->image_size) {
+            // The image changed on the server since the head request
+            ESP_LOGE(TAG, "Unexpected range response: HTTP %d, start %d, total %d", status,
+                     (int)range.range_start, (int)range.range_total);
+            http_close(client);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        uint32_t end = to < 0 ? st->image_size : (uint32_t)to + 1;
+        while (st->offset + fill < end) {
+            uint32_t want = SECTOR_SIZE - fill;
+            if (st->offset + fill + want > end) {
+                want = end - st->offset - fill;
+            }
+            int n = esp_http_client_read(client, (char *)buf + fill, want);
+            if (n <= 0) {
+                http_close(client);
+                return ESP_ERR_HTTP_EAGAIN;
+            }
+            fill += n;
+
+            if (fill == SECTOR_SIZE || st->offset + fill == st->image_size) {
+                esp_err_t err = write_sector(part, st->offset, buf, fill, verify);
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "Flash write at 0x%" PRIx32 " failed: %s", st->offset, esp_err_to_name(err));
+                    http_close(client);
+                    return err;
+                }
+                st->offset += fill;
+                fill = 0;
+                if (st->offset - saved >= SAVE_EVERY || st->offset == st->image_size) {
+                    state_save(st);
+                    saved = st->offset;
+                }
+            }
+            ota_progress_update(progress, (int32_t)(st->offset + fill), (int32_t)st->image_size, false);
+        }
+        http_close(client);
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_resume_download(const esp_http_client_config_t *config, esp_err_t (*validate)(esp_app_desc_t *))
+{
+    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+    if (part == NULL) {
+        ESP_LOGE(TAG, "No OTA partition to update");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_app_desc_t desc;
+    uint32_t image_size = 0;
+    esp_err_t err = ESP_FAIL;
+    for (int attempt = 0; attempt <= CONFIG_OTA_RESUME_RETRIES && err != ESP_OK; attempt++) {
+        if (attempt > 0) {
+            vTaskDelay(pdMS_TO_TICKS(RETRY_DELAY_MS));
+        }
+        err = read_image_head(config, &desc, &image_size);
+        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
+            return err;
+        }
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (image_size > part->size) {
+        ESP_LOGE(TAG, "Image of %" PRIu32 " bytes does not fit %s", image_size, part->label);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    ota_resume_state_t st;
+    if (state_load(&st) && st.partition_address == part->address && st.image_size == image_size &&
+        memcmp(st.elf_sha256, desc.app_elf_sha256, sizeof(st.elf_sha256)) == 0 && st.offset <= image_size) {
+        ESP_LOGI(TAG, "Resuming %s at %" PRIu32 " of %" PRIu32 " bytes", part->label, st.offset, image_size);
+    } else {
+        if (validate && validate(&desc) != ESP_OK) {
+            return ESP_ERR_INVALID_VERSION;
+        }
+        memset(&st, 0, sizeof(st));
+        st.partition_address = part->address;
+        st.image_size = image_size;
+        memcpy(st.elf_sha256, desc.app_elf_sha256, sizeof(st.elf_sha256));
+        err = state_save(&st);
+        if (err != ESP_OK) {
+            return err;
+        }
+        ESP_LOGI(TAG, "Downloading %" PRIu32 " bytes to %s", image_size, part->label);
+    }
+
+    uint8_t *buf = malloc(SECTOR_SIZE);
+    uint8_t *verify = malloc(SECTOR_SIZE);
+    if (buf == NULL || verify == NULL) {
+        free(buf);
+        free(verify);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ota_progress_state_t progress;
+    ota_progress_init(&progress);
+    uint32_t delay_ms = RETRY_DELAY_MS;
+    err = ESP_FAIL;
+    for (int attempt = 0; attempt <= CONFIG_OTA_RESUME_RETRIES; attempt++) {
+        uint32_t before = st.offset;
+        err = download_once(config, part, &st, buf, verify, &progress);
+        if (err == ESP_OK || err == ESP_ERR_INVALID_RESPONSE || err == ESP_ERR_INVALID_CRC) {
+            break;
+        }
+        state_save(&st);
+        ESP_LOGW(TAG, "Download dropped at %" PRIu32 " bytes (%s), retry in %" PRIu32 " ms", st.offset,
+                 esp_err_to_name(err), delay_ms);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        // Back off while nothing gets through, start over once it does
+        delay_ms = st.offset > before ? RETRY_DELAY_MS : delay_ms * 2;
+        if (delay_ms > RETRY_DELAY_MAX_MS) {
+            delay_ms = RETRY_DELAY_MAX_MS;
+        }
+    }
+    free(buf);
+    free(verify);
+
+    if (err == ESP_ERR_INVALID_RESPONSE) {
+        // The server has another image now; the next attempt starts afresh
+        state_clear();
+        return err;
+    }
+    if (err != ESP_OK) {
+        // Keeps the NVS state, so the next attempt resumes
+        state_save(&st);
+        return err;
+    }
+    ota_progress_update(&progress, (int32_t)st.offset, (int32_t)st.image_size, true);
+
+    // Verifies the image checksum and appended SHA-256 before switching
+    err = esp_ota_set_boot_partition(part);
+    state_clear();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "New image failed validation: %s", esp_err_to_name(err));
+    }
+    return err;
+}
@@ -0,0 +1,290 @@
+/*
+   Filesystems for the data partitions.
+
+   The asset slots (see ota_assets.c) hold SPIFFS, LittleFS or FAT on wear
+   levelling. New slots get the filesystem chosen with CONFIG_STORAGE_FS_*;
+   storage_mount_any() still mounts a slot left on another one by an older
+   firmware or factory image, so its files can be moved over.
+
+   Partitions are found by label whatever their subtype. The filesystem thus
+   changes without a new partition table, which devices in the field could
+   not get. This is also why FAT is mounted through wear levelling here:
+   esp_vfs_fat_spiflash_mount_rw_wl() only accepts subtype fat.
+
+   Not locked: partitions are mounted at boot and by the asset update task,
+   never at the same time.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_spiffs.h"
+#include "esp_littlefs.h"
+#include "esp_vfs_fat.h"
+#include "diskio_impl.h"
+#include "diskio_wl.h"
+#include "wear_levelling.h"
+#include "storage.h"
+
+static const char *TAG = "STORAGE";
+
+#define MAX_MOUNTS          3
+#define LABEL_SIZE          17          // esp_partition_t label
+#define BASE_PATH_SIZE      16
+#define FAT_WORK_SIZE       4096        // f_mkfs buffer, one sector
+#define FAT_FORMAT_ROOT     "/fat_fmt"
+
+typedef struct {
+    char label[LABEL_SIZE];             // empty for a free entry
+    char base_path[BASE_PATH_SIZE];
+    storage_fs_t fs;
+    wl_handle_t wl;                     // FAT only
+    BYTE pdrv;
+} mount_t;
+
+static mount_t mounts[MAX_MOUNTS];
+
+storage_fs_t storage_fs(void)
+{
+#if defined(CONFIG_STORAGE_FS_LITTLEFS)
+    return STORAGE_FS_LITTLEFS;
+#elif defined(CONFIG_STORAGE_FS_FAT)
+    return STORAGE_FS_FAT;
+#else
+    return STORAGE_FS_SPIFFS;
+#endif
+}
+
+const char *storage_fs_name(storage_fs_t fs)
+{
+    switch (fs) {
+    case STORAGE_FS_SPIFFS:
+        return "SPIFFS";
+    case STORAGE_FS_LITTLEFS:
+        return "LittleFS";
+    case STORAGE_FS_FAT:
+        return "FAT";
+    default:
+        return "none";
+    }
+}
+
+static mount_t *find_mount(const char *label)
+{
+    for (int i = 0; i < MAX_MOUNTS; i++) {
+        if (mounts[i].label[0] && strcmp(mounts[i].label, label) == 0) {
+            return &mounts[i];
+        }
+    }
+    return NULL;
+}
+
+static const esp_partition_t *find_partition(const char *label)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+}
+
+/* ---------- FAT ---------- */
+
+static void fat_drive(BYTE pdrv, char drv[3])
+{
+    drv[0] = (char)('0' + pdrv);
+    drv[1] = ':';
+    drv[2] = '\0';
+}
+
+static esp_err_t fat_mount(mount_t *m, const esp_partition_t *part, int max_files, bool format)
+{
+    if (ff_diskio_get_drive(&m->pdrv) != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = wl_mount(part, &m->wl);
+    if (err != ESP_OK) {
+        return err;
+    }
+    char drv[3];
+    fat_drive(m->pdrv, drv);
+    FATFS *fs = NULL;
+    err = ff_diskio_register_wl_partition(m->pdrv, m->wl);
+    if (err == ESP_OK) {
+        err = esp_vfs_fat_register(m->base_path, drv, max_files, &fs);
+    }
+    if (err != ESP_OK) {
+        ff_diskio_unregister(m->pdrv);
+        wl_unmount(m->wl);
+        return err;
+    }
+
+    FRESULT res = format ? FR_NO_FILESYSTEM : f_mount(fs, drv, 1);
+    if (res == FR_NO_FILESYSTEM && format) {
+        void *work = malloc(FAT_WORK_SIZE);
+        const MKFS_PARM opt = {(BYTE)(FM_ANY | FM_SFD), 0, 0, 0, CONFIG_WL_SECTOR_SIZE};
+        res = work ? f_mkfs(drv, &opt, work, FAT_WORK_SIZE) : FR_NOT_ENOUGH_CORE;
+        free(work);
+        if (res == FR_OK) {
+            res = f_mount(fs, drv, 0);
+        }
+    }
+    if (res != FR_OK) {
+        ESP_LOGD(TAG, "%s: no FAT (%d)", part->label, res);
+        f_mount(NULL, drv, 0);
+        ff_diskio_unregister(m->pdrv);
+        esp_vfs_fat_unregister_path(m->base_path);
+        wl_unmount(m->wl);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void fat_unmount(mount_t *m)
+{
+    char drv[3];
+    fat_drive(m->pdrv, drv);
+    f_mount(NULL, drv, 0);
+    ff_diskio_unregister(m->pdrv);
+    esp_vfs_fat_unregister_path(m->base_path);
+    wl_unmount(m->wl);
+}
+
+/* ---------- Mounting ---------- */
+
+static esp_err_t mount(storage_fs_t fs, const char *label, const char *base_path, int max_files, bool format)
+{
+    const esp_partition_t *part = find_partition(label);
+    if (part == NULL) {
+        ESP_LOGE(TAG, "No partition %s", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (find_mount(label)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    mount_t *m = NULL;
+    for (int i = 0; i < MAX_MOUNTS && m == NULL; i++) {
+        m = mounts[i].label[0] ? NULL : &mounts[i];
+    }
+    if (m == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    strlcpy(m->base_path, base_path, sizeof(m->base_path));
+
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (fs == STORAGE_FS_SPIFFS) {
+        esp_vfs_spiffs_conf_t conf = {
+            .base_path = base_path,
+            .partition_label = label,
+            .max_files = max_files,
+            .format_if_mount_failed = false,
+        };
+        err = esp_vfs_spiffs_register(&conf);
+    } else if (fs == STORAGE_FS_LITTLEFS) {
+        esp_vfs_littlefs_conf_t conf = {
+            .base_path = base_path,
+            .partition_label = label,
+            .format_if_mount_failed = false,
+        };
+        err = esp_vfs_littlefs_register(&conf);
+    } else if (fs == STORAGE_FS_FAT) {
+        err = fat_mount(m, part, max_files, format);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    strlcpy(m->label, label, sizeof(m->label));
+    m->fs = fs;
+    ESP_LOGI(TAG, "%s (%s) mounted at %s", label, storage_fs_name(fs), base_path);
+    return ESP_OK;
+}
+
+esp_err_t storage_mount(storage_fs_t fs, const char *label, const char *base_path, int max_files)
+{
+    return mount(fs, label, base_path, max_files, false);
+}
+
+esp_err_t storage_mount_any(const char *label, const char *base_path, int max_files, storage_fs_t *fs)
+{
+    // FAT goes last: wear levelling rewrites its state sectors on a partition
+    // it does not recognise, which would damage the other two
+    static const storage_fs_t order[] = { STORAGE_FS_SPIFFS, STORAGE_FS_LITTLEFS, STORAGE_FS_FAT };
+    if (find_partition(label) == NULL) {
+        ESP_LOGE(TAG, "No partition %s", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        esp_err_t err = storage_mount(order[i], label, base_path, max_files);
+        if (err == ESP_OK) {
+            *fs = order[i];
+            return ESP_OK;
+        }
+        if (err == ESP_ERR_INVALID_STATE) {
+            return err;
+        }
+    }
+    ESP_LOGE(TAG, "%s holds no known filesystem", label);
+    return ESP_FAIL;
+}
+
+esp_err_t storage_unmount(const char *label)
+{
+    mount_t *m = find_mount(label);
+    if (m == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_OK;
+    if (m->fs == STORAGE_FS_SPIFFS) {
+        err = esp_vfs_spiffs_unregister(label);
+    } else if (m->fs == STORAGE_FS_LITTLEFS) {
+        err = esp_vfs_littlefs_unregister(label);
+    } else {
+        fat_unmount(m);
+    }
+    m->label[0] = '\0';
+    return err;
+}
+
+esp_err_t storage_format(storage_fs_t fs, const char *label)
+{
+    const esp_partition_t *part = find_partition(label);
+    if (part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (find_mount(label)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Erased first, so storage_mount_any() finds nothing of the old filesystem
+    esp_err_t err = esp_partition_erase_range(part, 0, part->size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    switch (fs) {
+    case STORAGE_FS_SPIFFS:
+        return esp_spiffs_format(label);
+    case STORAGE_FS_LITTLEFS:
+        return esp_littlefs_format(label);
+    case STORAGE_FS_FAT:
+        err = mount(fs, label, FAT_FORMAT_ROOT, 1, true);
+        return err == ESP_OK ? storage_unmount(label) : err;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+esp_err_t storage_info(const char *label, size_t *total, size_t *used)
+{
+    mount_t *m = find_mount(label);
+    if (m == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (m->fs == STORAGE_FS_SPIFFS) {
+        return esp_spiffs_info(label, total, used);
+    }
+    if (m->fs == STORAGE_FS_LITTLEFS) {
+        return esp_littlefs_info(label, total, used);
+    }
+    uint64_t fat_total, fat_free;
+    esp_err_t err = esp_vfs_fat_info(m->base_path, &fat_total, &fat_free);
+    if (err == ESP_OK) {
+        *total = (size_t)fat_total;
+        *used = (size_t)(fat_total - fat_free);
+    }
+    return err;
+}
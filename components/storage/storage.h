@@ -0,0 +1,47 @@
+#ifndef tux_storage_H
+#define tux_storage_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    STORAGE_FS_NONE = 0,
+    STORAGE_FS_SPIFFS,
+    STORAGE_FS_LITTLEFS,
+    STORAGE_FS_FAT,             // FAT on wear levelling
+} storage_fs_t;
+
+/* Filesystem new slots are formatted with (CONFIG_STORAGE_FS_*) */
+storage_fs_t storage_fs(void);
+
+const char *storage_fs_name(storage_fs_t fs);
+
+/* Mounts the data partition label at base_path. max_files is ignored by LittleFS. */
+esp_err_t storage_mount(storage_fs_t fs, const char *label, const char *base_path, int max_files);
+
+/* Mounts whichever filesystem label holds and reports it in *fs */
+esp_err_t storage_mount_any(const char *label, const char *base_path, int max_files, storage_fs_t *fs);
+
+esp_err_t storage_unmount(const char *label);
+
+/* Erases label and writes an empty fs; label must not be mounted */
+esp_err_t storage_format(storage_fs_t fs, const char *label);
+
+/* Size and use of a mounted partition */
+esp_err_t storage_info(const char *label, size_t *total, size_t *used);
+
+/* Formats label with each filesystem in turn and logs open, random read,
+ * sequential write and fsync latencies (CONFIG_STORAGE_BENCHMARK). Destroys
+ * what label holds. */
+void storage_benchmark(const char *label);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif
@@ -0,0 +1,172 @@
+/*
+   Filesystem benchmark (CONFIG_STORAGE_BENCHMARK).
+
+   Formats a spare partition with each filesystem in turn and times what the
+   panel does on /spiffs:
+     format  erase and format
+     open    open and close one of OPEN_FILES small files, the directory
+             lookup included, like the asset and cache loaders
+     read    READ_SIZE bytes at a random offset of a FILE_SIZE file, like an
+             image decoder seeking through a wallpaper
+     write   FILE_SIZE bytes in WRITE_SIZE pieces, then fsync, as KB/s
+     fsync   fsync after appending RECORD_SIZE bytes, like the logger
+   Logs one line per filesystem with the mean and the worst case, and leaves
+   the partition formatted with the configured filesystem.
+*/
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "storage.h"
+
+static const char *TAG = "STORAGE";
+
+#define BENCH_ROOT          "/bench"
+#define FILE_SIZE           (128 * 1024)
+#define WRITE_SIZE          4096
+#define READ_SIZE           512
+#define READS               200
+#define OPEN_FILES          16
+#define OPEN_ROUNDS         4
+#define RECORD_SIZE         128
+#define SYNCS               32
+
+typedef struct {
+    int64_t total_us;
+    int64_t max_us;
+    int count;
+} timing_t;
+
+static void timing_add(timing_t *t, int64_t start_us)
+{
+    int64_t us = esp_timer_get_time() - start_us;
+    t->total_us += us;
+    t->max_us = us > t->max_us ? us : t->max_us;
+    t->count++;
+}
+
+static int64_t timing_mean(const timing_t *t)
+{
+    return t->count ? t->total_us / t->count : 0;
+}
+
+static esp_err_t write_file(const char *path, const uint8_t *buf, size_t size)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return ESP_FAIL;
+    }
+    esp_err_t err = ESP_OK;
+    for (size_t done = 0; done < size; done += WRITE_SIZE) {
+        size_t n = size - done < WRITE_SIZE ? size - done : WRITE_SIZE;
+        if (write(fd, buf, n) != (ssize_t)n) {
+            err = ESP_ERR_NO_MEM;
+            break;
+        }
+    }
+    if (fsync(fd) != 0 && err == ESP_OK) {
+        err = ESP_FAIL;
+    }
+    close(fd);
+    return err;
+}
+
+static esp_err_t run(storage_fs_t fs, const char *label, uint8_t *buf)
+{
+    timing_t open_t = {0}, read_t = {0}, fsync_t = {0};
+    char path[sizeof(BENCH_ROOT) + 16];
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = storage_format(fs, label);
+    int64_t format_ms = (esp_timer_get_time() - start) / 1000;
+    if (err == ESP_OK) {
+        err = storage_mount(fs, label, BENCH_ROOT, 4);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s: %s", storage_fs_name(fs), esp_err_to_name(err));
+        return err;
+    }
+
+    start = esp_timer_get_time();
+    err = write_file(BENCH_ROOT "/big.bin", buf, FILE_SIZE);
+    int64_t write_us = esp_timer_get_time() - start;
+
+    for (int i = 0; i < OPEN_FILES && err == ESP_OK; i++) {
+        snprintf(path, sizeof(path), BENCH_ROOT "/f%02d.bin", i);
+        err = write_file(path, buf, RECORD_SIZE);
+    }
+    for (int r = 0; r < OPEN_ROUNDS && err == ESP_OK; r++) {
+        for (int i = 0; i < OPEN_FILES; i++) {
+            snprintf(path, sizeof(path), BENCH_ROOT "/f%02d.bin", i);
+            start = esp_timer_get_time();
+            int fd = open(path, O_RDONLY);
+            if (fd >= 0) {
+                close(fd);
+                timing_add(&open_t, start);
+            }
+        }
+    }
+
+    int fd = open(BENCH_ROOT "/big.bin", O_RDONLY);
+    uint32_t seed = 1;          // the same offsets for every filesystem
+    for (int i = 0; i < READS && fd >= 0; i++) {
+        seed = seed * 1103515245 + 12345;
+        off_t offset = (seed >> 8) % (FILE_SIZE - READ_SIZE);
+        start = esp_timer_get_time();
+        if (lseek(fd, offset, SEEK_SET) == offset && read(fd, buf, READ_SIZE) == READ_SIZE) {
+            timing_add(&read_t, start);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    fd = open(BENCH_ROOT "/log.bin", O_WRONLY | O_CREAT | O_APPEND, 0644);
+    for (int i = 0; i < SYNCS && fd >= 0; i++) {
+        if (write(fd, buf, RECORD_SIZE) != RECORD_SIZE) {
+            break;
+        }
+        start = esp_timer_get_time();
+        if (fsync(fd) == 0) {
+            timing_add(&fsync_t, start);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    storage_unmount(label);
+
+    uint32_t kbps = write_us > 0 ? (uint32_t)((int64_t)FILE_SIZE * 1000000 / write_us / 1024) : 0;
+    ESP_LOGI(TAG,
+             "%-8s format %5" PRId64 " ms | open %5" PRId64 "/%6" PRId64 " us | read %5" PRId64 "/%6" PRId64
+             " us | write %4" PRIu32 " KB/s | fsync %5" PRId64 "/%6" PRId64 " us%s",
+             storage_fs_name(fs), format_ms, timing_mean(&open_t), open_t.max_us, timing_mean(&read_t),
+             read_t.max_us, kbps, timing_mean(&fsync_t), fsync_t.max_us, err == ESP_OK ? "" : " (incomplete)");
+    return err;
+}
+
+void storage_benchmark(const char *label)
+{
+    if (label == NULL) {
+        ESP_LOGW(TAG, "No spare partition for the storage benchmark");
+        return;
+    }
+    uint8_t *buf = malloc(WRITE_SIZE);
+    if (buf == NULL) {
+        return;
+    }
+    for (int i = 0; i < WRITE_SIZE; i++) {
+        buf[i] = (uint8_t)(i * 7);
+    }
+    ESP_LOGI(TAG, "Storage benchmark on %s, mean/worst", label);
+    static const storage_fs_t fss[] = { STORAGE_FS_SPIFFS, STORAGE_FS_LITTLEFS, STORAGE_FS_FAT };
+    for (size_t i = 0; i < sizeof(fss) / sizeof(fss[0]); i++) {
+        run(fss[i], label, buf);
+    }
+    free(buf);
+    storage_format(storage_fs(), label);
+}
@@ -0,0 +1,163 @@
+# GORILLA LOG decoder
+# Decodes the compressed sensor log written by main/logger (SD card /sdcard/log
+# or /spiffs/log). Uses the .idx time index to read only the blocks overlapping
+# the requested range.
+
+# Usage:
+# python gorilla_log.py csv LOGDIR [--from 2023-05-01T10:00] [--to 2023-05-01T12:00]
+# python gorilla_log.py stats LOGDIR [--min-ratio 4]
+import argparse
+import csv
+import datetime
+import glob
+import os
+import struct
+import sys
+
+BLOCK_SIZE = 4096
+HEADER = struct.Struct('<IBBHIqq')
+INDEX = struct.Struct('<qqI')
+MAGIC = 0x31524f47
+
+# Same order as Logger::sample / ShipModel
+CHANNELS = ['latitude', 'longitude', 'cog', 'sog', 'heading', 'depth',
+            'wind_angle', 'wind_speed', 'water_temp', 'air_temp', 'pressure',
+            'rudder_angle', 'engine_rpm', 'engine_temp', 'battery_voltage',
+            'battery_current']
+
+
+class BitReader:
+    def __init__(self, data):
+        self.value = int.from_bytes(data, 'big')
+        self.left = len(data) * 8
+
+    def read(self, bits):
+        self.left -= bits
+        return (self.value >> self.left) & ((1 << bits) - 1)
+
+
+def signed(v, bits):
+    return v - (1 << bits) if v >= 1 << (bits - 1) else v
+
+
+def read_dod(r):
+    if r.read(1) == 0:
+        return 0
+    if r.read(1) == 0:
+        return signed(r.read(7), 7)
+    if r.read(1) == 0:
+        return signed(r.read(9), 9)
+    if r.read(1) == 0:
+        return signed(r.read(12), 12)
+    return signed(r.read(32), 32)
+
+
+def decode_block(block):
+    """Yields (timestamp_ms, [values]) for every row of a block."""
+    magic, channels, _, rows, bits, first_ts, _ = HEADER.unpack_from(block)
+    if magic != MAGIC:
+        raise ValueError('bad block magic')
+    r = BitReader(block[HEADER.size:HEADER.size + (bits + 7) // 8])
+    prev = [r.read(32) for _ in range(channels)]
+    window = [None] * channels
+    ts, delta = first_ts, 0
+    yield ts, [struct.unpack('<f', struct.pack('<I', v))[0] for v in prev]
+
+    for _ in range(rows - 1):
+        delta += read_dod(r)
+        ts += delta
+        for ch in range(channels):
+            if r.read(1) == 0:
+                continue
+            if r.read(1) == 0:
+                leading, trailing = window[ch]
+                x = r.read(32 - leading - trailing) << trailing
+            else:
+                leading = r.read(5)
+                length = r.read(5) + 1
+                trailing = 32 - leading - length
+                window[ch] = (leading, trailing)
+                x = r.read(length) << trailing
+            prev[ch] ^= x
+        yield ts, [struct.unpack('<f', struct.pack('<I', v))[0] for v in prev]
+
+
+def segments(logdir):
+    return sorted(glob.glob(os.path.join(logdir, '*.gor')))
+
+
+def blocks_in_range(segment, start, end):
+    """Block numbers overlapping [start, end], from the index alone."""
+    with open(segment[:-4] + '.idx', 'rb') as f:
+        index = f.read()
+    for off in range(0, len(index) - INDEX.size + 1, INDEX.size):
+        first, last, block = INDEX.unpack_from(index, off)
+        if last >= start and first <= end:
+            yield block
+
+
+def read_rows(logdir, start, end):
+    for seg in segments(logdir):
+        with open(seg, 'rb') as f:
+            for block in blocks_in_range(seg, start, end):
+                f.seek(block * BLOCK_SIZE)
+                for ts, values in decode_block(f.read(BLOCK_SIZE)):
+                    if start <= ts <= end:
+                        yield ts, values
+
+
+def parse_time(s, default):
+    if s is None:
+        return default
+    return int(datetime.datetime.fromisoformat(s).timestamp() * 1000)
+
+
+def cmd_csv(args):
+    out = csv.writer(sys.stdout)
+    out.writerow(['time'] + CHANNELS)
+    for ts, values in read_rows(args.logdir, parse_time(args.start, 0),
+                                parse_time(args.end, 2 ** 63 - 1)):
+        stamp = datetime.datetime.fromtimestamp(ts / 1000).isoformat(timespec='milliseconds')
+        out.writerow([stamp] + ['' if v != v else '{:.6g}'.format(v) for v in values])
+
+
+def cmd_stats(args):
+    rows = blocks = fill = 0
+    channels = 0
+    for seg in segments(args.logdir):
+        with open(seg, 'rb') as f:
+            while True:
+                block = f.read(BLOCK_SIZE)
+                if len(block) < BLOCK_SIZE:
+                    break
+                _, channels, _, n, bits, _, _ = HEADER.unpack_from(block)
+                count = sum(1 for _ in decode_block(block))
+                if count != n:
+                    sys.exit('{}: block decoded {} of {} rows'.format(seg, count, n))
+                rows += n
+                blocks += 1
+                fill += HEADER.size + (bits + 7) // 8
+    if not blocks:
+        sys.exit('no blocks')
+    raw = rows * (8 + 4 * channels)
+    stored = blocks * BLOCK_SIZE
+    ratio = raw / stored
+    print('{} rows in {} blocks: {:.1f} bytes/row, ratio {:.2f} ({:.2f} without padding)'.format(
+        rows, blocks, stored / rows, ratio, raw / fill))
+    if args.min_ratio and ratio < args.min_ratio:
+        sys.exit('compression ratio {:.2f} below {}'.format(ratio, args.min_ratio))
+
+
+parser = argparse.ArgumentParser()
+sub = parser.add_subparsers(dest='cmd', required=True)
+p = sub.add_parser('csv', help='decode rows as CSV')
+p.add_argument('logdir')
+p.add_argument('--from', dest='start')
+p.add_argument('--to', dest='end')
+p.set_defaults(func=cmd_csv)
+p = sub.add_parser('stats', help='verify all blocks and print the compression ratio')
+p.add_argument('logdir')
+p.add_argument('--min-ratio', type=float, default=0)
+p.set_defaults(func=cmd_stats)
+args = parser.parse_args()
+args.func(args)
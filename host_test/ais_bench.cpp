@@ -0,0 +1,220 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    Replays a recorded AIS feed through Nmea0183 -> Ais -> AisTargets.
+
+    ais_bench [-s speed] [-n max_targets] feed ...
+
+    Feeds hold !AIVDM lines, optionally prefixed with a millisecond
+    timestamp and ';' as written by ais_replay.py. Two passes:
+      recorded  the feed at speed times its timing, with the range query
+                the plotter runs once per second of feed time
+      unpaced   messages per second through the whole chain, and the cost
+                of range queries over the filled table
+    Fails when a sentence is rejected, a fragment lost, a message not
+    decoded or the target table overflows.
+*/
+
+#include "ais/Ais.hpp"
+#include "nmea/Nmea0183.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ship;
+using Clock = std::chrono::steady_clock;
+
+static constexpr double OWN_LAT = 60.15;     // ais_replay.py --synthetic
+static constexpr double OWN_LON = 24.95;
+static constexpr float OWN_SOG = 6.0f;
+static constexpr float OWN_COG = 210.0f;
+static constexpr float RANGE_NM = 6.0f;
+static constexpr size_t MAX_CONTACTS = 512;
+
+struct Line {
+  int64_t ms;             // since the start of the feed
+  std::string text;       // with CR LF
+};
+
+static bool load(const char *path, std::vector<Line> &lines) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "Cannot read %s\n", path);
+    return false;
+  }
+  char buf[256];
+  int64_t first = -1, n = 0;
+  while (fgets(buf, sizeof(buf), f)) {
+    char *body = buf;
+    int64_t stamp = -1;
+    char *sep = strchr(buf, ';');
+    if (sep && sep > buf && strspn(buf, "0123456789") == size_t(sep - buf)) {
+      stamp = strtoll(buf, nullptr, 10);
+      body = sep + 1;
+    }
+    body[strcspn(body, "\r\n")] = '\0';
+    if (body[0] != '!' && body[0] != '$')
+      continue;
+    if (stamp < 0)
+      stamp = first < 0 ? 0 : first + n * 10; // untimed: 6000 per minute
+    first = first < 0 ? stamp : first;
+    lines.push_back({stamp - first, std::string(body) + "\r\n"});
+    n++;
+  }
+  fclose(f);
+  printf("%s: %zu sentences, %.1f s\n", path, lines.size(),
+         lines.empty() ? 0.0 : lines.back().ms / 1000.0);
+  return true;
+}
+
+static double seconds(Clock::time_point since) {
+  return std::chrono::duration<double>(Clock::now() - since).count();
+}
+
+static void feed(NmeaStream &stream, const Line &line) {
+  stream.feed(reinterpret_cast<const uint8_t *>(line.text.data()),
+              line.text.size());
+}
+
+static bool recorded(const std::vector<Line> &lines, size_t max_targets,
+                     double speed) {
+  AisTargets targets(max_targets);
+  if (targets.init(0) != ESP_OK)
+    return false;
+  Ais ais(targets);
+  Nmea0183 nmea;
+  nmea.subscribe(&ais);
+  NmeaStream stream(nmea);
+  static AisContact contacts[MAX_CONTACTS];
+
+  double query_us = 0, query_max_us = 0;
+  size_t queries = 0, in_range = 0;
+  int64_t next_query = 1000;
+  auto start = Clock::now();
+  for (size_t i = 0; i < lines.size();) {
+    double now = seconds(start) * speed * 1000;
+    for (; i < lines.size() && lines[i].ms <= now; i++) {
+      feed(stream, lines[i]);
+      if (lines[i].ms < next_query)
+        continue;
+      next_query += 1000;
+      auto q = Clock::now();
+      in_range = targets.nearby(OWN_LAT, OWN_LON, OWN_SOG, OWN_COG, RANGE_NM,
+                                contacts, MAX_CONTACTS);
+      double us = seconds(q) * 1e6;
+      query_us += us;
+      query_max_us = std::max(query_max_us, us);
+      queries++;
+    }
+    if (i < lines.size())
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  double elapsed = seconds(start);
+
+  const NmeaStats &n = nmea.stats();
+  const AisStats &a = ais.stats();
+  double minutes = lines.empty() ? 0 : lines.back().ms / 60000.0;
+  printf("recorded %.0fx: %u sentences (%.0f/min of feed) in %.2f s, %u messages, "
+         "%u decoded, %u targets, %zu within %.0f nm, query %.1f/%.1f us\n",
+         speed, n.sentences, minutes > 0 ? n.sentences / minutes : 0.0, elapsed,
+         a.messages, a.decoded, unsigned(targets.count()), in_range, RANGE_NM,
+         queries ? query_us / queries : 0.0, query_max_us);
+  bool ok = n.sentences == lines.size() && n.checksum_errors == 0 &&
+            n.malformed == 0 && a.fragments_lost == 0 && a.malformed == 0 &&
+            a.decoded == a.messages && targets.overflows() == 0 &&
+            in_range > 0;
+  if (!ok)
+    printf("  %u checksum errors, %u malformed, %u fragments lost, %u bad "
+           "payloads, %u overflows\n",
+           n.checksum_errors, n.malformed, a.fragments_lost, a.malformed,
+           targets.overflows());
+  return ok;
+}
+
+static void unpaced(const std::vector<Line> &lines, size_t max_targets) {
+  AisTargets targets(max_targets);
+  if (targets.init(0) != ESP_OK)
+    return;
+  Ais ais(targets);
+  Nmea0183 nmea;
+  nmea.subscribe(&ais);
+  NmeaStream stream(nmea);
+
+  auto start = Clock::now();
+  do {
+    for (auto &line : lines)
+      feed(stream, line);
+  } while (seconds(start) < 1.0);
+  double elapsed = seconds(start);
+  double rate = ais.stats().messages / elapsed;
+
+  static AisContact contacts[MAX_CONTACTS];
+  const float ranges[] = {1, 3, 6, 12, 24};
+  printf("unpaced: %u messages in %.2f s, %.0f messages/s, %.0f/min\n",
+         ais.stats().messages, elapsed, rate, rate * 60);
+  for (float range : ranges) {
+    size_t found = 0, rounds = 0;
+    start = Clock::now();
+    do {
+      found = targets.nearby(OWN_LAT, OWN_LON, OWN_SOG, OWN_COG, range,
+                             contacts, MAX_CONTACTS);
+      rounds++;
+    } while (seconds(start) < 0.2);
+    printf("  nearby %4.0f nm: %3zu of %zu targets, %.1f us\n", range, found,
+           targets.count(), seconds(start) * 1e6 / rounds);
+  }
+}
+
+int main(int argc, char **argv) {
+  double speed = 10;
+  size_t max_targets = 512;
+  std::vector<Line> lines;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      speed = atof(argv[++i]);
+      continue;
+    }
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      max_targets = strtoul(argv[++i], nullptr, 10);
+      continue;
+    }
+    if (!load(argv[i], lines))
+      return 2;
+  }
+  if (lines.empty() || speed <= 0 || max_targets == 0) {
+    fprintf(stderr, "usage: %s [-s speed] [-n max_targets] feed ...\n", argv[0]);
+    return 2;
+  }
+
+  bool ok = recorded(lines, max_targets, speed);
+  unpaced(lines, max_targets);
+  if (!ok)
+    printf("FAILED\n");
+  return ok ? 0 : 1;
+}
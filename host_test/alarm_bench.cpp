@@ -0,0 +1,204 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    Cost of an AlarmEngine update against the number of rules.
+
+    alarm_bench [-n updates] [-x max_time_ratio]
+
+    Engines with 10, 100 and 1000 rules on the depth input take the same
+    depth trace: a day at 1 Hz, 0.1 m resolution, between 1.5 and 28 m.
+    Four rules sit inside that range (shallow water, anchoring depth, ...),
+    the others are deep-water rules between 100 and 200 m that the trace
+    never reaches. A table scan evaluates every rule on every update; the
+    engine only evaluates the rules whose thresholds the value crossed,
+    after a full pass for the first value.
+    Fails unless
+    - every engine evaluates exactly the same rules, however many it has,
+    - those are fewer than one per update, and
+    - the time per update with 1000 rules is within max_time_ratio of the
+      time with 10 (queueing to the engine task included).
+    FreeRTOS, esp_timer and esp_event come from stubs/.
+*/
+
+#include "alarm/AlarmEngine.hpp"
+#include "events/tux_events.hpp"
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace ship;
+using Clock = std::chrono::steady_clock;
+
+ESP_EVENT_DEFINE_BASE(TUX_EVENTS);
+
+static const AlarmRule NEAR_RULES[] = {
+    {"Shallow water", ALARM_DEPTH, false, 3.0f, 0.5f, 2000, ALARM_ALARM, false},
+    {"Aground", ALARM_DEPTH, false, 1.8f, 0.2f, 0, ALARM_ALARM, true},
+    {"Anchoring depth", ALARM_DEPTH, false, 8.0f, 1.0f, 10000, ALARM_WARNING, false},
+    {"Off soundings", ALARM_DEPTH, true, 25.0f, 2.0f, 0, ALARM_WARNING, false},
+};
+static constexpr size_t NEAR = sizeof(NEAR_RULES) / sizeof(NEAR_RULES[0]);
+
+// Raised last, to tell when the engine task has handled everything before
+static const AlarmRule SENTINEL = {"Sentinel", ALARM_ENGINE_RPM, true, 1e6f, 0,
+                                   0, ALARM_ALARM, false};
+
+struct Result {
+  size_t rules;
+  uint32_t evaluations;
+  double ns_per_update;
+};
+
+static std::vector<float> make_trace(size_t updates) {
+  std::mt19937 rng(34);
+  std::normal_distribution<float> step(0, 0.08f);
+  std::vector<float> trace;
+  float depth = 10;
+  for (size_t i = 0; i < updates; i++) {
+    depth += step(rng);
+    if (depth < 1.5f)
+      depth = 3.0f - depth;
+    if (depth > 28)
+      depth = 56 - depth;
+    trace.push_back(std::round(depth * 10) / 10);
+  }
+  return trace;
+}
+
+static bool run(size_t count, const std::vector<float> &trace, Result &out) {
+  std::vector<AlarmRule> rules(NEAR_RULES, NEAR_RULES + NEAR);
+  for (size_t i = NEAR; i + 1 < count; i++) {
+    float threshold = 100 + 100.0f * i / count;
+    rules.push_back({"Deep water", ALARM_DEPTH, true, threshold, 1.0f, 0,
+                     ALARM_WARNING, false});
+  }
+  rules.push_back(SENTINEL);
+  uint16_t sentinel = rules.size() - 1;
+  // The first value of an input has nothing to compare with: it evaluates
+  // the rules at every threshold (set and clear) on that input
+  uint32_t first = 0;
+  for (const AlarmRule &r : rules)
+    first += r.hysteresis > 0 ? 2 : 1;
+
+  // Never destroyed: the engine task cannot be stopped on the host
+  AlarmEngine *engine = new AlarmEngine();
+  if (engine->compile(rules.data(), rules.size()) != ESP_OK ||
+      engine->start() != ESP_OK) {
+    printf("FAIL: %zu rules do not compile\n", count);
+    return false;
+  }
+
+  auto start = Clock::now();
+  for (float depth : trace) {
+    // The queue holds 32 updates; wait for room rather than lose one
+    uint32_t dropped = engine->dropped();
+    engine->feed(ALARM_DEPTH, depth);
+    while (engine->dropped() != dropped) {
+      std::this_thread::yield();
+      dropped = engine->dropped();
+      engine->feed(ALARM_DEPTH, depth);
+    }
+  }
+  engine->feed(ALARM_ENGINE_RPM, 2e6f);
+
+  std::vector<AlarmEvent> active(rules.size());
+  auto deadline = Clock::now() + std::chrono::seconds(30);
+  bool done = false;
+  while (!done && Clock::now() < deadline) {
+    size_t n = engine->active(active.data(), active.size());
+    for (size_t i = 0; i < n && !done; i++)
+      done = active[i].id == sentinel;
+    if (!done)
+      std::this_thread::yield();
+  }
+  double s = std::chrono::duration<double>(Clock::now() - start).count();
+  if (!done) {
+    printf("FAIL: %zu rules: engine did not catch up\n", count);
+    return false;
+  }
+
+  out.rules = count;
+  out.evaluations = engine->evaluations() - first;
+  out.ns_per_update = s * 1e9 / trace.size();
+  return true;
+}
+
+int main(int argc, char **argv) {
+  size_t updates = 86400;
+  double max_ratio = 3;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      updates = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+      max_ratio = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [-n updates] [-x max_time_ratio]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  std::vector<float> trace = make_trace(updates);
+  std::vector<Result> results;
+  bool ok = true;
+  printf("%zu depth updates\n", trace.size());
+  printf("rules  evaluated  table scan  ns/update\n");
+  for (size_t count : {10, 100, 1000}) {
+    Result r;
+    if (!run(count, trace, r)) {
+      ok = false;
+      continue;
+    }
+    printf("%5zu  %9" PRIu32 "  %10zu  %9.0f\n", r.rules, r.evaluations,
+           r.rules * trace.size(), r.ns_per_update);
+    results.push_back(r);
+  }
+
+  for (const Result &r : results) {
+    if (r.evaluations != results[0].evaluations) {
+      printf("FAIL: %zu rules evaluated %" PRIu32 " times, %zu rules %" PRIu32 "\n",
+             r.rules, r.evaluations, results[0].rules, results[0].evaluations);
+      ok = false;
+    }
+    if (r.evaluations >= trace.size()) {
+      printf("FAIL: %zu rules: %" PRIu32 " evaluations for %zu updates\n",
+             r.rules, r.evaluations, trace.size());
+      ok = false;
+    }
+  }
+  if (results.size() == 3 &&
+      results[2].ns_per_update > max_ratio * results[0].ns_per_update) {
+    printf("FAIL: 1000 rules take %.1fx the time of 10\n",
+           results[2].ns_per_update / results[0].ns_per_update);
+    ok = false;
+  }
+  printf("%s\n", ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
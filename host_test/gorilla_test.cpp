@@ -0,0 +1,424 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    GorillaBlock round trip and compression ratio.
+
+    gorilla_test [-r min_ratio] [-l logdir -t min_rows_per_s]
+
+    - boundaries  one block per delta-of-delta bucket edge (0, +-63/64,
+                  +-255/256, +-2047/2048, the 32 bit escape), decoded
+                  and compared bit for bit
+    - day         a synthetic day at 1 Hz (a passage, motoring, a night at
+                  anchor, sample jitter and dropped samples) through
+                  GorillaBlock; every block is decoded and compared bit
+                  for bit, NAN included, and the compression ratio
+                  (raw rows / 4 kB blocks) must reach min_ratio
+    - logger      with -l, the same day through Logger into logdir (emptied
+                  first): rows are appended as fast as the queue takes them,
+                  the segments read back and compared bit for bit. Appended
+                  rows per second, writes included, must reach min_rows_per_s.
+                  The log is left in logdir for gorilla_log.py stats.
+    The decoder is a port of gorilla_log.py decode_block(). FreeRTOS and
+    the ESP-IDF calls of Logger come from stubs/.
+*/
+
+#include "logger/Logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace ship;
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t CHANNELS = Logger::CHANNELS;
+static constexpr int64_t DAY_START = 1684915200000; // 2023-05-24 08:00 UTC
+static constexpr int DAY_ROWS = 24 * 3600;
+
+struct Row {
+  int64_t ts;
+  float values[CHANNELS];
+};
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                       \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                              \
+      printf(__VA_ARGS__);                                                     \
+      printf("\n");                                                            \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+class BitReader {
+public:
+  BitReader(const uint8_t *data, size_t bits) : _data(data), _bits(bits) {}
+
+  uint32_t read(unsigned bits) {
+    uint32_t v = 0;
+    for (unsigned i = 0; i < bits; i++, _pos++) {
+      bool bit = _pos < _bits && (_data[_pos >> 3] & (0x80 >> (_pos & 7)));
+      v = (v << 1) | bit;
+    }
+    return v;
+  }
+  bool overrun() const { return _pos > _bits; }
+
+private:
+  const uint8_t *_data;
+  size_t _bits;
+  size_t _pos = 0;
+};
+
+static int64_t sign(uint32_t v, unsigned bits) {
+  return bits == 32 ? int64_t(int32_t(v))
+                    : (v >= (1u << (bits - 1)) ? int64_t(v) - (1 << bits) : v);
+}
+
+static int64_t read_dod(BitReader &r) {
+  if (r.read(1) == 0)
+    return 0;
+  if (r.read(1) == 0)
+    return sign(r.read(7), 7);
+  if (r.read(1) == 0)
+    return sign(r.read(9), 9);
+  if (r.read(1) == 0)
+    return sign(r.read(12), 12);
+  return sign(r.read(32), 32);
+}
+
+// Appends the rows of one finished block to out; false on a bad header
+static bool decode_block(const uint8_t *block, std::vector<Row> &out) {
+  uint32_t magic, bits;
+  uint16_t rows;
+  int64_t first_ts, last_ts;
+  memcpy(&magic, block, 4);
+  size_t channels = block[4];
+  memcpy(&rows, block + 6, 2);
+  memcpy(&bits, block + 8, 4);
+  memcpy(&first_ts, block + 12, 8);
+  memcpy(&last_ts, block + 20, 8);
+  if (magic != GORILLA_MAGIC || channels != CHANNELS || rows == 0 ||
+      bits > (GORILLA_BLOCK_SIZE - GORILLA_HEADER_SIZE) * 8)
+    return false;
+
+  BitReader r(block + GORILLA_HEADER_SIZE, bits);
+  uint32_t prev[CHANNELS];
+  unsigned leading[CHANNELS] = {}, trailing[CHANNELS] = {};
+  Row row;
+  row.ts = first_ts;
+  for (size_t ch = 0; ch < CHANNELS; ch++)
+    prev[ch] = r.read(32);
+  memcpy(row.values, prev, sizeof(prev));
+  out.push_back(row);
+
+  int64_t delta = 0;
+  for (unsigned i = 1; i < rows; i++) {
+    delta += read_dod(r);
+    row.ts += delta;
+    for (size_t ch = 0; ch < CHANNELS; ch++) {
+      if (r.read(1) == 0)
+        continue;
+      if (r.read(1) == 1) {
+        leading[ch] = r.read(5);
+        unsigned len = r.read(5) + 1;
+        trailing[ch] = 32 - leading[ch] - len;
+      }
+      prev[ch] ^= r.read(32 - leading[ch] - trailing[ch]) << trailing[ch];
+    }
+    memcpy(row.values, prev, sizeof(prev));
+    out.push_back(row);
+  }
+  return !r.overrun() && row.ts == last_ts;
+}
+
+static bool same(const Row &a, const Row &b) {
+  // Bit for bit, so NAN compares equal to itself
+  return a.ts == b.ts && memcmp(a.values, b.values, sizeof(a.values)) == 0;
+}
+
+/* Encodes rows into as many blocks as needed; returns the blocks */
+static std::vector<std::vector<uint8_t>> encode(GorillaBlock &block,
+                                                const std::vector<Row> &rows) {
+  std::vector<std::vector<uint8_t>> blocks;
+  block.reset();
+  for (const Row &row : rows) {
+    if (!block.append(row.ts, row.values)) {
+      const uint8_t *data = block.finish();
+      blocks.emplace_back(data, data + GORILLA_BLOCK_SIZE);
+      block.reset();
+      block.append(row.ts, row.values);
+    }
+  }
+  if (block.rows()) {
+    const uint8_t *data = block.finish();
+    blocks.emplace_back(data, data + GORILLA_BLOCK_SIZE);
+  }
+  return blocks;
+}
+
+static void check_round_trip(const char *what, const std::vector<Row> &rows,
+                             const std::vector<std::vector<uint8_t>> &blocks) {
+  std::vector<Row> decoded;
+  for (size_t i = 0; i < blocks.size(); i++)
+    CHECK(decode_block(blocks[i].data(), decoded), "%s: block %zu does not decode",
+          what, i);
+  CHECK(decoded.size() == rows.size(), "%s: %zu of %zu rows decoded", what,
+        decoded.size(), rows.size());
+  for (size_t i = 0; i < rows.size() && i < decoded.size(); i++) {
+    if (!same(rows[i], decoded[i])) {
+      CHECK(false, "%s: row %zu differs, ts %lld read as %lld", what, i,
+            (long long)rows[i].ts, (long long)decoded[i].ts);
+      break;
+    }
+  }
+}
+
+static void test_boundaries(GorillaBlock &block) {
+  static const int64_t dods[] = {
+      0,     1,     -1,    63,    -64,   64,    -65,   255,    -256,
+      256,   -257,  2047,  -2048, 2048,  -2049, 40000, -40000, INT32_MAX,
+  };
+  for (int64_t dod : dods) {
+    // A steady 1 s, one step by dod and back, as a late sample makes
+    std::vector<Row> rows;
+    int64_t ts = DAY_START, delta = 1000;
+    if (dod < 0)
+      delta -= dod; // keeps every delta positive
+    for (int i = 0; i < 6; i++) {
+      Row row;
+      row.ts = ts;
+      for (size_t ch = 0; ch < CHANNELS; ch++)
+        row.values[ch] = float(i * 10 + ch);
+      rows.push_back(row);
+      int64_t step = i == 2 ? delta + dod : delta;
+      ts += step;
+    }
+    char what[32];
+    snprintf(what, sizeof(what), "dod %lld", (long long)dod);
+    auto blocks = encode(block, rows);
+    CHECK(blocks.size() == 1, "%s: %zu blocks", what, blocks.size());
+    check_round_trip(what, rows, blocks);
+  }
+}
+
+/*
+ * A day aboard at 1 Hz: moored at night, motoring out, eight hours under
+ * sail, motoring in, at anchor. Values carry the resolution of the
+ * instruments that send them; channels without a source are NAN.
+ */
+static std::vector<Row> make_day() {
+  std::mt19937 rng(33);
+  std::normal_distribution<float> noise(0, 1);
+  std::uniform_int_distribution<int> jitter(-3, 3);
+  auto q = [](float v, float step) { return std::round(v / step) * step; };
+
+  std::vector<Row> rows;
+  double lat = 59.4372, lon = 24.7454;
+  float cog = 270, depth = 4.2f, wind = 210, tws = 12, water = 287.4f,
+        air = 291.2f, pressure = 101320, volts = 12.9f;
+  int64_t ts = DAY_START;
+  for (int s = 0; s < DAY_ROWS; s++) {
+    int hour = s / 3600;
+    bool motoring = hour == 8 || hour == 17;
+    bool sailing = hour >= 9 && hour < 17;
+    bool moving = motoring || sailing;
+    float sog = 0;
+    if (moving) {
+      cog += 0.05f * noise(rng);
+      sog = motoring ? 5.5f + 0.1f * noise(rng) : 6.8f + 0.4f * noise(rng);
+      lat += sog / 3600.0 / 60.0 * std::cos(cog * M_PI / 180);
+      lon += sog / 3600.0 / 60.0 * std::sin(cog * M_PI / 180) / std::cos(lat * M_PI / 180);
+      depth = std::max(2.0f, depth + 0.05f * noise(rng));
+    }
+    wind += 0.5f * noise(rng);
+    tws = std::max(0.0f, tws + 0.05f * noise(rng));
+    if (s % 60 == 0) {
+      water += 0.01f * noise(rng);
+      air += 0.05f * noise(rng);
+      volts += motoring ? 0.01f : -0.002f;
+    }
+    if (s % 600 == 0)
+      pressure += 10 * std::round(noise(rng));
+
+    const float nan = NAN;
+    Row row;
+    row.ts = ts;
+    float v[CHANNELS] = {
+        float(lat),
+        float(lon),
+        moving ? q(cog, 0.1f) : nan,
+        q(sog, 0.1f),
+        q(std::fmod(cog + 360 - 7, 360), 0.1f),
+        q(depth, 0.1f),
+        q(std::fmod(wind - cog + 720, 360), 1),
+        q(tws, 0.1f),
+        q(water, 0.1f),
+        q(air, 0.1f),
+        pressure,
+        moving ? q(3 * noise(rng), 1) : nan,
+        motoring ? q(1800 + 20 * noise(rng), 10) : nan,
+        motoring ? q(353.2f + 0.5f * noise(rng), 1) : nan,
+        q(volts, 0.01f),
+        q(motoring ? 25.0f : -2.5f + 0.2f * noise(rng), 0.1f),
+    };
+    memcpy(row.values, v, sizeof(v));
+    rows.push_back(row);
+
+    // esp_timer jitter, and a sample now and then lost to a busy task
+    ts += 1000 + jitter(rng) + (rng() % 997 == 0 ? 1000 : 0);
+  }
+  return rows;
+}
+
+static void test_day(GorillaBlock &block, double min_ratio) {
+  std::vector<Row> rows = make_day();
+
+  auto start = Clock::now();
+  auto blocks = encode(block, rows);
+  double s = std::chrono::duration<double>(Clock::now() - start).count();
+  check_round_trip("day", rows, blocks);
+
+  double raw = double(rows.size()) * (sizeof(int64_t) + sizeof(float) * CHANNELS);
+  double ratio = raw / (blocks.size() * GORILLA_BLOCK_SIZE);
+  printf("day: %zu rows in %zu blocks, %.1f bytes/row, ratio %.2f, "
+         "%.0f rows/s encoded\n",
+         rows.size(), blocks.size(),
+         double(blocks.size() * GORILLA_BLOCK_SIZE) / rows.size(), ratio,
+         rows.size() / s);
+  CHECK(ratio >= min_ratio, "compression ratio %.2f below %.2f", ratio,
+        min_ratio);
+}
+
+/* Reads every block of the segments in dir, in segment order */
+static bool read_log(const std::filesystem::path &dir, std::vector<Row> &rows,
+                     size_t &blocks) {
+  std::vector<std::filesystem::path> segments;
+  for (auto &e : std::filesystem::directory_iterator(dir))
+    if (e.path().extension() == ".gor")
+      segments.push_back(e.path());
+  std::sort(segments.begin(), segments.end());
+
+  rows.clear();
+  blocks = 0;
+  uint8_t block[GORILLA_BLOCK_SIZE];
+  for (auto &path : segments) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+      return false;
+    bool ok = true;
+    while (ok && fread(block, sizeof(block), 1, f) == 1) {
+      ok = decode_block(block, rows);
+      blocks++;
+    }
+    fclose(f);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+static void test_logger(const char *dir, double min_rows_per_s) {
+  std::filesystem::create_directories(dir);
+  for (auto &e : std::filesystem::directory_iterator(dir))
+    std::filesystem::remove(e.path());
+  std::vector<Row> rows = make_day();
+
+  // Never destroyed, as in the firmware: its task cannot be stopped here
+  Logger *logger = new Logger(dir, 64, 86400, 64ull * 1024 * 1024);
+  CHECK(logger->start() == ESP_OK, "logger did not start");
+
+  auto start = Clock::now();
+  for (const Row &row : rows) {
+    while (!logger->append(row.ts, row.values))
+      std::this_thread::yield(); // queue full, the writer catches up
+  }
+  logger->flush();
+
+  // Done once every row reads back; the writer is not stopped
+  std::vector<Row> decoded;
+  size_t blocks = 0;
+  auto deadline = Clock::now() + std::chrono::seconds(30);
+  while ((!read_log(dir, decoded, blocks) || decoded.size() < rows.size()) &&
+         Clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  double s = std::chrono::duration<double>(Clock::now() - start).count();
+
+  CHECK(decoded.size() == rows.size(), "logger: %zu of %zu rows read back",
+        decoded.size(), rows.size());
+  for (size_t i = 0; i < rows.size() && i < decoded.size(); i++) {
+    if (!same(rows[i], decoded[i])) {
+      CHECK(false, "logger: row %zu differs", i);
+      break;
+    }
+  }
+
+  // dropped counts the appends retried above, no row was lost
+  const LoggerStats &stats = logger->stats();
+  double rows_per_s = rows.size() / s;
+  printf("logger: %zu rows in %zu blocks in %.2f s, %.0f rows/s, "
+         "queue full %" PRIu32 " times, %.0f kB/s written\n",
+         decoded.size(), blocks, s, rows_per_s, stats.dropped,
+         stats.written_bytes / 1024.0 / (stats.write_us ? stats.write_us / 1e6 : 1));
+  CHECK(rows_per_s >= min_rows_per_s, "logger: %.0f rows/s below %.0f",
+        rows_per_s, min_rows_per_s);
+}
+
+int main(int argc, char **argv) {
+  double min_ratio = 0;
+  double min_rows_per_s = 0;
+  const char *logdir = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      min_ratio = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      logdir = argv[++i];
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      min_rows_per_s = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [-r min_ratio] [-l logdir -t min_rows_per_s]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  static GorillaBlock block(CHANNELS); // 4 kB, as the logger keeps it
+  test_boundaries(block);
+  test_day(block, min_ratio);
+  if (logdir)
+    test_logger(logdir, min_rows_per_s);
+
+  printf("%s: %d failures\n", failures ? "FAILED" : "passed", failures);
+  return failures ? 1 : 0;
+}
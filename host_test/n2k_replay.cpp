@@ -0,0 +1,237 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    Replays candump logs through Nmea2000, standing in for N2kTwai.
+
+    n2k_replay [-s speed] log ...
+
+    Logs are in the `candump -l` format: "(seconds) iface id#data".
+    Three passes:
+      recorded   frames at speed times their recorded timing
+      saturated  the same frames back to back on a 250 kbit/s bus, at speed
+                 times bus time
+      unpaced    as fast as the decoder goes, for the throughput
+    The first two fail when a message of an accepted PGN is lost: every
+    single frame and every complete fast packet of the filter table must be
+    decoded. Logs must be clean recordings.
+*/
+
+#include "n2k/Nmea2000.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace ship;
+using Clock = std::chrono::steady_clock;
+
+static constexpr double BUS_BITRATE = 250000;
+
+struct Frame {
+  uint32_t ms;            // since the start of the log
+  uint32_t id;
+  uint8_t len;
+  uint8_t data[8];
+};
+
+// Accepted PGNs, as in Nmea2000.cpp; true for fast packets
+static const struct {
+  uint32_t pgn;
+  bool fast_packet;
+} accepted[] = {
+    {N2K_PGN_RUDDER, false},        {N2K_PGN_HEADING, false},
+    {N2K_PGN_ENGINE_RAPID, false},  {N2K_PGN_ENGINE_DYNAMIC, true},
+    {N2K_PGN_BATTERY, false},       {N2K_PGN_DEPTH, false},
+    {N2K_PGN_POSITION_RAPID, false}, {N2K_PGN_COG_SOG_RAPID, false},
+    {N2K_PGN_WIND, false},
+};
+
+class Counter : public N2kListener {
+public:
+  void on_position(const N2kPosition &) override { messages++; }
+  void on_cog_sog(const N2kCogSog &) override { messages++; }
+  void on_heading(const N2kHeading &) override { messages++; }
+  void on_rudder(const N2kRudder &) override { messages++; }
+  void on_wind(const N2kWind &) override { messages++; }
+  void on_depth(const N2kDepth &) override { messages++; }
+  void on_engine_rapid(const N2kEngineRapid &) override { messages++; }
+  void on_engine_dynamic(const N2kEngineDynamic &) override { messages++; }
+  void on_battery(const N2kBattery &) override { messages++; }
+  uint32_t messages = 0;
+};
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+static bool load(const char *path, std::vector<Frame> &frames) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "Cannot read %s\n", path);
+    return false;
+  }
+  char line[128];
+  double first = -1;
+  size_t start = frames.size();
+  while (fgets(line, sizeof(line), f)) {
+    double stamp;
+    char iface[16];
+    char frame[64];
+    if (sscanf(line, " (%lf) %15s %63s", &stamp, iface, frame) != 3)
+      continue;
+    char *hash = strchr(frame, '#');
+    if (!hash || hash - frame != 8)
+      continue; // standard 11 bit frames are not NMEA 2000
+    Frame fr = {};
+    fr.id = strtoul(frame, nullptr, 16);
+    for (const char *p = hash + 1; p[0] && p[1] && fr.len < 8; p += 2) {
+      int hi = hex_value(p[0]), lo = hex_value(p[1]);
+      if (hi < 0 || lo < 0)
+        break;
+      fr.data[fr.len++] = uint8_t((hi << 4) | lo);
+    }
+    first = first < 0 ? stamp : first;
+    fr.ms = uint32_t((stamp - first) * 1000);
+    frames.push_back(fr);
+  }
+  fclose(f);
+  printf("%s: %zu frames, %.1f s\n", path, frames.size() - start,
+         frames.size() > start ? frames.back().ms / 1000.0 : 0.0);
+  return true;
+}
+
+// Messages the decoder must produce from frames
+static uint32_t expected(const std::vector<Frame> &frames) {
+  uint32_t n = 0;
+  for (auto &fr : frames) {
+    uint32_t pgn = Nmea2000::pgn_of(fr.id);
+    for (auto &a : accepted)
+      if (a.pgn == pgn && (!a.fast_packet || (fr.len > 0 && (fr.data[0] & 0x1F) == 0)))
+        n++;
+  }
+  return n;
+}
+
+// Extended data frame, stuff bits left out: the most frames a bus carries
+static double bus_seconds(const Frame &fr) {
+  return (67 + 8 * fr.len) / BUS_BITRATE;
+}
+
+static double seconds(Clock::time_point since) {
+  return std::chrono::duration<double>(Clock::now() - since).count();
+}
+
+// Replays frames at speed x, at the times given by at(); false on loss
+template <typename At>
+static bool paced(const char *name, const std::vector<Frame> &frames,
+                  double speed, At at) {
+  Nmea2000 n2k;
+  Counter counter;
+  n2k.subscribe(&counter);
+
+  auto start = Clock::now();
+  size_t i = 0;
+  double end = 0;
+  while (i < frames.size()) {
+    double now = seconds(start) * speed;
+    for (; i < frames.size() && (end = at(i)) <= now; i++)
+      n2k.handle_frame(frames[i].id, frames[i].data, frames[i].len,
+                       uint32_t(end * 1000));
+    if (i < frames.size())
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  double elapsed = seconds(start);
+
+  const N2kStats &s = n2k.stats();
+  uint32_t want = expected(frames);
+  printf("%s %.0fx: %.1f s of bus time in %.2f s, %u frames (%.0f/s), "
+         "%u filtered, %u/%u messages, %u fast packet errors, %u slot overruns\n",
+         name, speed, end, elapsed, s.frames, s.frames / elapsed, s.filtered,
+         counter.messages, want, s.fast_packet_errors, s.slot_overruns);
+  return counter.messages == want && s.messages == want &&
+         s.fast_packet_errors == 0 && s.slot_overruns == 0;
+}
+
+// As fast as the decoder goes, for at least a second
+static void unpaced(const std::vector<Frame> &frames) {
+  Nmea2000 n2k;
+  Counter counter;
+  n2k.subscribe(&counter);
+  double bus = 0;
+  for (auto &fr : frames)
+    bus += bus_seconds(fr);
+
+  auto start = Clock::now();
+  uint32_t base = 0;
+  do {
+    for (auto &fr : frames)
+      n2k.handle_frame(fr.id, fr.data, fr.len, base + fr.ms);
+    base += frames.back().ms + N2K_FAST_PACKET_TIMEOUT_MS;
+  } while (seconds(start) < 1.0);
+  double elapsed = seconds(start);
+
+  double rate = n2k.stats().frames / elapsed;
+  double saturated = frames.size() / bus;
+  printf("unpaced: %u frames in %.2f s, %.0f frames/s, %u messages, "
+         "%.0fx a saturated bus of %.0f frames/s\n",
+         n2k.stats().frames, elapsed, rate, counter.messages, rate / saturated,
+         saturated);
+}
+
+int main(int argc, char **argv) {
+  double speed = 10;
+  std::vector<Frame> frames;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      speed = atof(argv[++i]);
+      continue;
+    }
+    if (!load(argv[i], frames))
+      return 2;
+  }
+  if (frames.empty() || speed <= 0) {
+    fprintf(stderr, "usage: %s [-s speed] candump.log ...\n", argv[0]);
+    return 2;
+  }
+
+  bool ok = paced("recorded", frames, speed,
+                  [&](size_t i) { return frames[i].ms / 1000.0; });
+  std::vector<double> bus(frames.size());
+  for (size_t i = 0; i < frames.size(); i++)
+    bus[i] = (i ? bus[i - 1] : 0) + bus_seconds(frames[i]);
+  ok &= paced("saturated", frames, speed, [&](size_t i) { return bus[i]; });
+  unpaced(frames);
+  if (!ok)
+    printf("FAILED: messages lost\n");
+  return ok ? 0 : 1;
+}
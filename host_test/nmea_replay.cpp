@@ -0,0 +1,200 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    Replays recorded NMEA 0183 logs through NmeaStream / Nmea0183.
+
+    nmea_replay [-s speed] log[@baud] ...
+
+    Every log is one input port, fed in UART ring buffer sized chunks. The
+    paced pass plays all ports together at speed times a saturated line
+    (characters back to back at the port's baud rate, the most a talker can
+    send) and fails if a sentence is lost or rejected; the unpaced pass
+    reports the decoder's own throughput. Logs must be clean recordings.
+*/
+
+#include "nmea/Nmea0183.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ship;
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t CHUNK = 120;     // NmeaUart RX-full threshold
+
+struct Log {
+  std::string path;
+  int baud = 38400;
+  std::vector<uint8_t> data;
+  uint32_t lines = 0;                    // sentences in the recording
+};
+
+class Counter : public NmeaListener {
+public:
+  void on_rmc(const NmeaRmc &) override { typed++; }
+  void on_gga(const NmeaGga &) override { typed++; }
+  void on_vtg(const NmeaVtg &) override { typed++; }
+  void on_hdg(const NmeaHdg &) override { typed++; }
+  void on_mwv(const NmeaMwv &) override { typed++; }
+  void on_dbt(const NmeaDbt &) override { typed++; }
+  void on_dpt(const NmeaDpt &) override { typed++; }
+  void on_xdr(const NmeaXdr &) override { typed++; }
+  uint32_t typed = 0;
+};
+
+static bool load(const char *arg, Log &log) {
+  log.path = arg;
+  size_t at = log.path.rfind('@');
+  if (at != std::string::npos) {
+    log.baud = atoi(log.path.c_str() + at + 1);
+    log.path.resize(at);
+  }
+  FILE *f = fopen(log.path.c_str(), "rb");
+  if (!f || log.baud <= 0) {
+    fprintf(stderr, "Cannot read %s\n", arg);
+    if (f)
+      fclose(f);
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    log.data.insert(log.data.end(), buf, buf + n);
+  fclose(f);
+  bool bol = true;
+  for (uint8_t c : log.data) {
+    if (bol && (c == '$' || c == '!'))
+      log.lines++;
+    bol = c == '\n';
+  }
+  return true;
+}
+
+static double seconds(Clock::time_point since) {
+  return std::chrono::duration<double>(Clock::now() - since).count();
+}
+
+// All ports at speed x their line rate (10 bits per character); false on loss
+static bool paced(const std::vector<Log> &logs, double speed) {
+  Nmea0183 nmea;
+  Counter counter;
+  nmea.subscribe(&counter);
+  std::vector<NmeaStream> streams(logs.size(), NmeaStream(nmea));
+  std::vector<size_t> done(logs.size(), 0);
+  uint32_t expected = 0;
+  double duration = 0;
+  for (auto &log : logs) {
+    expected += log.lines;
+    duration = std::max(duration, log.data.size() * 10.0 / log.baud);
+  }
+
+  auto start = Clock::now();
+  for (bool busy = true; busy;) {
+    busy = false;
+    double t = seconds(start) * speed;
+    for (size_t i = 0; i < logs.size(); i++) {
+      size_t due = std::min(logs[i].data.size(), size_t(t * logs[i].baud / 10));
+      while (done[i] < due) {
+        size_t n = std::min(CHUNK, due - done[i]);
+        streams[i].feed(logs[i].data.data() + done[i], n);
+        done[i] += n;
+      }
+      busy |= done[i] < logs[i].data.size();
+    }
+    if (busy)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  double elapsed = seconds(start);
+
+  const NmeaStats &s = nmea.stats();
+  printf("paced %.0fx: %.1f s of line time in %.2f s, %u/%u sentences (%.0f/s), "
+         "%u typed, %u checksum errors, %u malformed, %u overflows\n",
+         speed, duration, elapsed, s.sentences, expected,
+         s.sentences / elapsed, counter.typed, s.checksum_errors, s.malformed,
+         s.overflows);
+  return s.sentences == expected && s.checksum_errors == 0 &&
+         s.malformed == 0 && s.overflows == 0 && counter.typed == s.decoded;
+}
+
+// As fast as the decoder goes, for at least a second
+static void unpaced(const std::vector<Log> &logs) {
+  Nmea0183 nmea;
+  Counter counter;
+  nmea.subscribe(&counter);
+  double realtime = 0;     // sentences per second of saturated ports
+  size_t bytes = 0;
+  for (auto &log : logs) {
+    realtime += log.lines / (log.data.size() * 10.0 / log.baud);
+    bytes += log.data.size();
+  }
+
+  auto start = Clock::now();
+  int rounds = 0;
+  do {
+    for (auto &log : logs) {
+      NmeaStream stream(nmea);
+      for (size_t i = 0; i < log.data.size(); i += CHUNK)
+        stream.feed(log.data.data() + i, std::min(CHUNK, log.data.size() - i));
+    }
+    rounds++;
+  } while (seconds(start) < 1.0);
+  double elapsed = seconds(start);
+
+  double rate = nmea.stats().sentences / elapsed;
+  printf("unpaced: %u sentences in %.2f s, %.0f sentences/s, %.1f MB/s, "
+         "%.0fx the %.0f sentences/s of saturated ports\n",
+         nmea.stats().sentences, elapsed, rate,
+         bytes * rounds / elapsed / 1e6, rate / realtime, realtime);
+}
+
+int main(int argc, char **argv) {
+  double speed = 10;
+  std::vector<Log> logs;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      speed = atof(argv[++i]);
+      continue;
+    }
+    logs.emplace_back();
+    if (!load(argv[i], logs.back()))
+      return 2;
+    printf("%s: %u sentences at %d baud\n", logs.back().path.c_str(),
+           logs.back().lines, logs.back().baud);
+  }
+  if (logs.empty() || speed <= 0) {
+    fprintf(stderr, "usage: %s [-s speed] log[@baud] ...\n", argv[0]);
+    return 2;
+  }
+
+  bool ok = paced(logs, speed);
+  unpaced(logs);
+  if (!ok)
+    printf("FAILED: sentences lost or rejected\n");
+  return ok ? 0 : 1;
+}
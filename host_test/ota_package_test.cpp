@@ -0,0 +1,536 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    Applies full and delta OTA packages through components/ota/ota_package.c.
+
+    ota_package_test python ota_pack.py work_dir
+
+    Two synthetic app images are written to work_dir: the one running in
+    ota_0 and a new build of it, with code inserted part way and every
+    address after the insertion moved. ota_pack.py packs the new image and
+    makes a delta against the running one, as for a release, and the files
+    are served as http://ota.local/<name>. Flash, the OTA calls and the HTTP
+    client are in-memory stand-ins below (tinfl, SHA-256: stubs/). Each case
+    runs ota_package_download like the OTA task does and checks
+    - the URLs it fetched,
+    - its result,
+    - ota_1 holds the new image byte for byte and is set for boot, or on
+      failure that nothing was set for boot;
+    the successful cases are repeated for reads of 1, 7, 1460, 4096 and
+    random sizes.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "esp_timer.h"
+#include "ota_priv.h"
+}
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                       \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                              \
+      printf(__VA_ARGS__);                                                     \
+      printf("\n");                                                            \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static constexpr uint32_t SLOT_SIZE = 512 * 1024;
+static constexpr uint32_t SECTOR_SIZE = 4096;
+static constexpr size_t APP_DESC_OFFSET =
+    sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t);
+static const char *URL = "http://ota.local/new.bin";
+
+/* ---------- Flash and OTA ---------- */
+
+// NOR flash: erasing sets 0xFF, writing can only clear bits
+struct Slot {
+  esp_partition_t part;
+  std::vector<uint8_t> data;
+};
+
+static Slot slots[2] = {
+    {{nullptr, ESP_PARTITION_TYPE_APP, 0x10, 0x10000, SLOT_SIZE, SECTOR_SIZE,
+      "ota_0", false, false}, {}},
+    {{nullptr, ESP_PARTITION_TYPE_APP, 0x11, 0x10000 + SLOT_SIZE, SLOT_SIZE,
+      SECTOR_SIZE, "ota_1", false, false}, {}},
+};
+
+static struct {
+  esp_ota_handle_t handle; // 0 when none is open
+  uint32_t written;
+  uint32_t erased; // sectors are erased as sequential writes reach them
+  int begins;
+  int aborts;
+  const esp_partition_t *boot;
+} ota;
+
+static Slot *slot_of(const esp_partition_t *p) {
+  for (Slot &s : slots)
+    if (&s.part == p)
+      return &s;
+  return nullptr;
+}
+
+extern "C" esp_err_t esp_partition_read(const esp_partition_t *partition,
+                                        size_t src_offset, void *dst,
+                                        size_t size) {
+  Slot *s = slot_of(partition);
+  if (!s || src_offset > s->data.size() || size > s->data.size() - src_offset)
+    return ESP_ERR_INVALID_ARG;
+  memcpy(dst, s->data.data() + src_offset, size);
+  return ESP_OK;
+}
+
+extern "C" const esp_partition_t *esp_ota_get_running_partition(void) {
+  return &slots[0].part;
+}
+
+extern "C" const esp_partition_t *
+esp_ota_get_next_update_partition(const esp_partition_t *start_from) {
+  return start_from ? nullptr : &slots[1].part;
+}
+
+extern "C" esp_err_t
+esp_ota_get_partition_description(const esp_partition_t *partition,
+                                  esp_app_desc_t *app_desc) {
+  if (esp_partition_read(partition, APP_DESC_OFFSET, app_desc,
+                         sizeof(*app_desc)) != ESP_OK)
+    return ESP_ERR_INVALID_ARG;
+  return app_desc->magic_word == ESP_APP_DESC_MAGIC_WORD ? ESP_OK
+                                                         : ESP_ERR_NOT_FOUND;
+}
+
+extern "C" esp_err_t esp_ota_begin(const esp_partition_t *partition,
+                                   size_t image_size,
+                                   esp_ota_handle_t *out_handle) {
+  CHECK(ota.handle == 0, "esp_ota_begin with a handle open");
+  CHECK(image_size == OTA_WITH_SEQUENTIAL_WRITES, "image size %zu", image_size);
+  if (partition != &slots[1].part)
+    return ESP_ERR_OTA_PARTITION_CONFLICT;
+  ota.handle = ++ota.begins;
+  ota.written = 0;
+  ota.erased = 0;
+  *out_handle = ota.handle;
+  return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data,
+                                   size_t size) {
+  if (handle == 0 || handle != ota.handle)
+    return ESP_ERR_INVALID_ARG;
+  std::vector<uint8_t> &flash = slots[1].data;
+  if (size > flash.size() - ota.written)
+    return ESP_ERR_INVALID_SIZE;
+  while (ota.erased < ota.written + size) {
+    std::fill_n(flash.begin() + ota.erased, SECTOR_SIZE, 0xFF);
+    ota.erased += SECTOR_SIZE;
+  }
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++)
+    flash[ota.written + i] &= p[i];
+  ota.written += size;
+  return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+  if (handle == 0 || handle != ota.handle)
+    return ESP_ERR_INVALID_ARG;
+  ota.handle = 0;
+  esp_app_desc_t desc;
+  if (ota.written < APP_DESC_OFFSET + sizeof(desc) ||
+      slots[1].data[0] != ESP_IMAGE_HEADER_MAGIC ||
+      esp_ota_get_partition_description(&slots[1].part, &desc) != ESP_OK)
+    return ESP_ERR_OTA_VALIDATE_FAILED;
+  return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+  if (handle == 0 || handle != ota.handle)
+    return ESP_ERR_INVALID_ARG;
+  ota.handle = 0;
+  ota.aborts++;
+  return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition) {
+  CHECK(ota.handle == 0, "boot partition set with a handle open");
+  ota.boot = partition;
+  return ESP_OK;
+}
+
+/* ---------- HTTP ---------- */
+
+static std::map<std::string, std::vector<uint8_t>> www;
+static std::vector<std::string> requested;
+static size_t read_size; // most bytes a read returns, 0 for random
+static std::mt19937 rng;
+
+struct esp_http_client {
+  std::string url;
+  const std::vector<uint8_t> *body;
+  size_t pos;
+  bool open;
+};
+
+extern "C" esp_http_client_handle_t
+esp_http_client_init(const esp_http_client_config_t *config) {
+  return new esp_http_client{config->url, nullptr, 0, false};
+}
+
+extern "C" esp_err_t esp_http_client_open(esp_http_client_handle_t client,
+                                          int write_len) {
+  CHECK(write_len == 0, "open for a %d byte request body", write_len);
+  requested.push_back(client->url);
+  std::string prefix = "http://ota.local/";
+  if (client->url.compare(0, prefix.size(), prefix) != 0)
+    return ESP_ERR_HTTP_CONNECT;
+  auto it = www.find(client->url.substr(prefix.size()));
+  client->body = it == www.end() ? nullptr : &it->second;
+  client->open = true;
+  return ESP_OK;
+}
+
+extern "C" int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+  return client->body ? int64_t(client->body->size()) : 0;
+}
+
+extern "C" int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+  return client->body ? 200 : 404;
+}
+
+extern "C" int esp_http_client_read(esp_http_client_handle_t client,
+                                    char *buffer, int len) {
+  CHECK(client->open, "read from a closed client");
+  if (!client->body || len <= 0)
+    return 0;
+  size_t n = read_size ? read_size : std::uniform_int_distribution<size_t>(1, 2000)(rng);
+  n = std::min({n, size_t(len), client->body->size() - client->pos});
+  memcpy(buffer, client->body->data() + client->pos, n);
+  client->pos += n;
+  return int(n);
+}
+
+extern "C" bool
+esp_http_client_is_complete_data_received(esp_http_client_handle_t client) {
+  return client->body && client->pos == client->body->size();
+}
+
+extern "C" esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+  client->open = false;
+  return ESP_OK;
+}
+
+extern "C" esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+  CHECK(!client->open, "cleanup of an open client");
+  delete client;
+  return ESP_OK;
+}
+
+/* ---------- Progress ---------- */
+
+static int progress_final;
+
+extern "C" void ota_progress_init(ota_progress_state_t *s) {
+  memset(s, 0, sizeof(*s));
+  s->start_us = esp_timer_get_time();
+}
+
+extern "C" void ota_progress_update(ota_progress_state_t *, int32_t, int32_t,
+                                    bool final) {
+  progress_final += final;
+}
+
+/* ---------- Images ---------- */
+
+// Code words drawn from a small vocabulary, every 16th one the address of
+// another word, so that a build differs from the last mostly by moved
+// addresses
+static std::vector<uint8_t> make_image(const char *version, uint8_t elf_sha,
+                                       size_t insert_at, size_t insert_len) {
+  const size_t code_words = 50000;
+  const uint32_t load_addr = 0x400d0020;
+  std::mt19937 gen(1);
+  std::vector<uint32_t> vocab(256);
+  for (uint32_t &w : vocab)
+    w = gen();
+  std::vector<uint32_t> code;
+  for (size_t i = 0; i < code_words; i++) {
+    if (i == insert_at)
+      for (size_t k = 0; k < insert_len; k++)
+        code.push_back(0x1000 + uint32_t(k) * 3);
+    if (i % 16 == 0) {
+      // An address of a word of the original code, moved by the insertion
+      size_t target = gen() % code_words;
+      if (target >= insert_at)
+        target += insert_len;
+      code.push_back(load_addr + uint32_t(target) * 4);
+    } else {
+      code.push_back(vocab[gen() % (i % 3 ? 16 : 256)]);
+    }
+  }
+
+  esp_image_header_t h = {};
+  h.magic = ESP_IMAGE_HEADER_MAGIC;
+  h.segment_count = 1;
+  h.entry_addr = load_addr;
+  h.hash_appended = 1;
+  esp_app_desc_t desc = {};
+  desc.magic_word = ESP_APP_DESC_MAGIC_WORD;
+  snprintf(desc.version, sizeof(desc.version), "%s", version);
+  snprintf(desc.project_name, sizeof(desc.project_name), "ship-panel");
+  snprintf(desc.idf_ver, sizeof(desc.idf_ver), "v5.3");
+  for (size_t i = 0; i < sizeof(desc.app_elf_sha256); i++)
+    desc.app_elf_sha256[i] = uint8_t(elf_sha + i * 17);
+  esp_image_segment_header_t seg = {load_addr - 0x20,
+                                    uint32_t(sizeof(desc) + code.size() * 4)};
+
+  std::vector<uint8_t> image(sizeof(h) + sizeof(seg) + seg.data_len);
+  uint8_t *p = image.data();
+  memcpy(p, &h, sizeof(h));
+  memcpy(p += sizeof(h), &seg, sizeof(seg));
+  memcpy(p += sizeof(seg), &desc, sizeof(desc));
+  memcpy(p += sizeof(desc), code.data(), code.size() * 4);
+  return image;
+}
+
+static bool write_file(const std::string &path, const std::vector<uint8_t> &data) {
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+static bool read_file(const std::string &path, std::vector<uint8_t> &data) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  data.clear();
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static bool run(const std::string &cmd) {
+  printf("%s\n", cmd.c_str());
+  fflush(stdout);
+  return system(cmd.c_str()) == 0;
+}
+
+/* ---------- Cases ---------- */
+
+static std::vector<uint8_t> base, image;
+static esp_err_t validate_result;
+
+static esp_err_t validate(esp_app_desc_t *desc) {
+  CHECK(strcmp(desc->version, "1.1.0") == 0, "validate got version %.32s",
+        desc->version);
+  return validate_result;
+}
+
+// Runs one update into a passive slot that still holds an old image
+static esp_err_t update(const char *what) {
+  slots[0].data.assign(SLOT_SIZE, 0xFF);
+  std::copy(base.begin(), base.end(), slots[0].data.begin());
+  std::vector<uint8_t> running = slots[0].data;
+  slots[1].data.assign(SLOT_SIZE, 0x5A);
+  ota = {};
+  requested.clear();
+  progress_final = 0;
+  esp_http_client_config_t config = {};
+  config.url = URL;
+  esp_err_t err = ota_package_download(&config, validate);
+  CHECK(ota.handle == 0, "%s: OTA handle left open", what);
+  CHECK(slots[0].data == running, "%s: running slot changed", what);
+  return err;
+}
+
+// finals: downloads that ran to the end, verified or not
+static void expect_image(const char *what, size_t reads, int finals = 1) {
+  std::vector<uint8_t> &flash = slots[1].data;
+  CHECK(ota.boot == &slots[1].part, "%s, reads of %zu: ota_1 not set for boot",
+        what, reads);
+  CHECK(ota.written == image.size(), "%s, reads of %zu: %u bytes written, not %zu",
+        what, reads, unsigned(ota.written), image.size());
+  auto diff = std::mismatch(image.begin(), image.end(), flash.begin());
+  CHECK(diff.first == image.end(), "%s, reads of %zu: ota_1 differs at %zd",
+        what, reads, diff.first - image.begin());
+  CHECK(progress_final == finals, "%s: %d final progress updates", what,
+        progress_final);
+}
+
+static void expect_requests(const char *what, std::vector<std::string> urls) {
+  std::string got;
+  for (const std::string &u : requested)
+    got += " " + u;
+  CHECK(requested == urls, "%s: fetched%s", what, got.c_str());
+}
+
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    fprintf(stderr, "usage: %s python ota_pack.py work_dir\n", argv[0]);
+    return 2;
+  }
+  std::string pack = std::string("'") + argv[1] + "' '" + argv[2] + "'";
+  std::string dir = argv[3];
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir + "/www");
+
+  // The release: 1.1.0 inserts 3000 words a third of the way into 1.0.0.
+  // other.bin differs from base.bin after the app descriptor only, so it
+  // asks for the same delta URL.
+  base = make_image("1.0.0", 0x10, 0, 0);
+  image = make_image("1.1.0", 0x20, 16000, 3000);
+  std::vector<uint8_t> other = base;
+  other[other.size() / 2] ^= 0x01;
+  if (!write_file(dir + "/base.bin", base) || !write_file(dir + "/new.bin", image) ||
+      !write_file(dir + "/other.bin", other) ||
+      !run(pack + " pack '" + dir + "/new.bin' -o '" + dir + "/www/new.bin'") ||
+      !run(pack + " delta '" + dir + "/base.bin' '" + dir + "/new.bin' --url-dir '" +
+           dir + "/www'") ||
+      !run(pack + " delta '" + dir + "/other.bin' '" + dir + "/new.bin' -o '" +
+           dir + "/other.delta'")) {
+    fprintf(stderr, "cannot build the packages in %s\n", dir.c_str());
+    return 2;
+  }
+  char from[16];
+  snprintf(from, sizeof(from), ".from-%02x%02x%02x%02x",
+           base[APP_DESC_OFFSET + 144], base[APP_DESC_OFFSET + 145],
+           base[APP_DESC_OFFSET + 146], base[APP_DESC_OFFSET + 147]);
+  const std::string delta_name = std::string("new.bin") + from;
+  std::vector<uint8_t> full, delta, other_delta;
+  if (!read_file(dir + "/www/new.bin", full) ||
+      !read_file(dir + "/www/" + delta_name, delta) ||
+      !read_file(dir + "/other.delta", other_delta)) {
+    fprintf(stderr, "ota_pack.py did not write %s\n", delta_name.c_str());
+    return 2;
+  }
+  printf("image %zu bytes, package %zu, delta %zu\n", image.size(),
+         full.size(), delta.size());
+  CHECK(delta.size() < full.size() / 4, "delta of %zu bytes is no help",
+        delta.size());
+  const std::string full_url = URL;
+  const std::string delta_url = full_url + from;
+
+  struct Served {
+    const char *what;
+    const std::vector<uint8_t> *full; // new.bin
+    const std::vector<uint8_t> *delta; // new.bin.from-..., or none
+    std::vector<std::string> urls;
+  };
+  const std::vector<Served> good = {
+      {"delta", &full, &delta, {delta_url}},
+      {"full package", &full, nullptr, {delta_url, full_url}},
+      {"plain image", &image, nullptr, {delta_url, full_url}},
+      {"delta for another image", &full, &other_delta, {delta_url, full_url}},
+  };
+  for (size_t reads : {1, 7, 1460, 4096, 0}) {
+    read_size = reads;
+    rng.seed(reads + 1);
+    for (const Served &s : good) {
+      www = {{"new.bin", *s.full}};
+      if (s.delta)
+        www[delta_name] = *s.delta;
+      validate_result = ESP_OK;
+      esp_err_t err = update(s.what);
+      CHECK(err == ESP_OK, "%s, reads of %zu: %s", s.what, reads,
+            esp_err_to_name(err));
+      expect_image(s.what, reads);
+      expect_requests(s.what, s.urls);
+    }
+  }
+
+  // A delta that does not rebuild the image in its header is written in
+  // full, fails the SHA-256 and is aborted, then the full package applies
+  read_size = 1460;
+  std::vector<uint8_t> bad_delta = delta;
+  bad_delta[offsetof(ota_pkg_header_t, image_sha256)] ^= 0x01;
+  www = {{"new.bin", full}, {delta_name, bad_delta}};
+  esp_err_t err = update("corrupt delta");
+  CHECK(err == ESP_OK, "corrupt delta: %s", esp_err_to_name(err));
+  expect_image("corrupt delta", read_size, 2);
+  expect_requests("corrupt delta", {delta_url, full_url});
+
+  // Failures must leave the boot partition alone
+  struct Failing {
+    const char *what;
+    std::vector<uint8_t> full;
+    esp_err_t expected; // ESP_FAIL: any error
+    std::vector<std::string> urls;
+  };
+  std::vector<uint8_t> corrupt = full, truncated = full, no_image = full;
+  corrupt[corrupt.size() / 2] ^= 0x40;
+  truncated.resize(full.size() / 2);
+  no_image[0] ^= 0xFF;
+  const std::vector<Failing> bad = {
+      {"corrupt package", corrupt, ESP_FAIL, {delta_url, full_url}},
+      {"truncated package", truncated, ESP_ERR_INVALID_SIZE,
+       {delta_url, full_url}},
+      {"not a package", no_image, ESP_ERR_OTA_VALIDATE_FAILED,
+       {delta_url, full_url}},
+      {"missing", {}, ESP_ERR_NOT_FOUND, {delta_url, full_url}},
+  };
+  for (const Failing &f : bad) {
+    www.clear();
+    if (!f.full.empty())
+      www["new.bin"] = f.full;
+    validate_result = ESP_OK;
+    err = update(f.what);
+    CHECK(f.expected == ESP_FAIL ? err != ESP_OK : err == f.expected,
+          "%s: %s", f.what, esp_err_to_name(err));
+    CHECK(ota.boot == nullptr, "%s: a boot partition was set", f.what);
+    expect_requests(f.what, f.urls);
+  }
+
+  // A rejected version stops before anything is written, without a fallback
+  www = {{"new.bin", full}, {delta_name, delta}};
+  validate_result = ESP_ERR_INVALID_VERSION;
+  err = update("rejected version");
+  CHECK(err == ESP_ERR_INVALID_VERSION, "rejected version: %s",
+        esp_err_to_name(err));
+  CHECK(ota.begins == 0, "rejected version: esp_ota_begin called");
+  CHECK(ota.boot == nullptr, "rejected version: a boot partition was set");
+  expect_requests("rejected version", {delta_url});
+
+  printf("%s: %d failures\n", failures ? "FAILED" : "passed", failures);
+  return failures ? 1 : 0;
+}
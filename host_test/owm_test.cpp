@@ -0,0 +1,227 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    OwmParser against weather.json and a malformed-input corpus.
+
+    owm_test weather.json corpus_dir [mutations]
+
+    - weather.json must give the expected fields, however the body is split
+      into chunks: every chunk size, and every split into two chunks.
+    - Corpus files named ok-* must give the same fields as weather.json;
+      every other file must be rejected by finish().
+    - Mutations: weather.json with random bytes flipped, inserted, deleted
+      or cut off, a fixed seed so failures repeat. Any input must give the
+      same result whole and byte by byte.
+    Built with the address and undefined behaviour sanitizers, so an out of
+    bounds access fails the test as well.
+*/
+
+#include "apps/weather/OwmParser.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace ship;
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                       \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                              \
+      printf(__VA_ARGS__);                                                     \
+      printf("\n");                                                            \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+struct Result {
+  bool ok;
+  OwmWeather weather;
+
+  bool operator==(const Result &o) const {
+    return ok == o.ok && (!ok || weather == o.weather);
+  }
+};
+
+static bool read_file(const std::string &path, std::string &out) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  char buf[4096];
+  size_t n;
+  out.clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    out.append(buf, n);
+  fclose(f);
+  return true;
+}
+
+// Feeds body in pieces of chunk bytes, the first one first bytes long
+static Result parse(OwmParser &p, const std::string &body, size_t chunk,
+                    size_t first = 0) {
+  p.reset();
+  size_t i = 0;
+  if (first) {
+    p.feed(body.data(), std::min(first, body.size()));
+    i = std::min(first, body.size());
+  }
+  for (; i < body.size(); i += chunk)
+    p.feed(body.data() + i, std::min(chunk, body.size() - i));
+  return {p.finish(), p.weather()};
+}
+
+static Result parse(OwmParser &p, const std::string &body) {
+  return parse(p, body, body.size() ? body.size() : 1);
+}
+
+static void test_reference(OwmParser &p, const std::string &body,
+                           OwmWeather &reference) {
+  Result r = parse(p, body);
+  const OwmWeather &w = r.weather;
+  CHECK(r.ok, "weather.json rejected");
+  CHECK(p.status() == 200, "cod %u", p.status());
+  CHECK(w.temp == 20.9f && w.feels_like == 21.53f, "temp %g / %g", w.temp,
+        w.feels_like);
+  CHECK(w.humidity == 95 && w.pressure == 1012, "humidity %g, pressure %g",
+        w.humidity, w.pressure);
+  CHECK(w.wind_speed == 2.33f && w.wind_deg == 28 && w.wind_gust == 4.45f,
+        "wind %g %g %g", w.wind_speed, w.wind_deg, w.wind_gust);
+  CHECK(w.condition == 804 && strcmp(w.icon, "04n") == 0 && w.is_night(),
+        "condition %u icon %s", w.condition, w.icon);
+  CHECK(w.dt == 1669231333, "dt %u", unsigned(w.dt));
+  reference = w;
+
+  for (size_t chunk = 1; chunk <= body.size(); chunk++)
+    CHECK(parse(p, body, chunk) == r, "differs in chunks of %zu", chunk);
+  for (size_t split = 1; split < body.size(); split++)
+    CHECK(parse(p, body, body.size(), split) == r, "differs split at %zu",
+          split);
+}
+
+static void test_variants(OwmParser &p, const std::string &body) {
+  // Missing optional fields stay NAN, a second weather[] entry is ignored
+  Result r = parse(p, R"({"weather":[{"id":500,"icon":"10d"},{"id":701,"icon":"50d"}],)"
+                      R"("main":{"temp":-3.5},"cod":200})");
+  CHECK(r.ok && r.weather.temp == -3.5f && r.weather.condition == 500 &&
+            strcmp(r.weather.icon, "10d") == 0 && std::isnan(r.weather.humidity) &&
+            std::isnan(r.weather.wind_gust),
+        "minimal response");
+
+  // Keys of the same name deeper down do not overwrite the sections
+  r = parse(p, R"({"main":{"temp":1,"x":{"temp":99}},"sys":{"main":{"temp":98}},)"
+               R"("weather":[{"id":800,"icon":"01d","x":[{"id":1}]}],"cod":200})");
+  CHECK(r.ok && r.weather.temp == 1 && r.weather.condition == 800,
+        "nested keys: temp %g condition %u", r.weather.temp, r.weather.condition);
+
+  // Out of range numbers saturate instead of wrapping
+  r = parse(p, R"({"weather":[{"id":-5}],"main":{"temp":1e999},"dt":1e30,"cod":200})");
+  CHECK(r.ok && r.weather.condition == 0 && std::isinf(r.weather.temp) &&
+            r.weather.dt == UINT32_MAX,
+        "out of range: condition %u dt %u", r.weather.condition,
+        unsigned(r.weather.dt));
+
+  // A trailing newline after the body is fine
+  CHECK(parse(p, body + "\r\n").ok, "trailing newline");
+}
+
+static void test_corpus(OwmParser &p, const char *dir,
+                        const OwmWeather &reference) {
+  std::vector<std::filesystem::path> files;
+  for (auto &e : std::filesystem::directory_iterator(dir))
+    files.push_back(e.path());
+  std::sort(files.begin(), files.end());
+
+  for (auto &path : files) {
+    std::string body;
+    std::string name = path.filename().string();
+    CHECK(read_file(path.string(), body), "cannot read %s", name.c_str());
+    Result r = parse(p, body);
+    if (name.rfind("ok-", 0) == 0)
+      CHECK(r.ok && r.weather == reference, "%s not parsed like weather.json",
+            name.c_str());
+    else
+      CHECK(!r.ok, "%s accepted", name.c_str());
+    CHECK(parse(p, body, 1) == r, "%s differs byte by byte", name.c_str());
+    CHECK(parse(p, body, 7) == r, "%s differs in chunks of 7", name.c_str());
+  }
+  printf("corpus: %zu files\n", files.size());
+}
+
+static void test_mutations(OwmParser &p, const std::string &body, int count) {
+  std::mt19937 rng(36);
+  int accepted = 0;
+  for (int i = 0; i < count; i++) {
+    std::string m = body;
+    int edits = 1 + rng() % 4;
+    for (int e = 0; e < edits && !m.empty(); e++) {
+      size_t at = rng() % m.size();
+      switch (rng() % 5) {
+      case 0: m[at] ^= char(1 << (rng() % 8)); break;
+      case 1: m[at] = char(rng()); break;
+      case 2: m.insert(at, 1, "{}[]\",:\\0e-."[rng() % 12]); break;
+      case 3: m.erase(at, 1 + rng() % 8); break;
+      default: m.resize(at); break;
+      }
+    }
+    Result r = parse(p, m);
+    accepted += r.ok;
+    size_t chunk = 1 + rng() % 16;
+    if (!(parse(p, m, 1) == r) || !(parse(p, m, chunk) == r)) {
+      CHECK(false, "mutation %d differs when chunked", i);
+      break;
+    }
+  }
+  printf("mutations: %d inputs, %d still accepted\n", count, accepted);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s weather.json corpus_dir [mutations]\n", argv[0]);
+    return 2;
+  }
+  std::string body;
+  if (!read_file(argv[1], body)) {
+    fprintf(stderr, "Cannot read %s\n", argv[1]);
+    return 2;
+  }
+  int mutations = argc > 3 ? atoi(argv[3]) : 20000;
+
+  static OwmParser parser; // as in Weather, not on the stack
+  OwmWeather reference;
+  test_reference(parser, body, reference);
+  test_variants(parser, body);
+  test_corpus(parser, argv[2], reference);
+  test_mutations(parser, body, mutations);
+
+  printf("%s: %d failures\n", failures ? "FAILED" : "passed", failures);
+  return failures ? 1 : 0;
+}
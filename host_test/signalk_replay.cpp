@@ -0,0 +1,289 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    Replays a Signal K delta stream through SignalK and checks ShipModel.
+
+    signalk_replay stream.jsonl
+
+    The stream holds one WebSocket message per line, as a server sends them
+    to a vessels.self subscription (hello, meta, deltas with sources, object
+    values, nulls, notifications); a live server's stream can be saved with
+      websocat 'ws://host:3000/signalk/v1/stream?subscribe=self' > file
+    but the expected values below are those of signalk-sailing.jsonl.
+    stubs/esp_websocket_client.h stands in for the client: each message is
+    delivered as data events, split into
+    - one frame in one chunk,
+    - one frame in chunks of 1, 2, 3, 7, 64 and 1024 bytes,
+    - 1 to 4 frames (text then continuations) of random sizes, cut into
+      random chunks, with pongs between the frames, 20 fixed seeds.
+    Every split must parse without error and make exactly the same model
+    updates as the whole messages, ending on the last value of each path.
+*/
+
+#include "ShipModel.hpp"
+#include "signalk/SignalK.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace ship;
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                       \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                              \
+      printf(__VA_ARGS__);                                                     \
+      printf("\n");                                                            \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static constexpr double RAD_TO_DEG = 57.29577951308232;
+static constexpr double MS_TO_KNOTS = 1.9438444924406;
+
+// Sizes of the chunks of each frame of a message
+using Split = std::vector<std::vector<size_t>>;
+using Splitter = std::function<Split(size_t len)>;
+
+struct Update {
+  int field;
+  double value;
+
+  bool operator==(const Update &o) const {
+    return field == o.field &&
+           (value == o.value || (std::isnan(value) && std::isnan(o.value)));
+  }
+};
+
+static std::vector<Update> trace;
+
+struct Field {
+  const char *name;
+  Observable<float> *value;
+  double expected; // last value of the path in the stream
+};
+
+static std::vector<Field> fields() {
+  ShipModel &m = ShipModel::instance();
+  // The stream ends on a null depth, which must leave the previous one
+  return {
+      {"cog", &m.cog, 4.2774 * RAD_TO_DEG},
+      {"sog", &m.sog, 2.71 * MS_TO_KNOTS},
+      {"heading", &m.heading, 4.4048 * RAD_TO_DEG},
+      {"depth", &m.depth, 14.51},
+      {"wind_angle", &m.wind_angle, 0.8367 * RAD_TO_DEG},
+      {"wind_speed", &m.wind_speed, 6.15 * MS_TO_KNOTS},
+      {"water_temp", &m.water_temp, 283.62},
+      {"air_temp", &m.air_temp, 285.29},
+      {"pressure", &m.pressure, 101834.5},
+      {"rudder_angle", &m.rudder_angle, -0.0124 * RAD_TO_DEG},
+      {"engine_rpm", &m.engine_rpm, 30.67 * 60},
+      {"engine_temp", &m.engine_temp, 308.0},
+      {"battery_voltage", &m.battery_voltage, 12.93},
+      {"battery_current", &m.battery_current, 18.5},
+  };
+}
+
+static constexpr double EXPECTED_LATITUDE = 50.7706156;
+static constexpr double EXPECTED_LONGITUDE = -1.2966378;
+
+static bool read_lines(const char *path, std::vector<std::string> &lines) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  std::string line;
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    if (c != '\n') {
+      line += char(c);
+    } else if (!line.empty()) {
+      lines.push_back(line);
+      line.clear();
+    }
+  }
+  if (!line.empty())
+    lines.push_back(line);
+  fclose(f);
+  return true;
+}
+
+static void emit_data(uint8_t op_code, const char *data, size_t len,
+                      size_t payload_len, size_t offset, bool fin) {
+  esp_websocket_event_data_t ev = {};
+  ev.data_ptr = data;
+  ev.data_len = len;
+  ev.fin = fin;
+  ev.op_code = op_code;
+  ev.payload_len = payload_len;
+  ev.payload_offset = offset;
+  host_websocket_emit(WEBSOCKET_EVENT_DATA, &ev);
+}
+
+static void deliver(const std::string &msg, const Split &split, bool pongs) {
+  size_t pos = 0;
+  for (size_t f = 0; f < split.size(); f++) {
+    size_t frame_len = 0;
+    for (size_t n : split[f])
+      frame_len += n;
+    uint8_t op_code = f == 0 ? 0x01 : 0x00; // text, then continuations
+    bool fin = f + 1 == split.size();
+    size_t offset = 0;
+    for (size_t n : split[f]) {
+      emit_data(op_code, msg.data() + pos + offset, n, frame_len, offset, fin);
+      offset += n;
+    }
+    pos += frame_len;
+    // Control frames may come between the frames of a message
+    if (pongs && !fin)
+      emit_data(0x0A, "ping", 4, 4, 0, true);
+  }
+}
+
+static void reset_model() {
+  ShipModel &m = ShipModel::instance();
+  for (const Field &f : fields())
+    f.value->set(NAN);
+  m.latitude.set(NAN);
+  m.longitude.set(NAN);
+  trace.clear();
+}
+
+static void check_model(const char *what) {
+  ShipModel &m = ShipModel::instance();
+  for (const Field &f : fields()) {
+    float v = f.value->get();
+    CHECK(std::fabs(v - f.expected) <= 1e-4 * std::max(1.0, std::fabs(f.expected)),
+          "%s: %s is %g, expected %g", what, f.name, v, f.expected);
+  }
+  CHECK(m.latitude.get() == EXPECTED_LATITUDE, "%s: latitude is %.7f", what,
+        m.latitude.get());
+  CHECK(m.longitude.get() == EXPECTED_LONGITUDE, "%s: longitude is %.7f",
+        what, m.longitude.get());
+}
+
+static void replay(SignalK &sk, const std::vector<std::string> &lines,
+                   const char *what, const Splitter &splitter, bool pongs,
+                   const std::vector<Update> *reference) {
+  reset_model();
+  uint32_t deltas = sk.deltas();
+  uint32_t errors = sk.parse_errors();
+  for (const std::string &line : lines)
+    deliver(line, splitter(line.size()), pongs);
+
+  CHECK(sk.parse_errors() == errors, "%s: %u parse errors", what,
+        sk.parse_errors() - errors);
+  CHECK(sk.deltas() - deltas == lines.size(), "%s: %u of %zu messages parsed",
+        what, sk.deltas() - deltas, lines.size());
+  check_model(what);
+  if (reference)
+    CHECK(trace == *reference, "%s: %zu model updates, whole messages made %zu%s",
+          what, trace.size(), reference->size(),
+          trace.size() == reference->size() ? ", different ones" : "");
+}
+
+static Split chunks_of(size_t len, size_t n) {
+  std::vector<size_t> chunks;
+  for (size_t pos = 0; pos < len; pos += n)
+    chunks.push_back(std::min(n, len - pos));
+  return {chunks};
+}
+
+static Split random_split(size_t len, std::mt19937 &rng) {
+  // Cut points for up to 4 frames; empty frames are not sent
+  std::vector<size_t> cuts = {0, len};
+  int frames = std::uniform_int_distribution<int>(1, 4)(rng);
+  for (int i = 1; i < frames; i++)
+    cuts.push_back(std::uniform_int_distribution<size_t>(1, len - 1)(rng));
+  std::sort(cuts.begin(), cuts.end());
+  cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+  Split split;
+  std::uniform_int_distribution<size_t> chunk(1, 1024);
+  for (size_t i = 0; i + 1 < cuts.size(); i++) {
+    std::vector<size_t> chunks;
+    for (size_t pos = cuts[i]; pos < cuts[i + 1];) {
+      size_t n = std::min(chunk(rng) >> (chunk(rng) % 10), cuts[i + 1] - pos);
+      n = std::max<size_t>(n, 1);
+      chunks.push_back(n);
+      pos += n;
+    }
+    split.push_back(chunks);
+  }
+  return split;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s stream.jsonl\n", argv[0]);
+    return 2;
+  }
+  std::vector<std::string> lines;
+  if (!read_lines(argv[1], lines) || lines.empty()) {
+    fprintf(stderr, "cannot read %s\n", argv[1]);
+    return 2;
+  }
+
+  ShipModel &m = ShipModel::instance();
+  std::vector<Field> fs = fields();
+  for (size_t i = 0; i < fs.size(); i++)
+    fs[i].value->subscribe([i](const float &v) { trace.push_back({int(i), v}); });
+  int lat = fs.size(), lon = fs.size() + 1;
+  m.latitude.subscribe([lat](const double &v) { trace.push_back({lat, v}); });
+  m.longitude.subscribe([lon](const double &v) { trace.push_back({lon, v}); });
+
+  SignalK sk("ws://signalk.local:3000/signalk/v1/stream?subscribe=none");
+  CHECK(sk.start() == ESP_OK, "SignalK did not start");
+  host_websocket_emit(WEBSOCKET_EVENT_CONNECTED, nullptr);
+  CHECK(host_websocket_sent.find("\"navigation.position\"") != std::string::npos,
+        "position not subscribed: %s", host_websocket_sent.c_str());
+
+  replay(sk, lines, "whole", [](size_t len) { return Split{{len}}; }, false,
+         nullptr);
+  std::vector<Update> reference = trace;
+  printf("%zu messages, %zu model updates\n", lines.size(), reference.size());
+
+  char what[32];
+  for (size_t n : {1, 2, 3, 7, 64, 1024}) {
+    snprintf(what, sizeof(what), "chunks of %zu", n);
+    replay(sk, lines, what, [n](size_t len) { return chunks_of(len, n); },
+           false, &reference);
+  }
+  for (unsigned seed = 1; seed <= 20; seed++) {
+    std::mt19937 rng(seed);
+    snprintf(what, sizeof(what), "frames, seed %u", seed);
+    replay(sk, lines, what, [&rng](size_t len) { return random_split(len, rng); },
+           true, &reference);
+  }
+
+  printf("%s: %d failures\n", failures ? "FAILED" : "passed", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,45 @@
+/* Host stand-in: the app image layout, as in ESP-IDF */
+#pragma once
+#include <stdint.h>
+
+#define ESP_IMAGE_HEADER_MAGIC 0xE9
+#define ESP_APP_DESC_MAGIC_WORD 0xABCD5432
+
+typedef struct __attribute__((packed)) {
+  uint8_t magic;
+  uint8_t segment_count;
+  uint8_t spi_mode;
+  uint8_t spi_speed : 4;
+  uint8_t spi_size : 4;
+  uint32_t entry_addr;
+  uint8_t wp_pin;
+  uint8_t spi_pin_drv[3];
+  uint16_t chip_id;
+  uint8_t min_chip_rev;
+  uint16_t min_chip_rev_full;
+  uint16_t max_chip_rev_full;
+  uint8_t reserved[4];
+  uint8_t hash_appended;
+} esp_image_header_t;
+
+typedef struct {
+  uint32_t load_addr;
+  uint32_t data_len;
+} esp_image_segment_header_t;
+
+typedef struct {
+  uint32_t magic_word;
+  uint32_t secure_version;
+  uint32_t reserv1[2];
+  char version[32];
+  char project_name[32];
+  char time[16];
+  char date[16];
+  char idf_ver[32];
+  uint8_t app_elf_sha256[32];
+  uint16_t min_efuse_blk_rev_full;
+  uint16_t max_efuse_blk_rev_full;
+  uint8_t mmu_page_size;
+  uint8_t reserv3[3];
+  uint32_t reserv2[18];
+} esp_app_desc_t;
@@ -0,0 +1,50 @@
+/* Host stand-in for the ESP-IDF API used by the decoders under test */
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+#define ESP_OK          0
+#define ESP_FAIL        -1
+#define ESP_ERR_NO_MEM  0x101
+#define ESP_ERR_INVALID_ARG   0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE  0x104
+#define ESP_ERR_NOT_FOUND     0x105
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_INVALID_RESPONSE 0x108
+#define ESP_ERR_INVALID_CRC   0x109
+#define ESP_ERR_INVALID_VERSION 0x10A
+
+#define HOST_ERR_NAME(e)                                                       \
+  case e:                                                                      \
+    return #e;
+
+/* The codes above; the others by number, which ESP-IDF would name */
+static inline const char *esp_err_to_name(esp_err_t code) {
+  static char unknown[16];
+  switch (code) {
+    HOST_ERR_NAME(ESP_OK)
+    HOST_ERR_NAME(ESP_FAIL)
+    HOST_ERR_NAME(ESP_ERR_NO_MEM)
+    HOST_ERR_NAME(ESP_ERR_INVALID_ARG)
+    HOST_ERR_NAME(ESP_ERR_INVALID_STATE)
+    HOST_ERR_NAME(ESP_ERR_INVALID_SIZE)
+    HOST_ERR_NAME(ESP_ERR_NOT_FOUND)
+    HOST_ERR_NAME(ESP_ERR_NOT_SUPPORTED)
+    HOST_ERR_NAME(ESP_ERR_INVALID_RESPONSE)
+    HOST_ERR_NAME(ESP_ERR_INVALID_CRC)
+    HOST_ERR_NAME(ESP_ERR_INVALID_VERSION)
+  }
+  snprintf(unknown, sizeof(unknown), "0x%x", (unsigned)code);
+  return unknown;
+}
+
+#define ESP_ERROR_CHECK(x)                                                     \
+  do {                                                                         \
+    esp_err_t err_ = (x);                                                      \
+    if (err_ != ESP_OK) {                                                      \
+      fprintf(stderr, "%s failed: %d\n", #x, err_);                            \
+      abort();                                                                 \
+    }                                                                          \
+  } while (0)
@@ -0,0 +1,28 @@
+/* Host stand-in: an event loop that takes every event and handler and
+   drops them */
+#pragma once
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef const char *esp_event_base_t;
+typedef void *esp_event_handler_instance_t;
+typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t base,
+                                    int32_t id, void *data);
+#define ESP_EVENT_ANY_ID -1
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t const id
+#define ESP_EVENT_DEFINE_BASE(id) esp_event_base_t const id = #id
+
+static inline esp_err_t esp_event_post(esp_event_base_t, int32_t, const void *,
+                                       size_t, uint32_t) {
+  return ESP_OK;
+}
+
+static inline esp_err_t esp_event_handler_register(esp_event_base_t, int32_t,
+                                                   esp_event_handler_t, void *) {
+  return ESP_OK;
+}
+static inline esp_err_t esp_event_handler_unregister(esp_event_base_t, int32_t,
+                                                     esp_event_handler_t) {
+  return ESP_OK;
+}
@@ -0,0 +1,10 @@
+/* Host stand-in: every capability is plain malloc */
+#pragma once
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT    (1 << 2)
+#define MALLOC_CAP_SPIRAM  (1 << 10)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+static inline void *heap_caps_malloc(size_t size, unsigned) { return malloc(size); }
+static inline void heap_caps_free(void *p) { free(p); }
@@ -0,0 +1,17 @@
+/* Host stand-in: logging is dropped, it would only skew the benchmarks.
+   The arguments are still compiled, so they count as used and their
+   formats are checked. */
+#pragma once
+#include <stdio.h>
+
+#define ESP_LOG_DROP(tag, ...)                                                 \
+  do {                                                                         \
+    if (0)                                                                     \
+      printf(__VA_ARGS__);                                                     \
+    (void)(tag);                                                               \
+  } while (0)
+#define ESP_LOGE(tag, ...) ESP_LOG_DROP(tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ESP_LOG_DROP(tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ESP_LOG_DROP(tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ESP_LOG_DROP(tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ESP_LOG_DROP(tag, __VA_ARGS__)
@@ -0,0 +1,34 @@
+/* Host stand-in: a monotonic clock; timers are created but never fire */
+#pragma once
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef void (*esp_timer_cb_t)(void *arg);
+typedef enum { ESP_TIMER_TASK } esp_timer_dispatch_t;
+typedef struct {
+  esp_timer_cb_t callback;
+  void *arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+typedef struct esp_timer *esp_timer_handle_t;
+
+static inline int64_t esp_timer_get_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline esp_err_t esp_timer_create(const esp_timer_create_args_t *,
+                                         esp_timer_handle_t *out) {
+  *out = NULL;
+  return ESP_OK;
+}
+static inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t, uint64_t) {
+  return ESP_OK;
+}
+static inline esp_err_t esp_timer_stop(esp_timer_handle_t) { return ESP_OK; }
+static inline esp_err_t esp_timer_delete(esp_timer_handle_t) { return ESP_OK; }
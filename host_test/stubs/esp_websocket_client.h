@@ -0,0 +1,82 @@
+/* Host stand-in: a client that never connects. The test plays the server
+   through host_websocket_emit(), which calls the registered handler the
+   way the client task does for each received chunk. */
+#pragma once
+#include "esp_event.h"
+#include "freertos/FreeRTOS.h"
+#include <string>
+
+typedef enum {
+  WEBSOCKET_EVENT_ANY = -1,
+  WEBSOCKET_EVENT_ERROR = 0,
+  WEBSOCKET_EVENT_CONNECTED,
+  WEBSOCKET_EVENT_DISCONNECTED,
+  WEBSOCKET_EVENT_DATA,
+  WEBSOCKET_EVENT_CLOSED,
+} esp_websocket_event_id_t;
+
+typedef struct {
+  const char *data_ptr;
+  int data_len;
+  bool fin;
+  uint8_t op_code;
+  void *client;
+  void *user_context;
+  int payload_len;
+  int payload_offset;
+} esp_websocket_event_data_t;
+
+typedef struct {
+  const char *uri;
+  int buffer_size;
+  int reconnect_timeout_ms;
+  int network_timeout_ms;
+} esp_websocket_client_config_t;
+
+struct esp_websocket_client {
+  esp_event_handler_t handler;
+  void *handler_arg;
+};
+typedef struct esp_websocket_client *esp_websocket_client_handle_t;
+
+// The last client created, and what it sent
+inline esp_websocket_client_handle_t host_websocket_client;
+inline std::string host_websocket_sent;
+
+static inline esp_websocket_client_handle_t
+esp_websocket_client_init(const esp_websocket_client_config_t *) {
+  host_websocket_client = new esp_websocket_client{nullptr, nullptr};
+  return host_websocket_client;
+}
+static inline esp_err_t esp_websocket_client_destroy(esp_websocket_client_handle_t client) {
+  if (client == host_websocket_client)
+    host_websocket_client = nullptr;
+  delete client;
+  return ESP_OK;
+}
+static inline esp_err_t esp_websocket_client_start(esp_websocket_client_handle_t) {
+  return ESP_OK;
+}
+static inline esp_err_t esp_websocket_client_stop(esp_websocket_client_handle_t) {
+  return ESP_OK;
+}
+static inline esp_err_t
+esp_websocket_register_events(esp_websocket_client_handle_t client,
+                              esp_websocket_event_id_t, esp_event_handler_t handler,
+                              void *arg) {
+  client->handler = handler;
+  client->handler_arg = arg;
+  return ESP_OK;
+}
+static inline int esp_websocket_client_send_text(esp_websocket_client_handle_t,
+                                                 const char *data, int len,
+                                                 TickType_t) {
+  host_websocket_sent.append(data, len);
+  return len;
+}
+
+static inline void host_websocket_emit(int32_t id, esp_websocket_event_data_t *data) {
+  esp_websocket_client_handle_t c = host_websocket_client;
+  if (c && c->handler)
+    c->handler(c->handler_arg, "WEBSOCKET_EVENTS", id, data);
+}
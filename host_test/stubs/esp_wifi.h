@@ -0,0 +1,6 @@
+/* Host stand-in: only the IP event the clients wait for */
+#pragma once
+#include "esp_event.h"
+
+static esp_event_base_t const IP_EVENT = "IP_EVENT";
+typedef enum { IP_EVENT_STA_GOT_IP } ip_event_t;
@@ -0,0 +1,49 @@
+/* Host stand-in: FreeRTOS queues as a locked deque of fixed-size items */
+#pragma once
+#include "FreeRTOS.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct HostQueue {
+  std::mutex lock;
+  std::condition_variable ready;
+  std::deque<std::vector<uint8_t>> items;
+  size_t length;
+  size_t item_size;
+};
+typedef HostQueue *QueueHandle_t;
+
+static inline QueueHandle_t xQueueCreate(size_t length, size_t item_size) {
+  return new HostQueue{{}, {}, {}, length, item_size};
+}
+static inline void vQueueDelete(QueueHandle_t q) { delete q; }
+
+// Never waits for room; the callers under test only send with 0 ticks
+static inline BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t) {
+  std::lock_guard<std::mutex> guard(q->lock);
+  if (q->items.size() >= q->length)
+    return pdFALSE;
+  const uint8_t *p = static_cast<const uint8_t *>(item);
+  q->items.emplace_back(p, p + q->item_size);
+  q->ready.notify_one();
+  return pdTRUE;
+}
+
+static inline BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> guard(q->lock);
+  auto wait = std::chrono::milliseconds(ticks * portTICK_PERIOD_MS);
+  if (!q->ready.wait_for(guard, wait, [q] { return !q->items.empty(); }))
+    return pdFALSE;
+  memcpy(item, q->items.front().data(), q->item_size);
+  q->items.pop_front();
+  return pdTRUE;
+}
+
+static inline size_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  std::lock_guard<std::mutex> guard(q->lock);
+  return q->items.size();
+}
@@ -0,0 +1,17 @@
+/* Host stand-in: FreeRTOS mutexes as std::mutex */
+#pragma once
+#include "FreeRTOS.h"
+#include <mutex>
+
+typedef std::mutex *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::mutex; }
+static inline void vSemaphoreDelete(SemaphoreHandle_t m) { delete m; }
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t m, TickType_t) {
+  m->lock();
+  return pdTRUE;
+}
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t m) {
+  m->unlock();
+  return pdTRUE;
+}
@@ -0,0 +1,23 @@
+/* Host stand-in: tasks as detached threads. They cannot be deleted, so
+   objects owning a task must live until the program exits. */
+#pragma once
+#include "FreeRTOS.h"
+#include <chrono>
+#include <thread>
+
+typedef void (*TaskFunction_t)(void *);
+typedef std::thread::id *TaskHandle_t;
+
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *,
+                                                 uint32_t, void *arg, unsigned,
+                                                 TaskHandle_t *handle, int) {
+  std::thread t(fn, arg);
+  if (handle)
+    *handle = new std::thread::id(t.get_id());
+  t.detach();
+  return pdPASS;
+}
+static inline void vTaskDelete(TaskHandle_t) {}
+static inline void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
@@ -0,0 +1,16 @@
+/* Host stand-in for newlib extensions missing from older C libraries,
+   force-included by CMakeLists.txt where needed */
+#pragma once
+#include <cstring>
+
+#if !defined(HAVE_STRLCPY)
+static inline size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+#endif
@@ -0,0 +1,27 @@
+/* Host stand-in for the parts of loki-lib's SingletonHolder used in main/:
+   CreateStatic with NoDestroy, built on first use and never destroyed */
+#pragma once
+#include <new>
+
+namespace Loki {
+
+template <class T> struct CreateStatic {
+  static T *Create() {
+    alignas(T) static unsigned char storage[sizeof(T)];
+    return new (storage) T;
+  }
+};
+
+template <class T> struct NoDestroy {};
+
+template <class T, template <class> class CreationPolicy = CreateStatic,
+          template <class> class LifetimePolicy = NoDestroy>
+class SingletonHolder {
+public:
+  static T &Instance() {
+    static T *instance = CreationPolicy<T>::Create();
+    return *instance;
+  }
+};
+
+} // namespace Loki
@@ -0,0 +1,98 @@
+/* Host stand-in: the ROM's tinfl, as far as components/ota uses it, on
+   zlib's raw inflate. Like tinfl, output goes into a circular dictionary of
+   TINFL_LZ_DICT_SIZE bytes and tinfl_decompressor is a plain struct the
+   caller mallocs and frees, so zlib gets its state from an arena inside it. */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+typedef unsigned char mz_uint8;
+typedef unsigned int mz_uint32;
+typedef unsigned int mz_uint;
+
+#define TINFL_LZ_DICT_SIZE 32768
+#define TINFL_FLAG_PARSE_ZLIB_HEADER 1
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+#define TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF 4
+
+typedef enum {
+  TINFL_STATUS_BAD_PARAM = -3,
+  TINFL_STATUS_ADLER32_MISMATCH = -2,
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+#define HOST_TINFL_ARENA_SIZE (64 * 1024)
+
+typedef struct {
+  z_stream zs;
+  int started;
+  size_t arena_used;
+  unsigned char arena[HOST_TINFL_ARENA_SIZE] __attribute__((aligned(16)));
+} tinfl_decompressor;
+
+static inline voidpf host_tinfl_alloc(voidpf opaque, uInt items, uInt size) {
+  tinfl_decompressor *r = (tinfl_decompressor *)opaque;
+  size_t n = ((size_t)items * size + 15) & ~(size_t)15;
+  if (r->arena_used + n > sizeof(r->arena)) {
+    return Z_NULL;
+  }
+  voidpf p = r->arena + r->arena_used;
+  r->arena_used += n;
+  return p;
+}
+
+static inline void host_tinfl_free(voidpf opaque, voidpf address) {
+  (void)opaque;
+  (void)address;
+}
+
+#define tinfl_init(r) ((r)->started = 0, (r)->arena_used = 0)
+
+/* Inflates from pIn_buf_next into pOut_buf_next, which lies inside the
+   dictionary at pOut_buf_start; updates both sizes to the bytes consumed and
+   produced. zlib keeps its own window, but output must continue where the
+   last call left it in the dictionary, as tinfl reads matches from there. */
+static inline tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next,
+                                            size_t *pIn_buf_size, mz_uint8 *pOut_buf_start,
+                                            mz_uint8 *pOut_buf_next, size_t *pOut_buf_size,
+                                            const mz_uint32 decomp_flags) {
+  if (!r->started) {
+    memset(&r->zs, 0, sizeof(r->zs));
+    r->zs.zalloc = host_tinfl_alloc;
+    r->zs.zfree = host_tinfl_free;
+    r->zs.opaque = r;
+    if (inflateInit2(&r->zs, (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15) != Z_OK) {
+      return TINFL_STATUS_BAD_PARAM;
+    }
+    r->started = 1;
+  }
+  if (pOut_buf_next != pOut_buf_start + (r->zs.total_out & (TINFL_LZ_DICT_SIZE - 1)) ||
+      pOut_buf_next + *pOut_buf_size > pOut_buf_start + TINFL_LZ_DICT_SIZE) {
+    return TINFL_STATUS_BAD_PARAM;
+  }
+  r->zs.next_in = (Bytef *)pIn_buf_next;
+  r->zs.avail_in = (uInt)*pIn_buf_size;
+  r->zs.next_out = pOut_buf_next;
+  r->zs.avail_out = (uInt)*pOut_buf_size;
+  int ret = inflate(&r->zs, Z_NO_FLUSH);
+  *pIn_buf_size -= r->zs.avail_in;
+  *pOut_buf_size -= r->zs.avail_out;
+  if (ret == Z_STREAM_END) {
+    return TINFL_STATUS_DONE;
+  }
+  if (ret != Z_OK && ret != Z_BUF_ERROR) {
+    return TINFL_STATUS_FAILED;
+  }
+  if (r->zs.avail_out == 0) {
+    return TINFL_STATUS_HAS_MORE_OUTPUT;
+  }
+  if (!(decomp_flags & TINFL_FLAG_HAS_MORE_INPUT)) {
+    return TINFL_STATUS_FAILED;
+  }
+  return TINFL_STATUS_NEEDS_MORE_INPUT;
+}
@@ -0,0 +1,105 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __BOUND_LABEL_HPP
+#define __BOUND_LABEL_HPP
+
+#include "GuiThread.hpp"
+#include "Observable.hpp"
+#include <array>
+#include <cstring>
+#include <fmt/format.h>
+#include <lvgl.h>
+#include <mutex>
+
+namespace ship {
+
+/**
+ * BoundLabel binds an Observable to an lv_label.
+ *
+ * Each change is formatted into a stack buffer and compared with the text
+ * already on screen. The label is only invalidated when the rendered string
+ * differs, so a sensor repeating the same rounded value costs a format and
+ * a strcmp. The label shows the internal buffer through
+ * lv_label_set_text_static, so there is no malloc per update. The buffer is
+ * read by LVGL and written by any writer task, hence the compare runs under
+ * the GUI lock too.
+ *
+ * The object must outlive the Observable subscription and must not move.
+ */
+template <typename T, size_t N = 16> class BoundLabel {
+public:
+  /** \fn BoundLabel(GuiThread &gui, lv_obj_t *label, Observable<T> &source, const char *format)
+   *  \param gui: GUI thread whose lock guards LVGL calls.
+   *  \param label: target lv_label.
+   *  \param source: observed value.
+   *  \param format: fmt format string, e.g. "{:.1f}". Must stay valid.
+   */
+  BoundLabel(GuiThread &gui, lv_obj_t *label, Observable<T> &source,
+             const char *format = "{}")
+      : _gui(gui), _label(label), _format(format) {
+    _text.fill('\0');
+    lv_label_set_text_static(_label, _text.data());
+    source.subscribe([this](const T &value) { update(value); });
+  }
+  BoundLabel(const BoundLabel &) = delete;
+  BoundLabel &operator=(const BoundLabel &) = delete;
+
+  /** \fn void update(const T &value)
+   *  \brief Formats the value and refreshes the label if the text changed.
+   */
+  void update(const T &value) {
+    char buf[N];
+    auto res = fmt::format_to_n(buf, N - 1, fmt::runtime(_format), value);
+    *res.out = '\0';
+
+    std::lock_guard<GuiThread> lock(_gui);
+    if (strcmp(buf, _text.data()) == 0) {
+      _skipped++;
+      return;
+    }
+
+    memcpy(_text.data(), buf, (res.out - buf) + 1);
+    lv_label_set_text_static(_label, _text.data());
+    _updates++;
+  }
+
+  /** \brief Number of label refreshes. */
+  uint32_t updates() const { return _updates; }
+
+  /** \brief Number of changes which rendered to the same text. */
+  uint32_t skipped() const { return _skipped; }
+
+private:
+  GuiThread &_gui;
+  lv_obj_t *_label;
+  const char *_format;
+  std::array<char, N> _text;
+  uint32_t _updates = 0;
+  uint32_t _skipped = 0;
+};
+
+} // namespace ship
+
+#endif // __BOUND_LABEL_HPP
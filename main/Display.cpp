@@ -27,11 +27,16 @@ SOFTWARE.
 #include <functional>
 #include "Lcd.hpp"
 #include "Periodic.hpp"
+#include "Settings.hpp"
+#include <algorithm>
+#include <cstdlib>
 #include <vector>
 
 #define LV_TICK_PERIOD_MS 1
 #define BUFF_SIZE 40
 #define LVGL_DOUBLE_BUFFER
+#define BRIGHTNESS_FADE_MS 300
+#define BRIGHTNESS_STEP_MS 10
 
 using namespace ship;
 using namespace lvgl::core;
@@ -55,9 +60,19 @@ esp_err_t Display::init(const std::shared_ptr<Lcd> &tft) {
 
   lcd.setRotation(2);
   lcd.setColorDepth(16);
-  int brightness = 128; // prefs.getUInt("brightness", 128);
+  int brightness = settings().get<SETTING_BRIGHTNESS>();
   ESP_LOGI(TAG, "Setting brightness: %d", brightness);
-  lcd.setBrightness(brightness);
+  set_brightness(brightness);
+
+  const esp_timer_create_args_t fade_timer_args = {
+      .callback = &Display::fade_step,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "backlight",
+      .skip_unhandled_events = true};
+  ESP_ERROR_CHECK(esp_timer_create(&fade_timer_args, &_fade_timer));
+  settings().subscribe<SETTING_BRIGHTNESS>(
+      [this](const uint8_t &level) { set_brightness(level, BRIGHTNESS_FADE_MS); });
   const uint16_t fb_size = TFT_WIDTH * BUFF_SIZE;
   const uint16_t alloc_size = fb_size * sizeof(lv_color_t);
 #if defined(LVGL_DOUBLE_BUFFER)
@@ -108,6 +123,35 @@ void Display::flush_ready() {
   lv_disp_flush_ready(&disp_drv);
 }
 
+void Display::set_brightness(uint8_t level, uint32_t fade_ms) {
+  if (_fade_timer)
+    esp_timer_stop(_fade_timer);
+  _fade_target = level;
+  int steps = fade_ms / BRIGHTNESS_STEP_MS;
+  if (!_fade_timer || steps < 2) {
+    _brightness = level;
+    _lcd->setBrightness(level);
+    return;
+  }
+  _fade_step = std::max(1, std::abs(level - _brightness) / steps);
+  esp_timer_start_periodic(_fade_timer, BRIGHTNESS_STEP_MS * 1000);
+}
+
+// Backlight fade timer, runs in the esp_timer task
+void Display::fade_step(void *arg) {
+  Display &d = *static_cast<Display *>(arg);
+  int level = d._brightness;
+  int target = d._fade_target;
+  if (level < target)
+    level = std::min(level + d._fade_step, target);
+  else
+    level = std::max(level - d._fade_step, target);
+  d._brightness = level;
+  d._lcd->setBrightness(level);
+  if (level == target)
+    esp_timer_stop(d._fade_timer);
+}
+
   // Touchpad callback to read the touchpad
   void Display::touchpadRead(lv_indev_drv_t * indev_driver,
                              lv_indev_data_t * data) {
@@ -25,6 +25,7 @@ SOFTWARE.
 #ifndef __DISPLAY_HPP
 #define __DISPLAY_HPP
 
+#include <atomic>
 #include <memory>
 #include "device_conf.hpp"
 #include <loki/Singleton.h>
@@ -33,6 +34,7 @@ SOFTWARE.
 #include <lvglpp/core/object.h>
 #include <lvglpp/core/theme.h>
 #include <lvglpp/draw/image.h>
+#include <esp_timer.h>
 // class Preferences;
 
 namespace ship {
@@ -210,6 +212,19 @@ public:
    */
   void clean_dcache();
 
+  /** \fn void set_brightness(uint8_t level, uint32_t fade_ms)
+   *  \brief Moves the backlight to level in steps over fade_ms, 0 at once.
+   *  \param level: backlight level, 0-255.
+   *  \param fade_ms: fade duration in ms.
+   */
+  void set_brightness(uint8_t level, uint32_t fade_ms = 0);
+
+  /** \fn uint8_t get_brightness() const
+   *  \brief Gets the backlight level, the end level while fading.
+   *  \returns backlight level.
+   */
+  uint8_t get_brightness() const { return _fade_target; }
+
 protected:
   Display();
   ~Display() = default;
@@ -217,11 +232,16 @@ protected:
   void flush(const lv_area_t *area, lv_color_t *color_p);
   void update_driver();
   void flush_ready();
+  static void fade_step(void *arg);
 
   lv_disp_drv_t disp_drv;
   std::shared_ptr<Lcd> _lcd;
   std::unique_ptr<Periodic> _periodic;
   lv_disp_draw_buf_t draw_buf;
+  esp_timer_handle_t _fade_timer = nullptr;
+  std::atomic<uint8_t> _brightness{0};
+  std::atomic<uint8_t> _fade_target{0};
+  std::atomic<int> _fade_step{1};
 
   friend struct Loki::CreateStatic<Display>;
 };
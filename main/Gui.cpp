@@ -23,7 +23,11 @@ SOFTWARE.
 */
 
 #include "Gui.hpp"
+#include "BoundLabel.hpp"
 #include "GuiThread.hpp"
+#include "Settings.hpp"
+#include "ShipModel.hpp"
+#include "apps/weather/WeatherPanel.hpp"
 #include "events/gui_events.hpp"
 #include "log_tag.hpp"
 #include <esp_partition.h>
@@ -45,6 +49,7 @@ LV_FONT_DECLARE(font_robotomono_13)
 LV_FONT_DECLARE(font_fa_14)
 #define FA_SYMBOL_BLE "\xEF\x8A\x94"      // 0xf294
 #define FA_SYMBOL_SETTINGS "\xEF\x80\x93" // 0xf0ad
+#define DEG "\xC2\xB0"
 
 /*********************
  *      DEFINES
@@ -73,10 +78,22 @@ void Gui::init() {
   screen_w = lv_obj_get_width(lv_scr_act());
 
   theme.init();
-  bool darkTheme = true;
-  theme.setTheme(darkTheme);
+  theme.setTheme(settings().get<SETTING_DARK_THEME>());
 
   setup_styles();
+  settings().subscribe<SETTING_DARK_THEME>(
+      [this](const bool &dark) { apply_theme(dark); });
+}
+
+// Settings observer: restyles in place instead of rebuilding the screen.
+// Takes the GUI lock, so the setter must not already hold it from another task.
+void Gui::apply_theme(bool dark) {
+  std::lock_guard<GuiThread> lock(*guiThread);
+  theme.setTheme(dark);
+  lv_style_set_bg_color(&style_ui_island, theme.getBgColor());
+  lv_style_set_border_color(&style_ui_island, theme.getBgColor());
+  // Invalidates just the objects that use the style
+  lv_obj_report_style_change(&style_ui_island);
 }
 
 void Gui::setup_styles() {
@@ -172,9 +189,48 @@ void Gui::show() {
   lv_msg_send(MSG_PAGE_HOME, NULL);
 }
 
+// Caption over a value, returns the value label
+static lv_obj_t *create_reading(lv_obj_t *parent, const char *caption) {
+  lv_obj_t *cell = lv_obj_create(parent);
+  lv_obj_remove_style_all(cell);
+  lv_obj_set_size(cell, LV_PCT(33), LV_SIZE_CONTENT);
+  lv_obj_set_flex_flow(cell, LV_FLEX_FLOW_COLUMN);
+
+  lv_obj_t *label = lv_label_create(cell);
+  lv_obj_set_style_text_font(label, font_normal, 0);
+  lv_label_set_text_static(label, caption);
+
+  lv_obj_t *value = lv_label_create(cell);
+  lv_obj_set_style_text_font(value, font_xl, 0);
+  return value;
+}
+
 void Gui::create_page_home(lv_obj_t *parent) {
   /* HOME PAGE PANELS */
-  panel = tux_panel_create(parent, "", 130);
+  panel = tux_panel_create(parent, "SHIP", LV_SIZE_CONTENT);
   lv_obj_add_style(panel, &style_ui_island, 0);
   // tux_panel_devinfo(parent);
+
+  lv_obj_t *content = tux_panel_get_content(panel);
+  lv_obj_set_flex_flow(content, LV_FLEX_FLOW_ROW_WRAP);
+
+  // Labels only redraw when the rounded text changes
+  ShipModel &m = ShipModel::instance();
+  GuiThread &gui = *guiThread;
+  static BoundLabel<float> heading(gui, create_reading(content, "HDG"),
+                                   m.heading, "{:03.0f}" DEG);
+  static BoundLabel<float> cog(gui, create_reading(content, "COG"), m.cog,
+                               "{:03.0f}" DEG);
+  static BoundLabel<float> sog(gui, create_reading(content, "SOG"), m.sog,
+                               "{:.1f} kn");
+  static BoundLabel<float> depth(gui, create_reading(content, "DEPTH"),
+                                 m.depth, "{:.1f} m");
+  static BoundLabel<float> wind_angle(gui, create_reading(content, "AWA"),
+                                      m.wind_angle, "{:.0f}" DEG);
+  static BoundLabel<float> wind_speed(gui, create_reading(content, "AWS"),
+                                      m.wind_speed, "{:.1f} kn");
+
+#if defined(CONFIG_WEATHER_ENABLE)
+  static WeatherPanel weather_panel(parent, &style_ui_island);
+#endif
 }
\ No newline at end of file
@@ -40,11 +40,15 @@ public:
   void init();
   void show();
 
+  /** \brief GUI thread, lock it before touching LVGL from other tasks. */
+  GuiThread &thread() const { return *guiThread; }
+
 private:
   Gui() = default;
   ~Gui() = default;
 
   void setup_styles();
+  void apply_theme(bool dark);
   void setup_background_style();
 
   void create_page_home(lv_obj_t *parent);
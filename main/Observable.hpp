@@ -0,0 +1,97 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __OBSERVABLE_HPP
+#define __OBSERVABLE_HPP
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+#include <esp_timer.h>
+
+namespace ship {
+
+/**
+ * Observable holds a single typed model value (heading, depth, ...).
+ * Writers call set() from any task; subscribers are notified from the
+ * writer's task only when the value actually changed.
+ * Subscribe during setup, before the writers are started.
+ */
+template <typename T> class Observable {
+public:
+  using Callback = std::function<void(const T &)>;
+
+  explicit Observable(T initial = T{}) : _value(initial), _updated(0) {}
+  Observable(const Observable &) = delete;
+  Observable &operator=(const Observable &) = delete;
+
+  /** \brief Gets the last value. */
+  T get() const { return _value.load(std::memory_order_relaxed); }
+
+  /** \brief Time of the last set() in microseconds since boot, 0 if never set. */
+  int64_t updated() const { return _updated.load(std::memory_order_relaxed); }
+
+  /** \brief Tells if a value was received within max_age_ms. */
+  bool is_fresh(uint32_t max_age_ms) const {
+    int64_t t = updated();
+    return t != 0 && (esp_timer_get_time() - t) < int64_t(max_age_ms) * 1000;
+  }
+
+  /** \fn bool set(T value)
+   *  \brief Stores the value and notifies subscribers if it changed.
+   *  A NaN following a NaN is no change.
+   *  \returns true if subscribers were notified.
+   */
+  bool set(T value) {
+    bool first = _updated.exchange(esp_timer_get_time()) == 0;
+    T old = _value.exchange(value, std::memory_order_relaxed);
+    if (!first && same(old, value))
+      return false;
+    for (auto &cb : _subscribers)
+      cb(value);
+    return true;
+  }
+
+  /** \brief Registers a change callback. Not thread safe - use during setup. */
+  void subscribe(Callback cb) { _subscribers.push_back(std::move(cb)); }
+
+private:
+  static bool same(const T &a, const T &b) {
+    if constexpr (std::is_floating_point_v<T>)
+      return a == b || (std::isnan(a) && std::isnan(b));
+    else
+      return a == b;
+  }
+
+  std::atomic<T> _value;
+  std::atomic<int64_t> _updated;
+  std::vector<Callback> _subscribers;
+};
+
+} // namespace ship
+
+#endif // __OBSERVABLE_HPP
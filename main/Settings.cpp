@@ -0,0 +1,98 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Settings.hpp"
+#include "ConfigBase.h"
+#include "log_tag.hpp"
+#include <esp_timer.h>
+
+#define AUTOSAVE_DELAY_MS 5000
+
+using namespace ship;
+
+namespace {
+
+/** The settings as a JSON file, same keys as in NVS. */
+struct SettingsFile : ConfigBase<SettingsFile> {
+  uint8_t brightness = settings().get<SETTING_BRIGHTNESS>();
+  bool dark_theme = settings().get<SETTING_DARK_THEME>();
+
+  static constexpr auto fields = std::make_tuple(
+      configField(Settings::key<SETTING_BRIGHTNESS>(), &SettingsFile::brightness),
+      configField(Settings::key<SETTING_DARK_THEME>(), &SettingsFile::dark_theme));
+};
+static_assert(std::tuple_size<decltype(SettingsFile::fields)>::value == SETTING_COUNT,
+              "SettingsFile out of sync with SettingsSchema");
+
+esp_timer_handle_t autosave_timer = nullptr;
+const char *autosave_path = nullptr;
+
+void autosave(void *arg) { settings_export(autosave_path); }
+
+} // namespace
+
+esp_err_t ship::settings_export(const char *path) {
+  SettingsFile file;
+  esp_err_t err = file.save(path);
+  if (err == ESP_OK)
+    ESP_LOGI(TAG, "Settings saved to %s", path);
+  return err;
+}
+
+esp_err_t ship::settings_import(const char *path) {
+  SettingsFile file;
+  esp_err_t err = file.load(path);
+  if (err != ESP_OK) {
+    if (err != ESP_ERR_NOT_FOUND)
+      ESP_LOGE(TAG, "Settings not restored from %s: %s", path,
+               esp_err_to_name(err));
+    return err;
+  }
+  // set() checks the ranges, writes NVS and notifies the subscribers
+  settings().set<SETTING_BRIGHTNESS>(file.brightness);
+  settings().set<SETTING_DARK_THEME>(file.dark_theme);
+  ESP_LOGI(TAG, "Settings restored from %s: %u fields, %u rejected", path,
+           file.loaded(), file.rejected());
+  return ESP_OK;
+}
+
+void ship::settings_autosave(const char *path) {
+  if (autosave_timer)
+    return;
+  autosave_path = path;
+  const esp_timer_create_args_t args = {
+      .callback = &autosave,
+      .arg = nullptr,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "settings",
+      .skip_unhandled_events = true};
+  ESP_ERROR_CHECK(esp_timer_create(&args, &autosave_timer));
+  // Restarted by every change, so a burst of changes is saved once
+  auto changed = [](const auto &) {
+    esp_timer_stop(autosave_timer);
+    esp_timer_start_once(autosave_timer, AUTOSAVE_DELAY_MS * 1000);
+  };
+  settings().subscribe<SETTING_BRIGHTNESS>(changed);
+  settings().subscribe<SETTING_DARK_THEME>(changed);
+}
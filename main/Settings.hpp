@@ -0,0 +1,82 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SETTINGS_HPP
+#define __SETTINGS_HPP
+
+#include <cstdint>
+#include <esp_err.h>
+#include <tuple>
+#include "PreferencesSchema.h"
+
+namespace ship {
+
+/** Index of each field in SettingsSchema::fields, same order. */
+enum SettingKey : size_t {
+  SETTING_BRIGHTNESS,
+  SETTING_DARK_THEME,
+  SETTING_COUNT
+};
+
+/**
+ * User settings, all in the "settings" NVS namespace. Loaded once at boot;
+ * read with settings().get<SETTING_...>() without touching NVS.
+ * settings().set<SETTING_...>() notifies the subscribers of that setting:
+ * Display fades the backlight, Gui restyles for the theme, main posts
+ * TUX_EVENT_BRIGHTNESS_CHANGED / TUX_EVENT_THEME_CHANGED.
+ */
+struct SettingsSchema {
+  static constexpr auto fields = std::make_tuple(
+      PreferenceField<uint8_t>("brightness", 128, 8, 255),
+      PreferenceField<bool>("dark_theme", true));
+};
+
+using Settings = PreferencesStore<SettingsSchema>;
+static_assert(Settings::size == SETTING_COUNT, "SettingKey out of sync with SettingsSchema");
+
+inline Settings &settings() {
+  static Settings instance;
+  return instance;
+}
+
+/** \fn esp_err_t settings_export(const char *path)
+ *  \brief Writes the settings to a JSON file, atomically (see ConfigBase).
+ */
+esp_err_t settings_export(const char *path);
+
+/** \fn esp_err_t settings_import(const char *path)
+ *  \brief Applies a file written by settings_export(), e.g. from another
+ *  panel. Missing and out of range values leave the setting unchanged.
+ *  \returns ESP_ERR_NOT_FOUND without the file.
+ */
+esp_err_t settings_import(const char *path);
+
+/** \fn void settings_autosave(const char *path)
+ *  \brief Exports to path a few seconds after the last settings change.
+ */
+void settings_autosave(const char *path);
+
+} // namespace ship
+
+#endif // __SETTINGS_HPP
@@ -0,0 +1,76 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SHIP_MODEL_HPP
+#define __SHIP_MODEL_HPP
+
+#include "Observable.hpp"
+#include <cmath>
+#include <loki/Singleton.h>
+
+namespace ship {
+
+/**
+ * ShipModel is the single source of ship data for the UI.
+ * Ingestion tasks write the values, widgets and services subscribe to them.
+ * Units are SI / nautical as received: degrees, knots, metres, Kelvin, volts.
+ */
+class ShipModel {
+public:
+  static ShipModel &instance();
+
+  // Navigation
+  Observable<double> latitude{NAN};
+  Observable<double> longitude{NAN};
+  Observable<float> cog{NAN};            // course over ground, degrees true
+  Observable<float> sog{NAN};            // speed over ground, knots
+  Observable<float> heading{NAN};        // degrees magnetic
+  Observable<float> depth{NAN};          // below transducer, metres
+
+  // Wind
+  Observable<float> wind_angle{NAN};     // apparent, degrees relative to bow
+  Observable<float> wind_speed{NAN};     // apparent, knots
+
+  // Environment
+  Observable<float> water_temp{NAN};     // Kelvin
+  Observable<float> air_temp{NAN};       // Kelvin
+  Observable<float> pressure{NAN};       // Pascal
+
+  // Engine / electrical
+  Observable<float> rudder_angle{NAN};   // degrees, positive to starboard
+  Observable<float> engine_rpm{NAN};
+  Observable<float> engine_temp{NAN};    // Kelvin
+  Observable<float> battery_voltage{NAN};
+  Observable<float> battery_current{NAN};
+
+private:
+  ShipModel() = default;
+  ~ShipModel() = default;
+
+  friend struct Loki::CreateStatic<ShipModel>;
+};
+
+} // namespace ship
+
+#endif // __SHIP_MODEL_HPP
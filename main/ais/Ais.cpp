@@ -0,0 +1,210 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Ais.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <esp_timer.h>
+
+using namespace ship;
+
+/* Bit reader over the armored payload, no unpacking */
+class AisBits {
+public:
+  AisBits(const char *payload, size_t len, int fill)
+      : _p(payload), _bits(len * 6 - fill) {}
+
+  size_t size() const { return _bits; }
+
+  uint32_t u(size_t start, size_t len) const {
+    uint32_t v = 0;
+    for (size_t i = start; i < start + len; i++)
+      v = (v << 1) | (i < _bits ? (sixbit(_p[i / 6]) >> (5 - i % 6)) & 1 : 0);
+    return v;
+  }
+
+  int32_t s(size_t start, size_t len) const {
+    uint32_t v = u(start, len);
+    return (v & (1u << (len - 1))) ? int32_t(v | ~((1u << len) - 1)) : int32_t(v);
+  }
+
+  // 6-bit ASCII, '@' padded, trailing spaces trimmed
+  void text(size_t start, size_t chars, char *out) const {
+    size_t n = 0;
+    for (size_t i = 0; i < chars && start + i * 6 + 6 <= _bits; i++) {
+      uint8_t c = u(start + i * 6, 6);
+      if (c == 0)
+        break;
+      out[n++] = c < 32 ? c + 64 : c;
+    }
+    while (n && out[n - 1] == ' ')
+      n--;
+    out[n] = '\0';
+  }
+
+private:
+  static uint8_t sixbit(char c) {
+    uint8_t v = uint8_t(c) - 48;
+    return v > 40 ? v - 8 : v;
+  }
+
+  const char *_p;
+  size_t _bits;
+};
+
+static float speed(uint32_t v) { return v == 1023 ? NAN : v / 10.0f; }
+static float course(uint32_t v) { return v >= 3600 ? NAN : v / 10.0f; }
+static float heading(uint32_t v) { return v == 511 ? NAN : float(v); }
+static double lon(int32_t v) { return v == 181 * 600000 ? NAN : v / 600000.0; }
+static double lat(int32_t v) { return v == 91 * 600000 ? NAN : v / 600000.0; }
+
+void Ais::on_sentence(const NmeaSentence &s) {
+  if (!s.encapsulated || strcmp(s.formatter, "VDM") != 0 || s.count < 7)
+    return; // VDO is own ship, not a target
+
+  int count = atoi(s.fields[1]);
+  int num = atoi(s.fields[2]);
+  const char *payload = s.fields[5];
+  int fill = atoi(s.fields[6]);
+  size_t len = strlen(payload);
+
+  if (count == 1) {
+    decode(payload, len, fill);
+    return;
+  }
+
+  int seq = s.fields[3][0] ? atoi(s.fields[3]) : 0;
+  if (count < 1 || count > 5 || num < 1 || num > count || seq < 0 || seq > 9) {
+    _stats.malformed++;
+    return;
+  }
+
+  Fragments &f = _fragments[seq];
+  if (num == 1) {
+    if (f.count)
+      _stats.fragments_lost++; // previous message never completed
+    f.count = count;
+    f.next = 1;
+    f.len = 0;
+  } else if (f.count != count || f.next != num) {
+    _stats.fragments_lost++;
+    f.count = 0;
+    return;
+  }
+
+  if (f.len + len > AIS_MAX_PAYLOAD) {
+    _stats.malformed++;
+    f.count = 0;
+    return;
+  }
+  memcpy(f.payload + f.len, payload, len);
+  f.len += len;
+  f.next++;
+
+  if (num == count) {
+    f.count = 0;
+    decode(f.payload, f.len, fill);
+  }
+}
+
+void Ais::decode(const char *payload, size_t len, int fill) {
+  _stats.messages++;
+  if (len == 0 || fill < 0 || fill > 5) {
+    _stats.malformed++;
+    return;
+  }
+
+  AisBits b(payload, len, fill);
+  int64_t now = esp_timer_get_time() / 1000;
+  uint8_t type = b.u(0, 6);
+  uint32_t mmsi = b.u(8, 30);
+  char name[21];
+  char callsign[8];
+
+  switch (type) {
+  case 1:
+  case 2:
+  case 3: {
+    if (b.size() < 149)
+      break;
+    AisPosition p = {mmsi, lat(b.s(89, 27)), lon(b.s(61, 28)), speed(b.u(50, 10)),
+                     course(b.u(116, 12)), heading(b.u(128, 9)),
+                     uint8_t(b.u(38, 4)), false};
+    _targets.update(p, now);
+    _stats.decoded++;
+    return;
+  }
+  case 18:
+  case 19: {
+    if (b.size() < (type == 18 ? 168u : 312u))
+      break;
+    AisPosition p = {mmsi, lat(b.s(85, 27)), lon(b.s(57, 28)), speed(b.u(46, 10)),
+                     course(b.u(112, 12)), heading(b.u(124, 9)), 15, true};
+    _targets.update(p, now);
+    if (type == 19) {
+      b.text(143, 20, name);
+      AisStatic st = {mmsi, name, "", uint8_t(b.u(263, 8)),
+                      uint16_t(b.u(271, 9) + b.u(280, 9)),
+                      uint8_t(b.u(289, 6) + b.u(295, 6)), true};
+      _targets.update(st, now);
+    }
+    _stats.decoded++;
+    return;
+  }
+  case 5: {
+    if (b.size() < 420)
+      break;
+    b.text(70, 7, callsign);
+    b.text(112, 20, name);
+    AisStatic st = {mmsi, name, callsign, uint8_t(b.u(232, 8)),
+                    uint16_t(b.u(240, 9) + b.u(249, 9)),
+                    uint8_t(b.u(258, 6) + b.u(264, 6)), false};
+    _targets.update(st, now);
+    _stats.decoded++;
+    return;
+  }
+  case 24: {
+    if (b.u(38, 2) == 0) { // part A: name
+      if (b.size() < 160)
+        break;
+      b.text(40, 20, name);
+      AisStatic st = {mmsi, name, "", 0, 0, 0, true};
+      _targets.update(st, now);
+    } else { // part B: type, callsign, dimensions
+      if (b.size() < 162)
+        break;
+      b.text(90, 7, callsign);
+      AisStatic st = {mmsi, "", callsign, uint8_t(b.u(40, 8)),
+                      uint16_t(b.u(132, 9) + b.u(141, 9)),
+                      uint8_t(b.u(150, 6) + b.u(156, 6)), true};
+      _targets.update(st, now);
+    }
+    _stats.decoded++;
+    return;
+  }
+  default:
+    return; // not of interest
+  }
+  _stats.malformed++;
+}
@@ -0,0 +1,78 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __AIS_HPP
+#define __AIS_HPP
+
+#include "AisTargets.hpp"
+#include "nmea/Nmea0183.hpp"
+
+namespace ship {
+
+static constexpr size_t AIS_MAX_PAYLOAD = 5 * 64; // armored chars, 5 fragments
+
+struct AisStats {
+  uint32_t messages;      // complete payloads
+  uint32_t decoded;       // of a supported type
+  uint32_t fragments_lost;
+  uint32_t malformed;
+};
+
+/**
+ * Ais decodes !AIVDM sentences into the target table.
+ * Types 1/2/3 (class A position), 5 (class A static), 18 (class B
+ * position), 19 (class B extended) and 24 (class B static) are decoded;
+ * the 6-bit payload is read in place, without unpacking.
+ * Subscribe it to the Nmea0183 dispatcher the AIS receiver is on.
+ */
+class Ais : public NmeaListener {
+public:
+  explicit Ais(AisTargets &targets) : _targets(targets) {}
+
+  void on_sentence(const NmeaSentence &s) override;
+
+  /** \fn void decode(const char *payload, size_t len, int fill)
+   *  \brief Decodes one complete armored payload.
+   */
+  void decode(const char *payload, size_t len, int fill);
+
+  const AisStats &stats() const { return _stats; }
+
+private:
+  // Multi-fragment messages, by sequential message id 0-9
+  struct Fragments {
+    uint8_t count;        // 0 = slot unused
+    uint8_t next;         // next expected fragment number
+    size_t len;
+    char payload[AIS_MAX_PAYLOAD];
+  };
+
+  AisTargets &_targets;
+  Fragments _fragments[10] = {};
+  AisStats _stats = {};
+};
+
+} // namespace ship
+
+#endif // __AIS_HPP
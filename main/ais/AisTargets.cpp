@@ -0,0 +1,314 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "AisTargets.hpp"
+#include "log_tag.hpp"
+#include <cinttypes>
+#include <cstring>
+#include <esp_heap_caps.h>
+
+using namespace ship;
+
+#define AIS_CELL_NM 2.0             // grid cell size, ~ a harbour basin
+#define AIS_CELLS_PER_DEG (60.0 / AIS_CELL_NM)
+#define AIS_EXPIRE_PERIOD_MS 30000
+
+static constexpr double DEG_TO_RAD = 0.017453292519943295;
+
+static size_t pow2_at_least(size_t n) {
+  size_t p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+static void *psram_alloc(size_t size) {
+  void *p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return p ? p : heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+}
+
+AisTargets::AisTargets(size_t max_targets)
+    : _max(max_targets < NONE ? max_targets : NONE - 1),
+      _map_size(pow2_at_least(_max * 2)), _grid_size(pow2_at_least(_max)) {}
+
+AisTargets::~AisTargets() {
+  if (_timer) {
+    esp_timer_stop(_timer);
+    esp_timer_delete(_timer);
+  }
+  heap_caps_free(_pool);
+  heap_caps_free(_map);
+  heap_caps_free(_grid);
+  if (_mutex)
+    vSemaphoreDelete(_mutex);
+}
+
+esp_err_t AisTargets::init(int64_t max_age_ms) {
+  _pool = static_cast<Slot *>(psram_alloc(sizeof(Slot) * _max));
+  _map = static_cast<uint16_t *>(psram_alloc(sizeof(uint16_t) * _map_size));
+  _grid = static_cast<uint16_t *>(psram_alloc(sizeof(uint16_t) * _grid_size));
+  _mutex = xSemaphoreCreateMutex();
+  if (!_pool || !_map || !_grid || !_mutex)
+    return ESP_ERR_NO_MEM;
+
+  memset(_map, 0xff, sizeof(uint16_t) * _map_size);
+  memset(_grid, 0xff, sizeof(uint16_t) * _grid_size);
+  for (size_t i = 0; i < _max; i++)
+    _pool[i].next = i + 1 < _max ? i + 1 : NONE;
+  _free = 0;
+
+  ESP_LOGI(TAG, "AIS: %zu targets, %zu bytes", _max,
+           sizeof(Slot) * _max + sizeof(uint16_t) * (_map_size + _grid_size));
+
+  _max_age_ms = max_age_ms;
+  const esp_timer_create_args_t args = {
+      .callback = &AisTargets::expire_timer,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "ais_expire",
+      .skip_unhandled_events = true};
+  ESP_ERROR_CHECK(esp_timer_create(&args, &_timer));
+  return esp_timer_start_periodic(_timer, AIS_EXPIRE_PERIOD_MS * 1000);
+}
+
+void AisTargets::expire_timer(void *arg) {
+  AisTargets *self = reinterpret_cast<AisTargets *>(arg);
+  size_t removed = self->expire(esp_timer_get_time() / 1000, self->_max_age_ms);
+  ESP_LOGD(TAG, "AIS: %zu targets, %zu expired, %" PRIu32 " overflows",
+           self->_count, removed, self->_overflows);
+}
+
+size_t AisTargets::home(uint32_t mmsi) const {
+  // Fibonacci hashing; MMSIs share prefixes (MID) so mix all bits
+  return (uint32_t(mmsi * 2654435761u) >> 8) & (_map_size - 1);
+}
+
+uint16_t AisTargets::bucket_of(int32_t cell_lat, int32_t cell_lon) const {
+  uint32_t h = uint32_t(cell_lat) * 73856093u ^ uint32_t(cell_lon) * 19349663u;
+  return h & (_grid_size - 1);
+}
+
+AisTargets::Slot *AisTargets::get_or_add(uint32_t mmsi) {
+  size_t i = home(mmsi);
+  while (_map[i] != NONE) {
+    if (_pool[_map[i]].t.mmsi == mmsi)
+      return &_pool[_map[i]];
+    i = (i + 1) & (_map_size - 1);
+  }
+
+  if (_free == NONE) {
+    _overflows++;
+    return nullptr;
+  }
+  uint16_t idx = _free;
+  _free = _pool[idx].next;
+  _map[i] = idx;
+  _count++;
+
+  Slot &s = _pool[idx];
+  memset(&s.t, 0, sizeof(s.t));
+  s.t.mmsi = mmsi;
+  s.t.latitude = s.t.longitude = NAN;
+  s.t.sog = s.t.cog = s.t.heading = NAN;
+  s.t.nav_status = 15;
+  s.bucket = NONE;
+  s.next = NONE;
+  return &s;
+}
+
+void AisTargets::unlink(uint16_t idx) {
+  Slot &s = _pool[idx];
+  if (s.bucket == NONE)
+    return;
+  uint16_t *p = &_grid[s.bucket];
+  while (*p != idx)
+    p = &_pool[*p].next;
+  *p = s.next;
+  s.bucket = NONE;
+  s.next = NONE;
+}
+
+void AisTargets::relink(uint16_t idx) {
+  Slot &s = _pool[idx];
+  int32_t clat = int32_t(floor(s.t.latitude * AIS_CELLS_PER_DEG));
+  int32_t clon = int32_t(floor(s.t.longitude * AIS_CELLS_PER_DEG));
+  if (s.bucket != NONE && clat == s.cell_lat && clon == s.cell_lon)
+    return; // same cell, nothing to do
+  unlink(idx);
+  s.cell_lat = clat;
+  s.cell_lon = clon;
+  s.bucket = bucket_of(clat, clon);
+  s.next = _grid[s.bucket];
+  _grid[s.bucket] = idx;
+}
+
+void AisTargets::remove(uint16_t idx) {
+  unlink(idx);
+
+  // Backward shift delete keeps probe chains intact without tombstones
+  size_t i = home(_pool[idx].t.mmsi);
+  while (_map[i] != idx)
+    i = (i + 1) & (_map_size - 1);
+  size_t j = i;
+  while (true) {
+    j = (j + 1) & (_map_size - 1);
+    if (_map[j] == NONE)
+      break;
+    size_t k = home(_pool[_map[j]].t.mmsi);
+    // Move j into the hole at i unless its home lies cyclically in (i, j]
+    if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+      _map[i] = _map[j];
+      i = j;
+    }
+  }
+  _map[i] = NONE;
+
+  _pool[idx].next = _free;
+  _free = idx;
+  _count--;
+}
+
+void AisTargets::update(const AisPosition &p, int64_t now_ms) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  Slot *s = get_or_add(p.mmsi);
+  if (s) {
+    AisTarget &t = s->t;
+    t.sog = p.sog;
+    t.cog = p.cog;
+    t.heading = p.heading;
+    t.nav_status = p.nav_status;
+    t.class_b = p.class_b;
+    t.last_seen_ms = now_ms;
+    if (!std::isnan(p.latitude) && !std::isnan(p.longitude)) {
+      t.latitude = p.latitude;
+      t.longitude = p.longitude;
+      relink(s - _pool);
+    }
+  }
+  xSemaphoreGive(_mutex);
+}
+
+void AisTargets::update(const AisStatic &st, int64_t now_ms) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  Slot *s = get_or_add(st.mmsi);
+  if (s) {
+    AisTarget &t = s->t;
+    if (st.name && *st.name)
+      strlcpy(t.name, st.name, sizeof(t.name));
+    if (st.callsign && *st.callsign)
+      strlcpy(t.callsign, st.callsign, sizeof(t.callsign));
+    if (st.ship_type)
+      t.ship_type = st.ship_type;
+    if (st.length)
+      t.length = st.length;
+    if (st.beam)
+      t.beam = st.beam;
+    t.class_b = st.class_b;
+    t.last_seen_ms = now_ms;
+  }
+  xSemaphoreGive(_mutex);
+}
+
+size_t AisTargets::expire(int64_t now_ms, int64_t max_age_ms) {
+  size_t removed = 0;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  // Walk the map rather than the pool: only used slots are in there.
+  // A backward shift may move an unvisited entry into i, so re-check i.
+  for (size_t i = 0; i < _map_size;) {
+    uint16_t idx = _map[i];
+    if (idx != NONE && now_ms - _pool[idx].t.last_seen_ms > max_age_ms) {
+      remove(idx);
+      removed++;
+    } else {
+      i++;
+    }
+  }
+  xSemaphoreGive(_mutex);
+  return removed;
+}
+
+bool AisTargets::find(uint32_t mmsi, AisTarget &out) {
+  bool found = false;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  for (size_t i = home(mmsi); _map[i] != NONE; i = (i + 1) & (_map_size - 1)) {
+    if (_pool[_map[i]].t.mmsi == mmsi) {
+      out = _pool[_map[i]].t;
+      found = true;
+      break;
+    }
+  }
+  xSemaphoreGive(_mutex);
+  return found;
+}
+
+size_t AisTargets::nearby(double lat, double lon, float sog, float cog,
+                          float radius_nm, AisContact *out, size_t max) {
+  // Local flat projection around own ship, in nautical miles
+  const double coslat = cos(lat * DEG_TO_RAD);
+  const double dlat = radius_nm / 60.0;
+  const double dlon = radius_nm / (60.0 * (coslat > 0.01 ? coslat : 0.01));
+  const int32_t lat0 = int32_t(floor((lat - dlat) * AIS_CELLS_PER_DEG));
+  const int32_t lat1 = int32_t(floor((lat + dlat) * AIS_CELLS_PER_DEG));
+  const int32_t lon0 = int32_t(floor((lon - dlon) * AIS_CELLS_PER_DEG));
+  const int32_t lon1 = int32_t(floor((lon + dlon) * AIS_CELLS_PER_DEG));
+
+  const float own_vx = std::isnan(sog) || std::isnan(cog) ? 0 : sog * sinf(cog * DEG_TO_RAD);
+  const float own_vy = std::isnan(sog) || std::isnan(cog) ? 0 : sog * cosf(cog * DEG_TO_RAD);
+
+  size_t n = 0;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  for (int32_t clat = lat0; clat <= lat1; clat++) {
+    for (int32_t clon = lon0; clon <= lon1; clon++) {
+      for (uint16_t idx = _grid[bucket_of(clat, clon)]; idx != NONE && n < max;
+           idx = _pool[idx].next) {
+        const Slot &s = _pool[idx];
+        // Buckets are hashed: skip targets of other cells sharing it
+        if (s.cell_lat != clat || s.cell_lon != clon)
+          continue;
+
+        float px = (s.t.longitude - lon) * 60.0 * coslat;
+        float py = (s.t.latitude - lat) * 60.0;
+        float dist = sqrtf(px * px + py * py);
+        if (dist > radius_nm)
+          continue;
+
+        bool moving = !std::isnan(s.t.sog) && !std::isnan(s.t.cog);
+        float vx = (moving ? s.t.sog * sinf(s.t.cog * DEG_TO_RAD) : 0) - own_vx;
+        float vy = (moving ? s.t.sog * cosf(s.t.cog * DEG_TO_RAD) : 0) - own_vy;
+        float v2 = vx * vx + vy * vy;
+        float t = v2 > 1e-6f ? -(px * vx + py * vy) / v2 : 0; // hours
+        float cx = px + vx * t, cy = py + vy * t;
+
+        AisContact &c = out[n++];
+        c.target = s.t;
+        c.distance_nm = dist;
+        c.bearing = fmodf(atan2f(px, py) / DEG_TO_RAD + 360.0f, 360.0f);
+        c.cpa_nm = sqrtf(cx * cx + cy * cy);
+        c.tcpa_min = t * 60.0f;
+      }
+    }
+  }
+  xSemaphoreGive(_mutex);
+  return n;
+}
@@ -0,0 +1,165 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __AIS_TARGETS_HPP
+#define __AIS_TARGETS_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+namespace ship {
+
+/* One vessel, merged from position and static reports */
+struct AisTarget {
+  uint32_t mmsi;
+  double latitude;        // degrees, NAN until a position report
+  double longitude;
+  float sog;              // knots, NAN if not available
+  float cog;              // degrees true, NAN if not available
+  float heading;          // degrees true, NAN if not available
+  uint8_t nav_status;     // 15 = not defined (class B)
+  uint8_t ship_type;
+  bool class_b;
+  uint16_t length;        // metres
+  uint8_t beam;           // metres
+  char name[21];
+  char callsign[8];
+  int64_t last_seen_ms;
+};
+
+/* Position report (types 1, 2, 3, 18, 19) */
+struct AisPosition {
+  uint32_t mmsi;
+  double latitude;
+  double longitude;
+  float sog;
+  float cog;
+  float heading;
+  uint8_t nav_status;
+  bool class_b;
+};
+
+/* Static data (types 5, 19, 24); empty strings / 0 mean "not in this message" */
+struct AisStatic {
+  uint32_t mmsi;
+  const char *name;
+  const char *callsign;
+  uint8_t ship_type;
+  uint16_t length;
+  uint8_t beam;
+  bool class_b;
+};
+
+/* Target relative to own ship, see AisTargets::nearby */
+struct AisContact {
+  AisTarget target;
+  float distance_nm;
+  float bearing;          // degrees true from own ship
+  float cpa_nm;           // closest point of approach
+  float tcpa_min;         // time to CPA, negative when diverging
+};
+
+/**
+ * AisTargets is the table of known vessels.
+ *
+ * Targets live in a fixed pool in PSRAM. An open addressing hash map
+ * (linear probing, backward shift delete) finds them by MMSI, and a
+ * spatial hash of AIS_CELL_NM cells links the targets of each cell, so a
+ * range query only walks the cells under the circle instead of the whole
+ * table. Targets not heard for AIS_EXPIRY are dropped by expire().
+ * All methods are thread safe.
+ */
+class AisTargets {
+public:
+  explicit AisTargets(size_t max_targets);
+  ~AisTargets();
+
+  /** \fn esp_err_t init(int64_t max_age_ms)
+   *  \brief Allocates the pool and indexes, and expires targets not heard
+   *         for max_age_ms every 30 s.
+   */
+  esp_err_t init(int64_t max_age_ms);
+
+  void update(const AisPosition &p, int64_t now_ms);
+  void update(const AisStatic &s, int64_t now_ms);
+
+  /** \fn size_t expire(int64_t now_ms, int64_t max_age_ms)
+   *  \returns number of targets removed.
+   */
+  size_t expire(int64_t now_ms, int64_t max_age_ms);
+
+  /** \fn size_t nearby(double lat, double lon, float sog, float cog, float radius_nm, AisContact *out, size_t max)
+   *  \brief Targets within radius_nm of own ship, with CPA / TCPA.
+   *  \returns number of contacts written, unsorted.
+   */
+  size_t nearby(double lat, double lon, float sog, float cog, float radius_nm,
+                AisContact *out, size_t max);
+
+  /** \brief Copies one target, false if unknown. */
+  bool find(uint32_t mmsi, AisTarget &out);
+
+  size_t count() const { return _count; }
+  uint32_t overflows() const { return _overflows; }
+
+private:
+  static constexpr uint16_t NONE = 0xffff;
+
+  struct Slot {
+    AisTarget t;
+    int32_t cell_lat;     // grid cell, valid when bucket != NONE
+    int32_t cell_lon;
+    uint16_t bucket;
+    uint16_t next;        // next slot in the same bucket, or in the free list
+  };
+
+  static void expire_timer(void *arg);
+  Slot *get_or_add(uint32_t mmsi);
+  void remove(uint16_t idx);
+  void relink(uint16_t idx);
+  void unlink(uint16_t idx);
+  uint16_t bucket_of(int32_t cell_lat, int32_t cell_lon) const;
+  size_t home(uint32_t mmsi) const;
+
+  size_t _max;
+  size_t _map_size;       // power of 2, >= 2 * _max
+  size_t _grid_size;      // power of 2
+  Slot *_pool = nullptr;
+  uint16_t *_map = nullptr;   // slot index per hash entry, NONE = empty
+  uint16_t *_grid = nullptr;  // first slot per bucket
+  uint16_t _free = NONE;
+  size_t _count = 0;
+  uint32_t _overflows = 0;
+  SemaphoreHandle_t _mutex = nullptr;
+  esp_timer_handle_t _timer = nullptr;
+  int64_t _max_age_ms = 0;
+};
+
+} // namespace ship
+
+#endif // __AIS_TARGETS_HPP
@@ -0,0 +1,108 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "AlarmBanner.hpp"
+#include "events/tux_events.hpp"
+#include "log_tag.hpp"
+#include <mutex>
+
+using namespace ship;
+
+#define BANNER_HEIGHT 48
+
+AlarmBanner::AlarmBanner(GuiThread &gui, AlarmEngine &engine)
+    : _gui(gui), _engine(engine) {}
+
+AlarmBanner::~AlarmBanner() {
+  if (_handler)
+    esp_event_handler_instance_unregister(TUX_EVENTS, ESP_EVENT_ANY_ID, _handler);
+  if (_banner) {
+    std::lock_guard<GuiThread> lock(_gui);
+    lv_obj_del(_banner);
+  }
+}
+
+esp_err_t AlarmBanner::start() {
+  {
+    std::lock_guard<GuiThread> lock(_gui);
+    _banner = lv_obj_create(lv_layer_top());
+    lv_obj_set_size(_banner, LV_PCT(100), BANNER_HEIGHT);
+    lv_obj_align(_banner, LV_ALIGN_TOP_MID, 0, 0);
+    lv_obj_set_style_radius(_banner, 0, 0);
+    lv_obj_set_style_border_width(_banner, 0, 0);
+    lv_obj_clear_flag(_banner, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(_banner, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_event_cb(_banner, clicked, LV_EVENT_CLICKED, this);
+
+    _label = lv_label_create(_banner);
+    lv_obj_set_width(_label, LV_PCT(100));
+    lv_label_set_long_mode(_label, LV_LABEL_LONG_DOT);
+    lv_obj_set_style_text_color(_label, lv_color_white(), 0);
+    lv_obj_set_style_text_font(_label, &lv_font_montserrat_16, 0);
+    lv_obj_center(_label);
+  }
+
+  esp_err_t err = esp_event_handler_instance_register(
+      TUX_EVENTS, ESP_EVENT_ANY_ID, event_handler, this, &_handler);
+  // After registering, so nothing raised in between is missed
+  sync();
+  return err;
+}
+
+void AlarmBanner::event_handler(void *arg, esp_event_base_t base, int32_t id,
+                                void *data) {
+  if (id != TUX_EVENT_ALARM_RAISED && id != TUX_EVENT_ALARM_CLEARED &&
+      id != TUX_EVENT_ALARM_ACKED)
+    return;
+  reinterpret_cast<AlarmBanner *>(arg)->sync();
+}
+
+void AlarmBanner::clicked(lv_event_t *e) {
+  AlarmBanner *self = reinterpret_cast<AlarmBanner *>(lv_event_get_user_data(e));
+  self->_engine.acknowledge(self->_shown);
+}
+
+// Runs on the event task, and once on start()
+void AlarmBanner::sync() {
+  // Most severe first, newest among equals
+  AlarmEvent top;
+  size_t count = _engine.active(&top, 1);
+
+  std::lock_guard<GuiThread> lock(_gui);
+  if (count == 0) {
+    lv_obj_add_flag(_banner, LV_OBJ_FLAG_HIDDEN);
+    return;
+  }
+
+  _shown = top.id;
+  lv_color_t bg = top.severity == ALARM_ALARM ? lv_palette_main(LV_PALETTE_RED)
+                                              : lv_palette_main(LV_PALETTE_AMBER);
+  lv_obj_set_style_bg_color(_banner, bg, 0);
+  if (count > 1)
+    lv_label_set_text_fmt(_label, LV_SYMBOL_WARNING " %s (+%u)", top.message,
+                          unsigned(count - 1));
+  else
+    lv_label_set_text_fmt(_label, LV_SYMBOL_WARNING " %s", top.message);
+  lv_obj_clear_flag(_banner, LV_OBJ_FLAG_HIDDEN);
+}
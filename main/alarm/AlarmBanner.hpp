@@ -0,0 +1,68 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __ALARM_BANNER_HPP
+#define __ALARM_BANNER_HPP
+
+#include "AlarmEngine.hpp"
+#include "GuiThread.hpp"
+#include <esp_event.h>
+#include <lvgl.h>
+
+namespace ship {
+
+/**
+ * AlarmBanner shows unacknowledged alarms on the LVGL top layer, above
+ * every page. The most severe, most recent alarm is shown with a count of
+ * the others; tapping the banner acknowledges the shown alarm.
+ * The alarms are read from the engine at start and on every
+ * TUX_EVENT_ALARM_* event, so none raised before or between events is
+ * missed.
+ */
+class AlarmBanner {
+public:
+  AlarmBanner(GuiThread &gui, AlarmEngine &engine);
+  ~AlarmBanner();
+
+  /** \brief Creates the banner and subscribes to the alarm events. */
+  esp_err_t start();
+
+private:
+  static void event_handler(void *arg, esp_event_base_t base, int32_t id,
+                            void *data);
+  static void clicked(lv_event_t *e);
+  void sync();
+
+  GuiThread &_gui;
+  AlarmEngine &_engine;
+  lv_obj_t *_banner = nullptr;
+  lv_obj_t *_label = nullptr;
+  esp_event_handler_instance_t _handler = nullptr;
+
+  uint16_t _shown = 0;    // id of the alarm on the banner
+};
+
+} // namespace ship
+
+#endif // __ALARM_BANNER_HPP
@@ -0,0 +1,356 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "AlarmEngine.hpp"
+#include "ShipModel.hpp"
+#include "events/tux_events.hpp"
+#include "log_tag.hpp"
+#include <algorithm>
+#include <cmath>
+#include <esp_timer.h>
+
+using namespace ship;
+
+#define ALARM_QUEUE_LEN 32
+#define ALARM_TICK_MS   100    // delay resolution
+
+static constexpr double EARTH_RADIUS_M = 6371000.0;
+static constexpr double DEG_TO_RAD = 0.017453292519943295;
+
+AlarmEngine::~AlarmEngine() {
+  if (_task_handle)
+    vTaskDelete(_task_handle);
+  if (_queue)
+    vQueueDelete(_queue);
+  if (_mutex)
+    vSemaphoreDelete(_mutex);
+}
+
+esp_err_t AlarmEngine::compile(const AlarmRule *rules, size_t count) {
+  if (_task_handle || count > UINT16_MAX)
+    return ESP_ERR_INVALID_STATE;
+
+  _rules.clear();
+  _messages.clear();
+  _edges.clear();
+  _published.clear();
+  _rules.reserve(count);
+  _messages.reserve(count);
+  _edges.reserve(count * 2);
+  _published.reserve(count);
+
+  for (size_t i = 0; i < count; i++) {
+    const AlarmRule &r = rules[i];
+    if (r.input >= ALARM_INPUTS || r.hysteresis < 0)
+      return ESP_ERR_INVALID_ARG;
+    Rule c = {};
+    c.set = r.threshold;
+    c.clear = r.above ? r.threshold - r.hysteresis : r.threshold + r.hysteresis;
+    c.delay_ms = r.delay_ms;
+    c.input = r.input;
+    c.severity = r.severity;
+    c.state = ALARM_IDLE;
+    c.above = r.above;
+    c.latching = r.latching;
+    _rules.push_back(c);
+    _messages.push_back(r.message);
+    _published.push_back({{uint16_t(i), r.severity, ALARM_IDLE, NAN, r.message}, 0});
+    _edges.push_back({c.set, uint16_t(i)});
+    if (c.clear != c.set)
+      _edges.push_back({c.clear, uint16_t(i)});
+  }
+
+  // Group the edges by input, sorted by threshold within an input
+  std::sort(_edges.begin(), _edges.end(), [this](const Edge &a, const Edge &b) {
+    AlarmInput ia = _rules[a.rule].input, ib = _rules[b.rule].input;
+    return ia != ib ? ia < ib : a.threshold < b.threshold;
+  });
+  size_t e = 0;
+  for (size_t in = 0; in <= ALARM_INPUTS; in++) {
+    while (e < _edges.size() && _rules[_edges[e].rule].input < in)
+      e++;
+    _edge_begin[in] = e;
+  }
+
+  for (auto &v : _values)
+    v = NAN;
+  ESP_LOGI(TAG, "Alarms: %zu rules compiled", count);
+  return ESP_OK;
+}
+
+esp_err_t AlarmEngine::start() {
+  if (_task_handle)
+    return ESP_ERR_INVALID_STATE;
+
+  _queue = xQueueCreate(ALARM_QUEUE_LEN, sizeof(Msg));
+  _mutex = xSemaphoreCreateMutex();
+  if (!_queue || !_mutex)
+    return ESP_ERR_NO_MEM;
+
+  ShipModel &m = ShipModel::instance();
+  auto bind = [this](Observable<float> &o, AlarmInput input) {
+    o.subscribe([this, input](const float &v) { feed(input, v); });
+  };
+  bind(m.depth, ALARM_DEPTH);
+  bind(m.sog, ALARM_SOG);
+  bind(m.wind_speed, ALARM_WIND_SPEED);
+  bind(m.water_temp, ALARM_WATER_TEMP);
+  bind(m.engine_rpm, ALARM_ENGINE_RPM);
+  bind(m.engine_temp, ALARM_ENGINE_TEMP);
+  bind(m.battery_voltage, ALARM_BATTERY_VOLTAGE);
+  bind(m.battery_current, ALARM_BATTERY_CURRENT);
+  m.latitude.subscribe([this](const double &v) { post(MSG_LATITUDE, 0, 0, v); });
+  m.longitude.subscribe([this](const double &v) { post(MSG_LONGITUDE, 0, 0, v); });
+
+  BaseType_t res = xTaskCreatePinnedToCore(task_handler, "alarms", 1024 * 3,
+                                           this, 4, &_task_handle, 0);
+  return res == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void AlarmEngine::post(MsgType type, uint8_t input, uint16_t id, double v,
+                       double v2) {
+  if (!_queue)
+    return;
+  Msg msg = {type, input, id, v, v2};
+  if (xQueueSend(_queue, &msg, 0) != pdTRUE)
+    _dropped++;
+}
+
+void AlarmEngine::feed(AlarmInput input, float value) {
+  if (!std::isnan(value))
+    post(MSG_VALUE, input, 0, value);
+}
+
+void AlarmEngine::acknowledge(uint16_t id) { post(MSG_ACK, 0, id, 0); }
+
+void AlarmEngine::set_anchor(double latitude, double longitude) {
+  post(MSG_ANCHOR_SET, 0, 0, latitude, longitude);
+}
+
+void AlarmEngine::clear_anchor() { post(MSG_ANCHOR_CLEAR, 0, 0, 0); }
+
+void AlarmEngine::task_handler(void *arg) {
+  AlarmEngine *self = reinterpret_cast<AlarmEngine *>(arg);
+  Msg msg;
+  while (1) {
+    bool got = xQueueReceive(self->_queue, &msg, pdMS_TO_TICKS(ALARM_TICK_MS)) == pdTRUE;
+    int64_t now = esp_timer_get_time() / 1000;
+    if (got)
+      self->handle(msg, now);
+    if (!self->_pending.empty())
+      self->run_delays(now);
+    if (self->_repost_event >= 0)
+      self->post_event(self->_repost_event, self->_repost_id);
+  }
+}
+
+void AlarmEngine::handle(const Msg &msg, int64_t now) {
+  switch (msg.type) {
+  case MSG_VALUE:
+    update(AlarmInput(msg.input), msg.value, now);
+    break;
+  case MSG_LATITUDE:
+    _latitude = msg.value;
+    break;
+  case MSG_LONGITUDE:
+    // Position updates come as latitude then longitude
+    _longitude = msg.value;
+    update_anchor(now);
+    break;
+  case MSG_ANCHOR_SET:
+    _anchor_lat = msg.value;
+    _anchor_lon = msg.value2;
+    _anchored = true;
+    update_anchor(now);
+    break;
+  case MSG_ANCHOR_CLEAR:
+    _anchored = false;
+    update(ALARM_ANCHOR_DISTANCE, 0, now);
+    break;
+  case MSG_ACK: {
+    if (msg.id >= _rules.size())
+      break;
+    Rule &r = _rules[msg.id];
+    if (r.state != ALARM_ACTIVE)
+      break;
+    r.state = r.condition ? ALARM_ACKED : ALARM_IDLE;
+    notify(TUX_EVENT_ALARM_ACKED, msg.id);
+    break;
+  }
+  }
+}
+
+void AlarmEngine::update_anchor(int64_t now) {
+  if (!_anchored || std::isnan(_latitude) || std::isnan(_longitude))
+    return;
+  // Equirectangular is exact enough over an anchor swing
+  double x = (_longitude - _anchor_lon) * DEG_TO_RAD *
+             cos((_latitude + _anchor_lat) * 0.5 * DEG_TO_RAD);
+  double y = (_latitude - _anchor_lat) * DEG_TO_RAD;
+  update(ALARM_ANCHOR_DISTANCE, sqrt(x * x + y * y) * EARTH_RADIUS_M, now);
+}
+
+void AlarmEngine::update(AlarmInput input, float value, int64_t now) {
+  float old = _values[input];
+  _values[input] = value;
+  if (old == value)
+    return;
+
+  auto first = _edges.begin() + _edge_begin[input];
+  auto last = _edges.begin() + _edge_begin[input + 1];
+  if (!std::isnan(old)) {
+    // Only thresholds between the old and the new value can flip a rule
+    float lo = std::min(old, value), hi = std::max(old, value);
+    auto cmp = [](const Edge &e, float t) { return e.threshold < t; };
+    first = std::lower_bound(first, last, lo, cmp);
+    last = std::upper_bound(first, last, hi, [](float t, const Edge &e) {
+      return t < e.threshold;
+    });
+  }
+  for (auto it = first; it != last; ++it)
+    evaluate(it->rule, value, now);
+}
+
+void AlarmEngine::evaluate(uint16_t id, float value, int64_t now) {
+  Rule &r = _rules[id];
+  _evaluations++;
+
+  bool cond = r.condition;
+  if (r.above)
+    cond = cond ? value >= r.clear : value > r.set;
+  else
+    cond = cond ? value <= r.clear : value < r.set;
+  if (cond == r.condition)
+    return;
+  r.condition = cond;
+
+  if (cond) {
+    r.since_ms = now;
+    if (r.state != ALARM_IDLE)
+      return; // latched alarm re-occurring, still waiting for the ack
+    if (r.delay_ms == 0) {
+      r.state = ALARM_ACTIVE;
+      notify(TUX_EVENT_ALARM_RAISED, id);
+    } else {
+      r.state = ALARM_PENDING;
+      if (!r.pending) {
+        r.pending = true;
+        _pending.push_back(id);
+      }
+    }
+    return;
+  }
+
+  switch (r.state) {
+  case ALARM_PENDING:
+    r.state = ALARM_IDLE; // dropped from _pending on the next tick
+    break;
+  case ALARM_ACTIVE:
+    if (!r.latching) {
+      r.state = ALARM_IDLE;
+      notify(TUX_EVENT_ALARM_CLEARED, id);
+    }
+    break;
+  case ALARM_ACKED:
+    r.state = ALARM_IDLE;
+    notify(TUX_EVENT_ALARM_CLEARED, id);
+    break;
+  default:
+    break;
+  }
+}
+
+void AlarmEngine::run_delays(int64_t now) {
+  auto it = std::remove_if(_pending.begin(), _pending.end(), [&](uint16_t id) {
+    Rule &r = _rules[id];
+    if (r.state == ALARM_PENDING && now - r.since_ms < int64_t(r.delay_ms))
+      return false;
+    if (r.state == ALARM_PENDING) {
+      r.state = ALARM_ACTIVE;
+      notify(TUX_EVENT_ALARM_RAISED, id);
+    }
+    r.pending = false;
+    return true;
+  });
+  _pending.erase(it, _pending.end());
+}
+
+void AlarmEngine::notify(int32_t event, uint16_t id) {
+  const Rule &r = _rules[id];
+  AlarmEvent ev = {id, r.severity, r.state, _values[r.input], _messages[id]};
+  ESP_LOGW(TAG, "Alarm %u %s: %s (%.2f)", id,
+           event == TUX_EVENT_ALARM_RAISED    ? "raised"
+           : event == TUX_EVENT_ALARM_CLEARED ? "cleared"
+                                              : "acknowledged",
+           ev.message, ev.value);
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  Published &p = _published[id];
+  p.event = ev;
+  if (event == TUX_EVENT_ALARM_RAISED)
+    p.raised = ++_raised;
+  xSemaphoreGive(_mutex);
+
+  post_event(event, id);
+}
+
+// Never waits for the UI. A full event loop is retried every tick; the
+// event only tells the UI to read active() again, so the latest is enough.
+void AlarmEngine::post_event(int32_t event, uint16_t id) {
+  AlarmEvent ev = _published[id].event;
+  if (esp_event_post(TUX_EVENTS, event, &ev, sizeof(ev), 0) == ESP_OK) {
+    _repost_event = -1;
+  } else {
+    if (_repost_event < 0)
+      _dropped++;
+    _repost_event = event;
+    _repost_id = id;
+  }
+}
+
+size_t AlarmEngine::active(AlarmEvent *out, size_t max) {
+  if (!_mutex)
+    return 0;
+  size_t count = 0, n = 0;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  for (const auto &p : _published) {
+    if (p.event.state != ALARM_ACTIVE)
+      continue;
+    count++;
+    // Insertion into out, which stays sorted; the table is small
+    auto before = [&](const AlarmEvent &q) {
+      return p.event.severity != q.severity ? p.event.severity > q.severity
+                                            : p.raised > _published[q.id].raised;
+    };
+    size_t i = n < max ? n++ : max;
+    for (; i > 0 && before(out[i - 1]); i--) {
+      if (i < max)
+        out[i] = out[i - 1];
+    }
+    if (i < max)
+      out[i] = p.event;
+  }
+  xSemaphoreGive(_mutex);
+  return count;
+}
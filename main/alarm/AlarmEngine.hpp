@@ -0,0 +1,207 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __ALARM_ENGINE_HPP
+#define __ALARM_ENGINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <vector>
+
+namespace ship {
+
+/* Values rules can watch. ANCHOR_DISTANCE is derived from the position. */
+enum AlarmInput : uint8_t {
+  ALARM_DEPTH,            // metres
+  ALARM_SOG,              // knots
+  ALARM_WIND_SPEED,       // knots
+  ALARM_WATER_TEMP,       // Kelvin
+  ALARM_ENGINE_RPM,
+  ALARM_ENGINE_TEMP,      // Kelvin
+  ALARM_BATTERY_VOLTAGE,
+  ALARM_BATTERY_CURRENT,
+  ALARM_ANCHOR_DISTANCE,  // metres from the dropped anchor
+  ALARM_INPUTS
+};
+
+enum AlarmSeverity : uint8_t { ALARM_WARNING, ALARM_ALARM };
+
+enum AlarmState : uint8_t {
+  ALARM_IDLE,       // condition false
+  ALARM_PENDING,    // condition true, waiting for the delay
+  ALARM_ACTIVE,     // raised, not acknowledged
+  ALARM_ACKED,      // raised, acknowledged, condition still true
+};
+
+/**
+ * One alarm rule. Fires when the input goes above (or below) threshold
+ * and clears once it is back past threshold -/+ hysteresis.
+ * A latching alarm stays active after clearing until acknowledged.
+ */
+struct AlarmRule {
+  const char *message;    // shown on the banner, must stay valid
+  AlarmInput input;
+  bool above;             // true: fire above threshold, false: below
+  float threshold;
+  float hysteresis;
+  uint32_t delay_ms;      // condition must hold this long before raising
+  AlarmSeverity severity;
+  bool latching;
+};
+
+/* Payload of TUX_EVENT_ALARM_RAISED / _CLEARED / _ACKED */
+struct AlarmEvent {
+  uint16_t id;            // index of the rule in the compiled table
+  AlarmSeverity severity;
+  AlarmState state;       // state after the change
+  float value;            // input value at the time of the change
+  const char *message;
+};
+
+/**
+ * AlarmEngine evaluates a rule table against the ShipModel.
+ *
+ * compile() flattens the rules and builds, per input, a table of the set
+ * and clear thresholds sorted by value. When an input moves from a to b
+ * only the rules with a threshold between a and b can change state, so an
+ * update costs a binary search plus the rules actually crossed, however
+ * many rules watch that input.
+ *
+ * Updates are queued from the writer tasks without blocking and evaluated
+ * on the engine task, which also runs the delays. State changes are posted
+ * as TUX_EVENTS for the UI, and retried while the event loop is full; the
+ * UI reads the state itself with active().
+ */
+class AlarmEngine {
+public:
+  AlarmEngine() = default;
+  ~AlarmEngine();
+
+  /** \fn esp_err_t compile(const AlarmRule *rules, size_t count)
+   *  \brief Builds the rule table. Call once before start().
+   */
+  esp_err_t compile(const AlarmRule *rules, size_t count);
+
+  /** \brief Subscribes to the ShipModel and starts the engine task. */
+  esp_err_t start();
+
+  /** \brief Queues a new input value. Never blocks; NAN is ignored. */
+  void feed(AlarmInput input, float value);
+
+  /** \brief Acknowledges an alarm by AlarmEvent::id. */
+  void acknowledge(uint16_t id);
+
+  /** \fn size_t active(AlarmEvent *out, size_t max)
+   *  \brief Unacknowledged alarms, ALARM severity first, newest first
+   *         within a severity. Thread safe.
+   *  \returns number of unacknowledged alarms; at most max are written.
+   */
+  size_t active(AlarmEvent *out, size_t max);
+
+  /** \brief Anchor position for ALARM_ANCHOR_DISTANCE. */
+  void set_anchor(double latitude, double longitude);
+  void clear_anchor();
+
+  /** \brief Rules evaluated so far, to keep an eye on the cost. */
+  uint32_t evaluations() const { return _evaluations; }
+
+  /** \brief Updates lost because the queue was full. */
+  uint32_t dropped() const { return _dropped; }
+
+private:
+  enum MsgType : uint8_t { MSG_VALUE, MSG_LATITUDE, MSG_LONGITUDE, MSG_ACK,
+                           MSG_ANCHOR_SET, MSG_ANCHOR_CLEAR };
+  struct Msg {
+    MsgType type;
+    uint8_t input;
+    uint16_t id;
+    double value;
+    double value2;
+  };
+
+  struct Rule {
+    float set;            // threshold that raises
+    float clear;          // threshold that clears, includes hysteresis
+    uint32_t delay_ms;
+    int64_t since_ms;     // condition became true
+    AlarmInput input;
+    AlarmSeverity severity;
+    AlarmState state;
+    bool above : 1;
+    bool latching : 1;
+    bool condition : 1;
+    bool pending : 1;     // listed in _pending
+  };
+
+  struct Edge {
+    float threshold;
+    uint16_t rule;
+  };
+
+  static void task_handler(void *arg);
+  void post(MsgType type, uint8_t input, uint16_t id, double v, double v2 = 0);
+  void handle(const Msg &msg, int64_t now);
+  void update(AlarmInput input, float value, int64_t now);
+  void evaluate(uint16_t id, float value, int64_t now);
+  void run_delays(int64_t now);
+  void update_anchor(int64_t now);
+  void notify(int32_t event, uint16_t id);
+  void post_event(int32_t event, uint16_t id);
+
+  std::vector<Rule> _rules;
+  std::vector<const char *> _messages;
+  std::vector<Edge> _edges;                 // grouped by input, sorted by threshold
+  uint16_t _edge_begin[ALARM_INPUTS + 1] = {};
+  std::vector<uint16_t> _pending;           // rules waiting for their delay
+  float _values[ALARM_INPUTS];
+
+  // Last notified state per rule, read by active(); guarded by _mutex
+  struct Published {
+    AlarmEvent event;
+    uint32_t raised;      // order of raising, to sort by age
+  };
+  std::vector<Published> _published;
+  uint32_t _raised = 0;
+  SemaphoreHandle_t _mutex = nullptr;
+  int32_t _repost_event = -1;               // event the loop had no room for
+  uint16_t _repost_id = 0;
+
+  double _latitude = 0, _longitude = 0;
+  double _anchor_lat = 0, _anchor_lon = 0;
+  bool _anchored = false;
+
+  QueueHandle_t _queue = nullptr;
+  TaskHandle_t _task_handle = nullptr;
+  uint32_t _evaluations = 0;
+  uint32_t _dropped = 0;
+};
+
+} // namespace ship
+
+#endif // __ALARM_ENGINE_HPP
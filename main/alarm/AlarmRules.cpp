@@ -0,0 +1,48 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "AlarmRules.hpp"
+#include <sdkconfig.h>
+
+using namespace ship;
+
+#if defined(CONFIG_ALARM_ENABLE)
+
+static constexpr float CELSIUS_TO_KELVIN = 273.15f;
+
+const AlarmRule ship::alarm_rules[] = {
+    // message, input, above, threshold, hysteresis, delay, severity, latching
+    {"Shallow water", ALARM_DEPTH, false,
+     CONFIG_ALARM_SHALLOW_DEPTH_DM / 10.0f, 0.5f, 2000, ALARM_ALARM, false},
+    {"Anchor drag", ALARM_ANCHOR_DISTANCE, true,
+     CONFIG_ALARM_ANCHOR_RADIUS_M, 5.0f, 10000, ALARM_ALARM, true},
+    {"Engine temperature high", ALARM_ENGINE_TEMP, true,
+     CONFIG_ALARM_ENGINE_TEMP_C + CELSIUS_TO_KELVIN, 3.0f, 5000, ALARM_ALARM, true},
+    {"Battery low", ALARM_BATTERY_VOLTAGE, false,
+     CONFIG_ALARM_BATTERY_LOW_MV / 1000.0f, 0.3f, 30000, ALARM_WARNING, false},
+};
+
+const size_t ship::alarm_rules_count = sizeof(alarm_rules) / sizeof(alarm_rules[0]);
+
+#endif // CONFIG_ALARM_ENABLE
@@ -0,0 +1,86 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "AnchorButton.hpp"
+#include "ShipModel.hpp"
+#include "log_tag.hpp"
+#include <cmath>
+#include <mutex>
+
+using namespace ship;
+
+#define ANCHOR_FIX_MAX_AGE_MS 5000 // older positions do not set the anchor
+
+AnchorButton::AnchorButton(GuiThread &gui, AlarmEngine &engine)
+    : _gui(gui), _engine(engine) {}
+
+AnchorButton::~AnchorButton() {
+  if (_button) {
+    std::lock_guard<GuiThread> lock(_gui);
+    lv_obj_del(_button);
+  }
+}
+
+void AnchorButton::start() {
+  std::lock_guard<GuiThread> lock(_gui);
+  _button = lv_btn_create(lv_layer_top());
+  lv_obj_align(_button, LV_ALIGN_BOTTOM_RIGHT, -10, -10);
+  // Not checkable: the checked state follows the anchor, set by toggle()
+  lv_obj_add_event_cb(_button, long_pressed, LV_EVENT_LONG_PRESSED, this);
+
+  _label = lv_label_create(_button);
+  lv_label_set_text(_label, "Anchor");
+  lv_obj_center(_label);
+}
+
+void AnchorButton::long_pressed(lv_event_t *e) {
+  reinterpret_cast<AnchorButton *>(lv_event_get_user_data(e))->toggle();
+}
+
+// Runs on the LVGL task, which holds the GUI lock
+void AnchorButton::toggle() {
+  if (_anchored) {
+    _engine.clear_anchor();
+    _anchored = false;
+    lv_obj_clear_state(_button, LV_STATE_CHECKED);
+    lv_label_set_text(_label, "Anchor");
+    ESP_LOGI(TAG, "Anchor weighed");
+    return;
+  }
+
+  ShipModel &m = ShipModel::instance();
+  double lat = m.latitude.get(), lon = m.longitude.get();
+  if (!m.latitude.is_fresh(ANCHOR_FIX_MAX_AGE_MS) ||
+      !m.longitude.is_fresh(ANCHOR_FIX_MAX_AGE_MS) || std::isnan(lat) ||
+      std::isnan(lon)) {
+    ESP_LOGW(TAG, "No position fix, anchor not set");
+    lv_label_set_text(_label, "No fix");
+    return;
+  }
+  _engine.set_anchor(lat, lon);
+  _anchored = true;
+  lv_obj_add_state(_button, LV_STATE_CHECKED);
+  lv_label_set_text(_label, LV_SYMBOL_OK " Anchored");
+  ESP_LOGI(TAG, "Anchor set at %.6f, %.6f", lat, lon);
+}
@@ -0,0 +1,62 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __ANCHOR_BUTTON_HPP
+#define __ANCHOR_BUTTON_HPP
+
+#include "AlarmEngine.hpp"
+#include "GuiThread.hpp"
+#include <lvgl.h>
+
+namespace ship {
+
+/**
+ * AnchorButton drops the anchor for the "Anchor drag" alarm. It sits in
+ * the bottom right corner of the LVGL top layer, above every page.
+ * A long press sets the anchor at the current position, another long
+ * press weighs it; a long press, so a brush of the screen does not move
+ * the anchor. Without a fresh position the anchor is not set.
+ */
+class AnchorButton {
+public:
+  AnchorButton(GuiThread &gui, AlarmEngine &engine);
+  ~AnchorButton();
+
+  /** \brief Creates the button. */
+  void start();
+
+private:
+  static void long_pressed(lv_event_t *e);
+  void toggle();
+
+  GuiThread &_gui;
+  AlarmEngine &_engine;
+  lv_obj_t *_button = nullptr;
+  lv_obj_t *_label = nullptr;
+  bool _anchored = false;   // touched by the LVGL task only
+};
+
+} // namespace ship
+
+#endif // __ANCHOR_BUTTON_HPP
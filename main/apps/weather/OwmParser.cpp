@@ -0,0 +1,152 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "OwmParser.hpp"
+#include <cstdlib>
+#include <cstring>
+
+using namespace ship;
+
+// NAN != NAN, so compare missing values as equal
+static bool same(float a, float b) {
+  return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+bool OwmWeather::operator==(const OwmWeather &o) const {
+  return same(temp, o.temp) && same(feels_like, o.feels_like) &&
+         same(humidity, o.humidity) && same(pressure, o.pressure) &&
+         same(wind_speed, o.wind_speed) && same(wind_deg, o.wind_deg) &&
+         same(wind_gust, o.wind_gust) && condition == o.condition &&
+         memcmp(icon, o.icon, sizeof(icon)) == 0 && dt == o.dt;
+}
+
+// Out of range or fractional input must not be undefined behaviour
+static uint32_t to_uint(double v, uint32_t max) {
+  if (!(v >= 0))
+    return 0;
+  return v >= double(max) ? max : uint32_t(v);
+}
+
+void OwmParser::reset() {
+  _sax.reset();
+  _weather = OwmWeather();
+  _section = SEC_NONE;
+  _element = 0;
+  _seen = 0;
+  _cod = 0;
+  _complete = false;
+}
+
+bool OwmParser::feed(const char *data, size_t len) {
+  // Only whitespace may follow the document, e.g. a trailing newline
+  return _sax.feed(data, len);
+}
+
+bool OwmParser::finish() const {
+  return _complete && !_sax.error() && _cod == 200 &&
+         (_seen & (F_TEMP | F_CONDITION)) == (F_TEMP | F_CONDITION);
+}
+
+void OwmParser::onObjectStart() {
+  // Depth 2 objects are the sections of the root object
+  if (_sax.depth() == 2) {
+    const char *k = _sax.key();
+    _section = strcmp(k, "main") == 0   ? SEC_MAIN
+               : strcmp(k, "wind") == 0 ? SEC_WIND
+                                        : SEC_OTHER;
+  } else if (_sax.depth() == 3 && _section == SEC_WEATHER && _element < 255) {
+    _element++;
+  }
+}
+
+void OwmParser::onObjectEnd() {
+  if (_sax.depth() == 2)
+    _section = SEC_NONE;
+}
+
+void OwmParser::onArrayStart() {
+  if (_sax.depth() == 2)
+    _section = strcmp(_sax.key(), "weather") == 0 ? SEC_WEATHER : SEC_OTHER;
+}
+
+void OwmParser::onArrayEnd() {
+  if (_sax.depth() == 2)
+    _section = SEC_NONE;
+}
+
+void OwmParser::onString(const char *value) {
+  const char *k = _sax.key();
+  switch (_sax.depth()) {
+  case 1:
+    // Error responses carry cod as a string, e.g. "404"
+    if (strcmp(k, "cod") == 0)
+      _cod = uint16_t(to_uint(strtod(value, nullptr), UINT16_MAX));
+    break;
+  case 3:
+    if (_section == SEC_WEATHER && _element == 1 && strcmp(k, "icon") == 0) {
+      strncpy(_weather.icon, value, sizeof(_weather.icon) - 1);
+      _weather.icon[sizeof(_weather.icon) - 1] = '\0';
+    }
+    break;
+  }
+}
+
+void OwmParser::onNumber(double value) {
+  const char *k = _sax.key();
+  switch (_sax.depth()) {
+  case 1:
+    if (strcmp(k, "cod") == 0)
+      _cod = uint16_t(to_uint(value, UINT16_MAX));
+    else if (strcmp(k, "dt") == 0)
+      _weather.dt = to_uint(value, UINT32_MAX);
+    break;
+  case 2:
+    if (_section == SEC_MAIN) {
+      if (strcmp(k, "temp") == 0) {
+        _weather.temp = float(value);
+        _seen |= F_TEMP;
+      } else if (strcmp(k, "feels_like") == 0) {
+        _weather.feels_like = float(value);
+      } else if (strcmp(k, "humidity") == 0) {
+        _weather.humidity = float(value);
+      } else if (strcmp(k, "pressure") == 0) {
+        _weather.pressure = float(value);
+      }
+    } else if (_section == SEC_WIND) {
+      if (strcmp(k, "speed") == 0)
+        _weather.wind_speed = float(value);
+      else if (strcmp(k, "deg") == 0)
+        _weather.wind_deg = float(value);
+      else if (strcmp(k, "gust") == 0)
+        _weather.wind_gust = float(value);
+    }
+    break;
+  case 3:
+    if (_section == SEC_WEATHER && _element == 1 && strcmp(k, "id") == 0) {
+      _weather.condition = uint16_t(to_uint(value, UINT16_MAX));
+      _seen |= F_CONDITION;
+    }
+    break;
+  }
+}
@@ -0,0 +1,117 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __OWM_PARSER_HPP
+#define __OWM_PARSER_HPP
+
+#include <JsonSax.h>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace ship {
+
+/*
+    Streaming extractor for the OpenWeatherMap "current weather" response.
+    The HTTP body is fed chunk by chunk as it arrives; only the fields shown
+    on the weather page are kept, everything else is skipped by the SAX
+    parser without being stored. No DOM, no heap, constant stack.
+*/
+
+/** Fields of the OWM response that are displayed. Missing numbers are NAN. */
+struct OwmWeather {
+  float temp = NAN;           // in the requested units
+  float feels_like = NAN;
+  float humidity = NAN;       // %
+  float pressure = NAN;       // hPa
+  float wind_speed = NAN;     // m/s (metric) or mph (imperial)
+  float wind_deg = NAN;
+  float wind_gust = NAN;
+  uint16_t condition = 0;     // weather[0].id, e.g. 804
+  char icon[4] = {};          // weather[0].icon, e.g. "04n"
+  uint32_t dt = 0;            // time of the observation, unix seconds
+
+  /** \brief Night time icon variant ("..n"). */
+  bool is_night() const { return icon[2] == 'n'; }
+
+  bool operator==(const OwmWeather &o) const;
+  bool operator!=(const OwmWeather &o) const { return !(*this == o); }
+};
+
+class OwmParser : private JsonHandler {
+public:
+  OwmParser() : _sax(*this, true) {}
+  OwmParser(const OwmParser &) = delete;
+  OwmParser &operator=(const OwmParser &) = delete;
+
+  /** \brief Starts a new response. */
+  void reset();
+
+  /** \fn bool feed(const char *data, size_t len)
+   *  \brief Parses the next chunk of the HTTP body.
+   *  \returns false once the body is malformed; further input is ignored.
+   */
+  bool feed(const char *data, size_t len);
+
+  /** \fn bool finish()
+   *  \brief Call at the end of the body.
+   *  \returns true if a complete, well formed response with cod 200 and at
+   *  least the temperature and the condition code was parsed.
+   */
+  bool finish() const;
+
+  /** \brief Extracted fields, valid after finish() returned true. */
+  const OwmWeather &weather() const { return _weather; }
+
+  /** \brief OWM status code ("cod"), 0 if not seen yet. */
+  uint16_t status() const { return _cod; }
+
+private:
+  enum Section : uint8_t { SEC_NONE, SEC_MAIN, SEC_WIND, SEC_WEATHER, SEC_OTHER };
+
+  enum Field : uint8_t {
+    F_TEMP = 1 << 0,
+    F_CONDITION = 1 << 1,
+  };
+
+  void onObjectStart() override;
+  void onObjectEnd() override;
+  void onArrayStart() override;
+  void onArrayEnd() override;
+  void onString(const char *value) override;
+  void onNumber(double value) override;
+  void onDocumentEnd() override { _complete = true; }
+
+  JsonSax _sax;
+  OwmWeather _weather;
+  Section _section = SEC_NONE;
+  uint8_t _element = 0;       // 1 based index of the object in weather[]
+  uint8_t _seen = 0;          // Field bits
+  uint16_t _cod = 0;
+  bool _complete = false;
+};
+
+} // namespace ship
+
+#endif // __OWM_PARSER_HPP
@@ -0,0 +1,247 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Weather.hpp"
+#include "events/gui_events.hpp"
+#include "events/tux_events.hpp"
+#include "log_tag.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <esp_http_client.h>
+#include <esp_rom_crc.h>
+#include <esp_wifi.h>
+#include <lvgl.h>
+#include <mutex>
+
+using namespace ship;
+
+#if defined(CONFIG_WEATHER_UNITS_METRIC)
+#define WEATHER_UNITS "metric"
+#elif defined(CONFIG_WEATHER_UNITS_IMPERIAL)
+#define WEATHER_UNITS "imperial"
+#else
+#define WEATHER_UNITS "standard"
+#endif
+
+static constexpr uint32_t CACHE_MAGIC = 0x314d574f; // "OWM1"
+static constexpr int HTTP_TIMEOUT_MS = 10000;
+static constexpr size_t HTTP_CHUNK = 256;
+
+// Anything before this is an unset RTC, not a real fetch time
+static constexpr time_t CLOCK_VALID = 1640995200; // 2022-01-01
+
+// On-flash layout; versioned by the magic, guarded by the CRC
+struct WeatherCacheFile {
+  uint32_t magic;
+  uint32_t size;
+  int64_t fetched;
+  OwmWeather weather;
+  uint32_t crc;
+};
+
+static uint32_t cache_crc(const WeatherCacheFile &f) {
+  return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&f),
+                          offsetof(WeatherCacheFile, crc));
+}
+
+Weather::Weather(GuiThread &gui, const char *cache_path, uint32_t interval_s)
+    : _gui(gui), _cache_path(cache_path),
+      _interval_s(std::max(interval_s, OWM_MIN_INTERVAL_S)) {
+#if defined(CONFIG_WEATHER_USE_LOCAL)
+  snprintf(_url, sizeof(_url), "http://%s/weather.json",
+           CONFIG_WEATHER_LOCAL_URL);
+#else
+  snprintf(_url, sizeof(_url),
+           "http://%s/data/2.5/weather?units=" WEATHER_UNITS "&q=%s&APPID=%s",
+           CONFIG_WEATHER_OWM_URL, CONFIG_WEATHER_LOCATION,
+           CONFIG_WEATHER_API_KEY);
+#endif
+}
+
+Weather::~Weather() {
+  esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, ip_event_handler);
+  if (_task_handle)
+    vTaskDelete(_task_handle);
+}
+
+esp_err_t Weather::start() {
+  if (load_cache()) {
+    ESP_LOGI(TAG, "Weather from cache: %.1f, condition %u",
+             _weather.temp, _weather.condition);
+    _have = true;
+    publish();
+  }
+  return esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                    ip_event_handler, this);
+}
+
+void Weather::ip_event_handler(void *arg, esp_event_base_t base, int32_t id,
+                               void *data) {
+  Weather *self = reinterpret_cast<Weather *>(arg);
+  // The task keeps its own schedule across reconnects
+  if (!self->_started) {
+    self->_started =
+        xTaskCreatePinnedToCore(task_handler, "weather", 1024 * 6, self, 1,
+                                &self->_task_handle, 0) == pdPASS;
+  }
+}
+
+void Weather::task_handler(void *arg) {
+  Weather *self = reinterpret_cast<Weather *>(arg);
+
+  vTaskDelay(pdMS_TO_TICKS(self->first_delay_s() * 1000));
+  for (;;) {
+    OwmWeather w;
+    self->_fetches++;
+    if (self->fetch(w)) {
+      time_t now = time(nullptr);
+      self->_fetched = now >= CLOCK_VALID ? now : 0;
+      self->apply(w);
+    } else {
+      self->_failures++;
+    }
+    // Failures wait the full interval too, to stay within the API limit
+    vTaskDelay(pdMS_TO_TICKS(self->_interval_s * 1000));
+  }
+}
+
+uint32_t Weather::first_delay_s() const {
+  time_t now = time(nullptr);
+  if (_fetched == 0 || now < CLOCK_VALID || now < _fetched)
+    return 0;
+  time_t age = now - _fetched;
+  return age >= time_t(_interval_s) ? 0 : uint32_t(_interval_s - age);
+}
+
+bool Weather::fetch(OwmWeather &out) {
+  esp_http_client_config_t config = {};
+  config.url = _url;
+  config.timeout_ms = HTTP_TIMEOUT_MS;
+
+  esp_http_client_handle_t client = esp_http_client_init(&config);
+  if (!client)
+    return false;
+
+  bool ok = false;
+  if (esp_http_client_open(client, 0) == ESP_OK &&
+      esp_http_client_fetch_headers(client) >= 0) {
+    int status = esp_http_client_get_status_code(client);
+    // The body is parsed as it arrives; only the wanted fields are kept
+    _parser.reset();
+    char buf[HTTP_CHUNK];
+    int n;
+    while ((n = esp_http_client_read(client, buf, sizeof(buf))) > 0)
+      if (!_parser.feed(buf, n))
+        break;
+
+    ok = status == 200 && n >= 0 && _parser.finish();
+    if (ok)
+      out = _parser.weather();
+    else
+      ESP_LOGW(TAG, "Weather fetch failed: HTTP %d, cod %u", status,
+               _parser.status());
+  } else {
+    ESP_LOGW(TAG, "Weather fetch failed: no connection to %s",
+             CONFIG_WEATHER_OWM_URL);
+  }
+  esp_http_client_close(client);
+  esp_http_client_cleanup(client);
+  return ok;
+}
+
+void Weather::apply(const OwmWeather &w) {
+  // The observation time is not displayed, so it alone is no change
+  OwmWeather same = w;
+  same.dt = _weather.dt;
+  if (_have && same == _weather) {
+    _weather.dt = w.dt;
+    _unchanged++;
+    return;
+  }
+  _weather = w;
+  _have = true;
+  publish();
+  save_cache();
+}
+
+void Weather::publish() {
+  {
+    std::lock_guard<GuiThread> lock(_gui);
+    lv_msg_send(MSG_WEATHER_CHANGED, &_weather);
+  }
+  esp_event_post(TUX_EVENTS, TUX_EVENT_WEATHER_UPDATED, nullptr, 0, 0);
+}
+
+bool Weather::load_cache() {
+  // A power loss between remove and rename in save_cache() leaves only
+  // the temp file, which is complete by then
+  char tmp[64];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", _cache_path);
+  FILE *f = fopen(_cache_path, "rb");
+  if (!f)
+    f = fopen(tmp, "rb");
+  if (!f)
+    return false;
+  WeatherCacheFile c;
+  bool ok = fread(&c, sizeof(c), 1, f) == 1;
+  fclose(f);
+
+  if (!ok || c.magic != CACHE_MAGIC || c.size != sizeof(c) ||
+      c.crc != cache_crc(c)) {
+    ESP_LOGW(TAG, "Weather cache %s is invalid, ignored", _cache_path);
+    return false;
+  }
+  _weather = c.weather;
+  _fetched = time_t(c.fetched);
+  return true;
+}
+
+void Weather::save_cache() {
+  WeatherCacheFile c = {};
+  c.magic = CACHE_MAGIC;
+  c.size = sizeof(c);
+  c.fetched = int64_t(_fetched);
+  c.weather = _weather;
+  c.crc = cache_crc(c);
+
+  // Write a temp file and swap it in, so power loss keeps the old cache
+  char tmp[64];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", _cache_path);
+  FILE *f = fopen(tmp, "wb");
+  if (!f) {
+    ESP_LOGW(TAG, "Weather cache %s not writable", tmp);
+    return;
+  }
+  bool ok = fwrite(&c, sizeof(c), 1, f) == 1;
+  ok = fclose(f) == 0 && ok;
+  // SPIFFS rename does not replace an existing file
+  if (ok) {
+    remove(_cache_path);
+    ok = rename(tmp, _cache_path) == 0;
+  }
+  if (!ok)
+    ESP_LOGW(TAG, "Weather cache %s not saved", _cache_path);
+}
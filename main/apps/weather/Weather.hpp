@@ -0,0 +1,104 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __WEATHER_HPP
+#define __WEATHER_HPP
+
+#include "GuiThread.hpp"
+#include "OwmParser.hpp"
+#include <esp_event.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <ctime>
+
+namespace ship {
+
+// OWM free tier allows one request per minute (apps/weather/readme.txt)
+static constexpr uint32_t OWM_MIN_INTERVAL_S = 60;
+
+/**
+ * Weather fetches the OpenWeatherMap current weather and keeps the last
+ * good result in a small binary cache on SPIFFS, next to weather.json.
+ *
+ * At start the cached struct is published straight away, so the panel shows
+ * the last known weather before Wi-Fi is up. Refreshes run on their own task
+ * once the station got an IP, no more often than the refresh interval, which
+ * is never shorter than OWM_MIN_INTERVAL_S - also across reboots, using the
+ * fetch time stored in the cache.
+ *
+ * Results are published (MSG_WEATHER_CHANGED with a const OwmWeather *,
+ * TUX_EVENT_WEATHER_UPDATED) and written back only when a displayed value
+ * changed; a new observation time alone is not a change.
+ */
+class Weather {
+public:
+  /** \fn Weather(GuiThread &gui, const char *cache_path, uint32_t interval_s)
+   *  \param gui: GUI thread, locked while publishing to the panel.
+   *  \param cache_path: binary cache file, e.g. "/spiffs/weather/cache.bin".
+   *  \param interval_s: refresh interval, raised to OWM_MIN_INTERVAL_S.
+   */
+  Weather(GuiThread &gui, const char *cache_path, uint32_t interval_s);
+  ~Weather();
+
+  /** \brief Publishes the cached weather and fetches once the station got an IP. */
+  esp_err_t start();
+
+  /** \brief Last published weather; check has_data() first. */
+  const OwmWeather &weather() const { return _weather; }
+  bool has_data() const { return _have; }
+
+  uint32_t fetches() const { return _fetches; }
+  uint32_t failures() const { return _failures; }
+  uint32_t unchanged() const { return _unchanged; }
+
+private:
+  static void ip_event_handler(void *arg, esp_event_base_t base, int32_t id,
+                               void *data);
+  static void task_handler(void *arg);
+  uint32_t first_delay_s() const;
+  bool fetch(OwmWeather &out);
+  void apply(const OwmWeather &w);
+  void publish();
+  bool load_cache();
+  void save_cache();
+
+  GuiThread &_gui;
+  const char *_cache_path;
+  uint32_t _interval_s;
+  char _url[256];
+  OwmParser _parser;
+  OwmWeather _weather;
+  bool _have = false;
+  time_t _fetched = 0; // wall clock of the last good fetch, 0 if unknown
+  bool _started = false;
+  TaskHandle_t _task_handle = nullptr;
+
+  uint32_t _fetches = 0;
+  uint32_t _failures = 0;
+  uint32_t _unchanged = 0;
+};
+
+} // namespace ship
+
+#endif // __WEATHER_HPP
@@ -0,0 +1,216 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __WEATHER_ICONS_HPP
+#define __WEATHER_ICONS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <lvgl.h>
+#include "weathericons.h"
+
+namespace ship {
+
+/*
+    OWM condition id + day/night => Font Awesome glyph, as a dense table
+    generated at compile time. Lookup is one bounds check and two array reads.
+    Condition codes: https://openweathermap.org/weather-conditions
+*/
+
+enum WeatherGlyph : uint8_t {
+  WG_NONE,
+  WG_SUN,
+  WG_MOON,
+  WG_CLOUD,
+  WG_CLOUD_SUN,
+  WG_CLOUD_MOON,
+  WG_CLOUD_BOLT,
+  WG_CLOUD_RAIN,
+  WG_CLOUD_SUN_RAIN,
+  WG_CLOUD_MOON_RAIN,
+  WG_CLOUD_SHOWERS_HEAVY,
+  WG_CLOUD_SHOWERS_WATER,
+  WG_SNOWFLAKES,
+  WG_DROPLET,
+  WG_SMOG,
+  WG_VOLCANO,
+  WG_WIND,
+  WG_TORNADO,
+  WG_COUNT
+};
+
+// Indexed by WeatherGlyph
+static constexpr const char *weather_glyphs[WG_COUNT] = {
+    "",
+    FA_WEATHER_SUN,
+    FA_WEATHER_MOON,
+    FA_WEATHER_CLOUD,
+    FA_WEATHER_CLOUD_SUN,
+    FA_WEATHER_CLOUD_MOON,
+    FA_WEATHER_CLOUD_BOLT,
+    FA_WEATHER_CLOUD_RAIN,
+    FA_WEATHER_CLOUD_SUN_RAIN,
+    FA_WEATHER_CLOUD_MOON_RAIN,
+    FA_WEATHER_CLOUD_SHOWERS_HEAVY,
+    FA_WEATHER_CLOUD_SHOWERS_WATER,
+    FA_WEATHER_SNOWFLAKES,
+    FA_WEATHER_DROPLET,
+    FA_WEATHER_SMOG,
+    FA_WEATHER_VOLCANO,
+    FA_WEATHER_WIND,
+    FA_WEATHER_TORNADO,
+};
+
+static constexpr uint16_t OWM_ID_FIRST = 200;
+static constexpr uint16_t OWM_ID_LAST = 804;
+
+/** \brief The mapping itself; only evaluated at compile time. */
+constexpr WeatherGlyph classify_weather(uint16_t id, bool night) {
+  switch (id / 100) {
+  case 2: // Thunderstorm
+    return WG_CLOUD_BOLT;
+  case 3: // Drizzle
+    return WG_CLOUD_RAIN;
+  case 5: // Rain
+    if (id <= 501)
+      return night ? WG_CLOUD_MOON_RAIN : WG_CLOUD_SUN_RAIN;
+    if (id <= 504)
+      return WG_CLOUD_SHOWERS_HEAVY;
+    if (id == 511) // freezing rain
+      return WG_SNOWFLAKES;
+    return WG_CLOUD_SHOWERS_WATER; // 520-531 shower rain
+  case 6: // Snow
+    return WG_SNOWFLAKES;
+  case 7: // Atmosphere
+    switch (id) {
+    case 701: return WG_DROPLET; // mist
+    case 762: return WG_VOLCANO; // volcanic ash
+    case 771: return WG_WIND;    // squalls
+    case 781: return WG_TORNADO;
+    default:  return WG_SMOG;    // smoke, haze, dust, fog, sand
+    }
+  case 8: // Clear and clouds
+    if (id == 800)
+      return night ? WG_MOON : WG_SUN;
+    if (id <= 802)
+      return night ? WG_CLOUD_MOON : WG_CLOUD_SUN;
+    return WG_CLOUD;
+  default:
+    return WG_NONE;
+  }
+}
+
+// Two entries per id, day then night
+using WeatherGlyphTable =
+    std::array<WeatherGlyph, (OWM_ID_LAST - OWM_ID_FIRST + 1) * 2>;
+
+constexpr WeatherGlyphTable make_weather_glyph_table() {
+  WeatherGlyphTable t = {};
+  for (uint16_t id = OWM_ID_FIRST; id <= OWM_ID_LAST; id++) {
+    t[(id - OWM_ID_FIRST) * 2] = classify_weather(id, false);
+    t[(id - OWM_ID_FIRST) * 2 + 1] = classify_weather(id, true);
+  }
+  return t;
+}
+
+static constexpr WeatherGlyphTable weather_glyph_table =
+    make_weather_glyph_table();
+
+constexpr WeatherGlyph weather_glyph_id(uint16_t id, bool night) {
+  return (id < OWM_ID_FIRST || id > OWM_ID_LAST)
+             ? WG_NONE
+             : weather_glyph_table[(id - OWM_ID_FIRST) * 2 + (night ? 1 : 0)];
+}
+
+/** \fn const char *weather_glyph(uint16_t id, bool night)
+ *  \brief UTF-8 glyph for font_fa_weather_*, "" for unknown ids.
+ *  \param id: OWM condition id (weather[0].id).
+ *  \param night: true for the "..n" icon variant.
+ */
+inline const char *weather_glyph(uint16_t id, bool night) {
+  return weather_glyphs[weather_glyph_id(id, night)];
+}
+
+static_assert(sizeof(weather_glyph_table) == 1210, "one byte per id and flag");
+static_assert(weather_glyph_id(200, false) == WG_CLOUD_BOLT, "thunderstorm");
+static_assert(weather_glyph_id(232, true) == WG_CLOUD_BOLT, "thunderstorm");
+static_assert(weather_glyph_id(300, false) == WG_CLOUD_RAIN, "drizzle");
+static_assert(weather_glyph_id(500, false) == WG_CLOUD_SUN_RAIN, "light rain");
+static_assert(weather_glyph_id(500, true) == WG_CLOUD_MOON_RAIN, "light rain");
+static_assert(weather_glyph_id(502, false) == WG_CLOUD_SHOWERS_HEAVY, "heavy rain");
+static_assert(weather_glyph_id(511, false) == WG_SNOWFLAKES, "freezing rain");
+static_assert(weather_glyph_id(531, true) == WG_CLOUD_SHOWERS_WATER, "showers");
+static_assert(weather_glyph_id(601, false) == WG_SNOWFLAKES, "snow");
+static_assert(weather_glyph_id(701, false) == WG_DROPLET, "mist");
+static_assert(weather_glyph_id(741, false) == WG_SMOG, "fog");
+static_assert(weather_glyph_id(762, false) == WG_VOLCANO, "volcanic ash");
+static_assert(weather_glyph_id(781, false) == WG_TORNADO, "tornado");
+static_assert(weather_glyph_id(800, false) == WG_SUN, "clear day");
+static_assert(weather_glyph_id(800, true) == WG_MOON, "clear night");
+static_assert(weather_glyph_id(801, true) == WG_CLOUD_MOON, "few clouds");
+static_assert(weather_glyph_id(804, false) == WG_CLOUD, "overcast");
+static_assert(weather_glyph_id(199, false) == WG_NONE, "below range");
+static_assert(weather_glyph_id(805, false) == WG_NONE, "above range");
+static_assert(weather_glyph_id(400, false) == WG_NONE, "unused group");
+
+/*
+    Icon font by panel resolution: the largest font_fa_weather_* that keeps
+    the icon within about an eighth of the short side.
+*/
+
+struct WeatherIconFont {
+  uint16_t max_short_side; // applies up to this many pixels
+  uint8_t size;
+  const lv_font_t *font;
+};
+
+static constexpr WeatherIconFont weather_icon_fonts[] = {
+    {240, 32, &font_fa_weather_32},
+    {320, 42, &font_fa_weather_42},
+    {400, 48, &font_fa_weather_48},
+    {480, 56, &font_fa_weather_56},
+    {UINT16_MAX, 64, &font_fa_weather_64},
+};
+
+constexpr size_t weather_icon_font_index(uint16_t width, uint16_t height) {
+  uint16_t side = width < height ? width : height;
+  size_t i = 0;
+  while (side > weather_icon_fonts[i].max_short_side)
+    i++;
+  return i;
+}
+
+static_assert(weather_icon_fonts[weather_icon_font_index(320, 480)].size == 42,
+              "3.5 inch panels");
+static_assert(weather_icon_fonts[weather_icon_font_index(240, 320)].size == 32,
+              "2.4 inch panels");
+static_assert(weather_icon_fonts[weather_icon_font_index(480, 800)].size == 56,
+              "7 inch panels");
+static_assert(weather_icon_fonts[weather_icon_font_index(1024, 600)].size == 64,
+              "large panels");
+
+} // namespace ship
+
+#endif // __WEATHER_ICONS_HPP
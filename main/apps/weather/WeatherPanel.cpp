@@ -0,0 +1,122 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "WeatherPanel.hpp"
+#include "WeatherIcons.hpp"
+#include "device_conf.hpp"
+#include "events/gui_events.hpp"
+#include "widgets/tux_panel.h"
+#include <cmath>
+#include <cstring>
+#include <fmt/format.h>
+
+using namespace ship;
+
+#if defined(CONFIG_WEATHER_UNITS_METRIC)
+#define TEMP_UNIT "\xC2\xB0" "C"
+#define SPEED_UNIT "m/s"
+#elif defined(CONFIG_WEATHER_UNITS_IMPERIAL)
+#define TEMP_UNIT "\xC2\xB0" "F"
+#define SPEED_UNIT "mph"
+#else
+#define TEMP_UNIT "K"
+#define SPEED_UNIT "m/s"
+#endif
+
+// Resolved at compile time, so only this font size is linked in
+static constexpr const lv_font_t *icon_font =
+    weather_icon_fonts[weather_icon_font_index(TFT_WIDTH, TFT_HEIGHT)].font;
+
+WeatherPanel::WeatherPanel(lv_obj_t *parent, lv_style_t *style) {
+  _panel = tux_panel_create(parent, "WEATHER", 130);
+  lv_obj_add_style(_panel, style, 0);
+  lv_obj_t *content = tux_panel_get_content(_panel);
+  lv_obj_set_flex_flow(content, LV_FLEX_FLOW_ROW);
+  lv_obj_set_flex_align(content, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER,
+                        LV_FLEX_ALIGN_CENTER);
+
+  _icon = lv_label_create(content);
+  lv_obj_set_style_text_font(_icon, icon_font, 0);
+  lv_label_set_text_static(_icon, "");
+
+  lv_obj_t *text = lv_obj_create(content);
+  lv_obj_remove_style_all(text);
+  lv_obj_set_size(text, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+  lv_obj_set_flex_flow(text, LV_FLEX_FLOW_COLUMN);
+
+  _temp = lv_label_create(text);
+  lv_obj_set_style_text_font(_temp, &lv_font_montserrat_32, 0);
+  lv_label_set_text_static(_temp, "--");
+
+  _details = lv_label_create(text);
+  lv_label_set_text_static(_details, "Waiting for weather...");
+
+  lv_msg_subscribe_obj(MSG_WEATHER_CHANGED, _panel, this);
+  lv_obj_add_event_cb(_panel, msg_received, LV_EVENT_MSG_RECEIVED, this);
+}
+
+void WeatherPanel::msg_received(lv_event_t *e) {
+  auto *self = static_cast<WeatherPanel *>(lv_event_get_user_data(e));
+  lv_msg_t *m = lv_event_get_msg(e);
+  auto *w = static_cast<const OwmWeather *>(lv_msg_get_payload(m));
+  if (w)
+    self->update(*w);
+}
+
+void WeatherPanel::update(const OwmWeather &w) {
+  // Glyphs are string literals, so the pointer tells if it changed
+  const char *glyph = weather_glyph(w.condition, w.is_night());
+  if (lv_label_get_text(_icon) != glyph) {
+    lv_label_set_text_static(_icon, glyph);
+    _updates++;
+  } else {
+    _skipped++;
+  }
+
+  char buf[96];
+
+  auto res = fmt::format_to_n(buf, sizeof(buf) - 1, "{:.1f}" TEMP_UNIT, w.temp);
+  *res.out = '\0';
+  set_text(_temp, buf);
+
+  res = fmt::format_to_n(buf, sizeof(buf) - 1,
+                         "Feels {:.1f}" TEMP_UNIT "  {:.0f}%  {:.0f} hPa\n"
+                         "Wind {:.1f} " SPEED_UNIT " {:.0f}" "\xC2\xB0",
+                         w.feels_like, w.humidity, w.pressure, w.wind_speed,
+                         w.wind_deg);
+  if (!std::isnan(w.wind_gust))
+    res = fmt::format_to_n(res.out, buf + sizeof(buf) - 1 - res.out,
+                           "  gust {:.1f}", w.wind_gust);
+  *res.out = '\0';
+  set_text(_details, buf);
+}
+
+void WeatherPanel::set_text(lv_obj_t *label, const char *text) {
+  if (strcmp(lv_label_get_text(label), text) == 0) {
+    _skipped++;
+    return;
+  }
+  lv_label_set_text(label, text);
+  _updates++;
+}
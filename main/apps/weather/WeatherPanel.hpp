@@ -0,0 +1,66 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __WEATHER_PANEL_HPP
+#define __WEATHER_PANEL_HPP
+
+#include "OwmParser.hpp"
+#include <lvgl.h>
+
+namespace ship {
+
+/**
+ * Home page panel with the current weather.
+ *
+ * Listens to MSG_WEATHER_CHANGED. Every label is formatted into a stack
+ * buffer and only set when its text differs from what is on screen (the
+ * BoundLabel approach), so republishing the same weather redraws nothing.
+ * Create and use with the GUI lock held.
+ */
+class WeatherPanel {
+public:
+  WeatherPanel(lv_obj_t *parent, lv_style_t *style);
+  WeatherPanel(const WeatherPanel &) = delete;
+  WeatherPanel &operator=(const WeatherPanel &) = delete;
+
+  /** \brief Label refreshes, and labels which rendered to the same text. */
+  uint32_t updates() const { return _updates; }
+  uint32_t skipped() const { return _skipped; }
+
+private:
+  static void msg_received(lv_event_t *e);
+  void update(const OwmWeather &w);
+  void set_text(lv_obj_t *label, const char *text);
+
+  lv_obj_t *_panel;
+  lv_obj_t *_icon;
+  lv_obj_t *_temp;
+  lv_obj_t *_details;
+  uint32_t _updates = 0;
+  uint32_t _skipped = 0;
+};
+
+} // namespace ship
+
+#endif // __WEATHER_PANEL_HPP
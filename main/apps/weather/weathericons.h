@@ -27,10 +27,11 @@ SOFTWARE.
     https://openweathermap.org/weather-conditions#Weather-Condition-Codes-2
 */
 
-//LV_FONT_DECLARE(font_fa_weather_32)
+LV_FONT_DECLARE(font_fa_weather_32)
 LV_FONT_DECLARE(font_fa_weather_42)
-//LV_FONT_DECLARE(font_fa_weather_48)
-//LV_FONT_DECLARE(font_fa_weather_56)
+LV_FONT_DECLARE(font_fa_weather_48)
+LV_FONT_DECLARE(font_fa_weather_56)
+LV_FONT_DECLARE(font_fa_weather_64)
 
 #define FA_WEATHER_BOLT                 "\xEF\x83\xA7"      // f0e7
 #define FA_WEATHER_SUN                  "\xEF\x86\x85"      // f185
@@ -41,15 +41,19 @@ enum {
     TUX_EVENT_DATETIME_SET,                  // Date updated through SNTP 
 
     TUX_EVENT_OTA_STARTED,                   // Invoke OTA START
-    TUX_EVENT_OTA_IN_PROGRESS,               // OTA Progress including %
+    TUX_EVENT_OTA_IN_PROGRESS,               // ota_progress_t - percent, rate, ETA
     TUX_EVENT_OTA_ROLLBACK,                  // OTA Rollback
     TUX_EVENT_OTA_COMPLETED,                 // OTA Completed
     TUX_EVENT_OTA_FAILED,                    // OTA Failed
     TUX_EVENT_OTA_ABORTED,                   // OTA Aborted
 
     TUX_EVENT_WEATHER_UPDATED,  // Weather updated
-    TUX_EVENT_THEME_CHANGED,     // raised when the theme changes
-    TUX_EVENT_BRIGHTNESS_CHANGED // raised when the brightness changes
+    TUX_EVENT_THEME_CHANGED,     // bool - dark theme, raised when the setting changes
+    TUX_EVENT_BRIGHTNESS_CHANGED, // uint8_t - backlight level, raised when the setting changes
+
+    TUX_EVENT_ALARM_RAISED,      // AlarmEvent - alarm became active
+    TUX_EVENT_ALARM_CLEARED,     // AlarmEvent - condition gone
+    TUX_EVENT_ALARM_ACKED        // AlarmEvent - acknowledged by the user
 };
 
 #ifdef __cplusplus
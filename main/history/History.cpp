@@ -0,0 +1,104 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "History.hpp"
+#include "ShipModel.hpp"
+#include "log_tag.hpp"
+#include <esp_heap_caps.h>
+#include <new>
+
+using namespace ship;
+
+#define HISTORY_MAX_AGE_MS 2000 // older model values are recorded as gaps
+
+History &History::instance() {
+  using HistorySingleton =
+      Loki::SingletonHolder<History, Loki::CreateStatic, Loki::NoDestroy>;
+
+  return HistorySingleton::Instance();
+}
+
+template <typename T> static float fresh(const Observable<T> &o) {
+  return o.is_fresh(HISTORY_MAX_AGE_MS) ? float(o.get()) : NAN;
+}
+
+esp_err_t History::start() {
+  if (_timer)
+    return ESP_ERR_INVALID_STATE;
+
+  void *mem = heap_caps_malloc(bytes(), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!mem) {
+    ESP_LOGE(TAG, "History needs %u bytes of PSRAM", bytes());
+    return ESP_ERR_NO_MEM;
+  }
+  _series = static_cast<HistorySeries *>(mem);
+  for (size_t i = 0; i < HISTORY_CHANNELS; i++)
+    new (&_series[i]) HistorySeries();
+
+  _mutex = xSemaphoreCreateMutex();
+
+  const esp_timer_create_args_t args = {
+      .callback = &History::sample,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "history",
+      .skip_unhandled_events = false}; // every second must be inserted
+
+  ESP_ERROR_CHECK(esp_timer_create(&args, &_timer));
+  ESP_LOGI(TAG, "History: %u channels, %u bytes PSRAM", HISTORY_CHANNELS, bytes());
+  return esp_timer_start_periodic(_timer, 1000 * 1000);
+}
+
+void History::sample(void *arg) {
+  History *self = reinterpret_cast<History *>(arg);
+  ShipModel &m = ShipModel::instance();
+
+  // Read the model before taking the lock
+  float v[HISTORY_CHANNELS];
+  v[HISTORY_SOG] = fresh(m.sog);
+  v[HISTORY_DEPTH] = fresh(m.depth);
+  v[HISTORY_WIND_SPEED] = fresh(m.wind_speed);
+  v[HISTORY_WATER_TEMP] = fresh(m.water_temp);
+  v[HISTORY_AIR_TEMP] = fresh(m.air_temp);
+  v[HISTORY_PRESSURE] = fresh(m.pressure);
+  v[HISTORY_ENGINE_RPM] = fresh(m.engine_rpm);
+  v[HISTORY_ENGINE_TEMP] = fresh(m.engine_temp);
+  v[HISTORY_BATTERY_VOLTAGE] = fresh(m.battery_voltage);
+  v[HISTORY_BATTERY_CURRENT] = fresh(m.battery_current);
+
+  xSemaphoreTake(self->_mutex, portMAX_DELAY);
+  for (size_t i = 0; i < HISTORY_CHANNELS; i++)
+    self->_series[i].insert(v[i]);
+  xSemaphoreGive(self->_mutex);
+}
+
+size_t History::query(HistoryChannel channel, uint32_t range_s, TsPoint *out,
+                      size_t n) {
+  if (!_series || channel >= HISTORY_CHANNELS)
+    return 0;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  size_t res = _series[channel].query(range_s, out, n);
+  xSemaphoreGive(_mutex);
+  return res;
+}
@@ -0,0 +1,100 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __HISTORY_HPP
+#define __HISTORY_HPP
+
+#include "TimeSeries.hpp"
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <loki/Singleton.h>
+#include <sdkconfig.h>
+
+namespace ship {
+
+/* Channels with history. Angles are left out: their average wraps. */
+enum HistoryChannel : uint8_t {
+  HISTORY_SOG,
+  HISTORY_DEPTH,
+  HISTORY_WIND_SPEED,
+  HISTORY_WATER_TEMP,
+  HISTORY_AIR_TEMP,
+  HISTORY_PRESSURE,
+  HISTORY_ENGINE_RPM,
+  HISTORY_ENGINE_TEMP,
+  HISTORY_BATTERY_VOLTAGE,
+  HISTORY_BATTERY_CURRENT,
+  HISTORY_CHANNELS
+};
+
+// Compiled in either way, so keep the types complete when disabled
+#ifndef CONFIG_HISTORY_ENABLE
+#define CONFIG_HISTORY_RAW_SECONDS 60
+#define CONFIG_HISTORY_MINUTES 15
+#define CONFIG_HISTORY_QUARTERS 1
+#endif
+
+using HistorySeries = TimeSeries<CONFIG_HISTORY_RAW_SECONDS,
+                                 CONFIG_HISTORY_MINUTES,
+                                 CONFIG_HISTORY_QUARTERS>;
+
+/**
+ * History samples the ShipModel once per second into a TimeSeries per
+ * channel, allocated in PSRAM. Values older than 2 s are stored as gaps.
+ * Queries may come from any task, e.g. a chart refresh on the GUI task.
+ */
+class History {
+public:
+  static History &instance();
+
+  /** \brief Allocates the series and starts sampling. */
+  esp_err_t start();
+
+  /** \fn size_t query(HistoryChannel channel, uint32_t range_s, TsPoint *out, size_t n)
+   *  \brief Last range_s seconds of a channel as at most n points, oldest first.
+   *  \see TimeSeries::query
+   */
+  size_t query(HistoryChannel channel, uint32_t range_s, TsPoint *out, size_t n);
+
+  /** \brief PSRAM used by all channels. */
+  static constexpr size_t bytes() { return sizeof(HistorySeries) * HISTORY_CHANNELS; }
+
+private:
+  History() = default;
+  ~History() = default;
+
+  static void sample(void *arg);
+
+  HistorySeries *_series = nullptr;
+  SemaphoreHandle_t _mutex = nullptr;
+  esp_timer_handle_t _timer = nullptr;
+
+  friend struct Loki::CreateStatic<History>;
+};
+
+} // namespace ship
+
+#endif // __HISTORY_HPP
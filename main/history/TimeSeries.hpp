@@ -0,0 +1,187 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __TIME_SERIES_HPP
+#define __TIME_SERIES_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace ship {
+
+struct TsPoint {
+  float min;
+  float max;
+  float avg;
+};
+
+/**
+ * TimeSeries keeps the history of one channel in three fixed-size rings:
+ * raw 1 Hz samples, 1 minute and 15 minute min/max/avg rollups.
+ * Rollups are accumulated as samples are inserted, so insert is O(1) and
+ * nothing is ever rescanned.
+ *
+ * The memory footprint is sizeof(TimeSeries), fixed at compile time:
+ * RAW * 4 + (MINUTES + QUARTERS) * 12 bytes, plus a few accumulators.
+ * Not thread safe; History serialises access.
+ */
+template <size_t RAW, size_t MINUTES, size_t QUARTERS> class TimeSeries {
+public:
+  static constexpr size_t TIERS = 3;
+  static constexpr uint32_t resolution[TIERS] = {1, 60, 900};
+  static constexpr uint32_t capacity[TIERS] = {RAW, MINUTES, QUARTERS};
+
+  static_assert(RAW >= 60 && MINUTES >= 15 && QUARTERS > 0,
+                "each tier must hold at least one slot of the next one");
+
+  TimeSeries() { clear(); }
+
+  void clear() {
+    _seconds = 0;
+    _minute.reset();
+    _quarter.reset();
+  }
+
+  /** \fn void insert(float value)
+   *  \brief Appends the sample of the next second, NAN for "no data".
+   */
+  void insert(float value) {
+    _raw[_seconds % RAW] = value;
+    _minute.add(value);
+    _quarter.add(value);
+    _seconds++;
+
+    if (_seconds % 60 == 0) {
+      _minutes[(_seconds / 60 - 1) % MINUTES] = _minute.point();
+      _minute.reset();
+    }
+    if (_seconds % 900 == 0) {
+      _quarters[(_seconds / 900 - 1) % QUARTERS] = _quarter.point();
+      _quarter.reset();
+    }
+  }
+
+  /** \brief Number of seconds inserted so far. */
+  uint32_t seconds() const { return _seconds; }
+
+  /** \fn size_t query(uint32_t range_s, TsPoint *out, size_t n) const
+   *  \brief Downsamples the last range_s seconds into at most n points,
+   *         oldest first. Points without data are NAN.
+   *
+   *  Reads the coarsest tier finer than range_s / n that still covers the
+   *  range, so each point merges fewer than 60 slots whatever the range:
+   *  cost is O(n), not O(samples). The unfinished minute / quarter is not
+   *  part of the rollup tiers yet.
+   *  \returns number of points written, each covering range_s / returned.
+   */
+  size_t query(uint32_t range_s, TsPoint *out, size_t n) const {
+    if (n == 0 || range_s == 0)
+      return 0;
+
+    uint32_t bucket = std::max<uint32_t>(1, range_s / n);
+    size_t t = 0;
+    while (t + 1 < TIERS && (resolution[t + 1] <= bucket ||
+                             range_s > capacity[t] * resolution[t]))
+      t++;
+
+    const uint32_t res = resolution[t];
+    const int64_t end = _seconds / res; // one past the newest complete slot
+    const int64_t oldest = std::max<int64_t>(0, end - int64_t(capacity[t]));
+    const int64_t span = (range_s + res - 1) / res;
+    const int64_t begin = end - span;
+    n = std::min<size_t>(n, span);
+
+    for (size_t i = 0; i < n; i++) {
+      int64_t from = begin + span * i / n;
+      int64_t to = begin + span * (i + 1) / n;
+      Acc acc;
+      acc.reset();
+      for (int64_t s = std::max(from, oldest); s < to; s++)
+        acc.merge(slot(t, s));
+      out[i] = acc.point();
+    }
+    return n;
+  }
+
+private:
+  struct Acc {
+    float min, max, sum;
+    uint32_t count;
+
+    void reset() {
+      min = INFINITY;
+      max = -INFINITY;
+      sum = 0;
+      count = 0;
+    }
+    void add(float v) {
+      if (std::isnan(v))
+        return;
+      min = std::min(min, v);
+      max = std::max(max, v);
+      sum += v;
+      count++;
+    }
+    // Averages of rollups are merged unweighted
+    void merge(const TsPoint &p) {
+      if (std::isnan(p.avg))
+        return;
+      min = std::min(min, p.min);
+      max = std::max(max, p.max);
+      sum += p.avg;
+      count++;
+    }
+    TsPoint point() const {
+      if (count == 0)
+        return {NAN, NAN, NAN};
+      return {min, max, sum / count};
+    }
+  };
+
+  TsPoint slot(size_t tier, int64_t s) const {
+    switch (tier) {
+    case 0: {
+      float v = _raw[s % RAW];
+      return {v, v, v};
+    }
+    case 1:
+      return _minutes[s % MINUTES];
+    default:
+      return _quarters[s % QUARTERS];
+    }
+  }
+
+  uint32_t _seconds;
+  Acc _minute;
+  Acc _quarter;
+  float _raw[RAW];
+  TsPoint _minutes[MINUTES];
+  TsPoint _quarters[QUARTERS];
+};
+
+} // namespace ship
+
+#endif // __TIME_SERIES_HPP
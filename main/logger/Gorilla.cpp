@@ -0,0 +1,147 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Gorilla.hpp"
+#include <cstring>
+
+using namespace ship;
+
+// Capacity is checked per row against the worst case encoding
+static constexpr size_t TS_MAX_BITS = 4 + 32;
+static constexpr size_t VALUE_MAX_BITS = 2 + 5 + 5 + 32;
+static constexpr size_t STREAM_BITS = (GORILLA_BLOCK_SIZE - GORILLA_HEADER_SIZE) * 8;
+
+static uint32_t float_bits(float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+GorillaBlock::GorillaBlock(size_t channels)
+    : _channels(channels < GORILLA_MAX_CHANNELS ? channels : GORILLA_MAX_CHANNELS) {
+  reset();
+}
+
+void GorillaBlock::reset() {
+  memset(_buf, 0, sizeof(_buf));
+  _bits = 0;
+  _rows = 0;
+  _first_ts = _last_ts = _last_delta = 0;
+}
+
+void GorillaBlock::write(uint32_t value, unsigned bits) {
+  // MSB first; the buffer is zeroed so only ones need to be set
+  for (unsigned i = bits; i-- > 0; _bits++) {
+    if ((value >> i) & 1)
+      _buf[GORILLA_HEADER_SIZE + (_bits >> 3)] |= 0x80 >> (_bits & 7);
+  }
+}
+
+// Two's complement in 7, 9 or 12 bits, as gorilla_log.py signed() reads
+// them; not the paper's [-63, 64] ranges, whose +64 would read back as -64
+void GorillaBlock::write_dod(int64_t dod) {
+  if (dod == 0) {
+    write(0b0, 1);
+  } else if (dod >= -64 && dod <= 63) {
+    write(0b10, 2);
+    write(uint32_t(dod) & 0x7f, 7);
+  } else if (dod >= -256 && dod <= 255) {
+    write(0b110, 3);
+    write(uint32_t(dod) & 0x1ff, 9);
+  } else if (dod >= -2048 && dod <= 2047) {
+    write(0b1110, 4);
+    write(uint32_t(dod) & 0xfff, 12);
+  } else {
+    write(0b1111, 4);
+    write(uint32_t(int32_t(dod)), 32);
+  }
+}
+
+void GorillaBlock::write_value(size_t ch, uint32_t value) {
+  uint32_t x = value ^ _prev[ch];
+  _prev[ch] = value;
+  if (x == 0) {
+    write(0b0, 1);
+    return;
+  }
+
+  unsigned leading = __builtin_clz(x);
+  unsigned trailing = __builtin_ctz(x);
+
+  if (_leading[ch] != 0xff && leading >= _leading[ch] && trailing >= _trailing[ch]) {
+    // Fits the previous window: store only the meaningful bits
+    write(0b10, 2);
+    write(x >> _trailing[ch], 32 - _leading[ch] - _trailing[ch]);
+  } else {
+    unsigned len = 32 - leading - trailing;
+    write(0b11, 2);
+    write(leading, 5);
+    write(len - 1, 5);
+    write(x >> trailing, len);
+    _leading[ch] = leading;
+    _trailing[ch] = trailing;
+  }
+}
+
+bool GorillaBlock::append(int64_t ts, const float *values) {
+  if (_rows == UINT16_MAX ||
+      _bits + TS_MAX_BITS + VALUE_MAX_BITS * _channels > STREAM_BITS)
+    return false;
+
+  if (_rows == 0) {
+    _first_ts = ts;
+    for (size_t ch = 0; ch < _channels; ch++) {
+      _prev[ch] = float_bits(values[ch]);
+      _leading[ch] = 0xff; // no window yet
+      _trailing[ch] = 0;
+      write(_prev[ch], 32);
+    }
+  } else {
+    int64_t delta = ts - _last_ts;
+    int64_t dod = delta - _last_delta;
+    if (delta < 0 || dod < INT32_MIN || dod > INT32_MAX)
+      return false;
+    write_dod(dod);
+    _last_delta = delta;
+    for (size_t ch = 0; ch < _channels; ch++)
+      write_value(ch, float_bits(values[ch]));
+  }
+  _last_ts = ts;
+  _rows++;
+  return true;
+}
+
+const uint8_t *GorillaBlock::finish() {
+  uint8_t *h = _buf;
+  uint32_t magic = GORILLA_MAGIC;
+  uint32_t bits = _bits;
+  memcpy(h + 0, &magic, 4);
+  h[4] = _channels;
+  h[5] = 0;
+  memcpy(h + 6, &_rows, 2);
+  memcpy(h + 8, &bits, 4);
+  memcpy(h + 12, &_first_ts, 8);
+  memcpy(h + 20, &_last_ts, 8);
+  return _buf;
+}
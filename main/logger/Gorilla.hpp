@@ -0,0 +1,96 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __GORILLA_HPP
+#define __GORILLA_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ship {
+
+/*
+    Gorilla-style compression (Pelkonen et al., VLDB 2015) adapted to
+    rows of float32 sharing one millisecond timestamp.
+
+    Block layout, little endian, GORILLA_BLOCK_SIZE bytes:
+      u32 magic 'GOR1' | u8 channels | u8 0 | u16 rows | u32 bits
+      i64 first_ts | i64 last_ts | bitstream, MSB first, zero padded
+    Timestamps: first row from the header, then delta-of-delta:
+      '0' | '10'+7 bits | '110'+9 bits | '1110'+12 bits | '1111'+32 bits
+      two's complement: [-64, 63], [-256, 255], [-2048, 2047], 32 bits
+    Values: first row raw 32 bits, then XOR with the previous value:
+      '0' same | '10' + bits in the previous window |
+      '11' + 5 bits leading zeros + 5 bits (length - 1) + bits
+    Every block is self contained so it can be decoded on its own.
+*/
+
+static constexpr size_t GORILLA_BLOCK_SIZE = 4096;   // one flash / SD page
+static constexpr size_t GORILLA_HEADER_SIZE = 28;
+static constexpr size_t GORILLA_MAX_CHANNELS = 16;
+static constexpr uint32_t GORILLA_MAGIC = 0x31524f47; // "GOR1"
+
+class GorillaBlock {
+public:
+  explicit GorillaBlock(size_t channels);
+
+  /** \fn bool append(int64_t ts, const float *values)
+   *  \brief Encodes one row. Returns false if the block is full, or if ts
+   *         cannot follow the previous row (clock stepped back, or a jump
+   *         past the 32 bit escape); the row is then not consumed and
+   *         starts the next block. An empty block takes any row.
+   */
+  bool append(int64_t ts, const float *values);
+
+  /** \brief Fills in the header; data() then holds the complete block. */
+  const uint8_t *finish();
+
+  void reset();
+
+  uint16_t rows() const { return _rows; }
+  int64_t first_ts() const { return _first_ts; }
+  int64_t last_ts() const { return _last_ts; }
+  /** \brief Bytes of the block actually used by header and bitstream. */
+  size_t used() const { return GORILLA_HEADER_SIZE + (_bits + 7) / 8; }
+
+private:
+  void write(uint32_t value, unsigned bits);
+  void write_dod(int64_t dod);
+  void write_value(size_t ch, uint32_t value);
+
+  uint8_t _buf[GORILLA_BLOCK_SIZE];
+  size_t _channels;
+  size_t _bits = 0;
+  uint16_t _rows = 0;
+  int64_t _first_ts = 0;
+  int64_t _last_ts = 0;
+  int64_t _last_delta = 0;
+  uint32_t _prev[GORILLA_MAX_CHANNELS];
+  uint8_t _leading[GORILLA_MAX_CHANNELS];
+  uint8_t _trailing[GORILLA_MAX_CHANNELS];
+};
+
+} // namespace ship
+
+#endif // __GORILLA_HPP
@@ -0,0 +1,298 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Logger.hpp"
+#include "ShipModel.hpp"
+#include "log_tag.hpp"
+#include <cinttypes>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace ship;
+
+#define LOGGER_QUEUE_LEN   32   // rows, covers 30 s of a stalled card
+#define LOGGER_MAX_AGE_MS  2000 // older model values are logged as NAN
+#define LOGGER_CLOCK_VALID 1640995200 // 2022-01-01, before is an unset clock
+
+/* Index entry appended to the .idx file for every block written */
+struct __attribute__((packed)) LoggerIndexEntry {
+  int64_t first_ts;
+  int64_t last_ts;
+  uint32_t block;
+};
+
+static constexpr uint64_t BLOCK_COST = GORILLA_BLOCK_SIZE + sizeof(LoggerIndexEntry);
+
+Logger::Logger(const char *dir, uint32_t segment_blocks, uint32_t flush_s,
+               uint64_t max_bytes)
+    : _dir(dir), _segment_blocks(segment_blocks),
+      _flush_us(int64_t(flush_s) * 1000 * 1000), _max_bytes(max_bytes) {
+  // At least four segments, so retention deletes a part of the log only
+  uint64_t quarter = max_bytes / 4 / BLOCK_COST;
+  if (_segment_blocks > quarter)
+    _segment_blocks = quarter ? quarter : 1;
+}
+
+Logger::~Logger() {
+  if (_timer) {
+    esp_timer_stop(_timer);
+    esp_timer_delete(_timer);
+  }
+  if (_task_handle)
+    vTaskDelete(_task_handle);
+  if (_data)
+    fclose(_data);
+  if (_index)
+    fclose(_index);
+  if (_queue)
+    vQueueDelete(_queue);
+  delete _block;
+}
+
+esp_err_t Logger::start() {
+  if (_task_handle)
+    return ESP_ERR_INVALID_STATE;
+
+  mkdir(_dir, 0755); // fails harmlessly if it exists or on SPIFFS
+
+  // Continue after the highest segment number found
+  DIR *d = opendir(_dir);
+  if (d) {
+    struct dirent *e;
+    while ((e = readdir(d)) != nullptr) {
+      uint32_t n;
+      int end = 0;
+      if (sscanf(e->d_name, "%8" SCNu32 ".gor%n", &n, &end) != 1 ||
+          end == 0 || e->d_name[end] != '\0')
+        continue;
+      if (n >= _segment)
+        _segment = n + 1;
+      if (n < _oldest)
+        _oldest = n;
+      _used_bytes += segment_size(n);
+    }
+    closedir(d);
+  }
+  if (_oldest > _segment)
+    _oldest = _segment;
+
+  _block = new GorillaBlock(CHANNELS);
+  _queue = xQueueCreate(LOGGER_QUEUE_LEN, sizeof(Row));
+  if (!_queue)
+    return ESP_ERR_NO_MEM;
+
+  BaseType_t res = xTaskCreatePinnedToCore(task_handler, "logger", 1024 * 4,
+                                           this, 2, &_task_handle, 0);
+  if (res != pdPASS)
+    return ESP_ERR_NO_MEM;
+
+  const esp_timer_create_args_t args = {
+      .callback = &Logger::sample,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "logger",
+      .skip_unhandled_events = true};
+
+  ESP_ERROR_CHECK(esp_timer_create(&args, &_timer));
+  ESP_LOGI(TAG, "Logging to %s, segment %" PRIu32 ", %" PRIu64 " of %" PRIu64 " kB used",
+           _dir, _segment, _used_bytes / 1024, _max_bytes / 1024);
+  return esp_timer_start_periodic(_timer, 1000 * 1000);
+}
+
+template <typename T> static float fresh(const Observable<T> &o) {
+  return o.is_fresh(LOGGER_MAX_AGE_MS) ? float(o.get()) : NAN;
+}
+
+void Logger::sample(void *arg) {
+  Logger *self = reinterpret_cast<Logger *>(arg);
+  ShipModel &m = ShipModel::instance();
+
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < LOGGER_CLOCK_VALID)
+    return; // not set by SNTP yet
+  int64_t ts = int64_t(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+
+  const float values[CHANNELS] = {
+      fresh(m.latitude),      fresh(m.longitude),       fresh(m.cog),
+      fresh(m.sog),           fresh(m.heading),         fresh(m.depth),
+      fresh(m.wind_angle),    fresh(m.wind_speed),      fresh(m.water_temp),
+      fresh(m.air_temp),      fresh(m.pressure),        fresh(m.rudder_angle),
+      fresh(m.engine_rpm),    fresh(m.engine_temp),     fresh(m.battery_voltage),
+      fresh(m.battery_current),
+  };
+  self->append(ts, values);
+}
+
+bool Logger::append(int64_t ts, const float *values) {
+  Row row;
+  row.ts = ts;
+  memcpy(row.values, values, sizeof(row.values));
+  if (xQueueSend(_queue, &row, 0) != pdTRUE) {
+    _stats.dropped++;
+    return false;
+  }
+  return true;
+}
+
+void Logger::flush() {
+  // An empty row tells the task to write the partial block
+  Row row = {};
+  row.ts = INT64_MIN;
+  xQueueSend(_queue, &row, 0);
+}
+
+void Logger::task_handler(void *arg) {
+  Logger *self = reinterpret_cast<Logger *>(arg);
+  Row row;
+
+  while (1) {
+    if (xQueueReceive(self->_queue, &row, pdMS_TO_TICKS(1000)) != pdTRUE)
+      row.ts = 0;
+
+    GorillaBlock &block = *self->_block;
+    bool expired = block.rows() &&
+                   esp_timer_get_time() - self->_block_started > self->_flush_us;
+    if (row.ts == INT64_MIN || expired) {
+      if (block.rows())
+        self->write_block();
+      if (row.ts == INT64_MIN)
+        continue;
+    }
+    if (row.ts == 0)
+      continue;
+
+    if (!block.append(row.ts, row.values)) {
+      self->write_block();
+      block.append(row.ts, row.values);
+    }
+    if (block.rows() == 1)
+      self->_block_started = esp_timer_get_time();
+    self->_stats.rows++;
+    self->_stats.raw_bytes += sizeof(int64_t) + sizeof(float) * CHANNELS;
+  }
+}
+
+bool Logger::open_segment() {
+  char path[64];
+  snprintf(path, sizeof(path), "%s/%08" PRIu32 ".gor", _dir, _segment);
+  _data = fopen(path, "ab");
+  snprintf(path, sizeof(path), "%s/%08" PRIu32 ".idx", _dir, _segment);
+  _index = fopen(path, "ab");
+  if (!_data || !_index) {
+    ESP_LOGE(TAG, "Logger cannot open %s", path);
+    if (_data)
+      fclose(_data);
+    if (_index)
+      fclose(_index);
+    _data = _index = nullptr;
+    return false;
+  }
+  // Unbuffered: every write is already a whole block
+  setvbuf(_data, nullptr, _IONBF, 0);
+  _segment_block = 0;
+  _segment_last_ts = INT64_MIN;
+  return true;
+}
+
+void Logger::close_segment() {
+  fclose(_data);
+  fclose(_index);
+  _data = _index = nullptr;
+  _segment++;
+}
+
+uint64_t Logger::segment_size(uint32_t segment) const {
+  char path[64];
+  struct stat st;
+  uint64_t size = 0;
+  snprintf(path, sizeof(path), "%s/%08" PRIu32 ".gor", _dir, segment);
+  if (stat(path, &st) == 0)
+    size += st.st_size;
+  snprintf(path, sizeof(path), "%s/%08" PRIu32 ".idx", _dir, segment);
+  if (stat(path, &st) == 0)
+    size += st.st_size;
+  return size;
+}
+
+// Deletes the oldest closed segments until bytes more fit
+void Logger::make_room(uint64_t bytes) {
+  char path[64];
+  while (_used_bytes + bytes > _max_bytes && _oldest < _segment) {
+    uint64_t size = segment_size(_oldest);
+    snprintf(path, sizeof(path), "%s/%08" PRIu32 ".gor", _dir, _oldest);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/%08" PRIu32 ".idx", _dir, _oldest);
+    unlink(path);
+    _used_bytes -= size < _used_bytes ? size : _used_bytes;
+    if (size)
+      ESP_LOGI(TAG, "Logger deleted segment %" PRIu32, _oldest);
+    _oldest++;
+  }
+}
+
+void Logger::write_block() {
+  GorillaBlock &block = *_block;
+  // Clock stepped back: a new segment keeps every index in time order
+  if (_data && block.first_ts() < _segment_last_ts)
+    close_segment();
+  make_room(BLOCK_COST);
+  if (!_data && !open_segment()) {
+    _stats.dropped += block.rows();
+    block.reset();
+    return;
+  }
+
+  int64_t start = esp_timer_get_time();
+  const uint8_t *data = block.finish();
+  bool ok = fwrite(data, GORILLA_BLOCK_SIZE, 1, _data) == 1;
+  fsync(fileno(_data));
+
+  LoggerIndexEntry entry = {block.first_ts(), block.last_ts(), _segment_block};
+  ok = ok && fwrite(&entry, sizeof(entry), 1, _index) == 1;
+  fflush(_index);
+  fsync(fileno(_index));
+
+  _stats.write_us += esp_timer_get_time() - start;
+  if (ok) {
+    _stats.blocks++;
+    _stats.written_bytes += GORILLA_BLOCK_SIZE;
+    _used_bytes += BLOCK_COST;
+    _segment_last_ts = block.last_ts();
+  } else {
+    _stats.dropped += block.rows();
+    ESP_LOGW(TAG, "Logger write failed, segment %" PRIu32, _segment);
+  }
+  block.reset();
+
+  if (++_segment_block >= _segment_blocks) {
+    ESP_LOGI(TAG, "Logger segment %" PRIu32 " closed: ratio %.1f, %" PRIu64 " kB/s",
+             _segment, double(_stats.raw_bytes) / _stats.written_bytes,
+             _stats.written_bytes * 1000 / (_stats.write_us ? _stats.write_us : 1));
+    close_segment();
+  }
+}
@@ -0,0 +1,125 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __LOGGER_HPP
+#define __LOGGER_HPP
+
+#include "Gorilla.hpp"
+#include <cstdio>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+namespace ship {
+
+struct LoggerStats {
+  uint32_t rows;          // rows encoded
+  uint32_t dropped;       // rows lost because the writer fell behind
+  uint32_t blocks;        // blocks written
+  uint64_t raw_bytes;     // rows * (8 + 4 * channels)
+  uint64_t written_bytes; // blocks * GORILLA_BLOCK_SIZE
+  uint64_t write_us;      // time spent in fwrite + fsync
+};
+
+/**
+ * Logger records the ShipModel once per second into append-only,
+ * Gorilla-compressed segments: <dir>/NNNNNNNN.gor with a time index
+ * <dir>/NNNNNNNN.idx holding (first_ts, last_ts, block) for every block.
+ *
+ * Rows are queued without blocking; a background task encodes them into
+ * a page-sized block and writes it in one go when full, or when it got
+ * older than the flush period. Decode with gorilla_log.py.
+ *
+ * Sampling waits for a set clock (SNTP). A clock stepped later on closes
+ * the block, and a step back also the segment, so the index of a segment
+ * stays in time order. The oldest segments are deleted to keep the log
+ * within max_bytes.
+ */
+class Logger {
+public:
+  static constexpr size_t CHANNELS = 16;   // ShipModel fields, in order
+
+  /** \fn Logger(const char *dir, uint32_t segment_blocks, uint32_t flush_s, uint64_t max_bytes)
+   *  \param dir: directory for the segments, created if missing.
+   *  \param segment_blocks: blocks per segment before starting a new one,
+   *         at most a quarter of max_bytes.
+   *  \param flush_s: max age of a partial block before it is written.
+   *  \param max_bytes: size of all segments and indexes together.
+   */
+  Logger(const char *dir, uint32_t segment_blocks, uint32_t flush_s,
+         uint64_t max_bytes);
+  ~Logger();
+
+  /** \brief Starts the writer task and the 1 Hz sampler. */
+  esp_err_t start();
+
+  /** \brief Queues one row, never blocks. Timestamp in ms since epoch. */
+  bool append(int64_t ts, const float *values);
+
+  /** \brief Writes the partial block now, e.g. before a restart. */
+  void flush();
+
+  const LoggerStats &stats() const { return _stats; }
+
+private:
+  struct Row {
+    int64_t ts;
+    float values[CHANNELS];
+  };
+
+  static void task_handler(void *arg);
+  static void sample(void *arg);
+  bool open_segment();
+  void close_segment();
+  void make_room(uint64_t bytes);
+  uint64_t segment_size(uint32_t segment) const;
+  void write_block();
+
+  const char *_dir;
+  uint32_t _segment_blocks;
+  int64_t _flush_us;
+  uint64_t _max_bytes;
+
+  QueueHandle_t _queue = nullptr;
+  TaskHandle_t _task_handle = nullptr;
+  esp_timer_handle_t _timer = nullptr;
+
+  GorillaBlock *_block = nullptr;   // written by the task only
+  int64_t _block_started = 0;
+  FILE *_data = nullptr;
+  FILE *_index = nullptr;
+  uint32_t _segment = 0;
+  uint32_t _segment_block = 0;
+  int64_t _segment_last_ts = INT64_MIN;
+  uint32_t _oldest = UINT32_MAX;    // lowest segment on disk
+  uint64_t _used_bytes = 0;         // of all segments on disk
+
+  LoggerStats _stats = {};
+};
+
+} // namespace ship
+
+#endif // __LOGGER_HPP
@@ -559,6 +559,8 @@
 
 #define TUX_USE_PANEL     1
 
+#define TUX_USE_GAUGE     1
+
 /*-----------
  * Themes
  *----------*/
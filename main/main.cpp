@@ -27,15 +27,35 @@ SOFTWARE.
 #include "Display.hpp"
 #include "Gui.hpp"
 #include "Lcd.hpp"
+#include "alarm/AlarmBanner.hpp"
+#include "alarm/AnchorButton.hpp"
+#include "alarm/AlarmRules.hpp"
+#include "ais/Ais.hpp"
+#include "apps/weather/Weather.hpp"
+#include "history/History.hpp"
+#include "ota.h"
+#include "storage.h"
+#include "logger/Logger.hpp"
+#include "Preferences.h"
+#include "Settings.hpp"
+#include "n2k/N2kModel.hpp"
+#include "n2k/N2kTwai.hpp"
+#include "nmea/NmeaModel.hpp"
+#include "nmea/NmeaUart.hpp"
+#include "signalk/SignalK.hpp"
+#include "storage/LvFsCache.hpp"
 #include "soc/rtc.h"
+#include "telemetry/Telemetry.hpp"
 #include <esp_chip_info.h>
 #include <esp_partition.h>
 #include <esp_ota_ops.h>
 #include <spi_flash_mmap.h>
 #include <esp_flash.h>
-#include <esp_spiffs.h>
 #include <esp_vfs.h>
 #include <esp_vfs_fat.h>
+#include <esp_wifi.h>
+#include <driver/sdspi_host.h>
+#include <sdmmc_cmd.h>
 #include <nvs_flash.h>
 #include <fmt/core.h>
 #include <fmt/format.h>
@@ -79,41 +99,144 @@ esp_err_t lv_print_readme_txt(const char *filename) {
 }
 
 esp_err_t init_spiff() {
-  ESP_LOGI(TAG, "Initializing SPIFFS");
-
-  esp_vfs_spiffs_conf_t conf = {.base_path = "/spiffs",
-                                .partition_label = NULL,
-                                .max_files = 5,
-                                .format_if_mount_failed = false};
-
-  // Use settings defined above to initialize and mount SPIFFS filesystem.
-  // Note: esp_vfs_spiffs_register is an all-in-one convenience function.
-  esp_err_t ret = esp_vfs_spiffs_register(&conf);
+  ESP_LOGI(TAG, "Initializing storage");
 
+  // Assets may have been updated into the second slot, or moved there onto
+  // the filesystem chosen in Storage Config
+  esp_err_t ret = ota_assets_mount(5);
   if (ret != ESP_OK) {
-    if (ret == ESP_FAIL) {
-      ESP_LOGE(TAG, "Failed to mount or format filesystem");
-    } else if (ret == ESP_ERR_NOT_FOUND) {
-      ESP_LOGE(TAG, "Failed to find SPIFFS partition");
-    } else {
-      ESP_LOGE(TAG, "Failed to initialize SPIFFS (%s)", esp_err_to_name(ret));
-    }
+    ESP_LOGE(TAG, "Failed to mount storage (%s)", esp_err_to_name(ret));
     return ESP_FAIL;
   }
 
   size_t total = 0, used = 0;
-  ret = esp_spiffs_info(NULL, &total, &used);
+  ret = storage_info(ota_assets_partition(), &total, &used);
   if (ret != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to get SPIFFS partition information (%s)",
+    ESP_LOGE(TAG, "Failed to get storage partition information (%s)",
              esp_err_to_name(ret));
   } else {
     ESP_LOGI(TAG, "Partition size: total: %d, used: %d", total, used);
   }
+#if defined(CONFIG_STORAGE_BENCHMARK)
+  storage_benchmark(ota_assets_spare_partition());
+#endif
   return ESP_OK;
+}
+
+#if defined(SD_SUPPORTED)
+esp_err_t init_sdcard() {
+  ESP_LOGI(TAG, "Initializing SD card");
+
+  spi_bus_config_t bus_cfg = {};
+  bus_cfg.mosi_io_num = SD_MOSI;
+  bus_cfg.miso_io_num = SD_MISO;
+  bus_cfg.sclk_io_num = SD_SCLK;
+  bus_cfg.quadwp_io_num = -1;
+  bus_cfg.quadhd_io_num = -1;
+  bus_cfg.max_transfer_sz = 4096;
+  esp_err_t ret = spi_bus_initialize(SDSPI_HOST_ID, &bus_cfg, SDSPI_DEFAULT_DMA);
+  if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) { // may be shared
+    ESP_LOGE(TAG, "Failed to initialize SD SPI bus (%s)", esp_err_to_name(ret));
+    return ret;
+  }
+
+  sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+  host.slot = SDSPI_HOST_ID;
+  sdspi_device_config_t slot = SDSPI_DEVICE_CONFIG_DEFAULT();
+  slot.gpio_cs = SD_CS;
+  slot.host_id = SDSPI_HOST_ID;
+
+  // Allocation unit matches the 4 kB blocks of the sensor log
+  esp_vfs_fat_sdmmc_mount_config_t mount_config = {
+      .format_if_mount_failed = false,
+      .max_files = 5,
+      .allocation_unit_size = 16 * 1024};
 
-  // esp_vfs_spiffs_unregister(NULL);
-  // ESP_LOGI(TAG, "SPIFFS unmounted");
+  sdmmc_card_t *card;
+  ret = esp_vfs_fat_sdspi_mount("/sdcard", &host, &slot, &mount_config, &card);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to mount SD card (%s)", esp_err_to_name(ret));
+    return ret;
+  }
+  sdmmc_card_print_info(stdout, card);
+  return ESP_OK;
+}
+#endif
+
+#if defined(CONFIG_NMEA0183_ENABLE)
+static void start_nmea0183() {
+  // Lives for the lifetime of the app
+  static Nmea0183 nmea;
+  static NmeaModel nmea_model;
+  static NmeaUart nmea_uart(nmea);
+
+  nmea.subscribe(&nmea_model);
+#if defined(CONFIG_AIS_ENABLE)
+  static AisTargets ais_targets(CONFIG_AIS_MAX_TARGETS);
+  static Ais ais(ais_targets);
+  ESP_ERROR_CHECK(ais_targets.init(CONFIG_AIS_EXPIRY_MIN * 60 * 1000));
+  nmea.subscribe(&ais);
+#endif
+  nmea_uart.add_port((uart_port_t)CONFIG_NMEA0183_UART_NUM,
+                     CONFIG_NMEA0183_BAUD, CONFIG_NMEA0183_RX_GPIO);
+#if defined(CONFIG_NMEA0183_SECOND_PORT)
+  nmea_uart.add_port((uart_port_t)CONFIG_NMEA0183_SECOND_UART_NUM,
+                     CONFIG_NMEA0183_SECOND_BAUD, CONFIG_NMEA0183_SECOND_RX_GPIO);
+#endif
+  ESP_ERROR_CHECK(nmea_uart.start());
 }
+#endif
+
+#if defined(CONFIG_N2K_ENABLE)
+static void start_nmea2000() {
+  // Lives for the lifetime of the app
+  static Nmea2000 n2k;
+  static N2kModel n2k_model;
+  static N2kTwai n2k_twai(n2k);
+
+  n2k.subscribe(&n2k_model);
+  ESP_ERROR_CHECK(n2k_twai.start(CONFIG_N2K_TX_GPIO, CONFIG_N2K_RX_GPIO));
+}
+#endif
+
+#if defined(CONFIG_OTA_RESUMABLE)
+// A download cut short by a lost link or a reboot continues once the
+// station is back online
+static void ota_resume_handler(void *arg, esp_event_base_t base, int32_t id,
+                               void *data) {
+  if (ota_resume_pending() && xTaskGetHandle("ota") == nullptr) {
+    ESP_LOGI(TAG, "Resuming interrupted OTA");
+    xTaskCreatePinnedToCore(run_ota_task, "ota", 1024 * 8, nullptr, 5,
+                            nullptr, 0);
+  }
+}
+#endif
+
+#if defined(CONFIG_ASSETS_UPDATE)
+// Looks for newer assets once per boot
+static void assets_update_handler(void *arg, esp_event_base_t base, int32_t id,
+                                  void *data) {
+  static bool checked = false;
+  if (!checked && xTaskGetHandle("ota") == nullptr) {
+    checked = true;
+    xTaskCreatePinnedToCore(run_asset_update_task, "assets", 1024 * 8, nullptr,
+                            5, nullptr, 0);
+  }
+}
+#endif
+
+#if defined(CONFIG_OTA_BENCHMARK)
+// Development builds: measure OTA throughput once the station is online
+static void ota_bench_handler(void *arg, esp_event_base_t base, int32_t id,
+                              void *data) {
+  static bool started = false;
+  if (!started && xTaskGetHandle("ota_bench") == nullptr) {
+    started = true;
+    xTaskCreatePinnedToCore(run_ota_bench_task, "ota_bench", 1024 * 8, nullptr,
+                            5, nullptr, 0);
+  }
+}
+#endif
 
 extern "C" void app_main(void) {
   esp_log_level_set(TAG, ESP_LOG_DEBUG); // enable DEBUG logs for this App
@@ -130,23 +253,131 @@ extern "C" void app_main(void) {
       err = nvs_flash_init();
   }
   ESP_ERROR_CHECK(err);
+#if defined(CONFIG_PREFERENCES_BENCHMARK)
+  preferences_benchmark("prefs_bench");
+#endif
+  // Write-back, so dragging a slider ends in a single NVS write
+  if (settings().begin("settings", 1000))
+    ESP_LOGI(TAG, "Settings: %u of %u from NVS", settings().loaded(),
+             Settings::size);
 
   init_spiff();
+#if defined(SD_SUPPORTED)
+  [[maybe_unused]] bool sdcard = init_sdcard() == ESP_OK;
+#endif
+
+#if defined(CONFIG_SETTINGS_SNAPSHOT)
+  // Nothing in NVS: first boot of a panel, or NVS erased above
+  if (settings().loaded() == 0) {
+    esp_err_t restored = ESP_ERR_NOT_FOUND;
+#if defined(SD_SUPPORTED)
+    if (sdcard)
+      restored = settings_import("/sdcard/settings.json");
+#endif
+    if (restored != ESP_OK)
+      settings_import(CONFIG_SETTINGS_FILE);
+  }
+  settings_autosave(CONFIG_SETTINGS_FILE);
+#endif
 
   ESP_LOGI(TAG, "[APP] Free memory: %" PRIu32 " bytes", esp_get_free_heap_size());
 
   Display &display = Display::instance();
   display.init(std::make_shared<Lcd>());
+#if defined(CONFIG_LVFS_CACHE)
+  // Before the GUI thread starts, so no lock is needed. On failure the
+  // uncached built-in driver stays in place.
+  ESP_ERROR_CHECK_WITHOUT_ABORT(lvfs_cache_register(
+      'F', "/spiffs", CONFIG_LVFS_FLASH_BLOCK_SIZE, CONFIG_LVFS_FLASH_BLOCKS));
+#if defined(SD_SUPPORTED)
+  if (sdcard)
+    ESP_ERROR_CHECK_WITHOUT_ABORT(lvfs_cache_register(
+        'S', "/sdcard", CONFIG_LVFS_SD_BLOCK_SIZE, CONFIG_LVFS_SD_BLOCKS));
+#endif
+  lvfs_cache_log_every(CONFIG_LVFS_STATS_SECONDS);
+#endif
 
   ESP_ERROR_CHECK(esp_event_loop_create_default());
   ESP_ERROR_CHECK(esp_event_handler_instance_register(
       TUX_EVENTS, ESP_EVENT_ANY_ID, tux_event_handler, NULL, NULL));
+  settings().subscribe<SETTING_BRIGHTNESS>([](const uint8_t &level) {
+    esp_event_post(TUX_EVENTS, TUX_EVENT_BRIGHTNESS_CHANGED, &level,
+                   sizeof(level), 0);
+  });
+  settings().subscribe<SETTING_DARK_THEME>([](const bool &dark) {
+    esp_event_post(TUX_EVENTS, TUX_EVENT_THEME_CHANGED, &dark, sizeof(dark), 0);
+  });
+
+#if defined(CONFIG_OTA_RESUMABLE)
+  ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                             ota_resume_handler, NULL));
+#endif
+#if defined(CONFIG_OTA_BENCHMARK)
+  ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                             ota_bench_handler, NULL));
+#endif
+#if defined(CONFIG_ASSETS_UPDATE)
+  ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                             assets_update_handler, NULL));
+#endif
+#if defined(CONFIG_HISTORY_ENABLE)
+  ESP_ERROR_CHECK(History::instance().start());
+#endif
+#if defined(CONFIG_LOGGER_ENABLE)
+  // The asset slot also holds the assets, settings and weather cache
+  const char *log_dir = "/spiffs/log";
+  uint64_t log_max = uint64_t(CONFIG_LOGGER_MAX_FLASH_KB) * 1024;
+#if defined(SD_SUPPORTED)
+  if (sdcard) {
+    log_dir = "/sdcard/log";
+    log_max = uint64_t(CONFIG_LOGGER_MAX_SD_MB) * 1024 * 1024;
+  }
+#endif
+  static Logger logger(log_dir, CONFIG_LOGGER_SEGMENT_BLOCKS,
+                       CONFIG_LOGGER_FLUSH_SECONDS, log_max);
+  ESP_ERROR_CHECK(logger.start());
+#endif
+#if defined(CONFIG_ALARM_ENABLE)
+  // Subscribes to the model, so before the ingestion tasks start
+  static AlarmEngine alarms;
+  ESP_ERROR_CHECK(alarms.compile(alarm_rules, alarm_rules_count));
+  ESP_ERROR_CHECK(alarms.start());
+#endif
+  // The home page binds labels to the model, so before the ingestion tasks start
+  Gui &gui = Gui::instance();
+  gui.show();
+
+#if defined(CONFIG_NMEA0183_ENABLE)
+  start_nmea0183();
+#endif
+#if defined(CONFIG_N2K_ENABLE)
+  start_nmea2000();
+#endif
+#if defined(CONFIG_SIGNALK_ENABLE)
+  static SignalK signalk(CONFIG_SIGNALK_URL);
+  ESP_ERROR_CHECK(signalk.start());
+#endif
+#if defined(CONFIG_MQTT_TELEMETRY_ENABLE)
+  static Telemetry telemetry(CONFIG_BROKER_URL, CONFIG_MQTT_TOPIC_PREFIX);
+  ESP_ERROR_CHECK(telemetry.start());
+#endif
 
   lv_print_readme_txt("F:/readme.txt"); // SPIFF / FAT
 //   lv_print_readme_txt("S:/readme.txt"); // SDCARD
 
-  Gui &gui = Gui::instance();
-  gui.show();
+#if defined(CONFIG_ALARM_ENABLE)
+  // The banner lives on the top layer, so after the GUI is up
+  static AlarmBanner alarm_banner(gui.thread(), alarms);
+  ESP_ERROR_CHECK(alarm_banner.start());
+  static AnchorButton anchor_button(gui.thread(), alarms);
+  anchor_button.start();
+#endif
+#if defined(CONFIG_WEATHER_ENABLE)
+  // Shows the cached weather right away, refreshes once Wi-Fi is up
+  static Weather weather(gui.thread(), "/spiffs/weather/cache.bin",
+                         CONFIG_WEATHER_REFRESH_SECONDS);
+  ESP_ERROR_CHECK(weather.start());
+#endif
 }
 
 static const char *get_id_string(esp_event_base_t base, int32_t id) {
@@ -172,6 +403,12 @@ static const char *get_id_string(esp_event_base_t base, int32_t id) {
     return "TUX_EVENT_THEME_CHANGED";
   case TUX_EVENT_BRIGHTNESS_CHANGED:
     return "TUX_EVENT_BRIGHTNESS_CHANGED";
+  case TUX_EVENT_ALARM_RAISED:
+    return "TUX_EVENT_ALARM_RAISED";
+  case TUX_EVENT_ALARM_CLEARED:
+    return "TUX_EVENT_ALARM_CLEARED";
+  case TUX_EVENT_ALARM_ACKED:
+    return "TUX_EVENT_ALARM_ACKED";
   default:
     return "TUX_EVENT_UNKNOWN";
   }
@@ -184,6 +421,8 @@ static void tux_event_handler(void *arg, esp_event_base_t event_base,
            get_id_string(event_base, event_id));
   if (event_base != TUX_EVENTS)
     return; // bye bye - me not invited :(
+  if (event_id == TUX_EVENT_OTA_STARTED)
+    Preferences::flushAll(); // settings must not wait for the OTA reboot
 }
 
 static std::string device_info() {
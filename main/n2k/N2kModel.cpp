@@ -0,0 +1,85 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "N2kModel.hpp"
+#include "ShipModel.hpp"
+
+using namespace ship;
+
+void N2kModel::on_position(const N2kPosition &m) {
+  ShipModel &model = ShipModel::instance();
+  model.latitude.set(m.latitude);
+  model.longitude.set(m.longitude);
+}
+
+void N2kModel::on_cog_sog(const N2kCogSog &m) {
+  ShipModel &model = ShipModel::instance();
+  if (!m.magnetic)
+    model.cog.set(m.cog);
+  model.sog.set(m.sog);
+}
+
+void N2kModel::on_heading(const N2kHeading &m) {
+  if (!m.magnetic)
+    return; // ShipModel heading is magnetic
+  float heading = m.heading;
+  if (!std::isnan(m.deviation))
+    heading += m.deviation;
+  ShipModel::instance().heading.set(fmodf(heading + 360.0f, 360.0f));
+}
+
+void N2kModel::on_rudder(const N2kRudder &m) {
+  if (m.instance == 0)
+    ShipModel::instance().rudder_angle.set(m.position);
+}
+
+void N2kModel::on_wind(const N2kWind &m) {
+  if (m.reference != 2)
+    return; // apparent only
+  ShipModel &model = ShipModel::instance();
+  model.wind_angle.set(m.angle);
+  model.wind_speed.set(m.speed);
+}
+
+void N2kModel::on_depth(const N2kDepth &m) {
+  ShipModel::instance().depth.set(m.depth);
+}
+
+void N2kModel::on_engine_rapid(const N2kEngineRapid &m) {
+  if (m.instance == 0)
+    ShipModel::instance().engine_rpm.set(m.rpm);
+}
+
+void N2kModel::on_engine_dynamic(const N2kEngineDynamic &m) {
+  if (m.instance == 0)
+    ShipModel::instance().engine_temp.set(m.temperature);
+}
+
+void N2kModel::on_battery(const N2kBattery &m) {
+  if (m.instance != 0)
+    return;
+  ShipModel &model = ShipModel::instance();
+  model.battery_voltage.set(m.voltage);
+  model.battery_current.set(m.current);
+}
@@ -0,0 +1,51 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __N2K_MODEL_HPP
+#define __N2K_MODEL_HPP
+
+#include "Nmea2000.hpp"
+
+namespace ship {
+
+/**
+ * N2kModel copies decoded NMEA 2000 data into the ShipModel.
+ * Only engine and battery instance 0 are shown.
+ */
+class N2kModel : public N2kListener {
+public:
+  void on_position(const N2kPosition &m) override;
+  void on_cog_sog(const N2kCogSog &m) override;
+  void on_heading(const N2kHeading &m) override;
+  void on_rudder(const N2kRudder &m) override;
+  void on_wind(const N2kWind &m) override;
+  void on_depth(const N2kDepth &m) override;
+  void on_engine_rapid(const N2kEngineRapid &m) override;
+  void on_engine_dynamic(const N2kEngineDynamic &m) override;
+  void on_battery(const N2kBattery &m) override;
+};
+
+} // namespace ship
+
+#endif // __N2K_MODEL_HPP
@@ -0,0 +1,95 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "N2kTwai.hpp"
+#include "log_tag.hpp"
+#include <esp_timer.h>
+
+using namespace ship;
+
+#define N2K_RX_QUEUE_LEN 64 // ~35ms of a saturated bus
+
+N2kTwai::N2kTwai(Nmea2000 &n2k) : _n2k(n2k) {}
+
+N2kTwai::~N2kTwai() {
+  if (_task_handle) {
+    vTaskDelete(_task_handle);
+    twai_stop();
+    twai_driver_uninstall();
+  }
+}
+
+esp_err_t N2kTwai::start(int tx_pin, int rx_pin) {
+  if (_task_handle)
+    return ESP_ERR_INVALID_STATE;
+
+  // Listen only - the panel never transmits, so no address claim is needed
+  twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(
+      (gpio_num_t)tx_pin, (gpio_num_t)rx_pin, TWAI_MODE_LISTEN_ONLY);
+  g_config.rx_queue_len = N2K_RX_QUEUE_LEN;
+  g_config.tx_queue_len = 0;
+  g_config.alerts_enabled = TWAI_ALERT_NONE;
+  const twai_timing_config_t t_config = TWAI_TIMING_CONFIG_250KBITS();
+  // PGNs are spread over the whole 29 bit id, so the single hardware
+  // acceptance filter cannot express the PGN table - filtering is done
+  // in Nmea2000::handle_frame instead.
+  const twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+
+  esp_err_t err = twai_driver_install(&g_config, &t_config, &f_config);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "twai_driver_install failed (%s)", esp_err_to_name(err));
+    return err;
+  }
+  err = twai_start();
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "twai_start failed (%s)", esp_err_to_name(err));
+    twai_driver_uninstall();
+    return err;
+  }
+
+  BaseType_t res = xTaskCreatePinnedToCore(task_handler, "nmea2000", 1024 * 4,
+                                           this, 6, &_task_handle, 0);
+  ESP_LOGI(TAG, "NMEA 2000 on TWAI TX GPIO%d RX GPIO%d", tx_pin, rx_pin);
+  return res == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+uint32_t N2kTwai::missed() const {
+  twai_status_info_t status;
+  if (twai_get_status_info(&status) != ESP_OK)
+    return 0;
+  return status.rx_missed_count + status.rx_overrun_count;
+}
+
+void N2kTwai::task_handler(void *arg) {
+  N2kTwai *self = reinterpret_cast<N2kTwai *>(arg);
+  twai_message_t msg;
+  while (1) {
+    if (twai_receive(&msg, portMAX_DELAY) != ESP_OK)
+      continue;
+    if (!msg.extd || msg.rtr)
+      continue; // NMEA 2000 only uses extended data frames
+    uint32_t now_ms = esp_timer_get_time() / 1000;
+    self->_n2k.handle_frame(msg.identifier, msg.data, msg.data_length_code, now_ms);
+  }
+}
@@ -0,0 +1,63 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __N2K_TWAI_HPP
+#define __N2K_TWAI_HPP
+
+#include "Nmea2000.hpp"
+#include <driver/twai.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+namespace ship {
+
+/**
+ * N2kTwai receives NMEA 2000 frames from the TWAI (CAN) controller in
+ * listen-only mode and hands them to the decoder.
+ * A saturated 250 kbit/s bus carries roughly 1800 frames/s; the driver
+ * queue absorbs bursts and the decoder drops unwanted PGNs first thing.
+ */
+class N2kTwai {
+public:
+  explicit N2kTwai(Nmea2000 &n2k);
+  ~N2kTwai();
+
+  /** \fn esp_err_t start(int tx_pin, int rx_pin)
+   *  \brief Installs the TWAI driver at 250 kbit/s and starts the receive task.
+   */
+  esp_err_t start(int tx_pin, int rx_pin);
+
+  /** \brief Frames lost because the driver queue was full. */
+  uint32_t missed() const;
+
+private:
+  static void task_handler(void *arg);
+
+  Nmea2000 &_n2k;
+  TaskHandle_t _task_handle = nullptr;
+};
+
+} // namespace ship
+
+#endif // __N2K_TWAI_HPP
@@ -0,0 +1,277 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Nmea2000.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace ship;
+
+static constexpr float RAD_TO_DEG = 57.2957795f;
+static constexpr float MS_TO_KNOTS = 1.943844f;
+
+struct PgnFilter {
+  uint32_t pgn;
+  bool fast_packet;
+};
+
+// Accepted PGNs, sorted for binary search. Everything else is dropped.
+static constexpr PgnFilter pgn_filter[] = {
+    {N2K_PGN_RUDDER, false},
+    {N2K_PGN_HEADING, false},
+    {N2K_PGN_ENGINE_RAPID, false},
+    {N2K_PGN_ENGINE_DYNAMIC, true},
+    {N2K_PGN_BATTERY, false},
+    {N2K_PGN_DEPTH, false},
+    {N2K_PGN_POSITION_RAPID, false},
+    {N2K_PGN_COG_SOG_RAPID, false},
+    {N2K_PGN_WIND, false},
+};
+
+static constexpr bool is_sorted_filter() {
+  for (size_t i = 1; i < sizeof(pgn_filter) / sizeof(pgn_filter[0]); i++)
+    if (pgn_filter[i - 1].pgn >= pgn_filter[i].pgn)
+      return false;
+  return true;
+}
+static_assert(is_sorted_filter(), "pgn_filter must be sorted by PGN");
+
+static const PgnFilter *find_filter(uint32_t pgn) {
+  auto end = std::end(pgn_filter);
+  auto it = std::lower_bound(std::begin(pgn_filter), end, pgn,
+                             [](const PgnFilter &f, uint32_t p) { return f.pgn < p; });
+  return (it != end && it->pgn == pgn) ? it : nullptr;
+}
+
+/* Little endian field readers, "not available" values read as NAN */
+
+static uint16_t u16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static uint32_t u32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+static float uf16(const uint8_t *p, float scale) {
+  uint16_t v = u16(p);
+  return v >= 0xFFFD ? NAN : v * scale;
+}
+
+static float sf16(const uint8_t *p, float scale) {
+  int16_t v = int16_t(u16(p));
+  return v >= 0x7FFD ? NAN : v * scale;
+}
+
+static float uf32(const uint8_t *p, float scale) {
+  uint32_t v = u32(p);
+  return v >= 0xFFFFFFFD ? NAN : v * scale;
+}
+
+static double sf32(const uint8_t *p, double scale) {
+  int32_t v = int32_t(u32(p));
+  return v >= 0x7FFFFFFD ? NAN : v * scale;
+}
+
+uint32_t Nmea2000::pgn_of(uint32_t id) {
+  uint32_t dp = (id >> 24) & 0x03;   // extended data page + data page
+  uint32_t pf = (id >> 16) & 0xFF;
+  uint32_t ps = (id >> 8) & 0xFF;
+  // PDU1 (pf < 240) carries a destination address in PS, not part of the PGN
+  return (dp << 16) | (pf << 8) | (pf >= 240 ? ps : 0);
+}
+
+void Nmea2000::handle_frame(uint32_t id, const uint8_t *data, uint8_t len,
+                            uint32_t now_ms) {
+  _stats.frames++;
+  // A classic CAN DLC goes up to 15 but still means 8 bytes of data
+  len = std::min<uint8_t>(len, 8);
+
+  uint32_t pgn = pgn_of(id);
+  const PgnFilter *filter = find_filter(pgn);
+  if (!filter) {
+    _stats.filtered++;
+    return;
+  }
+
+  uint8_t source = id & 0xFF;
+  if (filter->fast_packet)
+    fast_packet(pgn, source, data, len, now_ms);
+  else
+    decode(pgn, source, data, len);
+}
+
+Nmea2000::Slot *Nmea2000::find_slot(uint32_t pgn, uint8_t source,
+                                    uint32_t now_ms) {
+  Slot *free_slot = nullptr;
+  for (auto &slot : _slots) {
+    if (slot.in_use && now_ms - slot.started_ms > N2K_FAST_PACKET_TIMEOUT_MS) {
+      slot.in_use = false; // sender went away mid-message
+      _stats.fast_packet_errors++;
+    }
+    if (slot.in_use && slot.pgn == pgn && slot.source == source)
+      return &slot;
+    if (!slot.in_use && !free_slot)
+      free_slot = &slot;
+  }
+  return free_slot;
+}
+
+void Nmea2000::fast_packet(uint32_t pgn, uint8_t source, const uint8_t *data,
+                           uint8_t len, uint32_t now_ms) {
+  if (len < 2)
+    return;
+
+  uint8_t sequence = data[0] >> 5;
+  uint8_t frame = data[0] & 0x1F;
+
+  Slot *slot = find_slot(pgn, source, now_ms);
+  if (frame == 0) {
+    if (!slot) {
+      _stats.slot_overruns++;
+      return;
+    }
+    if (slot->in_use)
+      _stats.fast_packet_errors++; // previous message never completed
+    slot->pgn = pgn;
+    slot->source = source;
+    slot->sequence = sequence;
+    slot->size = std::min<uint8_t>(data[1], N2K_FAST_PACKET_MAX);
+    slot->received = 0;
+    slot->next_frame = 1;
+    slot->started_ms = now_ms;
+    slot->in_use = true;
+
+    uint8_t n = std::min<uint8_t>(len - 2, slot->size);
+    memcpy(slot->data, data + 2, n);
+    slot->received = n;
+  } else {
+    if (!slot || !slot->in_use)
+      return; // first frame was missed or filtered
+    if (slot->sequence != sequence || slot->next_frame != frame) {
+      slot->in_use = false;
+      _stats.fast_packet_errors++;
+      return;
+    }
+    uint8_t n = std::min<uint8_t>(len - 1, slot->size - slot->received);
+    memcpy(slot->data + slot->received, data + 1, n);
+    slot->received += n;
+    slot->next_frame++;
+  }
+
+  if (slot->received >= slot->size) {
+    slot->in_use = false;
+    decode(pgn, source, slot->data, slot->size);
+  }
+}
+
+void Nmea2000::decode(uint32_t pgn, uint8_t source, const uint8_t *d,
+                      size_t len) {
+  switch (pgn) {
+  case N2K_PGN_POSITION_RAPID: {
+    if (len < 8)
+      return;
+    N2kPosition m{source, sf32(d, 1e-7), sf32(d + 4, 1e-7)};
+    for (auto *l : _listeners)
+      l->on_position(m);
+    break;
+  }
+  case N2K_PGN_COG_SOG_RAPID: {
+    if (len < 6)
+      return;
+    N2kCogSog m{source, (d[1] & 0x03) == 1, uf16(d + 2, 1e-4f * RAD_TO_DEG),
+                uf16(d + 4, 0.01f * MS_TO_KNOTS)};
+    for (auto *l : _listeners)
+      l->on_cog_sog(m);
+    break;
+  }
+  case N2K_PGN_HEADING: {
+    if (len < 8)
+      return;
+    N2kHeading m{source, (d[7] & 0x03) == 1, uf16(d + 1, 1e-4f * RAD_TO_DEG),
+                 sf16(d + 3, 1e-4f * RAD_TO_DEG), sf16(d + 5, 1e-4f * RAD_TO_DEG)};
+    for (auto *l : _listeners)
+      l->on_heading(m);
+    break;
+  }
+  case N2K_PGN_RUDDER: {
+    if (len < 6)
+      return;
+    N2kRudder m{source, d[0], sf16(d + 4, 1e-4f * RAD_TO_DEG)};
+    for (auto *l : _listeners)
+      l->on_rudder(m);
+    break;
+  }
+  case N2K_PGN_WIND: {
+    if (len < 6)
+      return;
+    N2kWind m{source, uint8_t(d[5] & 0x07), uf16(d + 1, 0.01f * MS_TO_KNOTS),
+              uf16(d + 3, 1e-4f * RAD_TO_DEG)};
+    for (auto *l : _listeners)
+      l->on_wind(m);
+    break;
+  }
+  case N2K_PGN_DEPTH: {
+    if (len < 7)
+      return;
+    N2kDepth m{source, uf32(d + 1, 0.01f), sf16(d + 5, 0.001f)};
+    for (auto *l : _listeners)
+      l->on_depth(m);
+    break;
+  }
+  case N2K_PGN_ENGINE_RAPID: {
+    if (len < 5)
+      return;
+    N2kEngineRapid m{source, d[0], uf16(d + 1, 0.25f), uf16(d + 3, 100.0f)};
+    for (auto *l : _listeners)
+      l->on_engine_rapid(m);
+    break;
+  }
+  case N2K_PGN_ENGINE_DYNAMIC: {
+    if (len < 15)
+      return;
+    N2kEngineDynamic m{source,
+                       d[0],
+                       uf16(d + 1, 100.0f),
+                       uf16(d + 3, 0.1f),
+                       uf16(d + 5, 0.01f),
+                       sf16(d + 7, 0.01f),
+                       sf16(d + 9, 0.1f),
+                       uf32(d + 11, 1.0f)};
+    for (auto *l : _listeners)
+      l->on_engine_dynamic(m);
+    break;
+  }
+  case N2K_PGN_BATTERY: {
+    if (len < 7)
+      return;
+    N2kBattery m{source, d[0], sf16(d + 1, 0.01f), sf16(d + 3, 0.1f),
+                 uf16(d + 5, 0.01f)};
+    for (auto *l : _listeners)
+      l->on_battery(m);
+    break;
+  }
+  default:
+    return;
+  }
+  _stats.messages++;
+}
@@ -0,0 +1,196 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __NMEA2000_HPP
+#define __NMEA2000_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ship {
+
+/*
+    NMEA 2000 frame filtering, fast-packet reassembly and PGN decoding.
+    Frames whose PGN is not in the filter table are dropped before any other
+    work. Fast packets are reassembled in a fixed pool of slots, so the
+    receive path never allocates.
+    Values are converted to the units of ShipModel (degrees, knots, metres,
+    Kelvin, volts). "Data not available" is decoded as NAN.
+*/
+
+static constexpr size_t N2K_FAST_PACKET_MAX = 223;
+static constexpr size_t N2K_FAST_PACKET_SLOTS = 8;
+static constexpr uint32_t N2K_FAST_PACKET_TIMEOUT_MS = 750;
+
+enum N2kPgn : uint32_t {
+  N2K_PGN_RUDDER = 127245,
+  N2K_PGN_HEADING = 127250,
+  N2K_PGN_ENGINE_RAPID = 127488,
+  N2K_PGN_ENGINE_DYNAMIC = 127489,
+  N2K_PGN_BATTERY = 127508,
+  N2K_PGN_DEPTH = 128267,
+  N2K_PGN_POSITION_RAPID = 129025,
+  N2K_PGN_COG_SOG_RAPID = 129026,
+  N2K_PGN_WIND = 130306,
+};
+
+struct N2kPosition {
+  uint8_t source;
+  double latitude;
+  double longitude;
+};
+
+struct N2kCogSog {
+  uint8_t source;
+  bool magnetic;      // COG reference
+  float cog;          // degrees
+  float sog;          // knots
+};
+
+struct N2kHeading {
+  uint8_t source;
+  bool magnetic;
+  float heading;      // degrees
+  float deviation;
+  float variation;
+};
+
+struct N2kRudder {
+  uint8_t source;
+  uint8_t instance;
+  float position;     // degrees, positive to starboard
+};
+
+struct N2kWind {
+  uint8_t source;
+  uint8_t reference;  // 0 true (ground, north), 1 magnetic, 2 apparent, 3 true (boat), 4 true (water)
+  float speed;        // knots
+  float angle;        // degrees
+};
+
+struct N2kDepth {
+  uint8_t source;
+  float depth;        // metres below transducer
+  float offset;       // metres, + to waterline, - to keel
+};
+
+struct N2kEngineRapid {
+  uint8_t source;
+  uint8_t instance;
+  float rpm;
+  float boost;        // Pa
+};
+
+struct N2kEngineDynamic {
+  uint8_t source;
+  uint8_t instance;
+  float oil_pressure; // Pa
+  float oil_temp;     // Kelvin
+  float temperature;  // Kelvin (coolant)
+  float alternator;   // volts
+  float fuel_rate;    // l/h
+  float hours;        // seconds
+};
+
+struct N2kBattery {
+  uint8_t source;
+  uint8_t instance;
+  float voltage;      // volts
+  float current;      // amperes
+  float temperature;  // Kelvin
+};
+
+/**
+ * Implement the PGNs of interest; everything defaults to no-op.
+ * Callbacks run on the receiving task and must not block.
+ */
+class N2kListener {
+public:
+  virtual ~N2kListener() = default;
+  virtual void on_position(const N2kPosition &) {}
+  virtual void on_cog_sog(const N2kCogSog &) {}
+  virtual void on_heading(const N2kHeading &) {}
+  virtual void on_rudder(const N2kRudder &) {}
+  virtual void on_wind(const N2kWind &) {}
+  virtual void on_depth(const N2kDepth &) {}
+  virtual void on_engine_rapid(const N2kEngineRapid &) {}
+  virtual void on_engine_dynamic(const N2kEngineDynamic &) {}
+  virtual void on_battery(const N2kBattery &) {}
+};
+
+struct N2kStats {
+  uint32_t frames;
+  uint32_t filtered;        // dropped by the PGN filter table
+  uint32_t messages;        // decoded messages
+  uint32_t fast_packet_errors; // out of order frames, timeouts
+  uint32_t slot_overruns;   // no free reassembly slot
+};
+
+class Nmea2000 {
+public:
+  /** \brief Registers a listener. Not thread safe - use during setup. */
+  void subscribe(N2kListener *listener) { _listeners.push_back(listener); }
+
+  /** \fn void handle_frame(uint32_t id, const uint8_t *data, uint8_t len, uint32_t now_ms)
+   *  \brief Filters, reassembles and decodes one received CAN frame.
+   *  \param id: 29 bit extended identifier.
+   *  \param len: the frame's DLC, as received; above 8 reads as 8.
+   *  \param now_ms: monotonic time, used to expire stale fast packets.
+   */
+  void handle_frame(uint32_t id, const uint8_t *data, uint8_t len,
+                    uint32_t now_ms);
+
+  const N2kStats &stats() const { return _stats; }
+
+  /** \brief Extracts the PGN from a 29 bit identifier. */
+  static uint32_t pgn_of(uint32_t id);
+
+private:
+  struct Slot {
+    uint32_t pgn;
+    uint8_t source;
+    uint8_t sequence;
+    uint8_t next_frame;
+    uint8_t size;
+    uint8_t received;
+    bool in_use;
+    uint32_t started_ms;
+    uint8_t data[N2K_FAST_PACKET_MAX];
+  };
+
+  void fast_packet(uint32_t pgn, uint8_t source, const uint8_t *data,
+                   uint8_t len, uint32_t now_ms);
+  Slot *find_slot(uint32_t pgn, uint8_t source, uint32_t now_ms);
+  void decode(uint32_t pgn, uint8_t source, const uint8_t *data, size_t len);
+
+  std::vector<N2kListener *> _listeners;
+  Slot _slots[N2K_FAST_PACKET_SLOTS] = {};
+  N2kStats _stats = {};
+};
+
+} // namespace ship
+
+#endif // __NMEA2000_HPP
@@ -0,0 +1,289 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Nmea0183.hpp"
+#include <cstdlib>
+#include <cstring>
+
+using namespace ship;
+
+// Packs a 3 letter sentence formatter so decoders can be picked by switch
+static constexpr uint32_t code(const char *f) {
+  return (uint32_t(uint8_t(f[0])) << 16) | (uint32_t(uint8_t(f[1])) << 8) |
+         uint32_t(uint8_t(f[2]));
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+static float to_float(const char *f) {
+  return (f && *f) ? strtof(f, nullptr) : NAN;
+}
+
+static uint32_t to_uint(const char *f) {
+  return (f && *f) ? strtoul(f, nullptr, 10) : 0;
+}
+
+static char to_char(const char *f) { return f ? f[0] : '\0'; }
+
+// hhmmss.ss => seconds since midnight
+static float to_time(const char *f) {
+  if (!f || strlen(f) < 6)
+    return NAN;
+  int hh = (f[0] - '0') * 10 + (f[1] - '0');
+  int mm = (f[2] - '0') * 10 + (f[3] - '0');
+  return hh * 3600 + mm * 60 + strtof(f + 4, nullptr);
+}
+
+// (d)ddmm.mmmm + hemisphere => signed degrees
+static double to_coord(const char *f, const char *hemi) {
+  if (!f || !*f || !hemi || !*hemi)
+    return NAN;
+  double v = strtod(f, nullptr);
+  double deg = floor(v / 100.0);
+  double res = deg + (v - deg * 100.0) / 60.0;
+  return (hemi[0] == 'S' || hemi[0] == 'W') ? -res : res;
+}
+
+// E/W suffixed angle => east positive
+static float to_signed(const char *f, const char *dir) {
+  float v = to_float(f);
+  return (dir && dir[0] == 'W') ? -v : v;
+}
+
+// Speed with unit letter => knots
+static float to_knots(float v, char unit) {
+  switch (unit) {
+  case 'K': return v / 1.852f;          // km/h
+  case 'M': return v * 1.943844f;       // m/s
+  case 'S': return v * 0.868976f;       // statute mph
+  default:  return v;                   // N
+  }
+}
+
+static void copy_talker(char *dst, const NmeaSentence &s) {
+  memcpy(dst, s.talker, sizeof(s.talker));
+}
+
+void Nmea0183::dispatch(char *line, size_t len) {
+  if (len < 6 || (line[0] != '$' && line[0] != '!')) {
+    _stats.malformed++;
+    return;
+  }
+
+  // Checksum is optional in 0183, but must match when present
+  char *star = static_cast<char *>(memchr(line, '*', len));
+  if (star) {
+    if (star + 2 >= line + len) {
+      _stats.malformed++;
+      return;
+    }
+    int hi = hex_value(star[1]);
+    int lo = hex_value(star[2]);
+    uint8_t sum = 0;
+    for (const char *p = line + 1; p < star; p++)
+      sum ^= uint8_t(*p);
+    if (hi < 0 || lo < 0 || sum != uint8_t((hi << 4) | lo)) {
+      _stats.checksum_errors++;
+      return;
+    }
+    *star = '\0';
+  } else {
+    line[len] = '\0';
+  }
+
+  // Tokenise in place: every ',' becomes a terminator
+  const char *fields[NMEA_MAX_FIELDS];
+  size_t count = 0;
+  char *p = line + 1;
+  fields[count++] = p;
+  while ((p = strchr(p, ',')) != nullptr && count < NMEA_MAX_FIELDS) {
+    *p++ = '\0';
+    fields[count++] = p;
+  }
+
+  // Address field: 2 char talker + 3 char formatter (proprietary P... is shorter)
+  size_t addr_len = strlen(fields[0]);
+  if (addr_len < 5) {
+    _stats.malformed++;
+    return;
+  }
+
+  NmeaSentence s;
+  s.talker[0] = fields[0][0];
+  s.talker[1] = fields[0][1];
+  s.talker[2] = '\0';
+  memcpy(s.formatter, fields[0] + addr_len - 3, 3);
+  s.formatter[3] = '\0';
+  s.encapsulated = line[0] == '!';
+  s.fields = fields;
+  s.count = count;
+
+  _stats.sentences++;
+  decode(s);
+  for (auto *l : _listeners)
+    l->on_sentence(s);
+}
+
+void Nmea0183::decode(const NmeaSentence &s) {
+  // Missing trailing fields read as empty
+  auto f = [&s](size_t i) -> const char * {
+    return i < s.count ? s.fields[i] : nullptr;
+  };
+
+  switch (code(s.formatter)) {
+  case code("RMC"): {
+    NmeaRmc m;
+    copy_talker(m.talker, s);
+    m.time = to_time(f(1));
+    m.valid = to_char(f(2)) == 'A';
+    m.latitude = to_coord(f(3), f(4));
+    m.longitude = to_coord(f(5), f(6));
+    m.sog = to_float(f(7));
+    m.cog = to_float(f(8));
+    m.date = to_uint(f(9));
+    m.variation = to_signed(f(10), f(11));
+    m.mode = to_char(f(12));
+    for (auto *l : _listeners)
+      l->on_rmc(m);
+    break;
+  }
+  case code("GGA"): {
+    NmeaGga m;
+    copy_talker(m.talker, s);
+    m.time = to_time(f(1));
+    m.latitude = to_coord(f(2), f(3));
+    m.longitude = to_coord(f(4), f(5));
+    m.quality = to_uint(f(6));
+    m.satellites = to_uint(f(7));
+    m.hdop = to_float(f(8));
+    m.altitude = to_float(f(9));
+    for (auto *l : _listeners)
+      l->on_gga(m);
+    break;
+  }
+  case code("VTG"): {
+    NmeaVtg m;
+    copy_talker(m.talker, s);
+    m.cog_true = to_float(f(1));
+    m.cog_magnetic = to_float(f(3));
+    m.sog = to_float(f(5));
+    if (std::isnan(m.sog))
+      m.sog = to_knots(to_float(f(7)), 'K');
+    m.mode = to_char(f(9));
+    for (auto *l : _listeners)
+      l->on_vtg(m);
+    break;
+  }
+  case code("HDG"): {
+    NmeaHdg m;
+    copy_talker(m.talker, s);
+    m.heading = to_float(f(1));
+    m.deviation = to_signed(f(2), f(3));
+    m.variation = to_signed(f(4), f(5));
+    for (auto *l : _listeners)
+      l->on_hdg(m);
+    break;
+  }
+  case code("MWV"): {
+    NmeaMwv m;
+    copy_talker(m.talker, s);
+    m.angle = to_float(f(1));
+    m.relative = to_char(f(2)) == 'R';
+    m.speed = to_knots(to_float(f(3)), to_char(f(4)));
+    m.valid = to_char(f(5)) == 'A';
+    for (auto *l : _listeners)
+      l->on_mwv(m);
+    break;
+  }
+  case code("DBT"): {
+    NmeaDbt m;
+    copy_talker(m.talker, s);
+    m.depth = to_float(f(3));
+    if (std::isnan(m.depth))
+      m.depth = to_float(f(1)) * 0.3048f;
+    for (auto *l : _listeners)
+      l->on_dbt(m);
+    break;
+  }
+  case code("DPT"): {
+    NmeaDpt m;
+    copy_talker(m.talker, s);
+    m.depth = to_float(f(1));
+    m.offset = to_float(f(2));
+    for (auto *l : _listeners)
+      l->on_dpt(m);
+    break;
+  }
+  case code("XDR"): {
+    NmeaXdr m;
+    copy_talker(m.talker, s);
+    m.count = 0;
+    for (size_t i = 1; i + 1 < s.count && m.count < NMEA_XDR_MAX; i += 4) {
+      auto &x = m.measurements[m.count++];
+      x.type = to_char(f(i));
+      x.value = to_float(f(i + 1));
+      x.unit = to_char(f(i + 2));
+      x.name = f(i + 3) ? f(i + 3) : "";
+    }
+    for (auto *l : _listeners)
+      l->on_xdr(m);
+    break;
+  }
+  default:
+    return;
+  }
+  _stats.decoded++;
+}
+
+void NmeaStream::feed(const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    char c = static_cast<char>(data[i]);
+
+    if (c == '$' || c == '!') {
+      // A start character always begins a new sentence, even mid-line
+      _len = 0;
+      _line[_len++] = c;
+      _in_sentence = true;
+    } else if (!_in_sentence) {
+      continue;
+    } else if (c == '\r' || c == '\n') {
+      _nmea.dispatch(_line, _len);
+      _in_sentence = false;
+    } else if (_len < NMEA_MAX_LINE) {
+      _line[_len++] = c;
+    } else {
+      // Too long - drop it and resync on the next start character
+      _in_sentence = false;
+      _nmea._stats.overflows++;
+    }
+  }
+}
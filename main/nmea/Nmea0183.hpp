@@ -0,0 +1,196 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __NMEA0183_HPP
+#define __NMEA0183_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ship {
+
+/*
+    NMEA 0183 sentence framing, validation and decoding.
+    No heap use and no copies past the line buffer: fields are tokenised in
+    place and decoded into the typed structs below.
+    Empty fields are decoded as NAN.
+*/
+
+static constexpr size_t NMEA_MAX_LINE = 96;    // spec says 82, be lenient
+static constexpr size_t NMEA_MAX_FIELDS = 40;  // XDR carries 4 per transducer
+static constexpr size_t NMEA_XDR_MAX = 8;
+
+struct NmeaSentence {
+  char talker[3];         // "GP", "II", "AI", ... (NUL terminated)
+  char formatter[4];      // "RMC", "VDM", ...
+  bool encapsulated;      // '!' sentence (AIS)
+  const char *const *fields; // fields[0] is the address field
+  size_t count;
+};
+
+struct NmeaRmc {
+  char talker[3];
+  float time;             // seconds since midnight UTC
+  bool valid;
+  double latitude;        // degrees, south negative
+  double longitude;       // degrees, west negative
+  float sog;              // knots
+  float cog;              // degrees true
+  uint32_t date;          // ddmmyy
+  float variation;        // degrees, west negative
+  char mode;              // FAA mode from NMEA 2.3, 'N' no fix, 0 if absent
+};
+
+struct NmeaGga {
+  char talker[3];
+  float time;
+  double latitude;
+  double longitude;
+  uint8_t quality;        // 0 = no fix
+  uint8_t satellites;
+  float hdop;
+  float altitude;         // metres
+};
+
+struct NmeaVtg {
+  char talker[3];
+  float cog_true;
+  float cog_magnetic;
+  float sog;              // knots
+  char mode;              // FAA mode from NMEA 2.3, 'N' no fix, 0 if absent
+};
+
+struct NmeaHdg {
+  char talker[3];
+  float heading;          // magnetic sensor heading
+  float deviation;        // east positive
+  float variation;        // east positive
+};
+
+struct NmeaMwv {
+  char talker[3];
+  float angle;            // degrees
+  bool relative;          // R = apparent / relative, T = true / theoretical
+  float speed;            // knots
+  bool valid;
+};
+
+struct NmeaDbt {
+  char talker[3];
+  float depth;            // metres below transducer
+};
+
+struct NmeaDpt {
+  char talker[3];
+  float depth;            // metres below transducer
+  float offset;           // + to waterline, - to keel
+};
+
+struct NmeaXdr {
+  char talker[3];
+  struct {
+    char type;            // C temperature, P pressure, A angle, T tacho ...
+    float value;
+    char unit;
+    const char *name;     // points into the line buffer
+  } measurements[NMEA_XDR_MAX];
+  size_t count;
+};
+
+/**
+ * Implement the sentences of interest; everything defaults to no-op.
+ * Callbacks run on the reading task and must not block.
+ */
+class NmeaListener {
+public:
+  virtual ~NmeaListener() = default;
+  virtual void on_rmc(const NmeaRmc &) {}
+  virtual void on_gga(const NmeaGga &) {}
+  virtual void on_vtg(const NmeaVtg &) {}
+  virtual void on_hdg(const NmeaHdg &) {}
+  virtual void on_mwv(const NmeaMwv &) {}
+  virtual void on_dbt(const NmeaDbt &) {}
+  virtual void on_dpt(const NmeaDpt &) {}
+  virtual void on_xdr(const NmeaXdr &) {}
+  /** Every valid sentence, decoded or not (e.g. !AIVDM). */
+  virtual void on_sentence(const NmeaSentence &) {}
+};
+
+struct NmeaStats {
+  uint32_t sentences;     // valid sentences
+  uint32_t decoded;       // sentences with a typed decoder
+  uint32_t checksum_errors;
+  uint32_t overflows;     // lines longer than NMEA_MAX_LINE
+  uint32_t malformed;
+};
+
+/**
+ * Decodes validated sentences and dispatches them to listeners.
+ * Shared between all input streams.
+ */
+class Nmea0183 {
+public:
+  /** \brief Registers a listener. Not thread safe - use during setup. */
+  void subscribe(NmeaListener *listener) { _listeners.push_back(listener); }
+
+  /** \fn void dispatch(char *line, size_t len)
+   *  \brief Validates, tokenises (in place) and dispatches one sentence.
+   *  \param line: sentence starting with '$' or '!', without CR/LF.
+   */
+  void dispatch(char *line, size_t len);
+
+  const NmeaStats &stats() const { return _stats; }
+
+private:
+  void decode(const NmeaSentence &s);
+
+  std::vector<NmeaListener *> _listeners;
+  NmeaStats _stats = {};
+
+  friend class NmeaStream;
+};
+
+/**
+ * Reassembles sentences from a byte stream. One per input port, since
+ * sentences of different ports must not be interleaved.
+ */
+class NmeaStream {
+public:
+  explicit NmeaStream(Nmea0183 &nmea) : _nmea(nmea) {}
+
+  /** \brief Feeds received bytes, dispatching every completed sentence. */
+  void feed(const uint8_t *data, size_t len);
+
+private:
+  Nmea0183 &_nmea;
+  char _line[NMEA_MAX_LINE + 1];
+  size_t _len = 0;
+  bool _in_sentence = false;
+};
+
+} // namespace ship
+
+#endif // __NMEA0183_HPP
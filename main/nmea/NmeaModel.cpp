@@ -0,0 +1,119 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "NmeaModel.hpp"
+#include "ShipModel.hpp"
+#include <cstring>
+
+using namespace ship;
+
+// Receivers without a fix still send RMC and VTG, with empty fields or
+// mode 'N'; keep the last good values rather than blank them
+void NmeaModel::on_rmc(const NmeaRmc &m) {
+  if (!m.valid || m.mode == 'N')
+    return;
+  ShipModel &model = ShipModel::instance();
+  if (!std::isnan(m.latitude) && !std::isnan(m.longitude)) {
+    model.latitude.set(m.latitude);
+    model.longitude.set(m.longitude);
+  }
+  if (!std::isnan(m.sog))
+    model.sog.set(m.sog);
+  if (!std::isnan(m.cog))
+    model.cog.set(m.cog);
+}
+
+void NmeaModel::on_vtg(const NmeaVtg &m) {
+  if (m.mode == 'N')
+    return;
+  ShipModel &model = ShipModel::instance();
+  if (!std::isnan(m.sog))
+    model.sog.set(m.sog);
+  if (!std::isnan(m.cog_true))
+    model.cog.set(m.cog_true);
+}
+
+void NmeaModel::on_hdg(const NmeaHdg &m) {
+  float heading = m.heading;
+  if (!std::isnan(m.deviation))
+    heading += m.deviation;
+  ShipModel::instance().heading.set(fmodf(heading + 360.0f, 360.0f));
+}
+
+void NmeaModel::on_mwv(const NmeaMwv &m) {
+  if (!m.valid || !m.relative)
+    return;
+  ShipModel &model = ShipModel::instance();
+  model.wind_angle.set(m.angle);
+  model.wind_speed.set(m.speed);
+}
+
+void NmeaModel::on_dbt(const NmeaDbt &m) {
+  ShipModel::instance().depth.set(m.depth);
+}
+
+void NmeaModel::on_dpt(const NmeaDpt &m) {
+  ShipModel::instance().depth.set(m.depth);
+}
+
+// Transducer names are not standardised, match the common ones loosely
+void NmeaModel::on_xdr(const NmeaXdr &m) {
+  ShipModel &model = ShipModel::instance();
+  for (size_t i = 0; i < m.count; i++) {
+    const auto &x = m.measurements[i];
+    if (std::isnan(x.value))
+      continue;
+
+    switch (x.type) {
+    case 'C': {
+      float kelvin = x.unit == 'K' ? x.value : x.value + 273.15f;
+      if (strstr(x.name, "WATER") || strstr(x.name, "WTH"))
+        model.water_temp.set(kelvin);
+      else if (strstr(x.name, "ENG"))
+        model.engine_temp.set(kelvin);
+      else if (strstr(x.name, "AIR") || strstr(x.name, "TEMP"))
+        model.air_temp.set(kelvin);
+      break;
+    }
+    case 'P':
+      model.pressure.set(x.unit == 'B' ? x.value * 100000.0f : x.value);
+      break;
+    case 'A':
+      if (strstr(x.name, "RUD"))
+        model.rudder_angle.set(x.value);
+      break;
+    case 'T':
+      model.engine_rpm.set(x.value);
+      break;
+    case 'U':
+      model.battery_voltage.set(x.value);
+      break;
+    case 'I':
+      model.battery_current.set(x.value);
+      break;
+    default:
+      break;
+    }
+  }
+}
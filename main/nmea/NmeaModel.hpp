@@ -0,0 +1,48 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __NMEA_MODEL_HPP
+#define __NMEA_MODEL_HPP
+
+#include "Nmea0183.hpp"
+
+namespace ship {
+
+/**
+ * NmeaModel copies decoded NMEA 0183 data into the ShipModel.
+ */
+class NmeaModel : public NmeaListener {
+public:
+  void on_rmc(const NmeaRmc &m) override;
+  void on_vtg(const NmeaVtg &m) override;
+  void on_hdg(const NmeaHdg &m) override;
+  void on_mwv(const NmeaMwv &m) override;
+  void on_dbt(const NmeaDbt &m) override;
+  void on_dpt(const NmeaDpt &m) override;
+  void on_xdr(const NmeaXdr &m) override;
+};
+
+} // namespace ship
+
+#endif // __NMEA_MODEL_HPP
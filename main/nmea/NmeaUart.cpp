@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "NmeaUart.hpp"
+#include "log_tag.hpp"
+#include <algorithm>
+
+using namespace ship;
+
+#define NMEA_RX_RING_SIZE   4096  // ~1s of a saturated 38400 baud link
+#define NMEA_EVENT_QUEUE    16
+#define NMEA_RX_CHUNK       256
+#define NMEA_RX_FULL_THRESH 64    // bytes in FIFO before the ISR runs
+
+NmeaUart::NmeaUart(Nmea0183 &nmea) : _nmea(nmea) {}
+
+NmeaUart::~NmeaUart() {
+  if (_task_handle)
+    vTaskDelete(_task_handle);
+  for (size_t i = 0; i < _port_cnt; i++) {
+    uart_driver_delete(_ports[i].uart);
+    delete _ports[i].stream;
+  }
+  if (_queue_set)
+    vQueueDelete(_queue_set);
+}
+
+esp_err_t NmeaUart::add_port(uart_port_t port, int baud, int rx_pin) {
+  if (_port_cnt >= MAX_PORTS || _task_handle)
+    return ESP_ERR_INVALID_STATE;
+
+  const uart_config_t config = {
+      .baud_rate = baud,
+      .data_bits = UART_DATA_8_BITS,
+      .parity = UART_PARITY_DISABLE,
+      .stop_bits = UART_STOP_BITS_1,
+      .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+      .source_clk = UART_SCLK_DEFAULT,
+  };
+
+  Port &p = _ports[_port_cnt];
+  p.uart = port;
+  ESP_ERROR_CHECK(uart_driver_install(port, NMEA_RX_RING_SIZE, 0,
+                                      NMEA_EVENT_QUEUE, &p.events, 0));
+  ESP_ERROR_CHECK(uart_param_config(port, &config));
+  ESP_ERROR_CHECK(uart_set_pin(port, UART_PIN_NO_CHANGE, rx_pin,
+                               UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+  uart_set_rx_full_threshold(port, NMEA_RX_FULL_THRESH);
+  uart_set_rx_timeout(port, 10); // symbols of idle line before flushing FIFO
+
+  p.stream = new NmeaStream(_nmea);
+  _port_cnt++;
+  ESP_LOGI(TAG, "NMEA 0183 on UART%d @ %d baud, RX GPIO%d", port, baud, rx_pin);
+  return ESP_OK;
+}
+
+esp_err_t NmeaUart::start() {
+  if (_port_cnt == 0 || _task_handle)
+    return ESP_ERR_INVALID_STATE;
+
+  _queue_set = xQueueCreateSet(NMEA_EVENT_QUEUE * _port_cnt);
+  for (size_t i = 0; i < _port_cnt; i++)
+    xQueueAddToSet(_ports[i].events, _queue_set);
+
+  // Same core as the protocol stacks, away from the LVGL task on core 1
+  BaseType_t res = xTaskCreatePinnedToCore(task_handler, "nmea0183", 1024 * 4,
+                                           this, 5, &_task_handle, 0);
+  return res == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void NmeaUart::task_handler(void *arg) {
+  NmeaUart *self = reinterpret_cast<NmeaUart *>(arg);
+  while (1) {
+    QueueSetMemberHandle_t member = xQueueSelectFromSet(self->_queue_set, portMAX_DELAY);
+    for (size_t i = 0; i < self->_port_cnt; i++) {
+      if (self->_ports[i].events == member)
+        self->drain(self->_ports[i]);
+    }
+  }
+}
+
+void NmeaUart::drain(Port &port) {
+  uart_event_t event;
+  if (xQueueReceive(port.events, &event, 0) != pdTRUE)
+    return;
+
+  switch (event.type) {
+  case UART_DATA: {
+    uint8_t chunk[NMEA_RX_CHUNK];
+    size_t buffered = 0;
+    uart_get_buffered_data_len(port.uart, &buffered);
+    while (buffered > 0) {
+      int len = uart_read_bytes(port.uart, chunk, std::min(buffered, sizeof(chunk)), 0);
+      if (len <= 0)
+        break;
+      port.stream->feed(chunk, len);
+      buffered -= len;
+    }
+    break;
+  }
+  case UART_FIFO_OVF:
+  case UART_BUFFER_FULL: {
+    // Reader fell behind; drop what is buffered and resync on the next '$'
+    size_t buffered = 0;
+    uart_get_buffered_data_len(port.uart, &buffered);
+    _dropped += buffered;
+    ESP_LOGW(TAG, "NMEA UART%d overflow, %u bytes dropped", port.uart, buffered);
+    uart_flush_input(port.uart);
+    xQueueReset(port.events);
+    break;
+  }
+  default:
+    break;
+  }
+}
@@ -0,0 +1,81 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __NMEA_UART_HPP
+#define __NMEA_UART_HPP
+
+#include "Nmea0183.hpp"
+#include <driver/uart.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+namespace ship {
+
+/**
+ * NmeaUart reads up to two NMEA 0183 talkers (e.g. a 38400 baud multiplexer
+ * and a 4800 baud instrument) from one task.
+ * The UART driver moves bytes from the FIFO into its ring buffer from the
+ * ISR; the task drains whole chunks on RX-full / RX-timeout events, so there
+ * is one wakeup per burst instead of one per byte.
+ */
+class NmeaUart {
+public:
+  static constexpr size_t MAX_PORTS = 2;
+
+  explicit NmeaUart(Nmea0183 &nmea);
+  ~NmeaUart();
+
+  /** \fn esp_err_t add_port(uart_port_t port, int baud, int rx_pin)
+   *  \brief Installs the UART driver for one talker. Call before start().
+   */
+  esp_err_t add_port(uart_port_t port, int baud, int rx_pin);
+
+  /** \brief Starts the reading task. */
+  esp_err_t start();
+
+  /** \brief Bytes lost to FIFO / ring buffer overflow. */
+  uint32_t dropped() const { return _dropped; }
+
+private:
+  struct Port {
+    uart_port_t uart;
+    QueueHandle_t events;
+    NmeaStream *stream;
+  };
+
+  static void task_handler(void *arg);
+  void drain(Port &port);
+
+  Nmea0183 &_nmea;
+  Port _ports[MAX_PORTS];
+  size_t _port_cnt = 0;
+  QueueSetHandle_t _queue_set = nullptr;
+  TaskHandle_t _task_handle = nullptr;
+  uint32_t _dropped = 0;
+};
+
+} // namespace ship
+
+#endif // __NMEA_UART_HPP
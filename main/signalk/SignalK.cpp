@@ -0,0 +1,240 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SignalK.hpp"
+#include "ShipModel.hpp"
+#include "log_tag.hpp"
+#include <cstring>
+#include <esp_wifi.h>
+#include <fmt/format.h>
+#include <iterator>
+
+using namespace ship;
+
+#define SIGNALK_WS_BUFFER_SIZE 1024
+
+static constexpr double RAD_TO_DEG = 57.29577951308232;
+static constexpr double MS_TO_KNOTS = 1.9438444924406;
+
+/* Subscribed paths. Signal K uses SI units, ShipModel uses degrees/knots. */
+struct SignalKPath {
+  const char *path;
+  void (*apply)(double value);
+};
+
+static const SignalKPath signalk_paths[] = {
+    {"navigation.courseOverGroundTrue",
+     [](double v) { ShipModel::instance().cog.set(v * RAD_TO_DEG); }},
+    {"navigation.speedOverGround",
+     [](double v) { ShipModel::instance().sog.set(v * MS_TO_KNOTS); }},
+    {"navigation.headingMagnetic",
+     [](double v) { ShipModel::instance().heading.set(v * RAD_TO_DEG); }},
+    {"environment.depth.belowTransducer",
+     [](double v) { ShipModel::instance().depth.set(v); }},
+    {"environment.wind.angleApparent",
+     [](double v) { ShipModel::instance().wind_angle.set(v * RAD_TO_DEG); }},
+    {"environment.wind.speedApparent",
+     [](double v) { ShipModel::instance().wind_speed.set(v * MS_TO_KNOTS); }},
+    {"environment.water.temperature",
+     [](double v) { ShipModel::instance().water_temp.set(v); }},
+    {"environment.outside.temperature",
+     [](double v) { ShipModel::instance().air_temp.set(v); }},
+    {"environment.outside.pressure",
+     [](double v) { ShipModel::instance().pressure.set(v); }},
+    {"steering.rudderAngle",
+     [](double v) { ShipModel::instance().rudder_angle.set(v * RAD_TO_DEG); }},
+    // Signal K revolutions are Hz
+    {"propulsion.main.revolutions",
+     [](double v) { ShipModel::instance().engine_rpm.set(v * 60.0); }},
+    {"propulsion.main.temperature",
+     [](double v) { ShipModel::instance().engine_temp.set(v); }},
+    {"electrical.batteries.house.voltage",
+     [](double v) { ShipModel::instance().battery_voltage.set(v); }},
+    {"electrical.batteries.house.current",
+     [](double v) { ShipModel::instance().battery_current.set(v); }},
+};
+
+static constexpr const char *SIGNALK_POSITION = "navigation.position";
+
+SignalK::SignalK(const char *url) : _url(url), _parser(*this) {}
+
+SignalK::~SignalK() {
+  esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, ip_event_handler);
+  if (_client) {
+    esp_websocket_client_stop(_client);
+    esp_websocket_client_destroy(_client);
+  }
+}
+
+esp_err_t SignalK::start() {
+  esp_websocket_client_config_t config = {};
+  config.uri = _url;
+  config.buffer_size = SIGNALK_WS_BUFFER_SIZE;
+  config.reconnect_timeout_ms = 5000;
+  config.network_timeout_ms = 10000;
+
+  _client = esp_websocket_client_init(&config);
+  if (!_client)
+    return ESP_ERR_NO_MEM;
+  esp_websocket_register_events(_client, WEBSOCKET_EVENT_ANY, ws_event_handler, this);
+
+  return esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                    ip_event_handler, this);
+}
+
+void SignalK::ip_event_handler(void *arg, esp_event_base_t /*base*/,
+                               int32_t /*id*/, void * /*data*/) {
+  SignalK *self = reinterpret_cast<SignalK *>(arg);
+  // The client reconnects by itself once started
+  if (!self->_started) {
+    ESP_LOGI(TAG, "Signal K connecting to %s", self->_url);
+    self->_started = esp_websocket_client_start(self->_client) == ESP_OK;
+  }
+}
+
+void SignalK::ws_event_handler(void *arg, esp_event_base_t /*base*/, int32_t id,
+                               void *data) {
+  SignalK *self = reinterpret_cast<SignalK *>(arg);
+  auto *ev = reinterpret_cast<esp_websocket_event_data_t *>(data);
+
+  switch (id) {
+  case WEBSOCKET_EVENT_CONNECTED:
+    ESP_LOGI(TAG, "Signal K connected");
+    self->subscribe();
+    break;
+  case WEBSOCKET_EVENT_DISCONNECTED:
+    ESP_LOGW(TAG, "Signal K disconnected");
+    break;
+  case WEBSOCKET_EVENT_DATA:
+    if (ev->op_code != 0x01 && ev->op_code != 0x00)
+      break; // text frames and their continuations only
+    // Large frames arrive in several chunks, and large messages in several
+    // frames: only the first chunk of a text frame starts a new message
+    if (ev->op_code == 0x01 && ev->payload_offset == 0)
+      self->_parser.reset();
+    if (!self->_parser.feed(ev->data_ptr, ev->data_len)) {
+      self->_parse_errors++;
+      self->_parser.reset();
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void SignalK::subscribe() {
+  // Built once per connection, not on the receive path
+  fmt::memory_buffer msg;
+  fmt::format_to(std::back_inserter(msg),
+                 R"({{"context":"vessels.self","subscribe":[{{"path":"{}","policy":"instant"}})",
+                 SIGNALK_POSITION);
+  for (const auto &p : signalk_paths)
+    fmt::format_to(std::back_inserter(msg),
+                   R"(,{{"path":"{}","policy":"instant","minPeriod":200}})", p.path);
+  fmt::format_to(std::back_inserter(msg), "]}}");
+
+  esp_websocket_client_send_text(_client, msg.data(), msg.size(), portMAX_DELAY);
+}
+
+void SignalK::onArrayStart() {
+  if (_values_key && _values_depth == 0)
+    _values_depth = _parser.depth();
+  _values_key = false;
+}
+
+void SignalK::onArrayEnd() {
+  if (_parser.depth() == _values_depth)
+    _values_depth = 0;
+}
+
+void SignalK::onObjectStart() {
+  _values_key = false;
+  if (_values_depth && _parser.depth() == _values_depth + 1) {
+    _entry_depth = _parser.depth();
+    _path[0] = '\0';
+    _value = NAN;
+    _latitude = NAN;
+    _longitude = NAN;
+  }
+}
+
+void SignalK::onObjectEnd() {
+  if (_entry_depth && _parser.depth() == _entry_depth) {
+    apply();
+    _entry_depth = 0;
+  }
+}
+
+void SignalK::onKey(const char *key) {
+  _values_key = strcmp(key, "values") == 0;
+}
+
+void SignalK::onString(const char *value) {
+  if (_entry_depth && _parser.depth() == _entry_depth &&
+      strcmp(_parser.key(), "path") == 0) {
+    strncpy(_path, value, sizeof(_path) - 1);
+    _path[sizeof(_path) - 1] = '\0';
+  }
+}
+
+void SignalK::onNumber(double value) {
+  if (!_entry_depth)
+    return;
+  const char *key = _parser.key();
+  if (_parser.depth() == _entry_depth && strcmp(key, "value") == 0)
+    _value = value;
+  else if (_parser.depth() == _entry_depth + 1) {
+    // navigation.position value is {"latitude":..,"longitude":..}
+    if (strcmp(key, "latitude") == 0)
+      _latitude = value;
+    else if (strcmp(key, "longitude") == 0)
+      _longitude = value;
+  }
+}
+
+void SignalK::onDocumentEnd() {
+  _deltas++;
+  _values_depth = 0;
+  _entry_depth = 0;
+}
+
+// "path" and "value" may come in any order, so apply at the end of the entry
+void SignalK::apply() {
+  if (strcmp(_path, SIGNALK_POSITION) == 0) {
+    if (!std::isnan(_latitude) && !std::isnan(_longitude)) {
+      ShipModel &model = ShipModel::instance();
+      model.latitude.set(_latitude);
+      model.longitude.set(_longitude);
+    }
+    return;
+  }
+  if (std::isnan(_value))
+    return;
+  for (const auto &p : signalk_paths) {
+    if (strcmp(_path, p.path) == 0) {
+      p.apply(_value);
+      return;
+    }
+  }
+}
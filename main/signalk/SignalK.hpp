@@ -0,0 +1,91 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SIGNALK_HPP
+#define __SIGNALK_HPP
+
+#include <JsonSax.h>
+#include <esp_event.h>
+#include <esp_websocket_client.h>
+
+namespace ship {
+
+/**
+ * SignalK subscribes to the delta stream of a Signal K server over
+ * WebSocket and updates the ShipModel for the subscribed paths only.
+ *
+ * Deltas are parsed incrementally as the WebSocket chunks arrive, so heap
+ * use is bounded by the client receive buffer whatever the message size.
+ */
+class SignalK : public JsonHandler {
+public:
+  explicit SignalK(const char *url);
+  ~SignalK();
+
+  /** \brief Connects once the station got an IP, reconnects on its own. */
+  esp_err_t start();
+
+  uint32_t deltas() const { return _deltas; }
+  uint32_t parse_errors() const { return _parse_errors; }
+
+private:
+  static void ip_event_handler(void *arg, esp_event_base_t base, int32_t id,
+                               void *data);
+  static void ws_event_handler(void *arg, esp_event_base_t base, int32_t id,
+                               void *data);
+  void subscribe();
+  void apply();
+
+  // JsonHandler
+  void onObjectStart() override;
+  void onObjectEnd() override;
+  void onArrayStart() override;
+  void onArrayEnd() override;
+  void onKey(const char *key) override;
+  void onString(const char *value) override;
+  void onNumber(double value) override;
+  void onDocumentEnd() override;
+
+  const char *_url;
+  esp_websocket_client_handle_t _client = nullptr;
+  bool _started = false;
+  JsonSax _parser;
+
+  // Where we are inside {"updates":[{"values":[{"path":..,"value":..}]}]}
+  uint8_t _values_depth = 0; // depth inside the "values" array, 0 = outside
+  uint8_t _entry_depth = 0;  // depth inside one {"path","value"} entry
+  bool _values_key = false;  // last key was "values"
+
+  char _path[64];
+  double _value;
+  double _latitude;
+  double _longitude;
+
+  uint32_t _deltas = 0;
+  uint32_t _parse_errors = 0;
+};
+
+} // namespace ship
+
+#endif // __SIGNALK_HPP
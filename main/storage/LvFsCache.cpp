@@ -0,0 +1,463 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "LvFsCache.hpp"
+#include "log_tag.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <dirent.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <fcntl.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <lvgl.h>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#define MAX_DRIVES 4
+
+using namespace ship;
+
+namespace {
+
+constexpr uint16_t NO_SLOT = 0xffff;
+
+struct Block {
+  uint32_t file;   // file id, 0 while unused
+  uint32_t index;  // block number within the file
+  uint32_t len;    // valid bytes, short at the end of the file
+  uint16_t prev;   // LRU list, most recently used first
+  uint16_t next;
+};
+
+struct OpenFile {
+  int fd;
+  uint32_t id;       // 0 when opened for writing: not cached
+  uint32_t size;
+  uint32_t pos;
+  uint16_t slot;     // current block, valid while it still holds (id, index)
+  std::string path;  // writers only, to drop the cached blocks at close
+};
+
+struct FileVersion {
+  uint32_t id;
+  uint32_t size;
+  time_t mtime;
+};
+
+class CachedDrive {
+public:
+  CachedDrive(char letter, const char *root, size_t block_size, uint8_t *data,
+              size_t blocks);
+
+  lv_fs_drv_t drv;
+  LvFsStats stats = {};
+
+private:
+  static CachedDrive &self(lv_fs_drv_t *drv) {
+    return *static_cast<CachedDrive *>(drv->user_data);
+  }
+  static bool ready(lv_fs_drv_t *drv);
+  static void *open(lv_fs_drv_t *drv, const char *path, lv_fs_mode_t mode);
+  static lv_fs_res_t close(lv_fs_drv_t *drv, void *file);
+  static lv_fs_res_t read(lv_fs_drv_t *drv, void *file, void *buf, uint32_t btr,
+                          uint32_t *br);
+  static lv_fs_res_t write(lv_fs_drv_t *drv, void *file, const void *buf,
+                           uint32_t btw, uint32_t *bw);
+  static lv_fs_res_t seek(lv_fs_drv_t *drv, void *file, uint32_t pos,
+                          lv_fs_whence_t whence);
+  static lv_fs_res_t tell(lv_fs_drv_t *drv, void *file, uint32_t *pos);
+  static void *dir_open(lv_fs_drv_t *drv, const char *path);
+  static lv_fs_res_t dir_read(lv_fs_drv_t *drv, void *dir, char *fn);
+  static lv_fs_res_t dir_close(lv_fs_drv_t *drv, void *dir);
+
+  std::string full_path(const char *path) const;
+  uint32_t file_id(const std::string &path, uint32_t size, time_t mtime);
+  uint16_t block(OpenFile &f, uint32_t index);
+  uint16_t fill(OpenFile &f, uint32_t index);
+  void touch(uint16_t slot);
+  void unlink(uint16_t slot);
+  static uint64_t key(uint32_t file, uint32_t index) {
+    return (uint64_t(file) << 32) | index;
+  }
+
+  std::string _root;
+  size_t _block_size;
+  uint8_t *_data;
+  std::vector<Block> _blocks;
+  uint16_t _head;
+  uint16_t _tail;
+  std::unordered_map<uint64_t, uint16_t> _index;
+  std::map<std::string, FileVersion> _files;
+  uint32_t _next_id = 0;
+  SemaphoreHandle_t _mutex;
+};
+
+CachedDrive *drives[MAX_DRIVES];
+size_t drive_count = 0;
+
+CachedDrive::CachedDrive(char letter, const char *root, size_t block_size,
+                         uint8_t *data, size_t blocks)
+    : _root(root), _block_size(block_size), _data(data), _blocks(blocks),
+      _head(0), _tail(blocks - 1), _mutex(xSemaphoreCreateMutex()) {
+  for (size_t i = 0; i < blocks; i++) {
+    _blocks[i] = {0, 0, 0, uint16_t(i ? i - 1 : NO_SLOT),
+                  uint16_t(i + 1 < blocks ? i + 1 : NO_SLOT)};
+  }
+  lv_fs_drv_init(&drv);
+  drv.letter = letter;
+  drv.cache_size = 0; // LVGL's own per-file cache would only copy twice
+  drv.ready_cb = ready;
+  drv.open_cb = open;
+  drv.close_cb = close;
+  drv.read_cb = read;
+  drv.write_cb = write;
+  drv.seek_cb = seek;
+  drv.tell_cb = tell;
+  drv.dir_open_cb = dir_open;
+  drv.dir_read_cb = dir_read;
+  drv.dir_close_cb = dir_close;
+  drv.user_data = this;
+}
+
+std::string CachedDrive::full_path(const char *path) const {
+  // "F:/a.bin" and "F:a.bin" both name <root>/a.bin
+  while (*path == '/')
+    path++;
+  return _root + "/" + path;
+}
+
+// Same path, size and mtime as last time: the cached blocks are still valid
+uint32_t CachedDrive::file_id(const std::string &path, uint32_t size,
+                              time_t mtime) {
+  FileVersion &v = _files[path];
+  if (v.id == 0 || v.size != size || v.mtime != mtime) {
+    if (++_next_id == 0)
+      ++_next_id;
+    v = {_next_id, size, mtime};
+  }
+  return v.id;
+}
+
+void CachedDrive::unlink(uint16_t slot) {
+  Block &b = _blocks[slot];
+  if (b.prev != NO_SLOT)
+    _blocks[b.prev].next = b.next;
+  else
+    _head = b.next;
+  if (b.next != NO_SLOT)
+    _blocks[b.next].prev = b.prev;
+  else
+    _tail = b.prev;
+}
+
+void CachedDrive::touch(uint16_t slot) {
+  if (slot == _head)
+    return;
+  unlink(slot);
+  Block &b = _blocks[slot];
+  b.prev = NO_SLOT;
+  b.next = _head;
+  _blocks[_head].prev = slot;
+  _head = slot;
+}
+
+// Reads block index of f into the least recently used slot
+uint16_t CachedDrive::fill(OpenFile &f, uint32_t index) {
+  uint16_t slot = _tail;
+  Block &b = _blocks[slot];
+  if (b.file)
+    _index.erase(key(b.file, b.index));
+  b.file = 0;
+
+  int64_t start = esp_timer_get_time();
+  uint8_t *dst = _data + size_t(slot) * _block_size;
+  size_t len = 0;
+  if (lseek(f.fd, off_t(index) * _block_size, SEEK_SET) < 0)
+    return NO_SLOT;
+  while (len < _block_size) {
+    ssize_t n = ::read(f.fd, dst + len, _block_size - len);
+    if (n < 0)
+      return NO_SLOT;
+    if (n == 0)
+      break;
+    len += n;
+  }
+  stats.storage_us += esp_timer_get_time() - start;
+  stats.storage_bytes += len;
+  stats.misses++;
+
+  b.file = f.id;
+  b.index = index;
+  b.len = len;
+  _index[key(f.id, index)] = slot;
+  return slot;
+}
+
+uint16_t CachedDrive::block(OpenFile &f, uint32_t index) {
+  uint16_t slot = f.slot;
+  if (slot != NO_SLOT && _blocks[slot].file == f.id &&
+      _blocks[slot].index == index) {
+    stats.hits++;
+  } else {
+    auto it = _index.find(key(f.id, index));
+    if (it != _index.end()) {
+      slot = it->second;
+      stats.hits++;
+    } else if ((slot = fill(f, index)) == NO_SLOT) {
+      return NO_SLOT;
+    }
+  }
+  touch(slot);
+  f.slot = slot;
+  return slot;
+}
+
+bool CachedDrive::ready(lv_fs_drv_t *drv) {
+  // Also tells whether the SD card is mounted
+  DIR *dir = opendir(self(drv)._root.c_str());
+  if (dir)
+    closedir(dir);
+  return dir != nullptr;
+}
+
+void *CachedDrive::open(lv_fs_drv_t *drv, const char *path,
+                        lv_fs_mode_t mode) {
+  CachedDrive &d = self(drv);
+  std::string name = d.full_path(path);
+  int flags = mode == LV_FS_MODE_RD   ? O_RDONLY
+              : mode == LV_FS_MODE_WR ? O_WRONLY | O_CREAT
+                                      : O_RDWR | O_CREAT;
+  int fd = ::open(name.c_str(), flags, 0644);
+  if (fd < 0)
+    return nullptr;
+  OpenFile *f = new OpenFile{fd, 0, 0, 0, NO_SLOT, {}};
+  struct stat st;
+  xSemaphoreTake(d._mutex, portMAX_DELAY);
+  if (mode != LV_FS_MODE_RD) {
+    f->path = name;
+    d._files.erase(name);
+  } else if (fstat(fd, &st) == 0) {
+    f->size = st.st_size;
+    f->id = d.file_id(name, st.st_size, st.st_mtime);
+  }
+  xSemaphoreGive(d._mutex);
+  return f;
+}
+
+lv_fs_res_t CachedDrive::close(lv_fs_drv_t *drv, void *file) {
+  CachedDrive &d = self(drv);
+  OpenFile *f = static_cast<OpenFile *>(file);
+  ::close(f->fd);
+  if (!f->path.empty()) {
+    // Readers that opened it meanwhile cached a half written file
+    xSemaphoreTake(d._mutex, portMAX_DELAY);
+    d._files.erase(f->path);
+    xSemaphoreGive(d._mutex);
+  }
+  delete f;
+  return LV_FS_RES_OK;
+}
+
+lv_fs_res_t CachedDrive::read(lv_fs_drv_t *drv, void *file, void *buf,
+                              uint32_t btr, uint32_t *br) {
+  CachedDrive &d = self(drv);
+  OpenFile &f = *static_cast<OpenFile *>(file);
+  *br = 0;
+  if (f.id == 0) {
+    ssize_t n = ::read(f.fd, buf, btr);
+    if (n < 0)
+      return LV_FS_RES_FS_ERR;
+    f.pos += n;
+    *br = n;
+    return LV_FS_RES_OK;
+  }
+
+  lv_fs_res_t res = LV_FS_RES_OK;
+  uint8_t *out = static_cast<uint8_t *>(buf);
+  uint32_t left = f.pos < f.size ? std::min(btr, f.size - f.pos) : 0;
+  xSemaphoreTake(d._mutex, portMAX_DELAY);
+  d.stats.reads++;
+  while (left > 0) {
+    uint32_t index = f.pos / d._block_size;
+    uint32_t offset = f.pos % d._block_size;
+    uint16_t slot = d.block(f, index);
+    if (slot == NO_SLOT) {
+      res = LV_FS_RES_FS_ERR;
+      break;
+    }
+    const Block &b = d._blocks[slot];
+    if (b.len <= offset)
+      break; // file shorter than at open
+    uint32_t n = std::min(left, b.len - offset);
+    memcpy(out, d._data + size_t(slot) * d._block_size + offset, n);
+    out += n;
+    left -= n;
+    f.pos += n;
+    *br += n;
+  }
+  d.stats.bytes += *br;
+  xSemaphoreGive(d._mutex);
+  return res;
+}
+
+lv_fs_res_t CachedDrive::write(lv_fs_drv_t *drv, void *file, const void *buf,
+                               uint32_t btw, uint32_t *bw) {
+  OpenFile &f = *static_cast<OpenFile *>(file);
+  if (f.id != 0)
+    return LV_FS_RES_DENIED;
+  ssize_t n = ::write(f.fd, buf, btw);
+  if (n < 0)
+    return LV_FS_RES_FS_ERR;
+  f.pos += n;
+  *bw = n;
+  return LV_FS_RES_OK;
+}
+
+lv_fs_res_t CachedDrive::seek(lv_fs_drv_t *drv, void *file, uint32_t pos,
+                              lv_fs_whence_t whence) {
+  OpenFile &f = *static_cast<OpenFile *>(file);
+  if (f.id == 0) {
+    // Uncached: the descriptor keeps the position
+    off_t p = lseek(f.fd, pos,
+                    whence == LV_FS_SEEK_SET   ? SEEK_SET
+                    : whence == LV_FS_SEEK_CUR ? SEEK_CUR
+                                               : SEEK_END);
+    if (p < 0)
+      return LV_FS_RES_FS_ERR;
+    f.pos = p;
+    return LV_FS_RES_OK;
+  }
+  switch (whence) {
+  case LV_FS_SEEK_SET:
+    f.pos = pos;
+    break;
+  case LV_FS_SEEK_CUR:
+    f.pos += pos;
+    break;
+  case LV_FS_SEEK_END:
+    f.pos = f.size + pos;
+    break;
+  default:
+    return LV_FS_RES_INV_PARAM;
+  }
+  return LV_FS_RES_OK;
+}
+
+lv_fs_res_t CachedDrive::tell(lv_fs_drv_t *drv, void *file, uint32_t *pos) {
+  *pos = static_cast<OpenFile *>(file)->pos;
+  return LV_FS_RES_OK;
+}
+
+void *CachedDrive::dir_open(lv_fs_drv_t *drv, const char *path) {
+  return opendir(self(drv).full_path(path).c_str());
+}
+
+// Same convention as the LVGL drivers: directories start with '/', "" at the end
+lv_fs_res_t CachedDrive::dir_read(lv_fs_drv_t *drv, void *dir, char *fn) {
+  struct dirent *entry;
+  do {
+    entry = readdir(static_cast<DIR *>(dir));
+    if (entry == nullptr) {
+      fn[0] = '\0';
+      return LV_FS_RES_OK;
+    }
+  } while (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0);
+  if (entry->d_type == DT_DIR)
+    sprintf(fn, "/%s", entry->d_name);
+  else
+    strcpy(fn, entry->d_name);
+  return LV_FS_RES_OK;
+}
+
+lv_fs_res_t CachedDrive::dir_close(lv_fs_drv_t *drv, void *dir) {
+  closedir(static_cast<DIR *>(dir));
+  return LV_FS_RES_OK;
+}
+
+} // namespace
+
+esp_err_t ship::lvfs_cache_register(char letter, const char *root,
+                                    size_t block_size, size_t blocks) {
+  if (drive_count == MAX_DRIVES || block_size < 512 || blocks < 2 ||
+      blocks >= NO_SLOT)
+    return ESP_ERR_INVALID_ARG;
+  uint8_t *data = static_cast<uint8_t *>(
+      heap_caps_malloc(block_size * blocks, MALLOC_CAP_SPIRAM));
+  if (data == nullptr) {
+    ESP_LOGW(TAG, "%c: no PSRAM for %u x %u byte blocks, left uncached",
+             letter, blocks, block_size);
+    return ESP_ERR_NO_MEM;
+  }
+  CachedDrive *drive = new CachedDrive(letter, root, block_size, data, blocks);
+  drives[drive_count++] = drive;
+  lv_fs_drv_register(&drive->drv);
+  ESP_LOGI(TAG, "%c: cached %s, %u x %u byte blocks", letter, root, blocks,
+           block_size);
+  return ESP_OK;
+}
+
+bool ship::lvfs_cache_stats(char letter, LvFsStats &stats) {
+  for (size_t i = 0; i < drive_count; i++) {
+    if (drives[i]->drv.letter == letter) {
+      stats = drives[i]->stats;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ship::lvfs_cache_log_every(uint32_t seconds) {
+  static esp_timer_handle_t timer = nullptr;
+  if (timer || seconds == 0)
+    return;
+  const esp_timer_create_args_t args = {
+      .callback = [](void *) { lvfs_cache_log_stats(); },
+      .arg = nullptr,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "lvfs_stats",
+      .skip_unhandled_events = true};
+  ESP_ERROR_CHECK(esp_timer_create(&args, &timer));
+  ESP_ERROR_CHECK(esp_timer_start_periodic(timer, seconds * 1000000ULL));
+}
+
+void ship::lvfs_cache_log_stats() {
+  for (size_t i = 0; i < drive_count; i++) {
+    const LvFsStats &s = drives[i]->stats;
+    uint32_t lookups = s.hits + s.misses;
+    ESP_LOGI(TAG,
+             "%c: %" PRIu32 " reads, %" PRIu32 "/%" PRIu32
+             " blocks hit (%" PRIu32 "%%), %" PRIu64 " KB served, %" PRIu64
+             " KB from storage in %" PRId64 " ms",
+             drives[i]->drv.letter, s.reads, s.hits, lookups,
+             lookups ? s.hits * 100 / lookups : 0, s.bytes / 1024,
+             s.storage_bytes / 1024, s.storage_us / 1000);
+  }
+}
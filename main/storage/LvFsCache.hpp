@@ -0,0 +1,71 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __LV_FS_CACHE_HPP
+#define __LV_FS_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <esp_err.h>
+
+namespace ship {
+
+/** Counters of one cached drive since registration. */
+struct LvFsStats {
+  uint32_t reads;          // lv_fs_read calls
+  uint32_t hits;           // blocks served from RAM
+  uint32_t misses;         // blocks read from storage
+  uint64_t bytes;          // bytes returned to LVGL
+  uint64_t storage_bytes;  // bytes read from storage
+  int64_t storage_us;      // time spent in storage reads
+};
+
+/**
+ * Cached lv_fs drive over a VFS directory, registered over the LVGL built-in
+ * driver of the same letter (LVGL picks the newest).
+ *
+ * Files are read in whole blocks into a pool in PSRAM that all files of the
+ * drive share, least recently used block evicted first. Each open file keeps
+ * its current block, so a sequential reader (image decoder, font loader) gets
+ * its many small reads served without even a lookup. A file changed
+ * behind LVGL's back (new size or mtime at open) starts with fresh blocks,
+ * files opened for writing bypass the cache.
+ *
+ * Call after lv_init().
+ */
+esp_err_t lvfs_cache_register(char letter, const char *root, size_t block_size,
+                              size_t blocks);
+
+/** \brief Counters of a registered drive, false for an unknown letter. */
+bool lvfs_cache_stats(char letter, LvFsStats &stats);
+
+/** \brief Logs the counters and hit rate of every registered drive. */
+void lvfs_cache_log_stats();
+
+/** \brief Calls lvfs_cache_log_stats() every seconds, 0 never. */
+void lvfs_cache_log_every(uint32_t seconds);
+
+} // namespace ship
+
+#endif // __LV_FS_CACHE_HPP
@@ -0,0 +1,129 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __CBOR_HPP
+#define __CBOR_HPP
+
+#include <cstdint>
+#include <cstring>
+
+namespace ship {
+
+/**
+ * Minimal RFC 8949 CBOR encoder into a caller supplied buffer.
+ * Covers what telemetry needs: unsigned/negative integers, float32/64,
+ * short text strings and indefinite length maps.
+ * On overflow the writer stops and ok() turns false.
+ */
+class CborWriter {
+public:
+  CborWriter(uint8_t *buf, size_t size) : _buf(buf), _size(size) {}
+
+  void map_begin() { put(0xbf); }        // indefinite length map
+  void map_end() { put(0xff); }
+
+  void uint(uint64_t v) { head(0, v); }
+
+  void sint(int64_t v) {
+    if (v < 0)
+      head(1, uint64_t(-1 - v));
+    else
+      head(0, uint64_t(v));
+  }
+
+  void f32(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put(0xfa);
+    be(bits, 4);
+  }
+
+  void f64(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put(0xfb);
+    be(bits, 8);
+  }
+
+  void text(const char *s) {
+    size_t len = strlen(s);
+    head(3, len);
+    if (room(len)) {
+      memcpy(_buf + _len, s, len);
+      _len += len;
+    }
+  }
+
+  size_t size() const { return _len; }
+  bool ok() const { return _ok; }
+
+private:
+  void head(uint8_t major, uint64_t v) {
+    uint8_t mt = major << 5;
+    if (v < 24) {
+      put(mt | uint8_t(v));
+    } else if (v <= 0xff) {
+      put(mt | 24);
+      be(v, 1);
+    } else if (v <= 0xffff) {
+      put(mt | 25);
+      be(v, 2);
+    } else if (v <= 0xffffffffULL) {
+      put(mt | 26);
+      be(v, 4);
+    } else {
+      put(mt | 27);
+      be(v, 8);
+    }
+  }
+
+  void be(uint64_t v, size_t n) {
+    if (!room(n))
+      return;
+    for (size_t i = 0; i < n; i++)
+      _buf[_len + i] = uint8_t(v >> (8 * (n - 1 - i)));
+    _len += n;
+  }
+
+  void put(uint8_t b) {
+    if (room(1))
+      _buf[_len++] = b;
+  }
+
+  bool room(size_t n) {
+    if (_ok && _len + n <= _size)
+      return true;
+    _ok = false;
+    return false;
+  }
+
+  uint8_t *_buf;
+  size_t _size;
+  size_t _len = 0;
+  bool _ok = true;
+};
+
+} // namespace ship
+
+#endif // __CBOR_HPP
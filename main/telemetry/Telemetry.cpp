@@ -0,0 +1,301 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Telemetry.hpp"
+#include "Cbor.hpp"
+#include "ShipModel.hpp"
+#include "log_tag.hpp"
+#include <cmath>
+#include <cstring>
+#include <esp_heap_caps.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+
+using namespace ship;
+
+#define TELEMETRY_TICK_MS     100   // publish check granularity
+#define TELEMETRY_MAX_PAYLOAD 128   // largest map (/nav) is 46 bytes
+
+enum : uint8_t { TOPIC_NAV, TOPIC_ENV, TOPIC_POWER, TOPIC_HEALTH };
+
+/* Topic suffix and minimum period between two messages */
+static const struct {
+  const char *suffix;
+  uint32_t min_period_ms;
+} topics[] = {
+    {"/nav", 1000},
+    {"/env", 2000},
+    {"/power", 5000},
+    {"/health", 30000},
+};
+static_assert(sizeof(topics) / sizeof(topics[0]) == Telemetry::TOPICS);
+
+/*
+  Channels and their topic. The CBOR key of a channel is its index + 1,
+  key 0 is the uptime in milliseconds of the snapshot. Keep in sync with
+  mqtt_telemetry.py.
+*/
+enum : uint8_t {
+  CH_LATITUDE, CH_LONGITUDE, CH_COG, CH_SOG, CH_HEADING,
+  CH_DEPTH, CH_WIND_ANGLE, CH_WIND_SPEED, CH_WATER_TEMP, CH_AIR_TEMP,
+  CH_PRESSURE, CH_RUDDER_ANGLE, CH_ENGINE_RPM, CH_ENGINE_TEMP,
+  CH_BATTERY_VOLTAGE, CH_BATTERY_CURRENT, CH_COUNT
+};
+static_assert(CH_COUNT == Telemetry::CHANNELS);
+
+static constexpr uint8_t channel_topic[CH_COUNT] = {
+    TOPIC_NAV, TOPIC_NAV, TOPIC_NAV, TOPIC_NAV, TOPIC_NAV,
+    TOPIC_ENV, TOPIC_ENV, TOPIC_ENV, TOPIC_ENV, TOPIC_ENV,
+    TOPIC_ENV, TOPIC_POWER, TOPIC_POWER, TOPIC_POWER,
+    TOPIC_POWER, TOPIC_POWER,
+};
+
+// Bit per channel of topic
+static constexpr uint32_t channels_of(size_t topic) {
+  uint32_t mask = 0;
+  for (size_t ch = 0; ch < CH_COUNT; ch++)
+    if (channel_topic[ch] == topic)
+      mask |= 1u << ch;
+  return mask;
+}
+
+/* Health keys, published on TOPIC_HEALTH */
+enum : uint8_t {
+  HEALTH_UPTIME, HEALTH_HEAP_FREE, HEALTH_HEAP_MIN, HEALTH_PSRAM_FREE,
+  HEALTH_RSSI, HEALTH_PUBLISHED, HEALTH_COALESCED, HEALTH_DROPPED
+};
+
+Telemetry::Telemetry(const char *broker_url, const char *prefix)
+    : _broker_url(broker_url) {
+  for (size_t i = 0; i < TOPICS; i++)
+    _topics[i] = std::string(prefix) + topics[i].suffix;
+  for (auto &v : _values)
+    v = NAN;
+}
+
+Telemetry::~Telemetry() {
+  esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, ip_event_handler);
+  if (_task_handle)
+    vTaskDelete(_task_handle);
+  if (_client) {
+    esp_mqtt_client_stop(_client);
+    esp_mqtt_client_destroy(_client);
+  }
+}
+
+template <typename T> void Telemetry::bind(T &observable, size_t channel) {
+  observable.subscribe([this, channel](const auto &v) { store(channel, v); });
+}
+
+esp_err_t Telemetry::start() {
+  ShipModel &m = ShipModel::instance();
+  bind(m.latitude, CH_LATITUDE);
+  bind(m.longitude, CH_LONGITUDE);
+  bind(m.cog, CH_COG);
+  bind(m.sog, CH_SOG);
+  bind(m.heading, CH_HEADING);
+  bind(m.depth, CH_DEPTH);
+  bind(m.wind_angle, CH_WIND_ANGLE);
+  bind(m.wind_speed, CH_WIND_SPEED);
+  bind(m.water_temp, CH_WATER_TEMP);
+  bind(m.air_temp, CH_AIR_TEMP);
+  bind(m.pressure, CH_PRESSURE);
+  bind(m.rudder_angle, CH_RUDDER_ANGLE);
+  bind(m.engine_rpm, CH_ENGINE_RPM);
+  bind(m.engine_temp, CH_ENGINE_TEMP);
+  bind(m.battery_voltage, CH_BATTERY_VOLTAGE);
+  bind(m.battery_current, CH_BATTERY_CURRENT);
+
+  esp_mqtt_client_config_t config = {};
+  config.broker.address.uri = _broker_url;
+  config.session.keepalive = 30;
+  config.network.reconnect_timeout_ms = 5000;
+
+  _client = esp_mqtt_client_init(&config);
+  if (!_client)
+    return ESP_ERR_NO_MEM;
+  esp_mqtt_client_register_event(_client, MQTT_EVENT_ANY, mqtt_event_handler, this);
+
+  // Encoding is cheap and never urgent - keep it below the ingestion tasks
+  BaseType_t res = xTaskCreatePinnedToCore(task_handler, "telemetry", 1024 * 3,
+                                           this, 2, &_task_handle, 0);
+  if (res != pdPASS)
+    return ESP_ERR_NO_MEM;
+
+  return esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                    ip_event_handler, this);
+}
+
+void Telemetry::ip_event_handler(void *arg, esp_event_base_t base, int32_t id,
+                                 void *data) {
+  Telemetry *self = reinterpret_cast<Telemetry *>(arg);
+  // The client reconnects by itself once started
+  if (!self->_started) {
+    ESP_LOGI(TAG, "MQTT connecting to %s", self->_broker_url);
+    self->_started = esp_mqtt_client_start(self->_client) == ESP_OK;
+  }
+}
+
+void Telemetry::mqtt_event_handler(void *arg, esp_event_base_t base, int32_t id,
+                                   void *data) {
+  Telemetry *self = reinterpret_cast<Telemetry *>(arg);
+
+  switch (id) {
+  case MQTT_EVENT_CONNECTED:
+    ESP_LOGI(TAG, "MQTT connected");
+    // Flush the coalesced snapshot right away instead of waiting a period.
+    // _last_publish belongs to the telemetry task, which picks this up.
+    portENTER_CRITICAL(&self->_lock);
+    self->_flush = true;
+    portEXIT_CRITICAL(&self->_lock);
+    self->_connected = true;
+    break;
+  case MQTT_EVENT_DISCONNECTED:
+    ESP_LOGW(TAG, "MQTT disconnected");
+    self->_connected = false;
+    break;
+  default:
+    break;
+  }
+}
+
+// Runs on the writer's task: keep it to a few stores
+void Telemetry::store(size_t channel, double value) {
+  uint32_t bit = 1u << channel;
+  portENTER_CRITICAL(&_lock);
+  if (_pending & bit)
+    _coalesced++;
+  _values[channel] = value;
+  _pending |= bit;
+  _dirty |= 1u << channel_topic[channel];
+  portEXIT_CRITICAL(&_lock);
+}
+
+void Telemetry::task_handler(void *arg) {
+  Telemetry *self = reinterpret_cast<Telemetry *>(arg);
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(TELEMETRY_TICK_MS));
+    if (self->_connected)
+      self->publish_due(esp_timer_get_time());
+  }
+}
+
+void Telemetry::publish_due(int64_t now) {
+  uint8_t buf[TELEMETRY_MAX_PAYLOAD];
+
+  portENTER_CRITICAL(&_lock);
+  bool flush = _flush;
+  _flush = false;
+  portEXIT_CRITICAL(&_lock);
+
+  for (size_t t = 0; t < TOPICS; t++) {
+    if (!flush && _last_publish[t] &&
+        now - _last_publish[t] < int64_t(topics[t].min_period_ms) * 1000)
+      continue;
+
+    size_t len;
+    uint32_t channels = 0;
+    if (t == TOPIC_HEALTH) {
+      len = encode_health(buf, sizeof(buf));
+    } else {
+      if (!(_dirty & (1u << t)))
+        continue;
+      len = encode(t, buf, sizeof(buf), channels);
+    }
+    if (len == 0)
+      continue;
+
+    // Enqueue only copies into the outbox; the MQTT task does the network I/O
+    int msg_id = esp_mqtt_client_enqueue(_client, _topics[t].c_str(),
+                                         reinterpret_cast<const char *>(buf),
+                                         len, 0, 0, true);
+    if (msg_id < 0) {
+      _dropped++;
+      portENTER_CRITICAL(&_lock);
+      _dirty |= 1u << t; // retry with whatever is newest next period
+      _pending |= channels;
+      portEXIT_CRITICAL(&_lock);
+    } else {
+      _published++;
+    }
+    _last_publish[t] = now;
+  }
+}
+
+// channels: the unpublished values taken, to put back if the send fails
+size_t Telemetry::encode(size_t topic, uint8_t *buf, size_t size,
+                         uint32_t &channels) {
+  double snapshot[CHANNELS];
+  uint32_t mask = channels_of(topic);
+  portENTER_CRITICAL(&_lock);
+  memcpy(snapshot, _values, sizeof(snapshot));
+  channels = _pending & mask;
+  _pending &= ~mask;
+  _dirty &= ~(1u << topic);
+  portEXIT_CRITICAL(&_lock);
+
+  CborWriter w(buf, size);
+  w.map_begin();
+  w.uint(0);
+  w.uint(esp_timer_get_time() / 1000);
+  for (size_t ch = 0; ch < CHANNELS; ch++) {
+    if (channel_topic[ch] != topic || std::isnan(snapshot[ch]))
+      continue;
+    w.uint(ch + 1);
+    // Positions need double precision, float32 is plenty for the rest
+    if (ch == CH_LATITUDE || ch == CH_LONGITUDE)
+      w.f64(snapshot[ch]);
+    else
+      w.f32(float(snapshot[ch]));
+  }
+  w.map_end();
+  return w.ok() ? w.size() : 0;
+}
+
+size_t Telemetry::encode_health(uint8_t *buf, size_t size) {
+  wifi_ap_record_t ap;
+  int rssi = esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0;
+
+  CborWriter w(buf, size);
+  w.map_begin();
+  w.uint(HEALTH_UPTIME);
+  w.uint(esp_timer_get_time() / 1000);
+  w.uint(HEALTH_HEAP_FREE);
+  w.uint(esp_get_free_heap_size());
+  w.uint(HEALTH_HEAP_MIN);
+  w.uint(esp_get_minimum_free_heap_size());
+  w.uint(HEALTH_PSRAM_FREE);
+  w.uint(heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+  w.uint(HEALTH_RSSI);
+  w.sint(rssi);
+  w.uint(HEALTH_PUBLISHED);
+  w.uint(_published);
+  w.uint(HEALTH_COALESCED);
+  w.uint(_coalesced);
+  w.uint(HEALTH_DROPPED);
+  w.uint(_dropped);
+  w.map_end();
+  return w.ok() ? w.size() : 0;
+}
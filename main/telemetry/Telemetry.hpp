@@ -0,0 +1,104 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __TELEMETRY_HPP
+#define __TELEMETRY_HPP
+
+#include <atomic>
+#include <esp_event.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mqtt_client.h>
+#include <string>
+
+namespace ship {
+
+/**
+ * Telemetry publishes the ShipModel and device health to an MQTT broker.
+ *
+ * Values are grouped per topic (<prefix>/nav, /env, /power, /health) and
+ * sent as one CBOR map per message, keyed by small integer channel ids.
+ * Every topic has a minimum publish period.
+ *
+ * Model callbacks only store the latest value and mark its topic dirty
+ * under a spinlock, so ingestion tasks never wait on the network. While the
+ * link is down, newer values overwrite older ones and the latest snapshot
+ * goes out right after reconnecting. A low priority task does the encoding
+ * and hands messages to the MQTT client's outbox.
+ */
+class Telemetry {
+public:
+  static constexpr size_t CHANNELS = 16;
+  static constexpr size_t TOPICS = 4;
+
+  Telemetry(const char *broker_url, const char *prefix);
+  ~Telemetry();
+
+  /** \brief Subscribes to the model, connects once the station got an IP. */
+  esp_err_t start();
+
+  /** \brief Messages handed to the MQTT client. */
+  uint32_t published() const { return _published; }
+
+  /** \brief Channel values overwritten before they were published. */
+  uint32_t coalesced() const { return _coalesced; }
+
+  /** \brief Messages the MQTT client refused (outbox full / no memory). */
+  uint32_t dropped() const { return _dropped; }
+
+private:
+  static void ip_event_handler(void *arg, esp_event_base_t base, int32_t id,
+                               void *data);
+  static void mqtt_event_handler(void *arg, esp_event_base_t base, int32_t id,
+                                 void *data);
+  static void task_handler(void *arg);
+
+  template <typename T> void bind(T &observable, size_t channel);
+  void store(size_t channel, double value);
+  void publish_due(int64_t now);
+  size_t encode(size_t topic, uint8_t *buf, size_t size, uint32_t &channels);
+  size_t encode_health(uint8_t *buf, size_t size);
+
+  const char *_broker_url;
+  std::string _topics[TOPICS];
+  esp_mqtt_client_handle_t _client = nullptr;
+  TaskHandle_t _task_handle = nullptr;
+  bool _started = false;
+  std::atomic<bool> _connected{false};
+
+  portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+  double _values[CHANNELS];   // latest value per channel, guarded by _lock
+  uint32_t _dirty = 0;        // bit per topic with unpublished values
+  uint32_t _pending = 0;      // bit per channel with an unpublished value
+  bool _flush = false;        // publish every topic now (reconnected)
+  int64_t _last_publish[TOPICS] = {}; // telemetry task only
+
+  uint32_t _published = 0;
+  uint32_t _coalesced = 0;
+  uint32_t _dropped = 0;
+};
+
+} // namespace ship
+
+#endif // __TELEMETRY_HPP
@@ -0,0 +1,488 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tux_gauge.c
+ *
+ */
+
+ /*********************
+  *      INCLUDES
+  *********************/
+#include "tux_gauge.h"
+#if TUX_USE_GAUGE
+
+#include <esp_heap_caps.h>
+
+  /*********************
+   *      DEFINES
+   *********************/
+#define MY_CLASS    &tux_gauge_class
+
+#define VALUE_SHIFT         4       // value fixed point (x16) for damping
+#define NEEDLE_LEN_PCT      85      // needle tip, % of radius
+#define NEEDLE_TAIL_PCT     15      // needle tail behind the hub, % of radius
+#define HUB_RADIUS          5
+#define MAJOR_TICK_LEN      12
+#define MINOR_TICK_LEN      6
+#define LABEL_BOX_W         40
+
+   /**********************
+    *      TYPEDEFS
+    **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void tux_gauge_constructor(const lv_obj_class_t* class_p, lv_obj_t* obj);
+static void tux_gauge_destructor(const lv_obj_class_t* class_p, lv_obj_t* obj);
+static void tux_gauge_event(const lv_obj_class_t* class_p, lv_event_t* e);
+static void render_face(lv_obj_t* obj);
+static void draw_needle(lv_obj_t* obj, lv_draw_ctx_t* draw_ctx);
+static void get_needle_area(lv_obj_t* obj, int32_t value, lv_area_t* area);
+static void refresh_needle(lv_obj_t* obj);
+static void damping_timer_cb(lv_timer_t* timer);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+const lv_obj_class_t tux_gauge_class = {
+    .constructor_cb = tux_gauge_constructor,
+    .destructor_cb = tux_gauge_destructor,
+    .event_cb = tux_gauge_event,
+    .base_class = &lv_obj_class,
+    .width_def = LV_DPI_DEF * 2,
+    .height_def = LV_DPI_DEF * 2,
+    .instance_size = sizeof(tux_gauge_t)
+};
+
+ /**********************
+  *   GLOBAL FUNCTIONS
+  **********************/
+
+lv_obj_t * tux_gauge_create(lv_obj_t* parent, lv_coord_t size)
+{
+    LV_LOG_INFO("begin");
+
+    lv_obj_t * obj = lv_obj_class_create_obj(&tux_gauge_class, parent);
+    LV_ASSERT_MALLOC(obj);
+    if (obj == NULL) return NULL;
+    lv_obj_class_init_obj(obj);
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+
+    // The gauge itself only hosts the face and draws the needle on top.
+    // The dial is transparent and the scale takes the inherited text colour
+    // until styled; the needle defaults to the theme's secondary colour.
+    lv_obj_remove_style_all(obj);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_line_color(obj, lv_theme_get_color_secondary(obj), LV_PART_INDICATOR);
+    lv_obj_set_style_line_width(obj, 3, LV_PART_INDICATOR);
+    lv_obj_set_size(obj, size, size);
+    gauge->hold_face = false;
+    render_face(obj);
+
+    return obj;
+}
+
+void tux_gauge_set_scale(lv_obj_t* obj, int32_t min, int32_t max,
+                         uint16_t angle_range, uint16_t rotation, bool wrap)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+    if (max <= min) return;
+
+    gauge->min = min;
+    gauge->max = max;
+    gauge->angle_range = wrap ? 360 : LV_MIN(angle_range, 360);
+    gauge->rotation = rotation % 360;
+    gauge->wrap = wrap;
+
+    int32_t lo = min << VALUE_SHIFT;
+    int32_t hi = max << VALUE_SHIFT;
+    gauge->target = LV_CLAMP(lo, gauge->target, hi);
+    gauge->current = LV_CLAMP(lo, gauge->current, hi);
+
+    render_face(obj);
+}
+
+void tux_gauge_set_ticks(lv_obj_t* obj, uint8_t major_cnt,
+                         uint8_t minor_per_major, uint8_t label_div)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+
+    gauge->major_cnt = LV_MAX(major_cnt, 2);
+    gauge->minor_per_major = LV_MAX(minor_per_major, 1);
+    gauge->label_div = LV_MAX(label_div, 1);
+
+    render_face(obj);
+}
+
+void tux_gauge_set_colors(lv_obj_t* obj, lv_color_t face, lv_color_t ticks,
+                          lv_color_t needle)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+
+    // Each local style sends LV_EVENT_STYLE_CHANGED, render once at the end
+    gauge->hold_face = true;
+    lv_obj_set_style_bg_color(obj, face, LV_PART_MAIN);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_COVER, LV_PART_MAIN);
+    lv_obj_set_style_text_color(obj, ticks, LV_PART_TICKS);
+    lv_obj_set_style_line_color(obj, needle, LV_PART_INDICATOR);
+    gauge->hold_face = false;
+
+    render_face(obj);
+}
+
+void tux_gauge_set_damping(lv_obj_t* obj, uint8_t damping)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+    gauge->damping = LV_MAX(damping, 1);
+}
+
+void tux_gauge_set_value(lv_obj_t* obj, int32_t value)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+
+    if (gauge->wrap) {
+        int32_t span = gauge->max - gauge->min;
+        value = ((value - gauge->min) % span + span) % span + gauge->min;
+    } else {
+        value = LV_CLAMP(gauge->min, value, gauge->max);
+    }
+
+    int32_t target = value << VALUE_SHIFT;
+    if (target == gauge->target) return;
+    gauge->target = target;
+
+    if (gauge->damping == TUX_GAUGE_DAMPING_NONE) {
+        gauge->current = target;
+        refresh_needle(obj);
+    } else {
+        lv_timer_resume(gauge->timer);
+    }
+}
+
+int32_t tux_gauge_get_value(lv_obj_t* obj)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+    return gauge->target >> VALUE_SHIFT;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void tux_gauge_constructor(const lv_obj_class_t* class_p, lv_obj_t* obj)
+{
+    LV_UNUSED(class_p);
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+
+    gauge->face_buf = NULL;
+    gauge->hold_face = true;    // until tux_gauge_create has styled and sized it
+    gauge->min = 0;
+    gauge->max = 100;
+    gauge->angle_range = 270;
+    gauge->rotation = 135;
+    gauge->major_cnt = 6;
+    gauge->minor_per_major = 4;
+    gauge->label_div = 1;
+    gauge->wrap = false;
+    gauge->damping = 64;
+    gauge->target = 0;
+    gauge->current = 0;
+    lv_area_set(&gauge->needle_area, 0, 0, -1, -1);
+
+    gauge->face = lv_canvas_create(obj);
+    lv_obj_clear_flag(gauge->face, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_pos(gauge->face, 0, 0);
+
+    gauge->timer = lv_timer_create(damping_timer_cb, LV_DISP_DEF_REFR_PERIOD, obj);
+    lv_timer_pause(gauge->timer);
+}
+
+static void tux_gauge_destructor(const lv_obj_class_t* class_p, lv_obj_t* obj)
+{
+    LV_UNUSED(class_p);
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+
+    if (gauge->timer) lv_timer_del(gauge->timer);
+    // The canvas child is deleted before us, so the buffer is no longer in use
+    if (gauge->face_buf) heap_caps_free(gauge->face_buf);
+    gauge->timer = NULL;
+    gauge->face_buf = NULL;
+}
+
+static void tux_gauge_event(const lv_obj_class_t* class_p, lv_event_t* e)
+{
+    LV_UNUSED(class_p);
+
+    // The face stands in for the background, which lv_obj would draw square
+    lv_event_code_t code = lv_event_get_code(e);
+    if (code == LV_EVENT_COVER_CHECK) {
+        lv_event_set_cover_res(e, LV_COVER_RES_NOT_COVER);
+        return;
+    }
+    if (code == LV_EVENT_DRAW_MAIN) return;
+
+    lv_res_t res = lv_obj_event_base(MY_CLASS, e);
+    if (res != LV_RES_OK) return;
+
+    lv_obj_t * obj = lv_event_get_target(e);
+
+    if (code == LV_EVENT_SIZE_CHANGED || code == LV_EVENT_STYLE_CHANGED) {
+        // Theme switches and restyled parents land here too
+        render_face(obj);
+    }
+    else if (code == LV_EVENT_DRAW_POST) {
+        // Children (the cached face) are drawn by now; only the needle is drawn live
+        draw_needle(obj, lv_event_get_draw_ctx(e));
+    }
+}
+
+/* Angle in degrees (0 = 3 o'clock, clockwise) of a fixed point value */
+static int16_t value_to_angle(const tux_gauge_t* gauge, int32_t value)
+{
+    int32_t span = (gauge->max - gauge->min) << VALUE_SHIFT;
+    int32_t offset = value - (gauge->min << VALUE_SHIFT);
+    return (int16_t)((gauge->rotation + (offset * gauge->angle_range) / span) % 360);
+}
+
+static void polar(lv_coord_t cx, lv_coord_t cy, lv_coord_t r, int16_t angle, lv_point_t* p)
+{
+    p->x = cx + ((r * lv_trigo_cos(angle)) >> LV_TRIGO_SHIFT);
+    p->y = cy + ((r * lv_trigo_sin(angle)) >> LV_TRIGO_SHIFT);
+}
+
+static void render_face(lv_obj_t* obj)
+{
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+    if (gauge->hold_face) return;
+    lv_coord_t w = lv_obj_get_width(obj);
+    lv_coord_t h = lv_obj_get_height(obj);
+    if (w <= 0 || h <= 0) return;
+
+    lv_img_dsc_t * img = lv_canvas_get_img(gauge->face);
+    if (gauge->face_buf == NULL || img->header.w != w || img->header.h != h) {
+        if (gauge->face_buf) heap_caps_free(gauge->face_buf);
+        size_t buf_size = LV_CANVAS_BUF_SIZE_TRUE_COLOR_ALPHA(w, h);
+        // Keep the face out of internal RAM when PSRAM is available
+        gauge->face_buf = heap_caps_malloc(buf_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (gauge->face_buf == NULL)
+            gauge->face_buf = heap_caps_malloc(buf_size, MALLOC_CAP_DEFAULT);
+        LV_ASSERT_MALLOC(gauge->face_buf);
+        if (gauge->face_buf == NULL) return;
+        lv_canvas_set_buffer(gauge->face, gauge->face_buf, w, h, LV_IMG_CF_TRUE_COLOR_ALPHA);
+    }
+
+    lv_coord_t cx = w / 2;
+    lv_coord_t cy = h / 2;
+    lv_coord_t r = LV_MIN(w, h) / 2 - 1;
+
+    // Dial from the main part background, scale from the ticks text colour
+    lv_color_t face_color = lv_obj_get_style_bg_color(obj, LV_PART_MAIN);
+    lv_opa_t face_opa = lv_obj_get_style_bg_opa(obj, LV_PART_MAIN);
+    lv_color_t tick_color = lv_obj_get_style_text_color(obj, LV_PART_TICKS);
+
+    lv_canvas_fill_bg(gauge->face, face_color, LV_OPA_TRANSP);
+
+    // Dial background
+    if (face_opa > LV_OPA_MIN) {
+        lv_draw_rect_dsc_t rect_dsc;
+        lv_draw_rect_dsc_init(&rect_dsc);
+        rect_dsc.radius = LV_RADIUS_CIRCLE;
+        rect_dsc.bg_color = face_color;
+        rect_dsc.bg_opa = face_opa;
+        lv_canvas_draw_rect(gauge->face, cx - r, cy - r, r * 2, r * 2, &rect_dsc);
+    }
+
+    // Scale arc
+    lv_draw_arc_dsc_t arc_dsc;
+    lv_draw_arc_dsc_init(&arc_dsc);
+    arc_dsc.color = tick_color;
+    arc_dsc.width = 2;
+    if (gauge->wrap)
+        lv_canvas_draw_arc(gauge->face, cx, cy, r - 2, 0, 360, &arc_dsc);
+    else
+        lv_canvas_draw_arc(gauge->face, cx, cy, r - 2, gauge->rotation,
+                           gauge->rotation + gauge->angle_range, &arc_dsc);
+
+    // Ticks and labels
+    lv_draw_line_dsc_t line_dsc;
+    lv_draw_line_dsc_init(&line_dsc);
+    line_dsc.color = tick_color;
+
+    lv_draw_label_dsc_t label_dsc;
+    lv_draw_label_dsc_init(&label_dsc);
+    label_dsc.color = tick_color;
+    label_dsc.font = lv_obj_get_style_text_font(obj, LV_PART_MAIN);
+    label_dsc.align = LV_TEXT_ALIGN_CENTER;
+    lv_coord_t font_h = lv_font_get_line_height(label_dsc.font);
+
+    // A wrapping scale ends where it starts, so its last major tick is skipped
+    uint16_t major_steps = gauge->wrap ? gauge->major_cnt : gauge->major_cnt - 1;
+    uint16_t steps = major_steps * gauge->minor_per_major;
+    uint16_t tick_cnt = gauge->wrap ? steps : steps + 1;
+    lv_coord_t r_out = r - 4;
+    lv_coord_t r_label = r_out - MAJOR_TICK_LEN - font_h;
+
+    for (uint16_t i = 0; i < tick_cnt; i++) {
+        bool major = (i % gauge->minor_per_major) == 0;
+        int16_t angle = (gauge->rotation + (i * gauge->angle_range) / steps) % 360;
+
+        lv_point_t p[2];
+        polar(cx, cy, r_out, angle, &p[0]);
+        polar(cx, cy, r_out - (major ? MAJOR_TICK_LEN : MINOR_TICK_LEN), angle, &p[1]);
+        line_dsc.width = major ? 2 : 1;
+        lv_canvas_draw_line(gauge->face, p, 2, &line_dsc);
+
+        if (major) {
+            int32_t value = gauge->min +
+                ((gauge->max - gauge->min) * (i / gauge->minor_per_major)) / major_steps;
+            char txt[12];
+            lv_snprintf(txt, sizeof(txt), "%" LV_PRId32, value / gauge->label_div);
+
+            lv_point_t lp;
+            polar(cx, cy, r_label, angle, &lp);
+            lv_canvas_draw_text(gauge->face, lp.x - LABEL_BOX_W / 2, lp.y - font_h / 2,
+                                LABEL_BOX_W, &label_dsc, txt);
+        }
+    }
+
+    lv_obj_invalidate(obj);
+}
+
+static void get_needle_points(lv_obj_t* obj, int32_t value, lv_point_t* tip, lv_point_t* tail)
+{
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+    lv_coord_t w = lv_area_get_width(&obj->coords);
+    lv_coord_t h = lv_area_get_height(&obj->coords);
+    lv_coord_t cx = obj->coords.x1 + w / 2;
+    lv_coord_t cy = obj->coords.y1 + h / 2;
+    lv_coord_t r = LV_MIN(w, h) / 2;
+    int16_t angle = value_to_angle(gauge, value);
+
+    polar(cx, cy, (r * NEEDLE_LEN_PCT) / 100, angle, tip);
+    polar(cx, cy, (r * NEEDLE_TAIL_PCT) / 100, (angle + 180) % 360, tail);
+}
+
+static void get_needle_area(lv_obj_t* obj, int32_t value, lv_area_t* area)
+{
+    lv_point_t tip, tail;
+    get_needle_points(obj, value, &tip, &tail);
+
+    lv_coord_t cx = obj->coords.x1 + lv_area_get_width(&obj->coords) / 2;
+    lv_coord_t cy = obj->coords.y1 + lv_area_get_height(&obj->coords) / 2;
+    lv_coord_t width = lv_obj_get_style_line_width(obj, LV_PART_INDICATOR);
+    lv_coord_t pad = LV_MAX(width / 2, HUB_RADIUS) + 1;
+
+    area->x1 = LV_MIN(LV_MIN(tip.x, tail.x), cx) - pad;
+    area->y1 = LV_MIN(LV_MIN(tip.y, tail.y), cy) - pad;
+    area->x2 = LV_MAX(LV_MAX(tip.x, tail.x), cx) + pad;
+    area->y2 = LV_MAX(LV_MAX(tip.y, tail.y), cy) + pad;
+}
+
+static void refresh_needle(lv_obj_t* obj)
+{
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+    lv_area_t old_area = gauge->needle_area;
+    lv_area_t new_area;
+    get_needle_area(obj, gauge->current, &new_area);
+    if (_lv_area_is_equal(&old_area, &new_area)) return;
+
+    // Small moves overlap, so one box covers both positions. Large moves are
+    // invalidated as two boxes to avoid redrawing the whole dial.
+    if (_lv_area_is_on(&old_area, &new_area)) {
+        lv_area_t swept;
+        _lv_area_join(&swept, &old_area, &new_area);
+        lv_obj_invalidate_area(obj, &swept);
+    } else {
+        lv_obj_invalidate_area(obj, &old_area);
+        lv_obj_invalidate_area(obj, &new_area);
+    }
+    gauge->needle_area = new_area;
+}
+
+static void draw_needle(lv_obj_t* obj, lv_draw_ctx_t* draw_ctx)
+{
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+    lv_point_t tip, tail;
+    get_needle_points(obj, gauge->current, &tip, &tail);
+    lv_color_t needle_color = lv_obj_get_style_line_color(obj, LV_PART_INDICATOR);
+
+    lv_draw_line_dsc_t line_dsc;
+    lv_draw_line_dsc_init(&line_dsc);
+    line_dsc.color = needle_color;
+    line_dsc.width = lv_obj_get_style_line_width(obj, LV_PART_INDICATOR);
+    line_dsc.round_start = 1;
+    line_dsc.round_end = 1;
+    lv_draw_line(draw_ctx, &line_dsc, &tail, &tip);
+
+    lv_draw_rect_dsc_t hub_dsc;
+    lv_draw_rect_dsc_init(&hub_dsc);
+    hub_dsc.radius = LV_RADIUS_CIRCLE;
+    hub_dsc.bg_color = needle_color;
+    hub_dsc.bg_opa = LV_OPA_COVER;
+    lv_coord_t cx = obj->coords.x1 + lv_area_get_width(&obj->coords) / 2;
+    lv_coord_t cy = obj->coords.y1 + lv_area_get_height(&obj->coords) / 2;
+    lv_area_t hub = { cx - HUB_RADIUS, cy - HUB_RADIUS, cx + HUB_RADIUS, cy + HUB_RADIUS };
+    lv_draw_rect(draw_ctx, &hub_dsc, &hub);
+
+    // Remember where the needle really is (layout may have moved the gauge)
+    get_needle_area(obj, gauge->current, &gauge->needle_area);
+}
+
+/* Runs once per display refresh while the needle is moving */
+static void damping_timer_cb(lv_timer_t* timer)
+{
+    lv_obj_t * obj = (lv_obj_t *)timer->user_data;
+    tux_gauge_t * gauge = (tux_gauge_t *)obj;
+
+    int32_t diff = gauge->target - gauge->current;
+    int32_t span = (gauge->max - gauge->min) << VALUE_SHIFT;
+    if (gauge->wrap) {
+        // Take the short way round (e.g. 350 -> 10 degrees)
+        if (diff > span / 2) diff -= span;
+        else if (diff < -span / 2) diff += span;
+    }
+
+    int32_t step = (diff * gauge->damping) / TUX_GAUGE_DAMPING_NONE;
+    if (step == 0) {
+        gauge->current = gauge->target;
+        lv_timer_pause(timer);
+    } else {
+        gauge->current += step;
+        if (gauge->wrap) {
+            int32_t lo = gauge->min << VALUE_SHIFT;
+            gauge->current = ((gauge->current - lo) % span + span) % span + lo;
+        }
+    }
+
+    refresh_needle(obj);
+}
+#endif /*TUX_USE_GAUGE*/
@@ -0,0 +1,146 @@
+/*
+MIT License
+
+Copyright (c) 2022 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tux_gauge.h
+ *
+ * Instrument dial (compass, wind angle, rudder, RPM).
+ * The face (arc, ticks, labels) is rendered once into a cached canvas and
+ * only the area swept by the needle is invalidated on updates.
+ *
+ * Colours come from the styles, so themes apply and a style change
+ * re-renders the face:
+ *   LV_PART_MAIN       bg_color / bg_opa: dial, text_font: labels
+ *   LV_PART_TICKS      text_color: scale arc, ticks and labels
+ *   LV_PART_INDICATOR  line_color / line_width: needle and hub
+ */
+
+#ifndef tux_gauge_H
+#define tux_gauge_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /*********************
+     *      INCLUDES
+     *********************/
+#include "lvgl.h"
+
+#if TUX_USE_GAUGE
+
+/*Testing of dependencies*/
+#if LV_USE_CANVAS == 0
+#error "tux_gauge: lv_canvas is required. Enable it in lv_conf.h (LV_USE_CANVAS  1) "
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+#define TUX_GAUGE_DAMPING_NONE  255     // needle jumps straight to the value
+
+ /**********************
+  *      TYPEDEFS
+  **********************/
+
+    typedef struct {
+        lv_obj_t obj;               // main gauge
+        lv_obj_t* face;             // canvas holding the cached dial face
+        void* face_buf;             // pixel buffer of the face canvas
+        lv_timer_t* timer;          // needle damping timer
+        bool hold_face;             // skip face renders while restyling
+
+        int32_t min;                // scale range
+        int32_t max;
+        uint16_t angle_range;       // degrees covered by the scale
+        uint16_t rotation;          // angle of 'min' (0 = 3 o'clock, clockwise)
+        uint8_t major_cnt;          // number of labelled ticks
+        uint8_t minor_per_major;    // minor ticks between two major ticks
+        uint8_t label_div;          // labels show value / label_div
+        bool wrap;                  // circular scale (compass, wind angle)
+
+        uint8_t damping;            // 1..255, share of the gap closed per frame
+        int32_t target;             // value * 16 (fixed point)
+        int32_t current;            // value * 16 (fixed point)
+        lv_area_t needle_area;      // last drawn needle bounding box
+    } tux_gauge_t;
+
+    extern const lv_obj_class_t tux_gauge_class;
+
+    /**********************
+     * GLOBAL PROTOTYPES
+     **********************/
+
+     /**
+      * Create an instrument gauge object
+      * @param parent        pointer to parent
+      * @param size          width and height of the dial
+      * @return              pointer to the gauge object
+      */
+    lv_obj_t* tux_gauge_create(lv_obj_t* parent, lv_coord_t size);
+
+    /**
+     * Configure the scale. Re-renders the cached face.
+     * @param wrap          true for circular scales where max == min (compass)
+     */
+    void tux_gauge_set_scale(lv_obj_t* obj, int32_t min, int32_t max,
+                             uint16_t angle_range, uint16_t rotation, bool wrap);
+
+    /**
+     * Configure tick marks and labels. Re-renders the cached face.
+     * @param label_div     labels show value / label_div (e.g. 100 for RPM x100)
+     */
+    void tux_gauge_set_ticks(lv_obj_t* obj, uint8_t major_cnt,
+                             uint8_t minor_per_major, uint8_t label_div);
+
+    /**
+     * Set the colours as local styles over the theme. Re-renders the cached face.
+     */
+    void tux_gauge_set_colors(lv_obj_t* obj, lv_color_t face, lv_color_t ticks,
+                              lv_color_t needle);
+
+    /**
+     * Set how fast the needle follows the value, once per display refresh.
+     * @param damping       1 (slow) .. TUX_GAUGE_DAMPING_NONE (no damping)
+     */
+    void tux_gauge_set_damping(lv_obj_t* obj, uint8_t damping);
+
+    /**
+     * Move the needle. Only the needle area is invalidated.
+     */
+    void tux_gauge_set_value(lv_obj_t* obj, int32_t value);
+
+    int32_t tux_gauge_get_value(lv_obj_t* obj);
+
+    /**********************
+     *      MACROS
+     **********************/
+
+#endif /*TUX_USE_GAUGE*/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*tux_gauge_H*/
@@ -0,0 +1,120 @@
+# MQTT TELEMETRY monitor and throughput test
+# Decodes the CBOR telemetry published by the panel, or floods a local broker
+# with panel-sized messages to measure throughput.
+# Requires: pip install paho-mqtt, and a broker, e.g. mosquitto -v on localhost
+
+# Usage:
+# python mqtt_telemetry.py [--host localhost] [--prefix ship-panel]
+# python mqtt_telemetry.py --bench 10000
+import argparse
+import struct
+import time
+import paho.mqtt.client as mqtt
+
+# CBOR keys as published by main/telemetry/Telemetry.cpp (key = index + 1)
+CHANNELS = ['latitude', 'longitude', 'cog', 'sog', 'heading',
+            'depth', 'wind_angle', 'wind_speed', 'water_temp', 'air_temp',
+            'pressure', 'rudder_angle', 'engine_rpm', 'engine_temp',
+            'battery_voltage', 'battery_current']
+HEALTH = ['uptime', 'heap_free', 'heap_min', 'psram_free',
+          'rssi', 'published', 'coalesced', 'dropped']
+
+
+def cbor_decode(data, pos=0):
+    """Decodes the CBOR subset the panel emits, returns (value, next_pos)."""
+    ib = data[pos]
+    major, info = ib >> 5, ib & 0x1f
+    pos += 1
+    if ib == 0xfa:
+        return struct.unpack('>f', data[pos:pos + 4])[0], pos + 4
+    if ib == 0xfb:
+        return struct.unpack('>d', data[pos:pos + 8])[0], pos + 8
+    if major == 5 and info == 31:
+        result = {}
+        while data[pos] != 0xff:
+            key, pos = cbor_decode(data, pos)
+            result[key], pos = cbor_decode(data, pos)
+        return result, pos + 1
+    if info < 24:
+        arg = info
+    else:
+        n = 1 << (info - 24)
+        arg = int.from_bytes(data[pos:pos + n], 'big')
+        pos += n
+    if major == 0:
+        return arg, pos
+    if major == 1:
+        return -1 - arg, pos
+    if major == 3:
+        return data[pos:pos + arg].decode(), pos + arg
+    raise ValueError('unsupported CBOR item 0x%02x' % ib)
+
+
+def cbor_encode_sample():
+    """A /nav sized message: uptime, 2 float64 and 3 float32."""
+    out = bytes([0xbf, 0x00, 0x1a]) + struct.pack('>I', int(time.time() * 1000) & 0xffffffff)
+    out += bytes([0x01, 0xfb]) + struct.pack('>d', 60.2)
+    out += bytes([0x02, 0xfb]) + struct.pack('>d', 24.1)
+    for key in (3, 4, 5):
+        out += bytes([key, 0xfa]) + struct.pack('>f', 1.5 * key)
+    return out + bytes([0xff])
+
+
+def monitor(args):
+    def on_message(client, userdata, msg):
+        values, _ = cbor_decode(msg.payload)
+        names = HEALTH if msg.topic.endswith('/health') else ['uptime'] + CHANNELS
+        pretty = ', '.join('{}={}'.format(names[k] if k < len(names) else k,
+                                          round(v, 6) if isinstance(v, float) else v)
+                           for k, v in values.items())
+        print('{} [{} bytes] {}'.format(msg.topic, len(msg.payload), pretty))
+
+    client = mqtt.Client()
+    client.on_message = on_message
+    client.connect(args.host, args.port)
+    client.subscribe(args.prefix + '/#')
+    print('Listening on ' + args.host + ' for ' + args.prefix + '/#')
+    client.loop_forever()
+
+
+def bench(args):
+    topic = args.prefix + '/bench'
+    received = [0]
+
+    def on_message(client, userdata, msg):
+        cbor_decode(msg.payload)
+        received[0] += 1
+
+    sub = mqtt.Client()
+    sub.on_message = on_message
+    sub.connect(args.host, args.port)
+    sub.subscribe(topic)
+    sub.loop_start()
+
+    pub = mqtt.Client()
+    pub.connect(args.host, args.port)
+    pub.loop_start()
+    time.sleep(0.5)
+
+    payload = cbor_encode_sample()
+    start = time.time()
+    for _ in range(args.bench):
+        pub.publish(topic, payload, qos=0)
+    while received[0] < args.bench and time.time() - start < 30:
+        time.sleep(0.01)
+    elapsed = time.time() - start
+    print('{} of {} messages ({} bytes each) in {:.2f}s: {:.0f} msg/s, {:.1f} kB/s'.format(
+        received[0], args.bench, len(payload), elapsed,
+        received[0] / elapsed, received[0] * len(payload) / elapsed / 1024))
+    pub.loop_stop()
+    sub.loop_stop()
+
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--host', default='localhost')
+parser.add_argument('--port', type=int, default=1883)
+parser.add_argument('--prefix', default='ship-panel')
+parser.add_argument('--bench', type=int, default=0,
+                    help='publish N sample messages and measure throughput')
+args = parser.parse_args()
+bench(args) if args.bench else monitor(args)
@@ -0,0 +1,165 @@
+# Flaky OTA server - stand-in for a marina Wi-Fi link
+#
+# Serves files like webserver.py, with HTTP Range support, but drops the
+# connection after a random number of bytes so resumable OTA
+# (CONFIG_OTA_RESUMABLE) can be tested against it.
+#
+# chunk, rate and mean_drop can be overridden per request in the query string.
+# Every chunk goes out in its own write, so with --tls chunk is the TLS record
+# size; CONFIG_OTA_BENCHMARK sweeps it that way.
+#
+# Usage:
+#   python ota_flaky_server.py --host 192.168.1.128 --port 8070 --tls
+#   python ota_flaky_server.py --mean-drop 200000 --rate 50000 --seed 1
+#   python ota_flaky_server.py --tls --mean-drop 0    (benchmark, no drops)
+#   curl -k "https://host:8070/build/ESP32-TUX.bin?chunk=4096&rate=100000"
+#
+# Output per request:
+#   "GET /build/ESP32-TUX.bin HTTP/1.1" bytes=409600- => dropped after 183211 bytes
+import argparse
+import http.server
+import os
+import random
+import re
+import socket
+import socketserver
+import ssl
+import struct
+import time
+import urllib.parse
+
+RANGE_RE = re.compile(r"bytes=(\d+)-(\d*)$")
+
+
+class FlakyHandler(http.server.SimpleHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        path = self.translate_path(self.path)
+        if not os.path.isfile(path):
+            self.send_error(404)
+            return
+        size = os.path.getsize(path)
+        start, end = 0, size - 1
+        status = 200
+
+        header = self.headers.get("Range")
+        if header:
+            m = RANGE_RE.match(header.strip())
+            if not m or int(m.group(1)) >= size:
+                self.send_response(416)
+                self.send_header("Content-Range", f"bytes */{size}")
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            start = int(m.group(1))
+            if m.group(2):
+                end = min(int(m.group(2)), size - 1)
+            status = 206
+
+        length = end - start + 1
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(length))
+        self.send_header("Accept-Ranges", "bytes")
+        if status == 206:
+            self.send_header("Content-Range", f"bytes {start}-{end}/{size}")
+        self.end_headers()
+
+        cfg = self.server.cfg
+        opts = self.overrides()
+        mean_drop = opts.get("mean_drop", cfg.mean_drop)
+        drop_after = None
+        if mean_drop > 0 and cfg.rng.random() < cfg.drop_chance:
+            drop_after = int(cfg.rng.expovariate(1.0 / mean_drop))
+
+        try:
+            sent = self.send_body(path, start, length, drop_after,
+                                  opts.get("chunk", cfg.chunk), opts.get("rate", cfg.rate))
+        except (ConnectionError, ssl.SSLError):
+            # The client went away first, e.g. a device rebooting mid-download
+            self.close_connection = True
+            self.log_message('"%s" %s => %d, client disconnected', self.requestline, header or "-", status)
+            return
+        if sent is None:
+            return
+        self.log_message('"%s" %s => %d, %d bytes', self.requestline, header or "-", status, sent)
+
+    def overrides(self):
+        """Integer chunk, rate and mean_drop from the query string."""
+        query = urllib.parse.parse_qs(urllib.parse.urlsplit(self.path).query)
+        opts = {}
+        for key in ("chunk", "rate", "mean_drop"):
+            if key in query and query[key][-1].isdigit():
+                opts[key] = int(query[key][-1])
+        if opts.get("chunk") == 0:
+            del opts["chunk"]
+        return opts
+
+    def send_body(self, path, start, length, drop_after, chunk_size, rate):
+        header = self.headers.get("Range")
+        sent = 0
+        started = time.monotonic()
+        with open(path, "rb") as f:
+            f.seek(start)
+            while sent < length:
+                chunk = f.read(min(chunk_size, length - sent))
+                if drop_after is not None and sent + len(chunk) > drop_after:
+                    chunk = chunk[: max(0, drop_after - sent)]
+                    self.wfile.write(chunk)
+                    sent += len(chunk)
+                    self.log_message('"%s" %s => dropped after %d bytes', self.requestline,
+                                     header or "-", sent)
+                    self.close_connection = True
+                    # Abortive close, like a link going away mid-transfer
+                    self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+                    return None
+                self.wfile.write(chunk)
+                sent += len(chunk)
+                if rate > 0:
+                    # Throttle to the configured link rate
+                    ahead = sent / rate - (time.monotonic() - started)
+                    if ahead > 0:
+                        time.sleep(ahead)
+        return sent
+
+    def log_request(self, code="-", size="-"):
+        pass  # do_GET logs the outcome
+
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+
+
+def main():
+    ap = argparse.ArgumentParser(description="HTTP(S) file server that drops connections at random offsets")
+    ap.add_argument("--host", default="0.0.0.0")
+    ap.add_argument("--port", type=int, default=8070)
+    ap.add_argument("--dir", default=".", help="directory to serve")
+    ap.add_argument("--tls", action="store_true", help="use server_certs/ca_cert.pem and ca_key.pem")
+    ap.add_argument("--mean-drop", type=int, default=300000,
+                    help="mean bytes sent before a drop, 0 = never drop")
+    ap.add_argument("--drop-chance", type=float, default=0.8, help="share of responses that drop")
+    ap.add_argument("--rate", type=int, default=0, help="bytes/s per connection, 0 = unlimited")
+    ap.add_argument("--chunk", type=int, default=1460)
+    ap.add_argument("--seed", type=int, default=None)
+    args = ap.parse_args()
+    args.rng = random.Random(args.seed)
+
+    ctx = None
+    if args.tls:
+        ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        ctx.load_cert_chain(keyfile="server_certs/ca_key.pem", certfile="server_certs/ca_cert.pem")
+
+    os.chdir(args.dir)
+    with Server((args.host, args.port), FlakyHandler) as httpd:
+        httpd.cfg = args
+        if ctx:
+            httpd.socket = ctx.wrap_socket(httpd.socket, server_side=True)
+        scheme = "https" if args.tls else "http"
+        print(f"Flaky server at => {scheme}://{args.host}:{args.port}/ (mean drop {args.mean_drop} bytes)")
+        httpd.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,320 @@
+# OTA PACKAGE builder
+# Builds compressed (.txp) or delta OTA packages for components/ota
+# (CONFIG_OTA_PACKAGES). The device inflates / patches them while streaming
+# straight into the passive ota_N slot.
+#
+# A delta applies only to the exact image it was made from. The device asks for
+# <firmware url>.from-<first 8 hex of the running image's ELF SHA-256> first,
+# and falls back to <firmware url> (a full package or a plain .bin).
+#
+# The assets subcommand writes fatfs/assets.manifest for CONFIG_ASSETS_UPDATE:
+# the version goes up whenever a file changed, and the device downloads only
+# files whose SHA-256 differs from its own manifest.
+#
+# Usage:
+# python ota_pack.py pack build/ESP32-TUX.bin -o build/ESP32-TUX.txp
+# python ota_pack.py delta old/ESP32-TUX.bin build/ESP32-TUX.bin --url-dir build
+# python ota_pack.py apply build/ESP32-TUX.txp -o out.bin [--base old.bin]
+# python ota_pack.py check old/ESP32-TUX.bin build/ESP32-TUX.bin
+# python ota_pack.py assets fatfs [--version N]
+import argparse
+import hashlib
+import os
+import struct
+import sys
+import time
+import zlib
+
+# Same layout as ota_pkg_header_t in components/ota/ota_priv.h
+HEADER = struct.Struct('<IBBHII32s32s')
+MAGIC = 0x31505854  # "TXP1"
+VERSION = 1
+ENC_DEFLATE = 1
+ENC_DELTA = 2
+
+# Delta ops, inside the deflate stream
+OP_ADD = 1      # u32 base offset, u32 length, then length bytes added to base
+OP_LITERAL = 2  # u32 length, then length bytes
+OP = struct.Struct('<BII')
+LIT = struct.Struct('<BI')
+
+# First segment header + esp_app_desc_t.app_elf_sha256
+IMAGE_MAGIC = 0xE9
+APP_DESC_MAGIC = 0xABCD5432
+APP_DESC_OFFSET = 24 + 8
+ELF_SHA_OFFSET = APP_DESC_OFFSET + 144
+
+# Asset manifest, read by components/ota/ota_assets.c
+ASSET_MAGIC = 'TXA1'
+ASSET_MANIFEST = 'assets.manifest'
+ASSET_PATH_MAX = 31    # CONFIG_SPIFFS_OBJ_NAME_LEN - 1
+ASSET_MAX = 64
+
+KEY = 16        # bytes hashed per match candidate
+STRIDE = 8      # base positions indexed
+MIN_MATCH = 24
+CANDIDATES = 8
+
+
+def elf_sha(image):
+    if image[0] != IMAGE_MAGIC or struct.unpack_from('<I', image, APP_DESC_OFFSET)[0] != APP_DESC_MAGIC:
+        sys.exit('not an ESP app image')
+    return image[ELF_SHA_OFFSET:ELF_SHA_OFFSET + 32]
+
+
+def deflate(data):
+    c = zlib.compressobj(9, zlib.DEFLATED, -15, 9)
+    return c.compress(data) + c.flush()
+
+
+def header(encoding, image, base=b''):
+    return HEADER.pack(MAGIC, VERSION, encoding, HEADER.size, len(image), len(base),
+                       hashlib.sha256(image).digest(),
+                       hashlib.sha256(base).digest() if base else bytes(32))
+
+
+def pack(image):
+    return header(ENC_DEFLATE, image) + deflate(image)
+
+
+def extend(new, base, i, j):
+    """Length of the approximate match new[i:] ~ base[j:].
+
+    Keeps going through short runs of differing bytes (relocated addresses)
+    as long as at least half of every 16-byte window still matches, like
+    bsdiff. The add bytes are then mostly zero and deflate to almost nothing.
+    """
+    n = 0
+    limit = min(len(new) - i, len(base) - j)
+    while n < limit:
+        # Fast path over exact runs
+        step = min(256, limit - n)
+        if new[i + n:i + n + step] == base[j + n:j + n + step]:
+            n += step
+            continue
+        while n < limit and new[i + n] == base[j + n]:
+            n += 1
+        window = min(16, limit - n)
+        same = sum(1 for k in range(window) if new[i + n + k] == base[j + n + k])
+        if same * 2 < window or window == 0:
+            break
+        n += window
+    # Do not end on differing bytes
+    while n > 0 and new[i + n - 1] != base[j + n - 1]:
+        n -= 1
+    return n
+
+
+def diff(base, new):
+    index = {}
+    for j in range(0, len(base) - KEY + 1, STRIDE):
+        index.setdefault(base[j:j + KEY], []).append(j)
+
+    ops = bytearray()
+    literal_start = 0
+    i = 0
+    last_shift = None   # base - new offset of the previous match
+    stats = {'add': 0, 'literal': 0}
+
+    def flush_literal(end):
+        if end > literal_start:
+            ops.extend(LIT.pack(OP_LITERAL, end - literal_start))
+            ops.extend(new[literal_start:end])
+            stats['literal'] += end - literal_start
+
+    while i < len(new) - KEY:
+        best_j, best_n = -1, 0
+        candidates = list(index.get(new[i:i + KEY], ())[:CANDIDATES])
+        if last_shift is not None and 0 <= i + last_shift < len(base):
+            candidates.append(i + last_shift)
+        for j in candidates:
+            n = extend(new, base, i, j)
+            if n > best_n:
+                best_j, best_n = j, n
+        if best_n < MIN_MATCH:
+            i += 1
+            continue
+        flush_literal(i)
+        ops.extend(OP.pack(OP_ADD, best_j, best_n))
+        ops.extend((new[i + k] - base[best_j + k]) & 0xff for k in range(best_n))
+        stats['add'] += best_n
+        last_shift = best_j - i
+        i += best_n
+        literal_start = i
+    flush_literal(len(new))
+    return bytes(ops), stats
+
+
+def delta(base, image):
+    ops, stats = diff(base, image)
+    return header(ENC_DELTA, image, base) + deflate(ops), stats
+
+
+def apply(pkg, base=None):
+    magic, version, encoding, hsize, image_size, base_size, image_sha, base_sha = HEADER.unpack_from(pkg)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('not an OTA package')
+    body = zlib.decompressobj(-15).decompress(pkg[hsize:])
+    if encoding == ENC_DEFLATE:
+        out = body
+    elif encoding == ENC_DELTA:
+        if base is None or len(base) < base_size or hashlib.sha256(base[:base_size]).digest() != base_sha:
+            raise ValueError('delta does not apply to this base image')
+        out = bytearray()
+        p = 0
+        while p < len(body):
+            op = body[p]
+            if op == OP_ADD:
+                _, src, n = OP.unpack_from(body, p)
+                p += OP.size
+                out.extend((base[src + k] + body[p + k]) & 0xff for k in range(n))
+                p += n
+            elif op == OP_LITERAL:
+                _, n = LIT.unpack_from(body, p)
+                p += LIT.size
+                out.extend(body[p:p + n])
+                p += n
+            else:
+                raise ValueError('bad op %d at %d' % (op, p))
+    else:
+        raise ValueError('unknown encoding %d' % encoding)
+    if len(out) != image_size or hashlib.sha256(out).digest() != image_sha:
+        raise ValueError('reconstructed image does not verify')
+    return bytes(out)
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def write(path, data):
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+def delta_name(base):
+    return '.from-' + elf_sha(base)[:4].hex()
+
+
+def ratio(pkg, image):
+    return '%d bytes, %.1f%% of %d' % (len(pkg), 100.0 * len(pkg) / len(image), len(image))
+
+
+def asset_entries(root):
+    entries = []
+    for d, dirs, files in os.walk(root):
+        dirs.sort()
+        for name in sorted(files):
+            path = os.path.relpath(os.path.join(d, name), root).replace(os.sep, '/')
+            if path == ASSET_MANIFEST:
+                continue
+            if len(path) > ASSET_PATH_MAX or ' ' in path:
+                sys.exit('%s: SPIFFS names are at most %d characters, without spaces' % (path, ASSET_PATH_MAX))
+            data = read(os.path.join(d, name))
+            entries.append((hashlib.sha256(data).hexdigest(), len(data), path))
+    if len(entries) > ASSET_MAX:
+        sys.exit('%d assets, the device takes at most %d' % (len(entries), ASSET_MAX))
+    return entries
+
+
+def read_manifest(path):
+    """(version, entries) of an existing manifest, (0, []) without one."""
+    if not os.path.exists(path):
+        return 0, []
+    lines = read(path).decode().splitlines()
+    magic, version = lines[0].split()
+    if magic != ASSET_MAGIC:
+        sys.exit('%s: not an asset manifest' % path)
+    return int(version), [(h, int(n), p) for h, n, p in (line.split() for line in lines[1:] if line)]
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Build and check OTA packages')
+    sub = ap.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('pack', help='compressed full image')
+    p.add_argument('image')
+    p.add_argument('-o', '--out', required=True)
+    p = sub.add_parser('delta', help='delta against the image running on the device')
+    p.add_argument('base')
+    p.add_argument('image')
+    p.add_argument('-o', '--out', help='output file')
+    p.add_argument('--url-dir', help='write <image name>.from-<sha> here, as the device requests it')
+    p = sub.add_parser('apply', help='reconstruct an image from a package')
+    p.add_argument('package')
+    p.add_argument('-o', '--out', required=True)
+    p.add_argument('--base')
+    p = sub.add_parser('assets', help='write the asset manifest of a SPIFFS image directory')
+    p.add_argument('dir')
+    p.add_argument('--version', type=int, help='default: one up if anything changed')
+    p = sub.add_parser('check', help='build both package types and verify they reconstruct')
+    p.add_argument('base')
+    p.add_argument('image')
+    args = ap.parse_args()
+
+    if args.cmd == 'pack':
+        image = read(args.image)
+        elf_sha(image)
+        pkg = pack(image)
+        write(args.out, pkg)
+        print('%s: %s' % (args.out, ratio(pkg, image)))
+    elif args.cmd == 'delta':
+        base, image = read(args.base), read(args.image)
+        elf_sha(image)
+        out = args.out
+        if args.url_dir:
+            out = os.path.join(args.url_dir, os.path.basename(args.image) + delta_name(base))
+        if not out:
+            sys.exit('need --out or --url-dir')
+        pkg, stats = delta(base, image)
+        write(out, pkg)
+        print('%s: %s (%d bytes copied with adds, %d literal)' %
+              (out, ratio(pkg, image), stats['add'], stats['literal']))
+        if len(pkg) >= len(pack(image)):
+            print('note: the delta is no smaller than a full package of this image')
+    elif args.cmd == 'apply':
+        base = read(args.base) if args.base else None
+        try:
+            image = apply(read(args.package), base)
+        except ValueError as e:
+            sys.exit(str(e))
+        write(args.out, image)
+        print('%s: %d bytes, SHA-256 verified' % (args.out, len(image)))
+    elif args.cmd == 'assets':
+        path = os.path.join(args.dir, ASSET_MANIFEST)
+        old_version, old = read_manifest(path)
+        entries = asset_entries(args.dir)
+        version = args.version
+        if version is None:
+            version = old_version if entries == old else old_version + 1
+        if version < old_version or (version == old_version and entries != old):
+            sys.exit('version %d: devices with version %d would not update' % (version, old_version))
+        changed = set(entries) - set(old)
+        with open(path, 'w', newline='\n') as f:
+            f.write('%s %d\n' % (ASSET_MAGIC, version))
+            for entry in entries:
+                f.write('%s %d %s\n' % entry)
+        print('%s: version %d, %d files, %d bytes' % (path, version, len(entries), sum(n for _, n, _ in entries)))
+        for _, n, p in sorted(changed, key=lambda e: e[2]):
+            print('  changed: %s (%d bytes)' % (p, n))
+    elif args.cmd == 'check':
+        base, image = read(args.base), read(args.image)
+        elf_sha(image)
+        t = time.monotonic()
+        full = pack(image)
+        print('pack:  %s in %.1f s' % (ratio(full, image), time.monotonic() - t))
+        t = time.monotonic()
+        pkg, stats = delta(base, image)
+        print('delta: %s in %.1f s' % (ratio(pkg, image), time.monotonic() - t))
+        ok = apply(full) == image and apply(pkg, base) == image
+        try:
+            apply(pkg, base[:-1] + bytes([base[-1] ^ 1]))
+            ok = False
+        except ValueError:
+            pass  # a delta must refuse any other base
+        print('reconstruct: %s' % ('OK' if ok else 'FAILED'))
+        sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,80 @@
+# SIGNAL K delta stream stand-in
+# Replays a recorded delta stream (one JSON delta per line) to every client
+# that connects to ws://HOST:PORT/signalk/v1/stream, like a Signal K server.
+# Lines may start with a millisecond timestamp and a ';' to keep the timing:
+#   1676196776123;{"context":"vessels.self","updates":[...]}
+# Requires: pip install websockets
+
+# Usage:
+# python signalk_replay.py recording.log [--speed 4] [--loop]
+import argparse
+import asyncio
+import json
+import websockets
+
+HOST = '0.0.0.0'
+PORT = 3000
+
+HELLO = {"name": "signalk_replay", "version": "1.0.0", "self": "vessels.self",
+         "roles": ["master", "main"]}
+
+
+def load(path):
+    deltas = []
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            stamp, sep, body = line.partition(';')
+            if sep and stamp.isdigit():
+                deltas.append((int(stamp), body))
+            else:
+                deltas.append((None, line))
+    return deltas
+
+
+async def replay(websocket, deltas, speed, loop):
+    await websocket.send(json.dumps(HELLO))
+    sent = 0
+    start = asyncio.get_running_loop().time()
+    while True:
+        first = None
+        for stamp, body in deltas:
+            if stamp is not None:
+                first = stamp if first is None else first
+                delay = (stamp - first) / 1000.0 / speed
+                wait = start + delay - asyncio.get_running_loop().time()
+                if wait > 0:
+                    await asyncio.sleep(wait)
+            await websocket.send(body)
+            sent += 1
+        if not loop:
+            break
+        start = asyncio.get_running_loop().time()
+    elapsed = asyncio.get_running_loop().time() - start
+    print("Sent {} deltas in {:.1f}s".format(sent, elapsed))
+
+
+async def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('recording')
+    parser.add_argument('--speed', type=float, default=1.0,
+                        help='replay speed, e.g. 4 for 4x real time')
+    parser.add_argument('--loop', action='store_true')
+    args = parser.parse_args()
+    deltas = load(args.recording)
+
+    async def handler(websocket, path=None):
+        # The subscription message is accepted but not filtered on
+        print("Client connected")
+        try:
+            await replay(websocket, deltas, args.speed, args.loop)
+        except websockets.ConnectionClosed:
+            print("Client disconnected")
+
+    async with websockets.serve(handler, HOST, PORT):
+        print("Signal K stand-in listening at => ws://" + HOST + ":" + str(PORT) + "/signalk/v1/stream")
+        await asyncio.Future()
+
+asyncio.run(main())